@@ -42,6 +42,15 @@ bool DecompressorBase::identify()
 	return identify(f);
 }
 
+bool DecompressorBase::decompress(const PPSystemString& outFileName, Hints hint)
+{
+	XMFile f(outFileName, true);
+	if (!f.isOpenForWriting())
+		return false;
+	
+	return decompressTo(f, hint);
+}
+
 void DecompressorBase::setFilename(const PPSystemString& fileName)
 {
 	this->fileName = fileName;
@@ -133,6 +142,29 @@ bool Decompressor::decompress(const PPSystemString& outFileName, Hints hint)
 	return result;
 }
 
+bool Decompressor::decompressTo(XMFileBase& outFile, Hints hint)
+{
+	const mp_uint32 startPos = outFile.pos();
+	
+	for (pp_int32 i = 0; i < decompressors.size(); i++)
+	{
+		if (decompressors.get(i)->identify())
+		{
+			if (decompressors.get(i)->decompressTo(outFile, hint))
+				return true;
+			
+			// let the next one start over, a file which still holds
+			// the leftovers of the failed attempt is of no use
+			if (outFile.size() > startPos && !outFile.truncate(startPos))
+				return false;
+			
+			outFile.seek(startPos);
+		}
+	}
+	
+	return false;
+}
+
 DecompressorBase* Decompressor::clone()
 {
 	return new Decompressor(fileName);
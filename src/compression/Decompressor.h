@@ -35,6 +35,7 @@
 #include "SimpleVector.h"
 
 class XMFile;
+class XMFileBase;
 
 class DecompressorBase
 {
@@ -66,7 +67,10 @@ public:
 	
 	virtual const PPSimpleVector<Descriptor>& getDescriptors(Hints hint) const = 0;
 	
-	virtual bool decompress(const PPSystemString& outFileName, Hints hint) = 0;
+	virtual bool decompress(const PPSystemString& outFileName, Hints hint);
+
+	// Decompress into any kind of file, e.g. an XMFileBuffer to keep it in memory
+	virtual bool decompressTo(XMFileBase& outFile, Hints hint) = 0;
 	
 	static void removeFile(const PPSystemString& fileName);
 	
@@ -96,6 +100,8 @@ public:
 
 	virtual bool decompress(const PPSystemString& outFileName, Hints hint);
 	
+	virtual bool decompressTo(XMFileBase& outFile, Hints hint);
+	
 	virtual DecompressorBase* clone();
 
 	virtual void setFilename(const PPSystemString& fileName);
@@ -36,10 +36,8 @@
 
 struct ModuleIdentificator : public Unlzx::FileIdentificator 
 {
-	virtual bool identify(const PPSystemString& filename) const
+	virtual bool identify(XMFileBase& file) const
 	{
-		XMFile file(filename);
-		
 		mp_ubyte buff[XModule::IdentificationBufferSize];
 		memset(buff, 0, sizeof(buff));
 
@@ -72,7 +70,7 @@ const PPSimpleVector<Descriptor>& DecompressorLZX::getDescriptors(Hints hint) co
 	return descriptors;
 }		
 	
-bool DecompressorLZX::decompress(const PPSystemString& outFilename, Hints hint)
+bool DecompressorLZX::decompressTo(XMFileBase& outFile, Hints hint)
 {
 	// If client requests something else than a module we can't deal we that
 	if (hint != HintAll &&
@@ -82,7 +80,7 @@ bool DecompressorLZX::decompress(const PPSystemString& outFilename, Hints hint)
 	ModuleIdentificator identificator;
 	Unlzx unlzx(fileName, &identificator);
 	
-	return unlzx.extractFile(true, &outFilename);
+	return unlzx.extractFile(true, &outFile);
 }
 
 DecompressorBase* DecompressorLZX::clone()
@@ -48,7 +48,7 @@ public:
 	
 	virtual const PPSimpleVector<Descriptor>& getDescriptors(Hints hint) const;
 
-	virtual bool decompress(const PPSystemString& outFilename, Hints hint);
+	virtual bool decompressTo(XMFileBase& outFile, Hints hint);
 	
 	virtual DecompressorBase* clone();
 };
@@ -53,6 +53,9 @@ public:
 
 	virtual bool decompress(const PPSystemString& outFilename, Hints hint);
 	
+	// QTKit can only export into files
+	virtual bool decompressTo(XMFileBase& outFile, Hints hint) { return false; }
+	
 	virtual DecompressorBase* clone();
 };
 
@@ -33,6 +33,8 @@
 
 #include "BasicTypes.h"
 
+class XMFileBase;
+
 class ZipExtractor
 {
 private:
@@ -41,7 +43,7 @@ private:
 public:
 	ZipExtractor(const PPSystemString& archivePath);
 
-	bool parseZip(pp_int32& err, bool extract, const PPSystemString* outFile);
+	bool parseZip(pp_int32& err, bool extract, XMFileBase* outFile);
 };
 
 #endif
@@ -610,21 +610,66 @@ void Unlzx::decrunch(struct UnLZX *unlzx)
 	unlzx->global_shift = shift;
 }
 
-XMFile* Unlzx::open_output(const PPSystemString& filename)
+XMFileBase* Unlzx::open_output(const PPSystemString& filename, struct UnLZX *unlzx)
 {
+	// when extracting into a given file every entry goes into memory
+	// first, only the one the identificator accepts is handed over
+	if (unlzx->outputFile)
+		return new XMFileBuffer();
+
 	XMFile *file = new XMFile(filename, true);
 	
 	if (!file->isOpenForWriting())
+	{
+		delete file;
 		return NULL;
+	}
 	
 	return(file);
 }
 
+bool Unlzx::close_output(XMFileBase* out_file, struct UnLZX *unlzx, bool identify)
+{
+	bool found = false;
+	
+	if (unlzx->outputFile)
+	{
+		XMFileBuffer* buffer = static_cast<XMFileBuffer*>(out_file);
+		
+		if (identify && identificator)
+		{
+			buffer->seek(0);
+			found = identificator->identify(*buffer);
+		}
+		
+		if (found)
+		{
+			const mp_sint32 size = (mp_sint32)buffer->size();
+			found = unlzx->outputFile->write(buffer->getData(), 1, size) == size;
+		}
+		
+		delete buffer;
+	}
+	else
+	{
+		PPSystemString fileName = out_file->getFileName();
+		delete out_file;
+		
+		if (identify && identificator)
+		{
+			XMFile file(fileName);
+			found = identificator->identify(file);
+		}
+	}
+	
+	return found;
+}
+
 signed long Unlzx::extract_normal(XMFile* in_file, struct UnLZX *unlzx, bool& found)
 {
 	found = false;
 	struct filename_node *node;
-	XMFile *out_file = NULL;
+	XMFileBase *out_file = NULL;
 	unsigned char *pos, *temp;
 	unsigned long count;
 	signed long abort = 0;
@@ -656,7 +701,7 @@ signed long Unlzx::extract_normal(XMFile* in_file, struct UnLZX *unlzx, bool& fo
 #ifdef UNLZX_DEBUG
 			printf("Extracting \"%s\"...", (char *)node->filename);
 #endif			
-			out_file = unlzx->temporaryFile ? open_output(*(unlzx->temporaryFile)) : open_output(PPSystemString((const char*)unlzx->work_buffer));
+			out_file = open_output(PPSystemString((const char*)unlzx->work_buffer), unlzx);
 		}
 		else
 		{
@@ -741,16 +786,13 @@ signed long Unlzx::extract_normal(XMFile* in_file, struct UnLZX *unlzx, bool& fo
 		}
 		if (out_file)
 		{
-			PPSystemString fileName = out_file->getFileName();
-			delete out_file;
-			if (!abort)
-			{
 #ifdef UNLZX_DEBUG
+			if (!abort)
 				printf(" crc %s\n", (char *)((node->crc == unlzx->sum) ? "good" : "bad"));
 #endif				
-				if (identificator)
-					found = identificator->identify(fileName);
-			}
+			// the first module found is kept
+			if (close_output(out_file, unlzx, !abort && !found))
+				found = true;
 		}
 	}
 	return(abort);
@@ -759,7 +801,7 @@ signed long Unlzx::extract_normal(XMFile* in_file, struct UnLZX *unlzx, bool& fo
 signed long Unlzx::extract_store(XMFile* in_file, struct UnLZX *unlzx, bool& found)
 {
 	struct filename_node *node;
-	XMFile *out_file = NULL;
+	XMFileBase *out_file = NULL;
 	unsigned long count;
 	signed long abort = 0;
 	
@@ -781,7 +823,7 @@ signed long Unlzx::extract_store(XMFile* in_file, struct UnLZX *unlzx, bool& fou
 #ifdef UNLZX_DEBUG
 			printf("Storing \"%s\"...", (char *)node->filename);
 #endif
-			out_file = unlzx->temporaryFile ? open_output(*(unlzx->temporaryFile)) : open_output(PPSystemString((const char*)unlzx->work_buffer));
+			out_file = open_output(PPSystemString((const char*)unlzx->work_buffer), unlzx);
 		}
 		else
 		{
@@ -825,16 +867,13 @@ signed long Unlzx::extract_store(XMFile* in_file, struct UnLZX *unlzx, bool& fou
 		}
 		if (out_file)
 		{
-			PPSystemString fileName = out_file->getFileName();
-			delete out_file;
-			if (!abort)
-			{
 #ifdef UNLZX_DEBUG
+			if (!abort)
 				printf(" crc %s\n", (char *)((node->crc == unlzx->sum) ? "good" : "bad"));
 #endif				
-				if (identificator)
-					found = identificator->identify(fileName);
-			}
+			// the first module found is kept
+			if (close_output(out_file, unlzx, !abort && !found))
+				found = true;
 		}
 	}
 	return(abort);
@@ -1323,7 +1362,7 @@ Unlzx::~Unlzx()
 		unlzx_free(unlzx);
 }
 
-bool Unlzx::extractFile(bool extract, const PPSystemString* outFilename)
+bool Unlzx::extractFile(bool extract, XMFileBase* outFile)
 {
 	int result = 0;
 	
@@ -1332,7 +1371,7 @@ bool Unlzx::extractFile(bool extract, const PPSystemString* outFilename)
 		if (extract)
 		{
 			unlzx->mode = 1;
-			unlzx->temporaryFile = outFilename;
+			unlzx->outputFile = outFile;
 			bool found = false;
 			// TODO: make this all type safe
 			result = process_archive(archiveFilename, unlzx, found);
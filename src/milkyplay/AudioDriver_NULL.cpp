@@ -38,15 +38,20 @@
 #include "AudioDriver_NULL.h"
 #include "MasterMixer.h"
 
-AudioDriver_NULL::AudioDriver_NULL() :
+AudioDriver_NULL::AudioDriver_NULL(SampleFormats sampleFormat/* = SampleFormat16Bit*/) :
 	numSamplesWritten(0),
-	compensateBuffer(0)
+	sampleFormat(sampleFormat),
+	compensateBuffer(0),
+	compensateBuffer32(0),
+	compensateBufferFloat(0)
 {
 }
 
 AudioDriver_NULL::~AudioDriver_NULL() 
 {
 	delete[] compensateBuffer;
+	delete[] compensateBuffer32;
+	delete[] compensateBufferFloat;
 }
 
 mp_sint32 AudioDriver_NULL::initDevice(mp_sint32 bufferSizeInWords, mp_uint32 mixFrequency, MasterMixer* mixer)
@@ -58,7 +63,23 @@ mp_sint32 AudioDriver_NULL::initDevice(mp_sint32 bufferSizeInWords, mp_uint32 mi
 	numSamplesWritten = 0;
 	
 	delete[] compensateBuffer;
-	compensateBuffer = new mp_sword[bufferSizeInWords];
+	compensateBuffer = NULL;
+	delete[] compensateBuffer32;
+	compensateBuffer32 = NULL;
+	delete[] compensateBufferFloat;
+	compensateBufferFloat = NULL;
+	
+	switch (sampleFormat)
+	{
+		case SampleFormat32Bit:
+			compensateBuffer32 = new mp_sint32[bufferSizeInWords];
+			break;
+		case SampleFormatFloat:
+			compensateBufferFloat = new float[bufferSizeInWords];
+			break;
+		default:
+			compensateBuffer = new mp_sword[bufferSizeInWords];
+	}
 
 	return MP_OK;
 }
@@ -92,7 +113,19 @@ void AudioDriver_NULL::advance()
 {
 	numSamplesWritten+=bufferSize / MP_NUMCHANNELS;	
 	
-    if (mixer->isPlaying())
-        mixer->mixerHandler(compensateBuffer);	
+	if (!mixer->isPlaying())
+		return;
+	
+	switch (sampleFormat)
+	{
+		case SampleFormat32Bit:
+			mixer->mixerHandler(compensateBuffer32);
+			break;
+		case SampleFormatFloat:
+			mixer->mixerHandler(compensateBufferFloat);
+			break;
+		default:
+			mixer->mixerHandler(compensateBuffer);
+	}
 }
 
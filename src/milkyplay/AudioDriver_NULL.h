@@ -43,12 +43,25 @@
 
 class AudioDriver_NULL : public AudioDriverBase
 {
+public:
+	// format of the buffer the mixer output is written to, 
+	// anything but 16 bit is taken from the mixer unclipped
+	enum SampleFormats
+	{
+		SampleFormat16Bit,		// compensateBuffer
+		SampleFormat32Bit,		// compensateBuffer32, see MasterMixer::mixerHandler
+		SampleFormatFloat		// compensateBufferFloat, full scale is -1.0 .. 1.0
+	};
+
 protected:
 	mp_uint32	numSamplesWritten;
+	SampleFormats sampleFormat;
 	mp_sword*	compensateBuffer;
+	mp_sint32*	compensateBuffer32;
+	float*		compensateBufferFloat;
 	
 public:
-				AudioDriver_NULL();
+				AudioDriver_NULL(SampleFormats sampleFormat = SampleFormat16Bit);
 
 	virtual		~AudioDriver_NULL();
 			
@@ -68,6 +81,8 @@ public:
 
 	virtual		void		advance();
 
+	SampleFormats			getSampleFormat() const { return sampleFormat; }
+
 };
 
 #endif
@@ -36,6 +36,7 @@
  */
 
 #include "AudioDriver_WAVWriter.h"
+#include "MasterMixer.h"
 
 struct TWAVHeader
 {
@@ -43,17 +44,44 @@ struct TWAVHeader
 	mp_dword length;			// filesize - 8
 	mp_ubyte WAVE[4];			// "WAVE"
 	mp_ubyte FMT[4];			// "fmt "
-	mp_dword fmtDataLength;		// = 16
-	mp_uword encodingTag;		
+	mp_dword fmtDataLength;		// = 16 (PCM) or 18 (float)
+	mp_uword encodingTag;		// 1 = PCM, 3 = IEEE float
 	mp_uword numChannels;		// Channels: 1 = mono, 2 = stereo
 	mp_dword sampleRate;		// Samples per second: e.g., 44100
 	mp_dword bytesPerSecond;	// sample rate * block align
 	mp_uword blockAlign;		// channels * numBits / 8
-	mp_uword numBits;			// 8 or 16
+	mp_uword numBits;			// 8, 16, 24 or 32
+	mp_uword extensionSize;		// = 0, not present for PCM
+	mp_ubyte FACT[4];			// "fact", not present for PCM
+	mp_dword factDataLength;	// = 4
+	mp_dword numSampleFrames;	// number of samples per channel
 	mp_ubyte DATA[4];			// "data"
 	mp_dword dataLength;		// sample data size
 };
 
+static void buildWAVHeader(TWAVHeader& hdr, WAVWriter::WAVFormats format, mp_sint32 sampleRate, mp_uint32 numSamples)
+{
+	const bool pcm = format != WAVWriter::WAVFormatFloat;
+
+	memcpy(hdr.RIFF, "RIFF", 4);
+	memcpy(hdr.WAVE, "WAVE", 4);
+	memcpy(hdr.FMT, "fmt ", 4);
+	hdr.fmtDataLength = pcm ? 16 : 18;
+	hdr.encodingTag = pcm ? 1 : 3;
+	hdr.numChannels = 2;
+	hdr.sampleRate = sampleRate;
+	hdr.numBits = format == WAVWriter::WAVFormat24Bit ? 24 : (format == WAVWriter::WAVFormatFloat ? 32 : 16);
+	hdr.blockAlign = (hdr.numChannels*hdr.numBits) / 8;
+	hdr.bytesPerSecond = hdr.sampleRate*hdr.blockAlign;
+	hdr.extensionSize = 0;
+	memcpy(hdr.FACT, "fact", 4);
+	hdr.factDataLength = 4;
+	hdr.numSampleFrames = numSamples;
+	memcpy(hdr.DATA, "data", 4);
+	hdr.dataLength = numSamples*hdr.blockAlign;	
+	hdr.length = (pcm ? 44 : 58) + hdr.dataLength - 8;
+}
+
 static void writeWAVHeader(XMFile* f, const TWAVHeader& hdr)
 {
 	f->write(hdr.RIFF, 1, 4);
@@ -73,14 +101,39 @@ static void writeWAVHeader(XMFile* f, const TWAVHeader& hdr)
 	f->writeWord(hdr.blockAlign);
 	f->writeWord(hdr.numBits);
 	
+	// non-PCM formats need the extension size and a fact chunk
+	if (hdr.encodingTag != 1)
+	{
+		f->writeWord(hdr.extensionSize);
+		
+		f->write(hdr.FACT, 1, 4);
+		f->writeDword(hdr.factDataLength);
+		f->writeDword(hdr.numSampleFrames);
+	}
+	
 	f->write(hdr.DATA, 1, 4);	
 	f->writeDword(hdr.dataLength);
 }
 
-WAVWriter::WAVWriter(const SYSCHAR* fileName) :
-	AudioDriver_NULL(),
+static AudioDriver_NULL::SampleFormats getSampleFormatForWAVFormat(WAVWriter::WAVFormats format)
+{
+	switch (format)
+	{
+		case WAVWriter::WAVFormat24Bit:
+			return AudioDriver_NULL::SampleFormat32Bit;
+		case WAVWriter::WAVFormatFloat:
+			return AudioDriver_NULL::SampleFormatFloat;
+		default:
+			return AudioDriver_NULL::SampleFormat16Bit;
+	}
+}
+
+WAVWriter::WAVWriter(const SYSCHAR* fileName, WAVFormats format/* = WAVFormat16Bit*/) :
+	AudioDriver_NULL(getSampleFormatForWAVFormat(format)),
 	f(NULL),
-	mixFreq(44100)
+	mixFreq(44100),
+	format(format),
+	buffer24(NULL)
 {
 	TWAVHeader hdr;
 	
@@ -94,20 +147,7 @@ WAVWriter::WAVWriter(const SYSCHAR* fileName) :
 	else
 	{
 		// build wav header
-		memcpy(hdr.RIFF, "RIFF", 4);
-		hdr.length = 44 - 8;
-		memcpy(hdr.WAVE, "WAVE", 4);
-		memcpy(hdr.FMT, "fmt ", 4);
-		hdr.fmtDataLength = 16;
-		hdr.encodingTag = 1;
-		hdr.numChannels = 2;
-		hdr.sampleRate = mixFreq;
-		hdr.numBits = 16;
-		hdr.blockAlign = (hdr.numChannels*hdr.numBits) / 8;
-		hdr.bytesPerSecond = hdr.sampleRate*hdr.blockAlign;
-		memcpy(hdr.DATA, "data", 4);
-		hdr.dataLength = 0;	
-		
+		buildWAVHeader(hdr, format, mixFreq, 0);
 		writeWAVHeader(f, hdr);
 	}
 }
@@ -116,6 +156,8 @@ WAVWriter::~WAVWriter()
 {
 	if (f)
 		delete f;
+		
+	delete[] buffer24;
 }
 
 mp_sint32 WAVWriter::initDevice(mp_sint32 bufferSizeInWords, mp_uint32 mixFrequency, MasterMixer* mixer)
@@ -125,6 +167,12 @@ mp_sint32 WAVWriter::initDevice(mp_sint32 bufferSizeInWords, mp_uint32 mixFreque
 		return res;
 
 	mixFreq = mixFrequency;
+	
+	delete[] buffer24;
+	buffer24 = NULL;
+	if (format == WAVFormat24Bit)
+		buffer24 = new mp_ubyte[bufferSizeInWords*3];
+	
 	return MP_OK;
 }
 
@@ -136,19 +184,7 @@ mp_sint32 WAVWriter::closeDevice()
 	TWAVHeader hdr;
 	
 	// build wav header
-	memcpy(hdr.RIFF, "RIFF", 4);
-	hdr.length = 44 + numSamplesWritten*4 - 8;
-	memcpy(hdr.WAVE, "WAVE", 4);
-	memcpy(hdr.FMT, "fmt ", 4);
-	hdr.fmtDataLength = 16;
-	hdr.encodingTag = 1;
-	hdr.numChannels = 2;
-	hdr.sampleRate = mixFreq;
-	hdr.numBits = 16;
-	hdr.blockAlign = (hdr.numChannels*hdr.numBits) / 8;
-	hdr.bytesPerSecond = hdr.sampleRate*hdr.blockAlign;
-	memcpy(hdr.DATA, "data", 4);
-	hdr.dataLength = (numSamplesWritten*2*hdr.numBits)/8;	
+	buildWAVHeader(hdr, format, mixFreq, numSamplesWritten);
 		
 	f->seek(0);
 
@@ -164,6 +200,38 @@ void WAVWriter::advance()
 	if (!f)
 		return;
 	
-	f->writeWords((mp_uword*)compensateBuffer, bufferSize);
+	switch (format)
+	{
+		case WAVFormat24Bit:
+		{
+			// same clipping as the 16 bit output, the upper 16 bits are identical
+			const mp_sint32 sampleShift = mixer->getSampleShift();
+			const mp_sint32 lowerBound = -((128<<sampleShift)*256); 
+			const mp_sint32 upperBound = ((128<<sampleShift)*256)-1;
+			
+			const mp_sint32* bufferIn = compensateBuffer32;
+			mp_ubyte* bufferOut = buffer24;
+			for (mp_sint32 i = 0; i < bufferSize; i++)
+			{
+				mp_sint32 b = *bufferIn++;
+				if (b>upperBound) b = upperBound; 
+				else if (b<lowerBound) b = lowerBound; 
+				b = sampleShift >= 8 ? (b >> (sampleShift-8)) : (b << (8-sampleShift));
+				
+				*bufferOut++ = (mp_ubyte)b;
+				*bufferOut++ = (mp_ubyte)(b >> 8);
+				*bufferOut++ = (mp_ubyte)(b >> 16);
+			}
+			
+			f->write(buffer24, 3, bufferSize);
+			break;
+		}
+		
+		case WAVFormatFloat:
+			f->writeDwords((mp_dword*)compensateBufferFloat, bufferSize);
+			break;
+			
+		default:
+			f->writeWords((mp_uword*)compensateBuffer, bufferSize);
+	}
 }
-
@@ -43,12 +43,23 @@
 
 class WAVWriter : public AudioDriver_NULL
 {
+public:
+	enum WAVFormats
+	{
+		WAVFormat16Bit,
+		WAVFormat24Bit,
+		// IEEE float, not clipped
+		WAVFormatFloat
+	};
+
 private:
 	XMFile*		f;
 	mp_sint32	mixFreq;
+	WAVFormats	format;
+	mp_ubyte*	buffer24;
 	
 public:
-				WAVWriter(const SYSCHAR* fileName);
+				WAVWriter(const SYSCHAR* fileName, WAVFormats format = WAVFormat16Bit);
 
 	virtual		~WAVWriter();
 			
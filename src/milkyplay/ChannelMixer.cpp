@@ -42,6 +42,7 @@
 #include "ResamplerFactory.h"
 #include "ResamplerMacros.h"
 #include "AudioDriverManager.h"
+#include "LockFreeRingBuffer.h"
 #include <math.h>
  
 // Ramp out will last (THEBEATLENGTH*RAMPDOWNFRACTION)>>8 samples
@@ -63,6 +64,42 @@ static inline mp_sint32 myMod(mp_sint32 a, mp_sint32 b)
   - Saga_Musix @ http://modarchive.org/forums/index.php?topic=3517.0
 */
 mp_sint32 ChannelMixer::panLUT[257];
+
+// FT2 panning law
+ChannelMixer::PanLUTInitializer::PanLUTInitializer()
+{
+	for (int i = 0; i <= 256; i++)
+		panLUT[i] = static_cast<mp_sint32> (8192.0 * sqrt(i/256.0) + 0.5);
+}
+
+ChannelMixer::PanLUTInitializer ChannelMixer::panLUTInitializer;
+
+// Thanks to DUMB for the filter coefficient computations
+// (IT filter cutoffs come in 1/256 steps)
+static inline double filterCutoffToInvAngle(double sampfreq, double cutoff)
+{
+	return sampfreq * pow(0.5, 0.25 + cutoff*(1.0/(24<<8))) * (1.0/(2*3.14159265358979323846*110.0));
+}
+
+static inline float filterResonanceToLoss(mp_sint32 resonance)
+{
+	const float LOG10 = 2.30258509299f;
+	return (float)exp(resonance*(-LOG10*1.2/128.0));
+}
+
+double ChannelMixer::filterCutoffFractionLUT[256];
+float ChannelMixer::filterResonanceLUT[128];
+
+ChannelMixer::FilterLUTInitializer::FilterLUTInitializer()
+{
+	for (int i = 0; i < 256; i++)
+		filterCutoffFractionLUT[i] = pow(0.5, i*(1.0/(24<<8)));
+	for (int i = 0; i < 128; i++)
+		filterResonanceLUT[i] = filterResonanceToLoss(i);
+}
+
+ChannelMixer::FilterLUTInitializer ChannelMixer::filterLUTInitializer;
+
 void ChannelMixer::panToVol (ChannelMixer::TMixerChannel *chn, mp_sint32 &volL, mp_sint32 &volR)
 {
 	mp_sint32 pan = (((chn->pan - 128)*panningSeparation) >> 8) + 128;
@@ -76,18 +113,41 @@ void ChannelMixer::panToVol (ChannelMixer::TMixerChannel *chn, mp_sint32 &volL,
 		volL = volR = 0;
 }
 
-void ChannelMixer::ResamplerBase::addChannelsNormal(ChannelMixer* mixer, mp_uint32 numChannels, mp_sint32* buffer32,mp_sint32 beatNum, mp_sint32 beatlength)
+// filter coefficient changes are ramped over a beat packet like volume 
+// changes, fades jump to the new coefficients
+static inline void startFilterRamp(ChannelMixer::TMixerChannel* chn, mp_sint32 rampl)
+{
+	chn->rampFilterStepA = (chn->toa-chn->a)/rampl;
+	chn->rampFilterStepB = (chn->tob-chn->b)/rampl;
+	chn->rampFilterStepC = (chn->toc-chn->c)/rampl;
+}
+
+static inline void endFilterRamp(ChannelMixer::TMixerChannel* chn)
+{
+	chn->a = chn->toa;
+	chn->b = chn->tob;
+	chn->c = chn->toc;
+	chn->rampFilterStepA = chn->rampFilterStepB = chn->rampFilterStepC = 0;
+}
+
+void ChannelMixer::ResamplerBase::addChannelsNormal(ChannelMixer* mixer, mp_uint32 numChannels, mp_sint32* mixBuffer32,mp_sint32 beatNum, mp_sint32 beatlength, mp_sint32 beatSize)
 {
 	ChannelMixer::TMixerChannel* channel = mixer->channel;
 	ChannelMixer::TMixerChannel* newChannel = mixer->newChannel;
+	const ChannelMixer::TActiveVoice* activeVoices = mixer->activeVoices;
+	const mp_uint32 numActiveVoices = mixer->numActiveVoices;
 	
-	for (mp_uint32 c=0;c<numChannels;c++) 
+	for (mp_uint32 v=0;v<numActiveVoices;v++) 
 	{
+		const mp_uint32 c = activeVoices[v].channel;
 		ChannelMixer::TMixerChannel* chn = &channel[c];
-		chn->index = c;		// For Amiga resampler
 
-		if (!(chn->flags & MP_SAMPLE_PLAY))
+		if (c >= numChannels || !(chn->flags & MP_SAMPLE_PLAY))
 			continue;
+
+		chn->index = c;		// For Amiga resampler
+		
+		mp_sint32* buffer32 = mixer->getChannelBuffer(chn, mixBuffer32);
 	
 		switch (chn->flags&(MP_SAMPLE_FADEOUT|MP_SAMPLE_FADEIN|MP_SAMPLE_FADEOFF))
 		{
@@ -119,29 +179,47 @@ void ChannelMixer::ResamplerBase::addChannelsNormal(ChannelMixer* mixer, mp_uint
 		}
 		
 		// mix here
-		addChannel(chn, buffer32, beatlength, beatlength);
+		if (mixer->scopeTaps)
+		{
+			mixer->beginScopeTap(buffer32, beatlength);
+			addChannel(chn, buffer32, beatlength, beatSize);
+			mixer->endScopeTap(c, buffer32, beatNum, beatlength);
+		}
+		else
+			addChannel(chn, buffer32, beatlength, beatSize);
 		
 	}
 }
 
-void ChannelMixer::ResamplerBase::addChannelsRamping(ChannelMixer* mixer, mp_uint32 numChannels, mp_sint32* buffer32,mp_sint32 beatNum, mp_sint32 beatlength)
+void ChannelMixer::ResamplerBase::addChannelsRamping(ChannelMixer* mixer, mp_uint32 numChannels, mp_sint32* mixBuffer32,mp_sint32 beatNum, mp_sint32 beatlength, mp_sint32 beatSize)
 {
 	ChannelMixer::TMixerChannel* channel = mixer->channel;
 	ChannelMixer::TMixerChannel* newChannel = mixer->newChannel;
+	const ChannelMixer::TActiveVoice* activeVoices = mixer->activeVoices;
+	const mp_uint32 numActiveVoices = mixer->numActiveVoices;
 	
-	for (mp_uint32 c=0;c<numChannels;c++) 
+	for (mp_uint32 v=0;v<numActiveVoices;v++) 
 	{	
+		const mp_uint32 c = activeVoices[v].channel;
 		ChannelMixer::TMixerChannel* chn = &channel[c];
-		chn->index = c;		// For Amiga resampler
 		
-		if (!(chn->flags & MP_SAMPLE_PLAY))
+		if (c >= numChannels || !(chn->flags & MP_SAMPLE_PLAY))
 			continue;
+
+		chn->index = c;		// For Amiga resampler
+		
+		mp_sint32* buffer32 = mixer->getChannelBuffer(chn, mixBuffer32);
+		
+		if (mixer->scopeTaps)
+			mixer->beginScopeTap(buffer32, beatlength);
 		
 		switch (chn->flags&(MP_SAMPLE_FADEOUT|MP_SAMPLE_FADEIN|MP_SAMPLE_FADEOFF))
 		{
 			case MP_SAMPLE_FADEOFF:
 			{
-				mp_sint32 maxramp = (beatlength*RAMPDOWNFRACTION)>>8;
+				endFilterRamp(chn);
+				
+				mp_sint32 maxramp = (beatSize*RAMPDOWNFRACTION)>>8;
 				mp_sint32 beatl = (!(chn->flags & 3)) ? (ChannelMixer::fixedmul(chn->loopend,chn->rsmpadd) >> 1) : maxramp; 
 
 				if (beatl > maxramp || beatl <= 0)
@@ -151,18 +229,20 @@ void ChannelMixer::ResamplerBase::addChannelsRamping(ChannelMixer* mixer, mp_uin
 				chn->rampFromVolStepR = (-chn->finalvolr)/beatl; 
 				
 				if (beatl)
-					addChannel(chn, buffer32, beatl, beatlength);
+					addChannel(chn, buffer32, beatl, beatSize);
 				chn->flags&=~(MP_SAMPLE_PLAY | MP_SAMPLE_FADEOFF);
-				continue;
+				break;
 			}
 		
 			case MP_SAMPLE_FADEIN:
 			{
+				endFilterRamp(chn);
+				
 				chn->flags = (chn->flags&~(MP_SAMPLE_FADEOUT|MP_SAMPLE_FADEIN))/*|MP_SAMPLE_FADEIN*/;
 
-				//mp_sint32 beatl = (beatlength*RAMPDOWNFRACTION)>>8;
+				//mp_sint32 beatl = (beatSize*RAMPDOWNFRACTION)>>8;
 				
-				mp_sint32 maxramp = (beatlength*RAMPDOWNFRACTION)>>8;
+				mp_sint32 maxramp = (beatSize*RAMPDOWNFRACTION)>>8;
 				if( !mixer->rampin ){
 				  maxramp = 1; // disable FT2 ramp-in (as specified by user)
 				}
@@ -179,7 +259,7 @@ void ChannelMixer::ResamplerBase::addChannelsRamping(ChannelMixer* mixer, mp_uin
 				
 				// mix here
 				if (beatl)
-					addChannel(chn, buffer32, beatl, beatlength);
+					addChannel(chn, buffer32, beatl, beatSize);
 
 				//chn->finalvoll = volL;
 				//chn->finalvolr = volR;
@@ -192,13 +272,15 @@ void ChannelMixer::ResamplerBase::addChannelsRamping(ChannelMixer* mixer, mp_uin
 				beatl = beatlength - beatl;
 				
 				if (beatl)
-					addChannel(chn, buffer32+offset*MP_NUMCHANNELS, beatl, beatlength);
+					addChannel(chn, buffer32+offset*MP_NUMCHANNELS, beatl, beatSize);
 				break;
 			}
 			
 			case MP_SAMPLE_FADEOUT:
 			{
-				mp_sint32 maxramp = (beatlength*RAMPDOWNFRACTION)>>8;
+				endFilterRamp(chn);
+				
+				mp_sint32 maxramp = (beatSize*RAMPDOWNFRACTION)>>8;
 				mp_sint32 beatl = (!(chn->flags & 3)) ? (ChannelMixer::fixedmul(chn->loopend,chn->rsmpadd) >> 1) : maxramp; 
 
 				if (beatl > maxramp || beatl <= 0)
@@ -227,7 +309,7 @@ void ChannelMixer::ResamplerBase::addChannelsRamping(ChannelMixer* mixer, mp_uin
 				chn->b = newChannel[c].b;
 				chn->c = newChannel[c].c;				
 				if (beatl)
-					addChannel(chn, buffer32, beatl, beatlength);
+					addChannel(chn, buffer32, beatl, beatSize);
 				chn->smpadd = tmpsmpadd;
 				chn->rsmpadd = tmprsmpadd;
 				chn->currsample = tmpcurrsample; 
@@ -262,7 +344,7 @@ void ChannelMixer::ResamplerBase::addChannelsRamping(ChannelMixer* mixer, mp_uin
 				chn->finalvoll = chn->finalvolr = 0;
 
 				if (beatl)
-					addChannel(chn, buffer32, beatl, beatlength);
+					addChannel(chn, buffer32, beatl, beatSize);
 
 				chn->rampFromVolStepL = 0;				
 				chn->rampFromVolStepR = 0;
@@ -272,20 +354,43 @@ void ChannelMixer::ResamplerBase::addChannelsRamping(ChannelMixer* mixer, mp_uin
 				beatl = beatlength - beatl;
 				
 				if (beatl)
-					addChannel(chn, buffer32+offset*MP_NUMCHANNELS, beatl, beatlength);
+					addChannel(chn, buffer32+offset*MP_NUMCHANNELS, beatl, beatSize);
 				
-				continue;
+				break;
 			}
 			default:
 			{
 				mp_sint32 volL, volR;
 				mixer->panToVol(chn, volL, volR);
 				
-				chn->rampFromVolStepL = (volL-chn->finalvoll)/beatlength;				
-				chn->rampFromVolStepR = (volR-chn->finalvolr)/beatlength;
+				// a volume change is ramped over one beat packet, even if
+				// more are mixed at once
+				const mp_sint32 rampl = beatlength > beatSize ? beatSize : beatlength;
+				
+				chn->rampFromVolStepL = (volL-chn->finalvoll)/rampl;				
+				chn->rampFromVolStepR = (volR-chn->finalvolr)/rampl;
+				
+				startFilterRamp(chn, rampl);
 				
 				// mix here
-				addChannel(chn, buffer32, beatlength, beatlength);
+				if (rampl < beatlength && 
+					(chn->rampFromVolStepL || chn->rampFromVolStepR || 
+					 chn->rampFilterStepA || chn->rampFilterStepB || chn->rampFilterStepC))
+				{
+					addChannel(chn, buffer32, rampl, beatSize);
+
+					chn->rampFromVolStepL = 0;				
+					chn->rampFromVolStepR = 0;
+					endFilterRamp(chn);
+
+					addChannel(chn, buffer32+rampl*MP_NUMCHANNELS, beatlength-rampl, beatSize);
+				}
+				else
+				{
+					addChannel(chn, buffer32, beatlength, beatSize);
+				}
+				
+				endFilterRamp(chn);
 	
 				//chn->finalvoll = volL;
 				//chn->finalvolr = volR;	
@@ -293,18 +398,20 @@ void ChannelMixer::ResamplerBase::addChannelsRamping(ChannelMixer* mixer, mp_uin
 			}
 		}
 		
+		if (mixer->scopeTaps)
+			mixer->endScopeTap(c, buffer32, beatNum, beatlength);
 	}
 }
 
-void ChannelMixer::ResamplerBase::addChannels(ChannelMixer* mixer, mp_uint32 numChannels, mp_sint32* buffer32,mp_sint32 beatNum, mp_sint32 beatlength)
+void ChannelMixer::ResamplerBase::addChannels(ChannelMixer* mixer, mp_uint32 numChannels, mp_sint32* buffer32,mp_sint32 beatNum, mp_sint32 beatlength, mp_sint32 beatSize)
 {
 	if (beatNum >= (signed)mixer->getNumBeatPackets())
 		beatNum = mixer->getNumBeatPackets();
 
 	if (isRamping())
-		addChannelsRamping(mixer, numChannels, buffer32, beatNum, beatlength);
+		addChannelsRamping(mixer, numChannels, buffer32, beatNum, beatlength, beatSize);
 	else
-		addChannelsNormal(mixer, numChannels, buffer32, beatNum, beatlength);
+		addChannelsNormal(mixer, numChannels, buffer32, beatNum, beatlength, beatSize);
 }
 
 void ChannelMixer::ResamplerBase::addChannel(TMixerChannel* chn, mp_sint32* buffer32, const mp_sint32 beatlength, const mp_sint32 beatSize)
@@ -325,9 +432,14 @@ void ChannelMixer::ResamplerBase::addChannel(TMixerChannel* chn, mp_sint32* buff
 		{ 
 			mp_sint32* tempBuffer32 = (buffer32); 
 			mp_sint32 todo = (beatlength); 
-			bool limit = false;
+			bool limit;
 			while (todo>0) 
 			{ 
+				limit = false;
+				// when several beat packets are mixed at once, a sample which is about
+				// to stop must not see past the current packet, or the fade out would
+				// be placed differently than with one packet at a time
+				const mp_sint32 limitTodo = (todo > beatSize && (chn->flags & 3) == 0) ? ((todo-1) % beatSize) + 1 : todo;
 				if (chn->flags&MP_SAMPLE_BACKWARD) 
 				{ 
 					mp_sint32 pos = ((todo*-chn->smpadd - chn->smpposfrac)>>16)+chn->smppos; 
@@ -341,10 +453,10 @@ void ChannelMixer::ResamplerBase::addChannel(TMixerChannel* chn, mp_sint32* buff
 						mp_sint32 length = MP_FP_CEIL(ChannelMixer::fixedmul((((chn->smppos-chn->loopstart)<<16)+chn->smpposfrac),chn->rsmpadd)); 
 						
 						if (!length) length++; 
-						if (length>todo) 
+						if (length>limitTodo) 
 						{
 							// Final mixing length is limited by the remaining buffer size
-							length = todo; 
+							length = limitTodo; 
 							// Mark that we're limited
 							limit = true;
 						}
@@ -411,9 +523,9 @@ void ChannelMixer::ResamplerBase::addChannel(TMixerChannel* chn, mp_sint32* buff
 					{ 
 						mp_sint32 length = MP_FP_CEIL(ChannelMixer::fixedmul((((chn->loopend-chn->smppos)<<16)-chn->smpposfrac),chn->rsmpadd)); 
 						if (!length) length++; 
-						if (length>todo) 
+						if (length>limitTodo) 
 						{
-							length = todo; 
+							length = limitTodo; 
 							limit = true;
 						}
 						/* sample is going to stop => fade out because of ending clicks */ 
@@ -480,6 +592,40 @@ void ChannelMixer::muteChannel(mp_sint32 c, bool m)
 	if (m) channel[c].flags|=MP_SAMPLE_MUTE;
 }
 
+void ChannelMixer::detachSampleData(const mp_sbyte* smp)
+{
+	if (smp == NULL || channel == NULL)
+		return;
+
+	for (mp_uint32 c = 0; c < mixerNumAllocatedChannels; c++)
+	{
+		TMixerChannel* chn = &channel[c];
+		
+		// a fade out might be about to switch over to the new channel
+		if (chn->sample == smp || 
+			((chn->flags & MP_SAMPLE_FADEOUT) && newChannel[c].sample == smp))
+		{
+			chn->flags&=~(MP_SAMPLE_PLAY|MP_SAMPLE_FADEIN|MP_SAMPLE_FADEOUT|MP_SAMPLE_FADEOFF);
+			chn->sample = NULL;
+		}
+		
+		if (newChannel[c].sample == smp)
+			newChannel[c].sample = NULL;
+	}
+	
+	if (timeRecords)
+	{
+		for (mp_uint32 i = 0; i < mixerNumAllocatedChannels*timeRecordSize; i++)
+		{
+			if (timeRecords[i].sample == smp)
+			{
+				timeRecords[i].flags&=~MP_SAMPLE_PLAY;
+				timeRecords[i].sample = NULL;
+			}
+		}
+	}
+}
+
 bool ChannelMixer::isChannelMuted(mp_sint32 c)
 {
 	return (channel[c].flags&MP_SAMPLE_MUTE) == MP_SAMPLE_MUTE;
@@ -503,6 +649,9 @@ void ChannelMixer::setFrequency(mp_sint32 frequency)
 	
 	mixbuffBeatPacket = new mp_sint32[beatPacketSize*MP_NUMCHANNELS];
 	
+	for (mp_sint32 i = 0; i < FILTERCUTOFFSTEPS; i++)
+		filterCutoffTable[i] = filterCutoffToInvAngle(frequency, i << 8);
+	
 	// channels contain information based on beatPacketSize so this might
 	// have been changed
 	reallocChannels();
@@ -514,7 +663,8 @@ void ChannelMixer::setFrequency(mp_sint32 frequency)
 void ChannelMixer::reallocChannels()
 {
 	// optimization in case we already have the allocated number of channels
-	if (mixerNumAllocatedChannels != mixerLastNumAllocatedChannels)
+	const bool numChannelsChanged = mixerNumAllocatedChannels != mixerLastNumAllocatedChannels;
+	if (numChannelsChanged)
 	{
 		delete[] channel;
 		channel = new TMixerChannel[mixerNumAllocatedChannels];	
@@ -522,13 +672,26 @@ void ChannelMixer::reallocChannels()
 		delete[] newChannel;
 		newChannel = new TMixerChannel[mixerNumAllocatedChannels];
 		
-		clearChannels();
+		delete[] activeVoices;
+		activeVoices = new TActiveVoice[mixerNumAllocatedChannels];
+		
+		delete[] voiceIndex;
+		voiceIndex = new mp_sint32[mixerNumAllocatedChannels];
 	}
 	
 #if defined(MILKYTRACKER) || defined (__MPTIMETRACKING__)
-	for (mp_uint32 i = 0; i < mixerNumAllocatedChannels; i++)
-		channel[i].reallocTimeRecord(getNumBeatPackets()+1);
+	delete[] timeRecords;
+	timeRecordSize = getNumBeatPackets()+1;
+	timeRecords = new TTimeRecord[mixerNumAllocatedChannels*timeRecordSize];
 #endif	
+
+	reallocScopeTaps();
+	reallocInsertBuffer();
+
+	if (numChannelsChanged)
+		clearChannels();
+	else
+		clearTimeRecords();
 	
 	mixerLastNumAllocatedChannels = mixerNumAllocatedChannels;
 
@@ -542,7 +705,218 @@ void ChannelMixer::clearChannels()
 	{
 		channel[i].clear();
 		newChannel[i].clear();
+		voiceIndex[i] = -1;
 	}
+	
+	numActiveVoices = 0;
+	
+	clearTimeRecords();
+}
+
+void ChannelMixer::clearTimeRecords()
+{
+	if (timeRecords == NULL)
+		return;
+
+	// same as what storeTimeRecords writes for a channel which isn't playing
+	TTimeRecord idle;
+	idle.volPan = 128 << 16;
+	idle.smppos = -1;
+	
+	for (mp_uint32 i = 0; i < mixerNumAllocatedChannels*timeRecordSize; i++)
+		timeRecords[i] = idle;
+}
+
+void ChannelMixer::reallocScopeTaps()
+{
+	delete[] scopeTaps;
+	scopeTaps = NULL;
+	delete[] scopeTapSnapshot;
+	scopeTapSnapshot = NULL;
+	
+	if (!scopeTapsEnabled)
+		return;
+
+	// room for the taps of two buffers, so the ones a reader is looking 
+	// at aren't overwritten right away
+	const mp_uint32 numPackets = getNumBeatPackets()+1;
+	scopeTapRingSize = 1;
+	while (scopeTapRingSize < numPackets*2)
+		scopeTapRingSize<<=1;
+	
+	scopeTaps = new TScopeTap[mixerNumAllocatedChannels*scopeTapRingSize];
+	// no beat packet has this running number any time soon
+	for (mp_uint32 i = 0; i < mixerNumAllocatedChannels*scopeTapRingSize; i++)
+		scopeTaps[i].packet = scopeTapFirstPacket - scopeTapRingSize;
+
+	scopeTapSnapshot = new mp_sint32[numPackets*ScopeTapLength];
+}
+
+void ChannelMixer::setScopeTaps(bool enable)
+{
+	if (enable == scopeTapsEnabled)
+		return;
+		
+	scopeTapsEnabled = enable;
+	reallocScopeTaps();
+}
+
+void ChannelMixer::reallocInsertBuffer()
+{
+	delete[] insertBuffer;
+	insertBuffer = NULL;
+	
+	if (!insertHook)
+		return;
+	
+	// a whole buffer can be mixed at once, the remainder of a buffer
+	// is mixed as a full beat packet though
+	const mp_uint32 size = mixBufferSize > beatPacketSize ? mixBufferSize : beatPacketSize;
+	insertBuffer = new mp_sint32[size*MP_NUMCHANNELS];
+}
+
+void ChannelMixer::setInsertHook(Mixable* insertHook, const mp_sbyte* sample)
+{
+	this->insertHook = sample ? insertHook : NULL;
+	insertSample = sample;
+	reallocInsertBuffer();
+}
+
+void ChannelMixer::mixBeatPacketInsert(mp_uint32 numChannels,
+									   mp_sint32* buffer32,
+									   mp_sint32 beatPacketIndex, 
+									   mp_sint32 beatPacketSize,
+									   mp_sint32 numBeatPackets)
+{
+	const mp_sint32 length = beatPacketSize*numBeatPackets;
+	
+	memset(insertBuffer, 0, length*MP_NUMCHANNELS*sizeof(mp_sint32));
+
+	resamplerTable[resamplerType]->addChannels(this, numChannels, buffer32, beatPacketIndex, length, beatPacketSize);
+	
+	// the hook keeps running when nothing plays the sample, so filter 
+	// tails aren't cut off. It's called for each beat packet or tick 
+	// span, i.e. several times per buffer
+	insertHook->mix(insertBuffer, length);
+	
+	const mp_sint32* src = insertBuffer;
+	for (mp_sint32 i = 0; i < length*MP_NUMCHANNELS; i++)
+		buffer32[i] += src[i];
+}
+
+void ChannelMixer::beginScopeTap(const mp_sint32* buffer32, mp_sint32 beatlength)
+{
+	const mp_sint32 beatSize = beatPacketSize;
+	mp_sint32* dst = scopeTapSnapshot;
+	
+	for (mp_sint32 offset = 0; offset < beatlength; offset+=beatSize)
+	{
+		const mp_sint32* src = buffer32 + offset*MP_NUMCHANNELS;
+		for (mp_sint32 i = 0; i < ScopeTapLength; i++)
+		{
+			const mp_sint32 pos = ((i*beatSize) / ScopeTapLength)*MP_NUMCHANNELS;
+			*dst++ = src[pos] + src[pos+1];
+		}
+	}
+}
+
+void ChannelMixer::endScopeTap(mp_uint32 c, const mp_sint32* buffer32, mp_sint32 beatPacketIndex, mp_sint32 beatlength)
+{
+	const mp_sint32 beatSize = beatPacketSize;
+	const mp_sint32* snapshot = scopeTapSnapshot;
+	TScopeTap* ring = scopeTaps + c*scopeTapRingSize;
+	mp_uint32 packet = scopeTapPacket + beatPacketIndex;
+	
+	for (mp_sint32 offset = 0; offset < beatlength; offset+=beatSize, packet++)
+	{
+		const mp_sint32* src = buffer32 + offset*MP_NUMCHANNELS;
+		TScopeTap& tap = ring[packet & (scopeTapRingSize-1)];
+		
+		for (mp_sint32 i = 0; i < ScopeTapLength; i++)
+		{
+			const mp_sint32 pos = ((i*beatSize) / ScopeTapLength)*MP_NUMCHANNELS;
+			// scaled by 1/sqrt(2), a channel panned to the center then
+			// looks like its sample played at the channel volume 
+			mp_sint32 y = ((src[pos] + src[pos+1] - *snapshot++) * 181) >> 8;
+			if (y < -32768) y = -32768;
+			if (y > 32767) y = 32767;
+			tap.frames[i] = (mp_sword)y;
+		}
+		
+		LockFreeAtomic::storeRelease(&tap.packet, packet);
+	}
+}
+
+bool ChannelMixer::readScopeTap(mp_uint32 c, mp_uint32 beatPacketIndex, mp_uint32 numFrames, mp_sint32* buffer, mp_uint32 count) const
+{
+	enum { MaxPackets = 8 };
+	
+	const TScopeTap* ring = scopeTaps;
+	if (ring == NULL || c >= mixerNumAllocatedChannels || !count)
+		return false;
+	ring+=c*scopeTapRingSize;
+	
+	// tap frames covered, plus one to interpolate the last value from
+	const mp_uint32 length = (numFrames*ScopeTapLength) / beatPacketSize + 2;
+	const mp_uint32 numPackets = (length + ScopeTapLength - 1) / ScopeTapLength;
+	if (numPackets > MaxPackets || numPackets*2 > scopeTapRingSize)
+		return false;
+	
+	// the channel didn't play in packets without a tap
+	static const mp_sword silence[ScopeTapLength] = {0};
+	const mp_sword* frames[MaxPackets];
+	
+	const mp_uint32 first = LockFreeAtomic::loadAcquire(&scopeTapFirstPacket) + beatPacketIndex;
+	for (mp_uint32 i = 0; i < numPackets; i++)
+	{
+		const TScopeTap& tap = ring[(first + i) & (scopeTapRingSize-1)];
+		frames[i] = LockFreeAtomic::loadAcquire(&tap.packet) == first + i ? tap.frames : silence;
+	}
+	
+	const mp_uint32 step = (mp_uint32)(((mp_int64)numFrames*ScopeTapLength*65536) / ((mp_int64)beatPacketSize*count));
+	mp_uint32 pos = 0;
+	for (mp_uint32 i = 0; i < count; i++, pos+=step)
+	{
+		const mp_uint32 j = pos >> 16;
+		const mp_sint32 frac = (pos & 65535) >> 1;
+		const mp_sint32 y1 = frames[j / ScopeTapLength][j % ScopeTapLength];
+		const mp_sint32 y2 = frames[(j+1) / ScopeTapLength][(j+1) % ScopeTapLength];
+		buffer[i] = y1 + (((y2 - y1)*frac) >> 15);
+	}
+	
+	// if the mixer began to overwrite any of these in the meantime, 
+	// what we've got might be a mix of two packets
+	LockFreeAtomic::barrier();
+	return (mp_sint32)(first + scopeTapRingSize - LockFreeAtomic::loadAcquire(&scopeTapEndPacket)) >= 0;
+}
+
+void ChannelMixer::updateActiveVoices(mp_uint32 numBeatPackets/* = 1*/)
+{
+	// a channel which stopped playing stays in the list until its idle
+	// state made it into every slot of its time record. The slots are
+	// filled from the start of each buffer, so this takes up to two buffers
+	const mp_uint32 maxIdlePackets = timeRecords ? timeRecordSize*2 : 0;
+	
+	mp_uint32 n = 0;
+	for (mp_uint32 v = 0; v < numActiveVoices; v++)
+	{
+		TActiveVoice voice = activeVoices[v];
+		
+		if (channel[voice.channel].flags & MP_SAMPLE_PLAY)
+		{
+			voice.idlePackets = 0;
+		}
+		else if ((voice.idlePackets+=numBeatPackets) > maxIdlePackets)
+		{
+			voiceIndex[voice.channel] = -1;
+			continue;
+		}
+		
+		voiceIndex[voice.channel] = n;
+		activeVoices[n++] = voice;
+	}
+	
+	numActiveVoices = n;
 }
 
 ChannelMixer::ChannelMixer(mp_uint32 numChannels,
@@ -555,10 +929,27 @@ ChannelMixer::ChannelMixer(mp_uint32 numChannels,
 	mixBufferSize(0),
 	channel(NULL),
 	newChannel(NULL),
+	activeVoices(NULL),
+	numActiveVoices(0),
+	voiceIndex(NULL),
+	timeRecords(NULL),
+	timeRecordSize(0),
+	scopeTaps(NULL),
+	scopeTapRingSize(0),
+	scopeTapSnapshot(NULL),
+	scopeTapPacket(0),
+	scopeTapFirstPacket(0),
+	scopeTapEndPacket(0),
+	scopeTapsEnabled(false),
+	insertHook(NULL),
+	insertSample(NULL),
+	insertBuffer(NULL),
 	resamplerType(MIXER_INVALID),
+	rampin(false),
 	paused(false),
 	disableMixing(false),
 	allowFilters(false),
+	tickSpanMixing(false),
 	initialized(false),
 	sampleCounter(0)
 {	
@@ -579,11 +970,6 @@ ChannelMixer::ChannelMixer(mp_uint32 numChannels,
 	setResamplerType(MIXER_NORMAL);
 
 	setBufferSize(BUFFERSIZE_DEFAULT);
-
-	// FT2 panning law
-	if (panLUT[1] == 0)
-		for (int i = 0; i <= 256; i++)
-			panLUT[i] = static_cast<mp_sint32> (8192.0 * sqrt(i/256.0) + 0.5);
 }
 
 ChannelMixer::~ChannelMixer()
@@ -602,6 +988,13 @@ ChannelMixer::~ChannelMixer()
 	if (newChannel) 
 		delete[] newChannel;
 	
+	delete[] activeVoices;
+	delete[] voiceIndex;
+	delete[] timeRecords;
+	delete[] scopeTaps;
+	delete[] scopeTapSnapshot;
+	delete[] insertBuffer;
+	
 	for (mp_uint32 i = 0; i < sizeof(resamplerTable) / sizeof(ResamplerBase*); i++)
 		delete resamplerTable[i];
 }
@@ -695,22 +1088,23 @@ void ChannelMixer::setFilterAttributes(mp_sint32 chn, mp_sint32 cutoff, mp_sint3
 		 channel[chn].resonance == resonance))
 		return;
 	
+	// there is nothing to ramp from when the filter is switched on
+	const bool filterWasOff = channel[chn].cutoff == MP_INVALID_VALUE || channel[chn].resonance == MP_INVALID_VALUE;
+	
 	channel[chn].cutoff = cutoff;
 	channel[chn].resonance = resonance;
 	
 	if (cutoff == MP_INVALID_VALUE || resonance == MP_INVALID_VALUE)
 		return;
 
-	// Thanks to DUMB for the filter coefficient computations	
-	const float LOG10 = 2.30258509299f;
-	const mp_sint32 IT_ENVELOPE_SHIFT = 8;
-	
 	float a, b, c;
 	{
-		float sampfreq = this->mixFrequency;
-	
-		float inv_angle = (float)(sampfreq * pow(0.5, 0.25 + cutoff*(1.0/(24<<IT_ENVELOPE_SHIFT))) * (1.0/(2*3.14159265358979323846*110.0)));
-		float loss = (float)exp(resonance*(-LOG10*1.2/128.0));
+		// envelopes might take the cutoff out of the tables' range
+		const mp_sint32 cutoffStep = cutoff >> 8;
+		const float inv_angle = (cutoffStep >= 0 && cutoffStep < FILTERCUTOFFSTEPS) ?
+			(float)(filterCutoffTable[cutoffStep] * filterCutoffFractionLUT[cutoff & 255]) :
+			(float)filterCutoffToInvAngle(this->mixFrequency, cutoff);
+		float loss = (resonance >= 0 && resonance < 128) ? filterResonanceLUT[resonance] : filterResonanceToLoss(resonance);
 		float d, e;
 #if 0
 		loss *= 2; // This is the mistake most players seem to make!
@@ -731,9 +1125,17 @@ void ChannelMixer::setFilterAttributes(mp_sint32 chn, mp_sint32 cutoff, mp_sint3
 #endif
 	}
 	
-	channel[chn].a = (mp_sint32)(a * (1 << (MP_FILTERPRECISION+16)));
-	channel[chn].b = (mp_sint32)(b * (1 << (MP_FILTERPRECISION+16)));
-	channel[chn].c = (mp_sint32)(c * (1 << (MP_FILTERPRECISION+16)));
+	// the mixer ramps a,b,c to the new coefficients over the next beat packet
+	channel[chn].toa = (mp_sint32)(a * (1 << (MP_FILTERPRECISION+16)));
+	channel[chn].tob = (mp_sint32)(b * (1 << (MP_FILTERPRECISION+16)));
+	channel[chn].toc = (mp_sint32)(c * (1 << (MP_FILTERPRECISION+16)));
+	
+	if (filterWasOff)
+	{
+		channel[chn].a = channel[chn].toa;
+		channel[chn].b = channel[chn].tob;
+		channel[chn].c = channel[chn].toc;
+	}
 }
 
 void ChannelMixer::playSample(mp_sint32 c, // channel
@@ -914,40 +1316,176 @@ void ChannelMixer::playSample(mp_sint32 c, // channel
 		}
 	}
 	
+	activateVoice(c);
 }
 
-static inline void storeTimeRecordData(mp_sint32 nb, ChannelMixer::TMixerChannel* chn)
+static inline void storeTimeRecordData(ChannelMixer::TTimeRecord* timeRecord, const ChannelMixer::TMixerChannel* chn)
 {
 	if (!(chn->flags & ChannelMixer::MP_SAMPLE_PLAY))
 	{
-		if (chn->timeRecord)
-		{
-			chn->timeRecord[nb].flags = chn->flags;
-			chn->timeRecord[nb].sample = NULL;
-			chn->timeRecord[nb].volPan = 128 << 16;
-			chn->timeRecord[nb].smppos = -1;
-		}
+		timeRecord->flags = chn->flags;
+		timeRecord->sample = NULL;
+		timeRecord->volPan = 128 << 16;
+		timeRecord->smppos = -1;
 	}
 	else
 	{
-		if (chn->timeRecord)
+		timeRecord->flags = chn->flags;
+		timeRecord->sample = chn->sample;
+		timeRecord->smppos = chn->smppos;
+		timeRecord->volPan = chn->vol + (chn->pan << 16);
+		timeRecord->smpposfrac = chn->smpposfrac;
+		timeRecord->smpadd = chn->smpadd;
+		timeRecord->smplen = chn->smplen;
+		if (chn->flags & ChannelMixer::MP_SAMPLE_ONESHOT)
+			timeRecord->loopend = chn->loopendcopy;
+		else
+			timeRecord->loopend = chn->loopend;
+		timeRecord->loopstart = chn->loopstart;
+		timeRecord->fixedtime = chn->fixedtime;			
+		timeRecord->fixedtimefrac = chn->fixedtimefrac;
+	}
+}
+
+void ChannelMixer::storeTimeRecords(mp_sint32 beatPacketIndex)
+{
+	if (timeRecords == NULL)
+		return;
+
+	for (mp_uint32 v = 0; v < numActiveVoices; v++)
+	{
+		const mp_uint32 c = activeVoices[v].channel;
+		if (c < mixerNumActiveChannels)
+			storeTimeRecordData(timeRecords + c*timeRecordSize + beatPacketIndex, &channel[c]);
+	}
+}
+
+// the channel state doesn't change within a span of beat packets, so the
+// position after numSamples can be calculated instead of being recorded
+static void extrapolateTimeRecordData(ChannelMixer::TTimeRecord* timeRecord, const ChannelMixer::TTimeRecord* first, mp_uint32 numSamples)
+{
+	*timeRecord = *first;
+	
+	if (!(first->flags & ChannelMixer::MP_SAMPLE_PLAY))
+		return;
+	
+	const mp_int64 distance = (mp_int64)first->smpadd * numSamples;
+	const mp_int64 loopstart = (mp_int64)first->loopstart << 16;
+	const mp_int64 looplen = ((mp_int64)first->loopend << 16) - loopstart;
+	mp_int64 pos = ((mp_int64)first->smppos << 16) + first->smpposfrac;
+	
+	switch (first->flags & 3)
+	{
+		// no loop
+		case 0:
 		{
-			chn->timeRecord[nb].flags = chn->flags;
-			chn->timeRecord[nb].sample = chn->sample;
-			chn->timeRecord[nb].smppos = chn->smppos;
-			chn->timeRecord[nb].volPan = chn->vol + (chn->pan << 16);
-			chn->timeRecord[nb].smpposfrac = chn->smpposfrac;
-			chn->timeRecord[nb].smpadd = chn->smpadd;
-			chn->timeRecord[nb].smplen = chn->smplen;
-			if (chn->flags & ChannelMixer::MP_SAMPLE_ONESHOT)
-				chn->timeRecord[nb].loopend = chn->loopendcopy;
+			const mp_int64 smplen = (mp_int64)first->smplen << 16;
+			pos = (first->flags & ChannelMixer::MP_SAMPLE_BACKWARD) ? pos - distance : pos + distance;
+			if (pos >= smplen && (first->flags & ChannelMixer::MP_SAMPLE_ONESHOT) && looplen > 0)
+			{
+				pos = loopstart + (pos - smplen) % looplen;
+				timeRecord->flags = (timeRecord->flags & ~ChannelMixer::MP_SAMPLE_ONESHOT) | 1;
+			}
+			else if (pos < 0 || pos >= smplen)
+			{
+				timeRecord->flags &= ~ChannelMixer::MP_SAMPLE_PLAY;
+				timeRecord->sample = NULL;
+				timeRecord->volPan = 128 << 16;
+				timeRecord->smppos = -1;
+				return;
+			}
+			break;
+		}
+		
+		// forward loop
+		case 1:
+			pos+=distance;
+			if (looplen > 0 && pos >= loopstart + looplen)
+				pos = loopstart + (pos - loopstart) % looplen;
+			break;
+		
+		// ping pong loop, unfold it into a forward loop of twice the length
+		case 2:
+		{
+			if (looplen <= 0)
+				break;
+			
+			mp_int64 unfolded;
+			if (first->flags & ChannelMixer::MP_SAMPLE_BACKWARD)
+				unfolded = looplen*2 - (pos - loopstart);
+			else if (pos + distance < loopstart + looplen)
+			{
+				pos+=distance;
+				break;
+			}
+			else
+				unfolded = pos - loopstart;
+			
+			if (unfolded < 0)
+				unfolded = 0;
+			unfolded = (unfolded + distance) % (looplen*2);
+			
+			if (unfolded < looplen)
+			{
+				pos = loopstart + unfolded;
+				timeRecord->flags &= ~ChannelMixer::MP_SAMPLE_BACKWARD;
+			}
 			else
-				chn->timeRecord[nb].loopend = chn->loopend;
-			chn->timeRecord[nb].loopstart = chn->loopstart;
-			chn->timeRecord[nb].fixedtime = chn->fixedtime;			
-			chn->timeRecord[nb].fixedtimefrac = chn->fixedtimefrac;
+			{
+				pos = loopstart + looplen*2 - unfolded;
+				timeRecord->flags |= ChannelMixer::MP_SAMPLE_BACKWARD;
+			}
+			break;
 		}
 	}
+	
+	timeRecord->smppos = (mp_sint32)(pos >> 16);
+	timeRecord->smpposfrac = (mp_sint32)(pos & 65535);
+}
+
+void ChannelMixer::extrapolateTimeRecords(mp_sint32 beatPacketIndex, mp_uint32 numBeatPackets)
+{
+	if (timeRecords == NULL)
+		return;
+
+	for (mp_uint32 v = 0; v < numActiveVoices; v++)
+	{
+		const mp_uint32 c = activeVoices[v].channel;
+		if (c >= mixerNumActiveChannels)
+			continue;
+		
+		TTimeRecord* timeRecord = timeRecords + c*timeRecordSize + beatPacketIndex;
+		
+		// the fades are done within the first beat packet, after that the
+		// channel is either stopped or playing the new sample
+		TTimeRecord first = *timeRecord;
+		if (first.flags & MP_SAMPLE_PLAY)
+		{
+			switch (first.flags & (MP_SAMPLE_FADEOUT | MP_SAMPLE_FADEIN | MP_SAMPLE_FADEOFF))
+			{
+				case MP_SAMPLE_FADEOFF:
+					first.flags&=~(MP_SAMPLE_PLAY | MP_SAMPLE_FADEOFF);
+					first.sample = NULL;
+					first.volPan = 128 << 16;
+					first.smppos = -1;
+					break;
+					
+				case MP_SAMPLE_FADEOUT:
+					storeTimeRecordData(&first, &newChannel[c]);
+					first.volPan = timeRecord->volPan;
+					first.smpadd = timeRecord->smpadd;
+					break;
+					
+				case MP_SAMPLE_FADEIN:
+					if (isRamping())
+						first.flags&=~MP_SAMPLE_FADEIN;
+					break;
+			}
+		}
+		
+		for (mp_uint32 i = 1; i <= numBeatPackets; i++)
+			extrapolateTimeRecordData(timeRecord + i, &first, i*beatPacketSize);
+	}
 }
 
 void ChannelMixer::mix(mp_sint32* mixbuff32, mp_uint32 bufferSize)
@@ -961,6 +1499,16 @@ void ChannelMixer::mix(mp_sint32* mixbuff32, mp_uint32 bufferSize)
 	{
 		mp_sint32* buffer = mixbuff32;
 		
+		// the taps of this buffer follow the ones of the last buffer, let 
+		// the readers know which ones are about to be overwritten
+		if (scopeTaps)
+		{
+			const mp_uint32 numPackets = getNumBeatPackets()+1;
+			scopeTapPacket = scopeTapFirstPacket + numPackets;
+			LockFreeAtomic::storeRelease(&scopeTapEndPacket, scopeTapPacket + numPackets);
+			LockFreeAtomic::barrier();
+		}
+		
 		mp_sint32 beatLength = beatPacketSize;
 		mp_sint32 mixSize = mixBufferSize;
 
@@ -1006,20 +1554,19 @@ void ChannelMixer::mix(mp_sint32* mixbuff32, mp_uint32 bufferSize)
 
 			const bool isRamping = this->isRamping();
 
-			for (nb=0;nb<numbeats;nb++) 
+			for (nb=0;nb<numbeats;) 
 			{
 				if (isRamping)
 				{
-					const TMixerChannel* src = channel;
-					TMixerChannel* dst = newChannel;
-					const mp_uint32 mixerNumActiveChannels = this->mixerNumActiveChannels;
 					if (allowFilters)
 					{
 						// this is crucial for volume ramping, store current
 						// active sample rate (stored in the step values for each channel)
 						// and also filter coefficients	and last samples			
-						for (mp_uint32 c = 0; c < mixerNumActiveChannels; c++, src++, dst++)
+						for (mp_uint32 v = 0; v < numActiveVoices; v++)
 						{
+							const TMixerChannel* src = &channel[activeVoices[v].channel];
+							TMixerChannel* dst = &newChannel[activeVoices[v].channel];
 							dst->smpadd = src->smpadd;
 							dst->rsmpadd = src->rsmpadd; 
 
@@ -1035,8 +1582,10 @@ void ChannelMixer::mix(mp_sint32* mixbuff32, mp_uint32 bufferSize)
 						// this is crucial for volume ramping, store current
 						// active sample rate (stored in the step values for each channel)
 						// and also filter coefficients	and last samples			
-						for (mp_uint32 c = 0; c < mixerNumActiveChannels; c++, src++, dst++)
+						for (mp_uint32 v = 0; v < numActiveVoices; v++)
 						{
+							const TMixerChannel* src = &channel[activeVoices[v].channel];
+							TMixerChannel* dst = &newChannel[activeVoices[v].channel];
 							dst->smpadd = src->smpadd;
 							dst->rsmpadd = src->rsmpadd; 
 						}
@@ -1045,15 +1594,36 @@ void ChannelMixer::mix(mp_sint32* mixbuff32, mp_uint32 bufferSize)
 
 				timer(nb);
 
+				// the beat packets up to the next tick don't change the channels,
+				// run their timers now and mix them together with this one
+				mp_sint32 span = 1;
+				if (tickSpanMixing)
+				{
+					mp_uint32 numQuiet = getNumBeatPacketsToNextTick();
+					if (numQuiet > (mp_uint32)(numbeats - nb - 1))
+						numQuiet = numbeats - nb - 1;
+					
+					for (mp_uint32 i = 1; i <= numQuiet; i++)
+						timer(nb + i);
+					
+					span+=numQuiet;
+				}
+
 				if (!disableMixing)
 				{
 					// do some in between state recording 
 					// to be able to show smooth updates even if the buffer is large
-					for (mp_uint32 c=0;c<mixerNumActiveChannels;c++) 
-						storeTimeRecordData(nb, &channel[c]);
-
-					mixBeatPacket(mixerNumActiveChannels, buffer+nb*beatLength*MP_NUMCHANNELS, nb, beatLength);	
+					storeTimeRecords(nb);
+
+					mixBeatPacket(mixerNumActiveChannels, buffer+nb*beatLength*MP_NUMCHANNELS, nb, beatLength, span);	
+					
+					if (span > 1)
+						extrapolateTimeRecords(nb, span - 1);
+					
+					updateActiveVoices(span);
 				}
+				
+				nb+=span;
 			}		
 
 			buffer+=numbeats*beatLength*MP_NUMCHANNELS;
@@ -1064,16 +1634,15 @@ void ChannelMixer::mix(mp_sint32* mixbuff32, mp_uint32 bufferSize)
 
 				if (isRamping)
 				{
-					const TMixerChannel* src = channel;
-					TMixerChannel* dst = newChannel;
-					const mp_uint32 mixerNumActiveChannels = this->mixerNumActiveChannels;
 					if (allowFilters)
 					{
 						// this is crucial for volume ramping, store current
 						// active sample rate (stored in the step values for each channel)
 						// and also filter coefficients	and last samples			
-						for (mp_uint32 c = 0; c < mixerNumActiveChannels; c++, src++, dst++)
+						for (mp_uint32 v = 0; v < numActiveVoices; v++)
 						{
+							const TMixerChannel* src = &channel[activeVoices[v].channel];
+							TMixerChannel* dst = &newChannel[activeVoices[v].channel];
 							dst->smpadd = src->smpadd;
 							dst->rsmpadd = src->rsmpadd; 
 
@@ -1089,8 +1658,10 @@ void ChannelMixer::mix(mp_sint32* mixbuff32, mp_uint32 bufferSize)
 						// this is crucial for volume ramping, store current
 						// active sample rate (stored in the step values for each channel)
 						// and also filter coefficients	and last samples			
-						for (mp_uint32 c = 0; c < mixerNumActiveChannels; c++, src++, dst++)
+						for (mp_uint32 v = 0; v < numActiveVoices; v++)
 						{
+							const TMixerChannel* src = &channel[activeVoices[v].channel];
+							TMixerChannel* dst = &newChannel[activeVoices[v].channel];
 							dst->smpadd = src->smpadd;
 							dst->rsmpadd = src->rsmpadd; 
 						}
@@ -1103,10 +1674,11 @@ void ChannelMixer::mix(mp_sint32* mixbuff32, mp_uint32 bufferSize)
 				{
 					// do some in between state recording 
 					// to be able to show smooth updates even if the buffer is large
-					for (mp_uint32 c=0;c<mixerNumActiveChannels;c++) 
-						storeTimeRecordData(nb, &channel[c]);
+					storeTimeRecords(nb);
 
 					mixBeatPacket(mixerNumActiveChannels, mixbuffBeatPacket, numbeats, beatLength);	
+					
+					updateActiveVoices();
 				}
 
 				mp_sint32 todo = mixBufferSize - done;
@@ -1122,6 +1694,9 @@ void ChannelMixer::mix(mp_sint32* mixbuff32, mp_uint32 bufferSize)
 				}
 			}
 		}
+		
+		if (scopeTaps)
+			LockFreeAtomic::storeRelease(&scopeTapFirstPacket, scopeTapPacket);
 	}
 	
 }
@@ -1214,8 +1789,8 @@ mp_sint32 ChannelMixer::getNumActiveChannels()
 {	
 	mp_sint32 i = 0;
 
-	for (mp_uint32 j = 0; j < mixerNumActiveChannels; j++)
-		if (channel[j].flags & 256)
+	for (mp_uint32 v = 0; v < numActiveVoices; v++)
+		if (activeVoices[v].channel < mixerNumActiveChannels && (channel[activeVoices[v].channel].flags & 256))
 			i++;
 
 	return i;
@@ -1368,19 +1943,19 @@ void ChannelMixer::mixData(mp_sint32 c,
 	if (packetIndex < 0)
 		packetIndex = 0;
 	
-	const ChannelMixer::TMixerChannel* tempchn = &channel[c];
+	const ChannelMixer::TTimeRecord* timeRecord = getTimeRecord(c) + packetIndex;
 	ChannelMixer::TMixerChannel channel;
 	
-	channel.flags = tempchn->timeRecord[packetIndex].flags;
-	channel.sample = tempchn->timeRecord[packetIndex].sample;
-	channel.smppos = tempchn->timeRecord[packetIndex].smppos;
-	channel.smpposfrac = tempchn->timeRecord[packetIndex].smpposfrac;
-	channel.smpadd = tempchn->timeRecord[packetIndex].smpadd;
-	channel.smplen = tempchn->timeRecord[packetIndex].smplen;
-	channel.loopend = channel.loopendcopy = tempchn->timeRecord[packetIndex].loopend;
-	channel.loopstart = tempchn->timeRecord[packetIndex].loopstart;
-	channel.vol = tempchn->timeRecord[packetIndex].volPan & 0xFFFF;
-	channel.pan = tempchn->timeRecord[packetIndex].volPan >> 16;
+	channel.flags = timeRecord->flags;
+	channel.sample = timeRecord->sample;
+	channel.smppos = timeRecord->smppos;
+	channel.smpposfrac = timeRecord->smpposfrac;
+	channel.smpadd = timeRecord->smpadd;
+	channel.smplen = timeRecord->smplen;
+	channel.loopend = channel.loopendcopy = timeRecord->loopend;
+	channel.loopstart = timeRecord->loopstart;
+	channel.vol = timeRecord->volPan & 0xFFFF;
+	channel.pan = timeRecord->volPan >> 16;
 	
 	ChannelMixer::TMixerChannel* chn = &channel;
 	
@@ -64,7 +64,7 @@ class MixerSettings
 protected:
 	enum
 	{
-		NUMRESAMPLERTYPES = 21,
+		NUMRESAMPLERTYPES = 23,
 	};
 
 public:
@@ -102,6 +102,9 @@ public:
 		MIXER_AMIGA1200LED,
 		MIXER_AMIGA1200LED_RAMPING,
 
+		MIXER_SINCPOLYPHASE,
+		MIXER_SINCPOLYPHASE_RAMPING,
+
 		MIXER_DUMMY,
 		
 		MIXER_INVALID
@@ -187,6 +190,19 @@ public:
 		}
 	};
 
+	enum
+	{
+		ScopeTapLength		= 64
+	};
+
+	// what a channel added to the mix during one beat packet, decimated
+	// to ScopeTapLength mono frames (see setScopeTaps)
+	struct TScopeTap
+	{
+		volatile mp_uint32	packet;					// running number of the beat packet
+		mp_sword			frames[ScopeTapLength];
+	};
+
 	struct TMixerChannel 
 	{
 		mp_uint32			flags;					// bit 8 = sample played
@@ -215,6 +231,10 @@ public:
 		mp_sint32			rampFromVolStepL;
 
 		mp_sint32			a,b,c;					// Filter coefficients
+		mp_sint32			toa,tob,toc;			// Filter coefficients a,b,c are ramped to
+		mp_sint32			rampFilterStepA;
+		mp_sint32			rampFilterStepB;
+		mp_sint32			rampFilterStepC;
 		mp_sint32			currsample;				// sample history for filtering
 		mp_sint32			prevsample;				// see above
 
@@ -224,27 +244,15 @@ public:
 		mp_sint32			fixedtime;				// for amiga resampler (running time)
 		mp_sint32			fixedtimefrac;			// for sinc/amiga resamplers (running time fraction)
 
-		mp_uint32			timeRecordSize;
-		TTimeRecord*		timeRecord;
 		mp_sint32			index;					// For Amiga resampler
 
-		TMixerChannel() :
-			timeRecordSize(0),
-			timeRecord(NULL)
+		TMixerChannel()
 		{
 			clear();
 		}
 
-		TMixerChannel(bool fastContruction) :
-			timeRecordSize(0),
-			timeRecord(NULL)
-		{
-		}
-		
-		~TMixerChannel()
+		TMixerChannel(bool fastContruction)
 		{
-			if (timeRecord)
-				delete[] timeRecord;
 		}
 
 		void clear()
@@ -270,6 +278,10 @@ public:
 			rampFromVolStepL	= 0;
 			
 			a = b = c			= 0;
+			toa = tob = toc		= 0;
+			rampFilterStepA		= 0;
+			rampFilterStepB		= 0;
+			rampFilterStepC		= 0;
 			currsample			= 0;
 			prevsample			= 0;
 			
@@ -279,33 +291,34 @@ public:
 			fixedtime			= 0;
 			fixedtimefrac		= 0;
 			index				= -1;		// is filled during runtime
-			
-			if (timeRecord)
-				memset(timeRecord, 0, sizeof(TTimeRecord) * timeRecordSize);
-		}
-		
-		void reallocTimeRecord(mp_uint32 size)
-		{
-			delete[] timeRecord;
-			timeRecordSize = size;
-			timeRecord = new TTimeRecord[size];
 		}
 	};
+
+	// entry of the list of channels the mixer has to walk: the ones which
+	// are playing and the ones which stopped so recently that their time
+	// records still need to be updated
+	struct TActiveVoice
+	{
+		mp_uint32			channel;
+		mp_uint32			idlePackets;			// beat packets since the channel stopped playing
+	};
 	
 	class ResamplerBase
 	{
 	private:
 		// add channels without volume ramping
-		void addChannelsNormal(ChannelMixer* mixer, mp_uint32 numChannels, mp_sint32* buffer32,mp_sint32 beatNum, mp_sint32 beatlength);		
+		void addChannelsNormal(ChannelMixer* mixer, mp_uint32 numChannels, mp_sint32* buffer32,mp_sint32 beatNum, mp_sint32 beatlength, mp_sint32 beatSize);		
 		// add channels with volume ramping
-		void addChannelsRamping(ChannelMixer* mixer, mp_uint32 numChannels, mp_sint32* buffer32,mp_sint32 beatNum, mp_sint32 beatlength);		
+		void addChannelsRamping(ChannelMixer* mixer, mp_uint32 numChannels, mp_sint32* buffer32,mp_sint32 beatNum, mp_sint32 beatlength, mp_sint32 beatSize);		
 
 	public:
 		virtual ~ResamplerBase()
 		{
 		}
 		
-		void addChannels(ChannelMixer* mixer, mp_uint32 numChannels, mp_sint32* buffer32,mp_sint32 beatNum, mp_sint32 beatlength);
+		// beatlength is the number of samples to mix, which can span several
+		// beat packets. Volume ramps are always sized after one beat packet (beatSize)
+		void addChannels(ChannelMixer* mixer, mp_uint32 numChannels, mp_sint32* buffer32,mp_sint32 beatNum, mp_sint32 beatlength, mp_sint32 beatSize);
 		void addChannel(TMixerChannel* chn, mp_sint32* buffer32, const mp_sint32 beatlength, const mp_sint32 beatSize);		
 		
 		// walk along the sample
@@ -367,6 +380,39 @@ private:
 		
 	TMixerChannel*	channel;
 	TMixerChannel*  newChannel;
+
+	TActiveVoice*	activeVoices;
+	mp_uint32		numActiveVoices;
+	mp_sint32*		voiceIndex;				// index of each channel in activeVoices, -1 = not listed
+
+	// kept apart from the channel state the resamplers work on,
+	// timeRecordSize entries per channel
+	TTimeRecord*	timeRecords;
+	mp_uint32		timeRecordSize;
+
+	// each channel has a ring of scopeTapRingSize taps, the audio thread
+	// writes them while the readers check whether they got lapped
+	TScopeTap*		scopeTaps;
+	mp_uint32		scopeTapRingSize;
+	mp_sint32*		scopeTapSnapshot;		// mix buffer at the tap points before a channel is added
+	mp_uint32		scopeTapPacket;			// running number of the first beat packet of the buffer being mixed
+	volatile mp_uint32 scopeTapFirstPacket;	// same for the last buffer which is done
+	volatile mp_uint32 scopeTapEndPacket;	// taps before this one might be written to
+	bool			scopeTapsEnabled;
+	
+	// channels playing insertSample are mixed into insertBuffer first,
+	// which runs through insertHook before it's added to the mix
+	Mixable*		insertHook;
+	const mp_sbyte*	insertSample;
+	mp_sint32*		insertBuffer;
+	
+	// filter cutoff of every whole cutoff step at the current mixing 
+	// frequency, see setFilterAttributes
+	enum
+	{
+		FILTERCUTOFFSTEPS = 256
+	};
+	double			filterCutoffTable[FILTERCUTOFFSTEPS];
 	
 	mp_sint32		masterVolume;			// mixer master volume	
 	mp_sint32		panningSeparation;		// panning separation from 0 (mono) to 256 (full stereo)
@@ -379,15 +425,32 @@ private:
 	bool			paused;
 	bool			disableMixing;
 	bool			allowFilters;
+	bool			tickSpanMixing;
 
 	void			setFrequency(mp_sint32 frequency);
 	
 	void			mixBeatPacket(mp_uint32 numChannels,
 								  mp_sint32* buffer32,
 								  mp_sint32 beatPacketIndex, 
-								  mp_sint32 beatPacketSize) 
+								  mp_sint32 beatPacketSize,
+								  mp_sint32 numBeatPackets = 1) 
 	{ 
-		resamplerTable[resamplerType]->addChannels(this, numChannels, buffer32, beatPacketIndex, beatPacketSize);
+		if (insertHook)
+			mixBeatPacketInsert(numChannels, buffer32, beatPacketIndex, beatPacketSize, numBeatPackets);
+		else
+			resamplerTable[resamplerType]->addChannels(this, numChannels, buffer32, beatPacketIndex, beatPacketSize*numBeatPackets, beatPacketSize);
+	}
+	
+	void			mixBeatPacketInsert(mp_uint32 numChannels,
+										mp_sint32* buffer32,
+										mp_sint32 beatPacketIndex, 
+										mp_sint32 beatPacketSize,
+										mp_sint32 numBeatPackets);
+
+	// where the resampler mixes a channel to, buffer32 is the mix buffer
+	mp_sint32*		getChannelBuffer(const TMixerChannel* chn, mp_sint32* buffer32) const
+	{
+		return (insertHook && chn->sample == insertSample) ? insertBuffer : buffer32;
 	}
 	
 	inline void		timer(mp_uint32 beatIndex)
@@ -395,6 +458,32 @@ private:
 		timerHandler(beatIndex <= getNumBeatPackets() ? beatIndex : getNumBeatPackets());
 	}
 	
+	// called whenever a channel starts playing
+	inline void		activateVoice(mp_uint32 c)
+	{
+		if (voiceIndex[c] < 0)
+		{
+			voiceIndex[c] = numActiveVoices;
+			activeVoices[numActiveVoices++].channel = c;
+		}
+		activeVoices[voiceIndex[c]].idlePackets = 0;
+	}
+	
+	// drops channels which have been idle for long enough, after mixing numBeatPackets
+	void			updateActiveVoices(mp_uint32 numBeatPackets = 1);
+	
+	void			storeTimeRecords(mp_sint32 beatPacketIndex);
+	// fills in the time records of the beat packets following beatPacketIndex
+	// which have been mixed along with it
+	void			extrapolateTimeRecords(mp_sint32 beatPacketIndex, mp_uint32 numBeatPackets);
+	void			clearTimeRecords();
+	
+	void			reallocScopeTaps();
+	void			reallocInsertBuffer();
+	// record what the mixing in between these two calls adds to the buffer
+	void			beginScopeTap(const mp_sint32* buffer32, mp_sint32 beatlength);
+	void			endScopeTap(mp_uint32 c, const mp_sint32* buffer32, mp_sint32 beatPacketIndex, mp_sint32 beatlength);
+	
 	void			reallocChannels();
 	void			clearChannels();
 
@@ -419,6 +508,10 @@ public:
 	void			setDisableMixing(bool disableMixing) { this->disableMixing = disableMixing; }
 	void			setAllowFilters(bool allowFilters) { this->allowFilters = allowFilters; }
 	bool			getAllowFilters() const { return allowFilters; }
+	// mix everything up to the next tick in one go instead of one beat packet
+	// at a time, requires the timer handler to support getNumBeatPacketsToNextTick()
+	void			setTickSpanMixing(bool tickSpanMixing) { this->tickSpanMixing = tickSpanMixing; }
+	bool			isTickSpanMixing() const { return tickSpanMixing; }
 
 	void			resetChannelsFull();
 	void			resetChannelsWithoutMuting();
@@ -456,6 +549,27 @@ public:
 	
 	ResamplerBase*  getCurrentResampler() const { return resamplerTable[resamplerType]; }
 	
+	// state history of a channel, one entry per beat packet of the current buffer
+	const TTimeRecord* getTimeRecord(mp_uint32 c) const { return timeRecords ? timeRecords + c*timeRecordSize : NULL; }
+	mp_uint32		getTimeRecordSize() const { return timeRecordSize; }
+	
+	// record the output of each channel for oscilloscopes while mixing,
+	// off by default since it makes mixing noticeably slower. Don't change
+	// this while mixing
+	void			setScopeTaps(bool enable);
+	bool			hasScopeTaps() const { return scopeTaps != NULL; }
+	// resample numFrames frames of channel c's output, starting with the given
+	// beat packet of the current buffer, into count values. Can be called from 
+	// any thread, fails if there are no taps or they have been overwritten
+	bool			readScopeTap(mp_uint32 c, mp_uint32 beatPacketIndex, mp_uint32 numFrames, mp_sint32* buffer, mp_uint32 count) const;
+	
+	// run the channels playing the given sample data through insertHook 
+	// before they're added to the mix, insertHook sees only these channels
+	// and its mix() is called once per beat packet or tick span.
+	// NULL removes the hook, don't change this while mixing
+	void			setInsertHook(Mixable* insertHook, const mp_sbyte* sample);
+	Mixable*		getInsertHook() const { return insertHook; }
+	
 protected:
 	bool			initialized;
 	bool			startPlay;
@@ -504,6 +618,11 @@ public:
 
 	void			breakLoop(mp_sint32 c) { channel[c].flags&=~3; channel[c].loopend = channel[c].smplen; }
 
+	// stops every channel playing from the given sample memory and removes it
+	// from the time records, so it can be freed afterwards. As this doesn't wait
+	// for the mixer, it must be called from the mixer thread (e.g. in a timer tick)
+	void			detachSampleData(const mp_sbyte* smp);
+
 	// handle with care
 	void			setSamplePos(mp_sint32 c, mp_sint32 pos) { channel[c].smppos = pos; channel[c].smpposfrac = 0; }
 	
@@ -543,9 +662,30 @@ public:
 protected:
 	// timer procedure for mixing
 	virtual void	timerHandler(mp_sint32 currentBeatPacket) = 0;
+	// number of beat packets after the current one in which the timer handler
+	// doesn't touch any channel, 0 if that's unknown
+	virtual mp_uint32 getNumBeatPacketsToNextTick() const { return 0; }
 	void		   	panToVol(ChannelMixer::TMixerChannel *chn, mp_sint32 &left, mp_sint32 &right);
 	static mp_sint32 panLUT[257];
 
+	// fills panLUT at startup, mixers may be created from several threads
+	struct PanLUTInitializer
+	{
+		PanLUTInitializer();
+	};
+	static PanLUTInitializer panLUTInitializer;
+
+	// fractions of a filter cutoff step and filter resonances, 
+	// filled at startup as well
+	static double filterCutoffFractionLUT[256];
+	static float filterResonanceLUT[128];
+	
+	struct FilterLUTInitializer
+	{
+		FilterLUTInitializer();
+	};
+	static FilterLUTInitializer filterLUTInitializer;
+
 #ifdef MILKYTRACKER
 	friend class PlayerController;
 #endif
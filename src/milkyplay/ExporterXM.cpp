@@ -1342,9 +1342,21 @@ static void sort(mp_sword* array,mp_sint32 l, mp_sint32 r)
 }
 
 mp_sint32 XModule::saveExtendedModule(const SYSCHAR* fileName, const char* trackerString/* = NULL*/)
+{
+	XMFile f(fileName, true);
+	
+	if (!f.isOpenForWriting())
+		return MP_DEVICE_ERROR;
+
+	return saveExtendedModule(f, trackerString);
+}
+
+mp_sint32 XModule::saveExtendedModule(XMFileBase& f, const char* trackerString/* = NULL*/)
 {
 	mp_sint32 i,j,k,l;
 	
+	decodeAllSamples();
+	
 	TWorkBuffers workBuffers;
 	workBuffers.bpm = header.speed;
 	workBuffers.speed = header.tempo;
@@ -1362,8 +1374,6 @@ mp_sint32 XModule::saveExtendedModule(const SYSCHAR* fileName, const char* track
 		insNum++;
 	
 	// ------ start ---------------------------------
-	XMFile f(fileName, true);
-	
 	if (!f.isOpenForWriting())
 		return MP_DEVICE_ERROR;
 
@@ -1860,6 +1870,8 @@ mp_sint32 XModule::saveProtrackerModule(const SYSCHAR* fileName)
 	if (!f.isOpenForWriting())
 		return MP_DEVICE_ERROR;
 
+	decodeAllSamples();
+
 	f.write(header.name,1,20);
 	
 	mp_sint32 i,j,k;
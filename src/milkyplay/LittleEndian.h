@@ -39,11 +39,24 @@
 
 #include "MilkyPlayTypes.h"
 
+// Byte order of the host, only needed for the bulk conversions below
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__)
+	#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		#define MILKYPLAY_BIGENDIAN
+	#endif
+#elif defined(__BIG_ENDIAN__) || defined(__ppc__) || defined(__POWERPC__)
+	#define MILKYPLAY_BIGENDIAN
+#endif
+
 class LittleEndian
 {
 public:
 	static mp_uword			GET_WORD(const void* ptr);
 	static mp_uint32		GET_DWORD(const void* ptr);
+
+	// In place conversion of count little endian words/dwords into host order
+	static void				CONVERT_WORDS(mp_uword* buffer, mp_uint32 count);
+	static void				CONVERT_DWORDS(mp_dword* buffer, mp_uint32 count);
 };
 
 class BigEndian
@@ -51,6 +64,58 @@ class BigEndian
 public:
 	static mp_uword			GET_WORD(const void* ptr);
 	static mp_uint32		GET_DWORD(const void* ptr);
+
+	// In place conversion of count big endian words/dwords into host order
+	static void				CONVERT_WORDS(mp_uword* buffer, mp_uint32 count);
+	static void				CONVERT_DWORDS(mp_dword* buffer, mp_uint32 count);
 };
 
+#ifdef MILKYPLAY_BIGENDIAN
+inline void LittleEndian::CONVERT_WORDS(mp_uword* buffer, mp_uint32 count)
+{
+	for (mp_uint32 i = 0; i < count; i++)
+		buffer[i] = (mp_uword)((buffer[i] >> 8) | (buffer[i] << 8));
+}
+
+inline void LittleEndian::CONVERT_DWORDS(mp_dword* buffer, mp_uint32 count)
+{
+	for (mp_uint32 i = 0; i < count; i++)
+	{
+		const mp_dword dw = buffer[i];
+		buffer[i] = (dw >> 24) | ((dw >> 8) & 0xFF00) | ((dw & 0xFF00) << 8) | (dw << 24);
+	}
+}
+
+inline void BigEndian::CONVERT_WORDS(mp_uword*, mp_uint32)
+{
+}
+
+inline void BigEndian::CONVERT_DWORDS(mp_dword*, mp_uint32)
+{
+}
+#else
+inline void LittleEndian::CONVERT_WORDS(mp_uword*, mp_uint32)
+{
+}
+
+inline void LittleEndian::CONVERT_DWORDS(mp_dword*, mp_uint32)
+{
+}
+
+inline void BigEndian::CONVERT_WORDS(mp_uword* buffer, mp_uint32 count)
+{
+	for (mp_uint32 i = 0; i < count; i++)
+		buffer[i] = (mp_uword)((buffer[i] >> 8) | (buffer[i] << 8));
+}
+
+inline void BigEndian::CONVERT_DWORDS(mp_dword* buffer, mp_uint32 count)
+{
+	for (mp_uint32 i = 0; i < count; i++)
+	{
+		const mp_dword dw = buffer[i];
+		buffer[i] = (dw >> 24) | ((dw >> 8) & 0xFF00) | ((dw & 0xFF00) << 8) | (dw << 24);
+	}
+}
+#endif
+
 #endif
@@ -45,7 +45,12 @@ const char* LoaderDTM_2::identifyModule(const mp_ubyte* buffer)
 		
 	bool hasPATT = false, hasINST = false, hasSEQ = false;
 	
-	mp_sint32 i = 8 + BigEndian::GET_DWORD(buffer+4);
+	// chunks behind a header this long are out of reach anyway
+	const mp_uint32 headerLen = BigEndian::GET_DWORD(buffer+4);
+	if (headerLen > 2040)
+		return NULL;
+		
+	mp_sint32 i = 8 + headerLen;
 	while (i < 2040 && !(hasPATT && hasINST && hasSEQ))
 	{
 		mp_ubyte ID[4], lenBuf[4];
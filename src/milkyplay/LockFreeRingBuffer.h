@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2009, The MilkyTracker Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the <ORGANIZATION> nor the names of its contributors
+ *   may be used to endorse or promote products derived from this software
+ *   without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ *  LockFreeRingBuffer.h
+ *  MilkyPlay
+ *
+ *  Single producer/single consumer ring buffer without any locking.
+ *
+ *  One thread only ever calls push(), another one only pop(). An entry
+ *  is written before the write index is published (release) and the
+ *  consumer reads the write index before the entry (acquire), the read
+ *  index works the same way in the other direction. Neither side ever
+ *  waits for the other, push() simply fails when the buffer is full.
+ *
+ *  The indices are free running counters, so all size entries can be
+ *  used and getNumPushed()/getNumPopped() can be compared to find out
+ *  whether a given entry has been consumed yet.
+ *
+ */
+#ifndef __LOCKFREERINGBUFFER_H__
+#define __LOCKFREERINGBUFFER_H__
+
+#include "MilkyPlayTypes.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7)))
+#define __LOCKFREE_GCC_ATOMICS__
+#endif
+
+namespace LockFreeAtomic
+{
+	static inline void barrier()
+	{
+#if defined(__GNUC__)
+		__sync_synchronize();
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+		__dmb(_ARM64_BARRIER_ISH);
+#elif defined(_MSC_VER) && defined(_M_ARM)
+		__dmb(_ARM_BARRIER_ISH);
+#elif defined(_MSC_VER)
+		// x86 keeps the order of loads and of stores, only the compiler must not reorder
+		_ReadWriteBarrier();
+#endif
+	}
+
+	static inline mp_uint32 loadAcquire(const volatile mp_uint32* p)
+	{
+#ifdef __LOCKFREE_GCC_ATOMICS__
+		return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#else
+		mp_uint32 v = *p;
+		barrier();
+		return v;
+#endif
+	}
+
+	static inline void storeRelease(volatile mp_uint32* p, mp_uint32 v)
+	{
+#ifdef __LOCKFREE_GCC_ATOMICS__
+		__atomic_store_n(p, v, __ATOMIC_RELEASE);
+#else
+		barrier();
+		*p = v;
+#endif
+	}
+
+	// stores v only if *p still holds expected, returns whether it did
+	static inline bool compareAndSwap(volatile mp_uint32* p, mp_uint32 expected, mp_uint32 v)
+	{
+#if defined(__GNUC__)
+		return __sync_bool_compare_and_swap(p, expected, v);
+#elif defined(_MSC_VER)
+		return _InterlockedCompareExchange((volatile long*)p, (long)v, (long)expected) == (long)expected;
+#else
+		// not atomic, only good enough for a single thread
+		if (*p != expected)
+			return false;
+		*p = v;
+		return true;
+#endif
+	}
+}
+
+// size must be a power of two
+template<class T, mp_uint32 size>
+class LockFreeRingBuffer
+{
+private:
+	typedef char SizeMustBePowerOfTwo[(size && !(size & (size - 1))) ? 1 : -1];
+
+	T buffer[size];
+
+	volatile mp_uint32 readIndex;
+	volatile mp_uint32 writeIndex;
+
+	// no copying
+	LockFreeRingBuffer(const LockFreeRingBuffer& src);
+	LockFreeRingBuffer& operator=(const LockFreeRingBuffer& src);
+
+public:
+	LockFreeRingBuffer() :
+		readIndex(0),
+		writeIndex(0)
+	{
+	}
+
+	// producer side
+	bool push(const T& entry)
+	{
+		const mp_uint32 w = writeIndex;
+		if (w - LockFreeAtomic::loadAcquire(&readIndex) >= size)
+			return false;
+
+		buffer[w & (size - 1)] = entry;
+		LockFreeAtomic::storeRelease(&writeIndex, w + 1);
+		return true;
+	}
+
+	// consumer side
+	bool pop(T& entry)
+	{
+		const mp_uint32 r = readIndex;
+		if (r == LockFreeAtomic::loadAcquire(&writeIndex))
+			return false;
+
+		entry = buffer[r & (size - 1)];
+		LockFreeAtomic::storeRelease(&readIndex, r + 1);
+		return true;
+	}
+
+	// pop() in two steps: the entry stays queued (and counts as not popped
+	// for the producer) until consume() is called after it has been used
+	bool peek(T& entry) const
+	{
+		const mp_uint32 r = readIndex;
+		if (r == LockFreeAtomic::loadAcquire(&writeIndex))
+			return false;
+
+		entry = buffer[r & (size - 1)];
+		return true;
+	}
+
+	void consume()
+	{
+		LockFreeAtomic::storeRelease(&readIndex, readIndex + 1);
+	}
+
+	// these can be called from either side
+	mp_uint32 getNumPushed() const { return LockFreeAtomic::loadAcquire(&writeIndex); }
+	mp_uint32 getNumPopped() const { return LockFreeAtomic::loadAcquire(&readIndex); }
+	bool isEmpty() const { return getNumPushed() == getNumPopped(); }
+
+	// true when the entry which made getNumPushed() return numPushed has been popped
+	bool hasPopped(mp_uint32 numPushed) const { return (mp_sint32)(getNumPopped() - numPushed) >= 0; }
+};
+
+#endif
@@ -39,12 +39,71 @@
 #include "MilkyPlayCommon.h"
 #include "AudioDriverBase.h"
 #include "AudioDriverManager.h"
+#include "ThreadPool.h"
+#include "LockFreeRingBuffer.h"
+#include <stddef.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define __MASTERMIXER_SSE2__
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define __MASTERMIXER_NEON__
+#include <arm_neon.h>
+#endif
 
 enum
 {
 	BlockTimeOut = 5000
 };
 
+class MasterMixer::DeviceMixJob : public ThreadPool::Job
+{
+public:
+	Mixable* mixable;
+	mp_sint32* buffer;
+	mp_uint32 bufferSize;
+	bool clear;
+
+	DeviceMixJob() :
+		mixable(0),
+		buffer(0),
+		bufferSize(0),
+		clear(false)
+	{
+	}
+
+	virtual void run()
+	{
+		if (clear)
+			memset(buffer, 0, bufferSize*MP_NUMCHANNELS*sizeof(mp_sint32));
+		mixable->mix(buffer, bufferSize);
+	}
+};
+
+// dst+=src, integer additions so the result doesn't depend on the order
+static void sumBuffers(mp_sint32* dst, const mp_sint32* src, mp_uint32 count)
+{
+	mp_uint32 i = 0;
+#if defined(__MASTERMIXER_SSE2__)
+	// src is a scratch buffer and always aligned
+	for (; i + 8 <= count; i+=8)
+	{
+		__m128i* d = (__m128i*)(dst + i);
+		const __m128i* s = (const __m128i*)(src + i);
+		_mm_storeu_si128(d, _mm_add_epi32(_mm_loadu_si128(d), _mm_load_si128(s)));
+		_mm_storeu_si128(d + 1, _mm_add_epi32(_mm_loadu_si128(d + 1), _mm_load_si128(s + 1)));
+	}
+#elif defined(__MASTERMIXER_NEON__)
+	for (; i + 8 <= count; i+=8)
+	{
+		vst1q_s32(dst + i, vaddq_s32(vld1q_s32(dst + i), vld1q_s32(src + i)));
+		vst1q_s32(dst + i + 4, vaddq_s32(vld1q_s32(dst + i + 4), vld1q_s32(src + i + 4)));
+	}
+#endif
+	for (; i < count; i++)
+		dst[i]+=src[i];
+}
+
 MasterMixer::MasterMixer(mp_uint32 sampleRate, 
 						 mp_uint32 bufferSize/* = 0*/, 
 						 mp_uint32 numDevices/* = 1*/,
@@ -57,7 +116,15 @@ MasterMixer::MasterMixer(mp_uint32 sampleRate,
 	disableMixing(false),
 	numDevices(numDevices),
 	filterHook(0),
+	limiterDrive(0),
 	devices(new DeviceDescriptor[numDevices]),
+	parallelMixing(false),
+	minParallelBufferSize(DefaultMinParallelBufferSize),
+	threadPool(0),
+	mixJobs(0),
+	scratchBufferMem(0),
+	scratchBuffer(0),
+	scratchBufferStride(0),
 	audioDriverManager(0),
 	audioDriver(audioDriver),
 	initialized(false),
@@ -71,6 +138,8 @@ MasterMixer::~MasterMixer()
 {
 	cleanup();
 
+	delete threadPool;
+	delete[] mixJobs;
 	delete audioDriverManager;
 	delete[] devices;
 }
@@ -121,6 +190,9 @@ mp_sint32 MasterMixer::openAudioDevice()
 	
 	buffer = new mp_sint32[bufferSize*MP_NUMCHANNELS];	
 	
+	if (parallelMixing)
+		allocScratchBuffers();
+	
 	initialized = true;	
 	return 0;
 }
@@ -206,6 +278,7 @@ mp_sint32 MasterMixer::setBufferSize(mp_uint32 bufferSize)
 		this->bufferSize = bufferSize;
 		delete[] buffer;
 		buffer = NULL;
+		freeScratchBuffers();
 		
 		notifyListener(MasterMixerNotificationBufferSizeChanged);
 	}
@@ -380,7 +453,119 @@ bool MasterMixer::isDevicePaused(Mixable* device)
 	return false;
 }
 
+void MasterMixer::setParallelMixing(bool parallelMixing, mp_uint32 minBufferSize/* = DefaultMinParallelBufferSize*/)
+{
+	minParallelBufferSize = minBufferSize;
+
+	if (parallelMixing && threadPool == NULL)
+	{
+		// nothing to gain
+		if (numDevices < 2 || ThreadPool::getNumProcessors() < 2)
+			return;
+	
+		mixJobs = new DeviceMixJob[numDevices];
+		threadPool = new ThreadPool();
+	}
+
+	// scratch buffers are only ever freed while the audio device is closed,
+	// the mixer thread must not see the flag before everything is in place
+	if (parallelMixing && scratchBuffer == NULL && buffer)
+		allocScratchBuffers();
+	
+	LockFreeAtomic::barrier();
+	this->parallelMixing = parallelMixing;
+}
+
 void MasterMixer::mixerHandler(mp_sword* buffer)
+{
+	mixDevices();
+	
+	if (!disableMixing)
+		swapOutBuffer(buffer);
+}
+
+void MasterMixer::mixerHandler(mp_sint32* buffer)
+{
+	mixDevices();
+	
+	if (disableMixing)
+		return;
+		
+	if (filterHook)
+		filterHook->mix(this->buffer, bufferSize);
+	
+	memcpy(buffer, this->buffer, bufferSize*MP_NUMCHANNELS*sizeof(mp_sint32));
+}
+
+void MasterMixer::mixerHandler(float* buffer)
+{
+	mixDevices();
+	
+	if (disableMixing)
+		return;
+		
+	if (filterHook)
+		filterHook->mix(this->buffer, bufferSize);
+	
+	const mp_sint32* bufferIn = this->buffer;
+	const float scale = 1.0f / (float)(32768 << sampleShift);
+	const mp_sint32 bufferSize = this->bufferSize*MP_NUMCHANNELS;
+	
+	for (mp_sint32 i = 0; i < bufferSize; i++)
+		*buffer++ = (float)*bufferIn++ * scale;
+}
+
+void MasterMixer::notifyListener(MasterMixerNotifications notification)
+{
+	if (listener)
+		listener->masterMixerNotification(notification);
+}
+
+void MasterMixer::cleanup()
+{
+	if (started)
+		stop();
+
+	if (initialized)
+		closeAudioDevice();
+
+	if (buffer)
+	{
+		delete[] buffer;	
+		buffer = 0;
+	}
+	
+	freeScratchBuffers();
+}
+
+void MasterMixer::allocScratchBuffers()
+{
+	freeScratchBuffers();
+
+	if (numDevices < 2 || bufferSize == 0)
+		return;
+
+	// the first active device mixes straight into the mix buffer,
+	// every other one gets a buffer starting on a cache line of its own
+	scratchBufferStride = (bufferSize*MP_NUMCHANNELS + 15) & ~15;
+	scratchBufferMem = new mp_sint32[scratchBufferStride*(numDevices-1) + 16];
+	scratchBuffer = (mp_sint32*)(((size_t)scratchBufferMem + 63) & ~(size_t)63);
+}
+
+void MasterMixer::freeScratchBuffers()
+{
+	scratchBuffer = 0;
+	delete[] scratchBufferMem;
+	scratchBufferMem = 0;
+	scratchBufferStride = 0;
+}
+
+inline void MasterMixer::prepareBuffer()
+{
+	memset(buffer, 0, bufferSize*MP_NUMCHANNELS*sizeof(mp_sint32)); 
+}
+
+inline void MasterMixer::mixDevices()
 {
 	if (!disableMixing)
 		prepareBuffer();
@@ -389,6 +574,11 @@ void MasterMixer::mixerHandler(mp_sword* buffer)
 	const mp_uint32 bufferSize = this->bufferSize;
 	mp_sint32* mixBuffer = this->buffer;
 	
+	// devices are only collected here and mixed in parallel afterwards
+	const bool parallel = parallelMixing && scratchBuffer && !disableMixing && 
+		bufferSize >= minParallelBufferSize;
+	mp_uint32 numActiveDevices = 0;
+	
 	DeviceDescriptor* device = this->devices;	
 	for (mp_sint32 i = 0; i < numDevices; i++, device++)
 	{
@@ -404,43 +594,52 @@ void MasterMixer::mixerHandler(mp_sword* buffer)
 		}
 		else if (device->mixable && !device->paused)
 		{
-			device->mixable->mix(mixBuffer, bufferSize);
+			if (parallel)
+				mixJobs[numActiveDevices++].mixable = device->mixable;
+			else
+				device->mixable->mix(mixBuffer, bufferSize);
 		}
 	}
 
+	if (numActiveDevices)
+		mixDevicesParallel(numActiveDevices);
+
 	if( limiterDrive > 0 ){
 		masteringLimiter.ingain = float(30.0/10.0) * (float)limiterDrive;
 		masteringLimiter.mix(mixBuffer, bufferSize );
 	}
-	
-	if (!disableMixing)
-		swapOutBuffer(buffer);
-}
-
-void MasterMixer::notifyListener(MasterMixerNotifications notification)
-{
-	if (listener)
-		listener->masterMixerNotification(notification);
 }
 
-void MasterMixer::cleanup()
+inline void MasterMixer::mixDevicesParallel(mp_uint32 numActiveDevices)
 {
-	if (started)
-		stop();
-
-	if (initialized)
-		closeAudioDevice();
+	mp_sint32* mixBuffer = this->buffer;
+	const mp_uint32 bufferSize = this->bufferSize;
 
-	if (buffer)
+	if (numActiveDevices < 2)
 	{
-		delete[] buffer;	
-		buffer = 0;
+		mixJobs[0].mixable->mix(mixBuffer, bufferSize);
+		return;
 	}
-}
 
-inline void MasterMixer::prepareBuffer()
-{
-	memset(buffer, 0, bufferSize*MP_NUMCHANNELS*sizeof(mp_sint32)); 
+	mixJobs[0].buffer = mixBuffer;
+	mixJobs[0].bufferSize = bufferSize;
+	mixJobs[0].clear = false;
+	
+	mp_uint32 i;
+	for (i = 1; i < numActiveDevices; i++)
+	{
+		mixJobs[i].buffer = scratchBuffer + (i-1)*scratchBufferStride;
+		mixJobs[i].bufferSize = bufferSize;
+		mixJobs[i].clear = true;
+		threadPool->addJob(&mixJobs[i]);
+	}
+	
+	// the mixer thread takes the first device and helps out with the rest
+	mixJobs[0].run();
+	threadPool->waitForAll();
+	
+	for (i = 1; i < numActiveDevices; i++)
+		sumBuffers(mixBuffer, mixJobs[i].buffer, bufferSize*MP_NUMCHANNELS);
 }
 
 inline void MasterMixer::swapOutBuffer(mp_sword* bufferOut)
@@ -50,6 +50,13 @@ public:
 		MasterMixerNotificationSampleRateChanged
 	};
 
+	enum
+	{
+		// below this many frames dispatching the devices to the
+		// worker threads costs more than it saves
+		DefaultMinParallelBufferSize = 512
+	};
+
 	class MasterMixerNotificationListener
 	{
 	public:
@@ -98,6 +105,12 @@ public:
 		
 	void mixerHandler(mp_sword* buffer);
 	
+	// same as above but without reducing the mix to 16 bit, nothing is clipped:
+	// the 32 bit version hands out the mix buffer as is (full scale is 32768<<sampleShift),
+	// the float version scales it to -1.0 .. 1.0
+	void mixerHandler(mp_sint32* buffer);
+	void mixerHandler(float* buffer);
+	
 	// allows to control the loudness of the resulting output stream
 	// by bit-shifting the output *right* (dividing by 2^shift)
 	void setSampleShift(mp_sint32 shift) { sampleShift = shift; }
@@ -121,6 +134,14 @@ public:
 	mp_sint32 getCurrentSamplePeak(mp_sint32 position, mp_sint32 channel);	
 
 	void setLimiterDrive( mp_uint32 drive ){ this->limiterDrive = drive; }
+
+	// mix every device into a buffer of its own on a pool of worker threads
+	// and sum the buffers up afterwards. Buffers smaller than minBufferSize
+	// and less than two active devices are still mixed serially.
+	// The output is identical to the serial mix, so this can be toggled
+	// while the mixer is running.
+	void setParallelMixing(bool parallelMixing, mp_uint32 minBufferSize = DefaultMinParallelBufferSize);
+	bool isParallelMixing() const { return parallelMixing; }
 			
 private:
 	MasterMixerNotificationListener* listener;
@@ -151,6 +172,16 @@ private:
 	};
 	
 	DeviceDescriptor* devices;
+
+	class DeviceMixJob;
+	
+	bool parallelMixing;
+	mp_uint32 minParallelBufferSize;
+	class ThreadPool* threadPool;
+	DeviceMixJob* mixJobs;
+	mp_sint32* scratchBufferMem;
+	mp_sint32* scratchBuffer;
+	mp_uint32 scratchBufferStride;
 	
 	mutable class AudioDriverManager* audioDriverManager;
 	AudioDriverInterface* audioDriver;
@@ -163,7 +194,12 @@ private:
 	
 	void cleanup();
 	
+	void allocScratchBuffers();
+	void freeScratchBuffers();
+	
 	inline void prepareBuffer();
+	inline void mixDevices();
+	inline void mixDevicesParallel(mp_uint32 numActiveDevices);
 	inline void swapOutBuffer(mp_sword* bufferOut);
 };
 
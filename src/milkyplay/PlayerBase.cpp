@@ -99,6 +99,8 @@ PlayerBase::PlayerBase(mp_uint32 frequency) :
 
 	patternIndexToPlay = -1;
 	
+	stateSnapshotTable = NULL;
+	
 	playMode = PlayMode_Auto;	
 	
 	reallocTimeRecord();
@@ -329,6 +331,103 @@ void PlayerBase::setPatternPos(mp_uint32 pos, mp_uint32 row/* = 0*/, bool resetC
 	}
 }
 
+bool PlayerBase::setPatternPosFromSnapshot(const StateSnapshotTable& table, mp_uint32 pos, mp_uint32 row/* = 0*/)
+{
+	if (!module || !startPlay || paused || playOneRowOnly || patternIndexToPlay != -1) 
+		return false;
+
+	const StateSnapshot* snapshot = table.get(pos);
+	
+	// the snapshot might have been taken after a pattern break into the order
+	if (snapshot == NULL || snapshot->getRow() > (mp_sint32)row)
+		return false;
+		
+	if (!restoreStateSnapshot(*snapshot))
+		return false;
+
+	// replay without mixing until the row is about to be processed
+	while (poscnt == (mp_sint32)pos && adder && !halted &&
+		   (rowcnt != (mp_sint32)row || ticker != 0 || !(((mp_int64)BPMCounter + (mp_int64)adder) >> 32)))
+	{
+		timerHandler(0);
+	}
+	
+	ChannelMixer::resetChannelsWithoutMuting();
+	
+	lastUnvisitedPos = poscnt;
+	
+	updateTimeRecord();
+	
+	return true;
+}
+
+void PlayerBase::saveState(StateSnapshot& snapshot) const
+{
+	snapshot.playerType = getType();
+	snapshot.module = module;
+	snapshot.mainVolume = mainVolume;
+	snapshot.tickSpeed = tickSpeed;
+	snapshot.baseBpm = baseBpm;
+	snapshot.bpm = bpm;
+	snapshot.ticker = ticker;
+	snapshot.rowcnt = rowcnt;
+	snapshot.poscnt = poscnt;
+	snapshot.synccnt = synccnt;
+	snapshot.adder = adder;
+	snapshot.BPMCounter = BPMCounter;
+}
+
+void PlayerBase::restoreState(const StateSnapshot& snapshot)
+{
+	ChannelMixer::resetChannelsWithoutMuting();
+
+	mainVolume = snapshot.mainVolume;
+	tickSpeed = snapshot.tickSpeed;
+	baseBpm = snapshot.baseBpm;
+	bpm = snapshot.bpm;
+	ticker = snapshot.ticker;
+	rowcnt = snapshot.rowcnt;
+	poscnt = snapshot.poscnt;
+	synccnt = snapshot.synccnt;
+	adder = snapshot.adder;
+	BPMCounter = snapshot.BPMCounter;
+	
+	lastUnvisitedPos = poscnt;
+	halted = false;
+
+	updateTimeRecord();
+}
+
+PlayerBase::StateSnapshotTable::StateSnapshotTable()
+{
+	memset(snapshots, 0, sizeof(snapshots));
+}
+
+PlayerBase::StateSnapshotTable::~StateSnapshotTable()
+{
+	clear();
+}
+
+void PlayerBase::StateSnapshotTable::clear()
+{
+	for (mp_uint32 i = 0; i < sizeof(snapshots)/sizeof(StateSnapshot*); i++)
+	{
+		delete snapshots[i];
+		snapshots[i] = NULL;
+	}
+}
+
+void PlayerBase::StateSnapshotTable::set(mp_uint32 order, StateSnapshot* snapshot)
+{
+	if (order >= sizeof(snapshots)/sizeof(StateSnapshot*))
+	{
+		delete snapshot;
+		return;
+	}
+	
+	delete snapshots[order];
+	snapshots[order] = snapshot;
+}
 
 void PlayerBase::timerHandler(mp_sint32 currentBeatPacket)
 {
@@ -338,4 +437,27 @@ void PlayerBase::timerHandler(mp_sint32 currentBeatPacket)
 											   tickSpeed, 
 											   mainVolume,
 											   ticker);
+
+	// the players add the adder right after this, so a carry
+	// means the row is about to be processed
+	if (stateSnapshotTable && startPlay && !paused && !halted && !idle && 
+		patternIndexToPlay == -1 && ticker == 0 &&
+		(((mp_int64)BPMCounter + (mp_int64)adder) >> 32) &&
+		!stateSnapshotTable->get(poscnt))
+	{
+		stateSnapshotTable->set(poscnt, createStateSnapshot());
+	}
+}
+
+mp_uint32 PlayerBase::getNumBeatPacketsToNextTick() const
+{
+	// BPM independent envelopes are updated on every beat packet
+	if (module == NULL || (module->header.flags & XModule::MODULE_AMSENVELOPES))
+		return 0;
+	
+	if (paused || !adder)
+		return 0xFFFFFFFF;
+
+	// the timer handler adds adder to BPMCounter, the first carry is the next tick
+	return (mp_uint32)((0xFFFFFFFFu - BPMCounter) / adder);
 }
@@ -153,6 +153,55 @@ public:
 		PlayerType_INVALID = -1	// NULL player :D
 	};
 	
+	// Copy of the replay state right before a row is processed,
+	// the players derive from this to add their channel state
+	class StateSnapshot
+	{
+	private:
+		PlayerTypes		playerType;
+		const XModule*	module;
+		mp_sint32		mainVolume;
+		mp_sint32		tickSpeed;
+		mp_sint32		baseBpm;
+		mp_sint32		bpm;
+		mp_sint32		ticker;
+		mp_sint32		rowcnt;
+		mp_sint32		poscnt;
+		mp_int64		synccnt;
+		mp_uint32		adder, BPMCounter;
+		
+		friend class PlayerBase;
+
+	public:
+		virtual ~StateSnapshot() {}
+		
+		PlayerTypes		getPlayerType() const { return playerType; }
+		mp_sint32		getOrder() const { return poscnt; }
+		mp_sint32		getRow() const { return rowcnt; }
+	};
+	
+	// One snapshot per order, taken when the order is entered for the first time
+	class StateSnapshotTable
+	{
+	private:
+		StateSnapshot*	snapshots[256];
+		
+		// not copyable
+		StateSnapshotTable(const StateSnapshotTable& src);
+		const StateSnapshotTable& operator=(const StateSnapshotTable& src);
+		
+	public:
+		StateSnapshotTable();
+		~StateSnapshotTable();
+		
+		void			clear();
+		
+		// the table takes ownership of the snapshot
+		void			set(mp_uint32 order, StateSnapshot* snapshot);
+		
+		const StateSnapshot* get(mp_uint32 order) const { return order < 256 ? snapshots[order] : NULL; }
+	};
+	
 protected:
 	XModule*		module;
 
@@ -183,8 +232,19 @@ protected:
 
 	mp_sint32		patternIndexToPlay;		// Play special pattern, -1 = Play entire song
 
+	StateSnapshotTable* stateSnapshotTable;	// Snapshots are captured into this table while playing (can be NULL)
+
 	mp_sint32		kick();
 
+	void			saveState(StateSnapshot& snapshot) const;
+	void			restoreState(const StateSnapshot& snapshot);
+
+	// snapshots can only be restored into the same kind of player playing the same module
+	bool			canRestoreState(const StateSnapshot& snapshot) const 
+	{
+		return module != NULL && snapshot.module == module && snapshot.playerType == getType();
+	}
+
 	virtual mp_sint32 allocateStructures() { return 0; }
 
 	virtual void clearEffectMemory() { }	
@@ -219,6 +279,9 @@ public:
 	// virtual from mixer class, perform playing here
 	virtual void timerHandler(mp_sint32 currentBeatPacket);
 
+	// ticks are only processed when the BPM counter overflows
+	virtual mp_uint32 getNumBeatPacketsToNextTick() const;
+
 	virtual void restart(mp_uint32 startPosition = 0, 
 						 mp_uint32 startRow = 0, 
 						 bool resetMixer = true, 
@@ -287,6 +350,14 @@ public:
 
 	virtual mp_sint32	getLastUnvisitedPosition() const { return lastUnvisitedPos; }
 
+	// the position the replay is at, getPosition() follows the mixed beat packets instead
+	void				getReplayPosition(mp_sint32& order, mp_sint32& row, mp_sint32& ticker) const
+	{
+		order = poscnt;
+		row = rowcnt;
+		ticker = this->ticker;
+	}
+
 	virtual void		getPosition(mp_sint32& order, mp_sint32& row, mp_sint32& ticker, mp_uint32 i = 0) const
 	{ 
 		order = (timeRecord[i].posRowTempoSpeed >> TimeRecord::BITPOS_POS) & 255;
@@ -300,6 +371,19 @@ public:
 	virtual void			lastPattern();
 	virtual void			setPatternPos(mp_uint32 pos, mp_uint32 row = 0, bool resetChannels = true, bool resetFXMemory = true);
 
+	// Capture a snapshot whenever an order is entered for the first time
+	void					setStateSnapshotTable(StateSnapshotTable* table) { stateSnapshotTable = table; }
+	
+	// Copy of the current state, NULL if the player doesn't support snapshots
+	virtual StateSnapshot*	createStateSnapshot() const { return NULL; }
+	
+	// Continue from a snapshot of the same module, the mixer channels are reset
+	virtual bool			restoreStateSnapshot(const StateSnapshot&) { return false; }
+
+	// Jump to the position with the state a linear playthrough would have,
+	// returns false if the table has nothing for that order
+	bool					setPatternPosFromSnapshot(const StateSnapshotTable& table, mp_uint32 pos, mp_uint32 row = 0);
+
 	virtual void			setTempo(mp_sint32 tempo) 
 	{ 
 		bpm = tempo;
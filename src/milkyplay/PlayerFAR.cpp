@@ -420,6 +420,8 @@ DoNote1:
 					m=module->smp[module->instr[q].snum[0]].type;
 					CurVols[ch]=RetVol[ch]-1;
 					CurChSmp[ch]=q;
+					if (module->instr[q].snum[0] != -1)
+						module->decodeSample(module->instr[q].snum[0]);
 					if ((m&3) && module->instr[q].snum[0] != -1)
 					{
 						playSample(CurVoice, 
@@ -490,6 +492,8 @@ NoNote1:
 							   module->smp[module->instr[q].snum[0]].RepEnd,
 							   CurVoice,m);*/
 				
+				if (module->instr[q].snum[0] != -1)
+					module->decodeSample(module->instr[q].snum[0]);
 				if ((m&3) && module->instr[q].snum[0] != -1)
 				{
 					playSample(CurVoice, 
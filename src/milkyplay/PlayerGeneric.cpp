@@ -155,6 +155,29 @@ PlayerBase*	PlayerGeneric::getPreferredPlayer(XModule* module) const
 	}
 }
 
+PlayerBase* PlayerGeneric::getReplayOnlyPlayer(XModule* module) const
+{
+	PlayerBase* player = getPreferredPlayer(module);
+	
+	if (player == NULL)
+		return NULL;
+	
+	player->adjustFrequency(frequency);
+	player->setBufferSize(bufferSize);
+	player->setPlayMode(playMode);
+	for (mp_sint32 i = PlayModeOptionFirst; i < PlayModeOptionLast; i++)
+		player->enable((PlayModeOptions)i, options[i]);			
+	player->setDisableMixing(true);
+#ifndef MILKYTRACKER
+	if (player->getType() == PlayerBase::PlayerType_IT)
+	{
+		static_cast<PlayerIT*>(player)->setNumMaxVirChannels(numMaxVirChannels);
+	}
+#endif
+
+	return player;
+}
+
 PlayerGeneric::PlayerGeneric(mp_sint32 frequency, AudioDriverInterface* audioDriver/* = NULL*/) :
 	mixer(NULL),
 	player(NULL),
@@ -175,8 +198,12 @@ PlayerGeneric::PlayerGeneric(mp_sint32 frequency, AudioDriverInterface* audioDri
 	repeat = false;
 	resetOnStopFlag = false;
 	autoAdjustPeak = false;
+	exportWAVFormat = WAVWriter::WAVFormat16Bit;
+	exportFilterHook = NULL;
+	stateSnapshots = NULL;
 	disableMixing = false;
 	allowFilters = false;
+	tickSpanMixing = false;
 #ifdef __FORCEPOWEROFTWOBUFFERSIZE__
 	compensateBufferFlag = true;
 #else
@@ -215,6 +242,8 @@ PlayerGeneric::~PlayerGeneric()
 
 	delete[] audioDriverName;
 	
+	delete stateSnapshots;
+	
 	delete listener;
 }
 
@@ -578,6 +607,7 @@ mp_sint32 PlayerGeneric::startPlaying(XModule* module,
 			
 			player->setDisableMixing(disableMixing);
 			player->setAllowFilters(allowFilters);
+			player->setTickSpanMixing(tickSpanMixing);
 			//if (paused)
 			//	player->pausePlaying();
 
@@ -704,6 +734,14 @@ void PlayerGeneric::setAllowFilters(bool b)
 		player->setAllowFilters(allowFilters);
 }
 
+void PlayerGeneric::setTickSpanMixing(bool b)
+{
+	tickSpanMixing = b;
+
+	if (player)
+		player->setTickSpanMixing(tickSpanMixing);
+}
+
 bool PlayerGeneric::getAllowFilters() const
 {
 	if (player)
@@ -843,6 +881,160 @@ void PlayerGeneric::setPatternPos(mp_uint32 pos, mp_uint32 row/* = 0*/, bool res
 		player->setPatternPos(pos, row, resetChannels, resetFXMemory);
 }
 
+mp_sint32 PlayerGeneric::createStateSnapshots(XModule* module)
+{
+	clearStateSnapshots();
+
+	PlayerBase* player = getReplayOnlyPlayer(module);
+	
+	if (player == NULL)
+		return MP_UNSUPPORTED;
+
+	stateSnapshots = new PlayerBase::StateSnapshotTable();
+	player->setStateSnapshotTable(stateSnapshots);
+	
+	mp_sint32 res = player->startPlaying(module, false, 0, 0, -1, NULL, false, -1);
+	
+	// nothing is mixed, only the song is processed
+	if (res == MP_OK)
+	{
+		while (!player->hasSongHalted())
+			player->timerHandler(0);
+	}
+	
+	player->setStateSnapshotTable(NULL);
+	player->stopPlaying();
+	
+	delete player;
+	
+	if (res != MP_OK)
+		clearStateSnapshots();
+	
+	return res;
+}
+
+void PlayerGeneric::clearStateSnapshots()
+{
+	delete stateSnapshots;
+	stateSnapshots = NULL;
+}
+
+// same as XModule::buildSubSongTable: orders without any notes don't start a sub-song
+static bool isOrderEmpty(const XModule* module, mp_sint32 order)
+{
+	const mp_sint32 ord = module->header.ord[order];
+	if (ord >= module->header.patnum)
+		return true;
+		
+	const TXMPattern& pattern = module->phead[ord];
+	if (pattern.patternData == NULL)
+		return true;
+	
+	const mp_sint32 slotSize = 2 + 2*pattern.effnum;
+	for (mp_sint32 i = 0; i < pattern.rows*pattern.channum; i++)
+	{
+		if (pattern.patternData[i*slotSize])
+			return false;
+	}
+	
+	return true;
+}
+
+mp_sint32 PlayerGeneric::analyzeSong(XModule* module, TSongAnalysis& analysis)
+{
+	analysis.numSubSongs = 0;
+	for (mp_sint32 i = 0; i < 256; i++)
+		analysis.timingLUT[i] = -1;
+
+	PlayerBase* player = getReplayOnlyPlayer(module);
+	
+	if (player == NULL)
+		return MP_UNSUPPORTED;
+	
+	const mp_sint32 numOrders = module->header.ordnum;
+	const mp_int64 beatPacketSize = player->getBeatPacketSize();
+	
+	// rows which have been played by any of the sub-songs
+	mp_ubyte* rowHits = new mp_ubyte[256*256/8];
+	memset(rowHits, 0, 256*256/8);
+	
+	mp_sint32 res = MP_OK;
+	mp_sint32 startOrder = 0;
+
+	while (startOrder < numOrders && analysis.numSubSongs < 256)
+	{
+		res = player->startPlaying(module, false, startOrder, 0, -1, NULL, false, -1);
+		if (res != MP_OK)
+			break;
+	
+		TSubSong& subSong = analysis.subSongs[analysis.numSubSongs++];
+		subSong.startOrder = subSong.endOrder = startOrder;
+		subSong.loopOrder = subSong.loopRow = -1;
+		subSong.numSamples = 0;
+		
+		while (true)
+		{
+			mp_sint32 order, row, ticker;
+			player->getReplayPosition(order, row, ticker);
+			
+			const bool rowStarts = (ticker == 0 && player->getNumBeatPacketsToNextTick() == 0);
+			const bool visited = order < numOrders && ((rowHits[(order*256+row)>>3] >> (row&7)) & 1);
+			
+			player->timerHandler(0);
+			
+			if (rowStarts && order < numOrders)
+			{
+				rowHits[(order*256+row)>>3] |= 1 << (row&7);
+				
+				if (analysis.timingLUT[order] == -1)
+					analysis.timingLUT[order] = subSong.numSamples;
+				if (order > subSong.endOrder)
+					subSong.endOrder = order;
+			}
+			
+			// the player stops at the end of the song or when it comes 
+			// across a row which has been played already
+			if (player->hasSongHalted())
+			{
+				if (visited)
+				{
+					subSong.loopOrder = order;
+					subSong.loopRow = row;
+				}
+				break;
+			}
+			
+			subSong.numSamples+=beatPacketSize;
+		}
+		
+		player->stopPlaying();
+		
+		// next sub-song starts at the first order nobody has played yet
+		for (startOrder = 0; startOrder < numOrders; startOrder++)
+		{
+			if (analysis.timingLUT[startOrder] == -1 && !isOrderEmpty(module, startOrder))
+				break;
+		}
+	}
+	
+	delete[] rowHits;
+	delete player;
+	
+	return res;
+}
+
+bool PlayerGeneric::setPatternPosFromSnapshot(mp_uint32 pos, mp_uint32 row/* = 0*/)
+{
+	if (player == NULL)
+		return false;
+	
+	if (stateSnapshots && player->setPatternPosFromSnapshot(*stateSnapshots, pos, row))
+		return true;
+	
+	player->setPatternPos(pos, row);
+	return false;
+}
+
 mp_sint32 PlayerGeneric::getTempo() const
 {
 	if (player)
@@ -917,7 +1109,7 @@ struct PeakAutoAdjustFilter : public Mixable
 	}
 };
 
-// export to 16bit stereo WAV
+// export to stereo WAV (16 bit, 24 bit or float)
 mp_sint32 PlayerGeneric::exportToWAV(const SYSCHAR* fileName, XModule* module, 
 									 mp_sint32 startOrder/* = 0*/, mp_sint32 endOrder/* = -1*/, 
 									 const mp_ubyte* mutingArray/* = NULL*/, mp_uint32 mutingNumChannels/* = 0*/,
@@ -933,7 +1125,7 @@ mp_sint32 PlayerGeneric::exportToWAV(const SYSCHAR* fileName, XModule* module,
 	
 	if (wavWriter == NULL)
 	{
-		wavWriter = new WAVWriter(fileName);
+		wavWriter = new WAVWriter(fileName, exportWAVFormat);
 		isWAVWriterDriver = true;
 	
 		if (!static_cast<WAVWriter*>(wavWriter)->isOpen())
@@ -952,6 +1144,8 @@ mp_sint32 PlayerGeneric::exportToWAV(const SYSCHAR* fileName, XModule* module,
 	PeakAutoAdjustFilter filter;
 	if (autoAdjustPeak)
 		mixer.setFilterHook(&filter);
+	else if (exportFilterHook)
+		mixer.setFilterHook(exportFilterHook);
 		
 	if (player)
 	{
@@ -963,6 +1157,7 @@ mp_sint32 PlayerGeneric::exportToWAV(const SYSCHAR* fileName, XModule* module,
 		player->setPlayMode(playMode);
 		player->setDisableMixing(disableMixing);
 		player->setAllowFilters(allowFilters);		
+		player->setTickSpanMixing(tickSpanMixing);
 #ifndef MILKYTRACKER
 		if (player->getType() == PlayerBase::PlayerType_IT)
 		{
@@ -982,6 +1177,10 @@ mp_sint32 PlayerGeneric::exportToWAV(const SYSCHAR* fileName, XModule* module,
 		mixer.setLimiterDrive(limiterDrive);
 		player->startPlaying(module, false, startOrder, 0, -1, customPanningTable, false, -1);
 		
+		// pick up the state the song has at the start order
+		if (stateSnapshots && startOrder > 0)
+			player->setPatternPosFromSnapshot(*stateSnapshots, startOrder);
+		
 		mixer.start();
 	}
 
@@ -1036,6 +1235,158 @@ mp_sint32 PlayerGeneric::exportToWAV(const SYSCHAR* fileName, XModule* module,
 	return numWrittenSamples;
 }
 
+// first pass of the normalized export:
+// spool the final 32 bit mix to a file and gather statistics
+struct NormalizeCaptureFilter : public Mixable
+{
+	XMFile* f;
+	mp_sint32 peak;
+	double sumOfSquares;
+	
+	NormalizeCaptureFilter(XMFile* f) :
+		f(f),
+		peak(0),
+		sumOfSquares(0.0)
+	{
+	}
+	
+	virtual void mix(mp_sint32* buffer, mp_uint32 bufferSize)
+	{
+		const mp_sint32* buffer32 = buffer;
+		
+		for (mp_uint32 i = 0; i < bufferSize*MP_NUMCHANNELS; i++)
+		{
+			mp_sint32 b = *buffer32++;
+			
+			if (abs(b) > peak)
+				peak = abs(b);
+			
+			sumOfSquares+=(double)b*(double)b;
+		}
+		
+		f->writeDwords((const mp_dword*)buffer, bufferSize*MP_NUMCHANNELS);
+	}
+};
+
+// second pass: play back the spooled mix with the gain applied (16.16)
+struct NormalizeReader : public Mixable
+{
+	XMFile* f;
+	mp_sint32 gain;
+	
+	NormalizeReader(XMFile* f, mp_sint32 gain) :
+		f(f),
+		gain(gain)
+	{
+	}
+	
+	virtual void mix(mp_sint32* buffer, mp_uint32 bufferSize)
+	{
+		// we're the only device, the mix buffer is empty
+		f->readDwords((mp_dword*)buffer, bufferSize*MP_NUMCHANNELS);
+		
+		for (mp_uint32 i = 0; i < bufferSize*MP_NUMCHANNELS; i++)
+			buffer[i] = (mp_sint32)(((mp_int64)buffer[i]*gain) >> 16);
+	}
+};
+
+mp_sint32 PlayerGeneric::exportToWAVNormalized(const SYSCHAR* fileName, 
+											   const SYSCHAR* tempFileName,
+											   XModule* module, 
+											   mp_sint32 startOrder/* = 0*/, mp_sint32 endOrder/* = -1*/, 
+											   const mp_ubyte* mutingArray/* = NULL*/, mp_uint32 mutingNumChannels/* = 0*/,
+											   const mp_ubyte* customPanningTable/* = NULL*/,
+											   mp_uint32 limiterDrive/* = 0*/,
+											   TExportStatistics* statistics/* = NULL*/)
+{
+	const mp_sint32 currentMasterVolume = masterVolume;
+	
+	XMFile* f = new XMFile(tempFileName, true);
+	if (!f->isOpenForWriting())
+	{
+		delete f;
+		return MP_DEVICE_ERROR;
+	}
+	
+	// --- pass 1: mix into the intermediate file ---
+	NormalizeCaptureFilter capture(f);
+	AudioDriver_NULL* nullDriver = new AudioDriver_NULL();
+	
+	exportFilterHook = &capture;
+	
+	mp_sint32 numSamples = exportToWAV(NULL, module, startOrder, endOrder,
+									   mutingArray, mutingNumChannels,
+									   customPanningTable,
+									   nullDriver, NULL, limiterDrive);
+	
+	exportFilterHook = NULL;
+	masterVolume = currentMasterVolume;
+	
+	delete nullDriver;
+	delete f;
+	
+	if (numSamples < 0)
+	{
+		XMFile::remove(tempFileName);
+		return numSamples;
+	}
+
+	// scale the peak to full scale, but never amplify
+	const mp_sint32 fullScale = ((32768 << sampleShift) - 1);
+	mp_sint32 gain = 65536;
+	if (capture.peak > fullScale)
+		gain = (mp_sint32)(((mp_int64)fullScale << 16) / capture.peak);
+
+	// --- pass 2: apply gain and write the WAV file ---
+	f = new XMFile(tempFileName, false);
+	if (!f->isOpen())
+	{
+		delete f;
+		XMFile::remove(tempFileName);
+		return MP_DEVICE_ERROR;
+	}
+
+	WAVWriter* wavWriter = new WAVWriter(fileName, exportWAVFormat);
+	if (!wavWriter->isOpen())
+	{
+		delete wavWriter;
+		delete f;
+		XMFile::remove(tempFileName);
+		return MP_DEVICE_ERROR;
+	}
+	
+	NormalizeReader reader(f, gain);
+	
+	MasterMixer mixer(frequency, bufferSize, 1, wavWriter);
+	mixer.setSampleShift(sampleShift);
+	mixer.addDevice(&reader);
+	mixer.start();
+	
+	while ((mp_sint32)wavWriter->getNumPlayedSamples() < numSamples)
+		wavWriter->advance();
+	
+	mixer.stop();
+	mixer.closeAudioDevice();
+	
+	delete wavWriter;
+	delete f;
+	XMFile::remove(tempFileName);
+	
+	if (statistics)
+	{
+		const double scale = (double)gain / (65536.0 * (double)(32768 << sampleShift));
+		const double rms = numSamples ? sqrt(capture.sumOfSquares / ((double)numSamples*MP_NUMCHANNELS)) : 0.0;
+		
+		statistics->peak = capture.peak;
+		statistics->masterVolume = (mp_sint32)(((mp_int64)currentMasterVolume*gain) >> 16);
+		// silence is reported as the level of one LSB of the mixer
+		statistics->peakDB = (float)(20.0*log10((capture.peak ? capture.peak : 1)*scale));
+		statistics->rmsDB = (float)(20.0*log10((rms >= 1.0 ? rms : 1.0)*scale));
+	}
+	
+	return numSamples;
+}
+
 bool PlayerGeneric::grabChannelInfo(mp_sint32 chn, TPlayerChannelInfo& channelInfo) const
 {
 	if (player)
@@ -45,6 +45,7 @@
 #include "XMFile.h"
 #include "ChannelMixer.h"
 #include "PlayerBase.h"
+#include "AudioDriver_WAVWriter.h"
 
 class XModule;
 class AudioDriverInterface;
@@ -85,6 +86,8 @@ private:
 	bool				disableMixing;
 	// remember if filters are allowed
 	bool				allowFilters;
+	// remember if everything up to the next tick is mixed at once
+	bool				tickSpanMixing;
 	// remember idle state
 	bool				idle;
 	// remember to play only one row
@@ -105,6 +108,12 @@ private:
 	mp_sint32			numMaxVirChannels;
 	// remember mastering limiter
 	mp_uint32 			limiterDrive;
+	// sample format of exported WAV files
+	WAVWriter::WAVFormats	exportWAVFormat;
+	// additional filter hook for exportToWAV (see exportToWAVNormalized)
+	class Mixable*		exportFilterHook;
+	// per order snapshots of the replay state (see createStateSnapshots)
+	PlayerBase::StateSnapshotTable*	stateSnapshots;
 
 	void				adjustSettings();
 
@@ -124,6 +133,12 @@ private:
 	 */
 	PlayerBase*			getPreferredPlayer(XModule* module) const;
 
+	/**
+	 * Allocate a player which is only used to process the song, without mixing.
+	 * It's set up to replay exactly like the players we play with.
+	 */
+	PlayerBase*			getReplayOnlyPlayer(XModule* module) const;
+
 public:
 	/**
 	 * Construct a PlayerGeneric object for a given output frequency
@@ -180,6 +195,21 @@ public:
 	 */
 	void				setPeakAutoAdjust(bool b);
 	
+	/**
+	 * Specify the sample format of files written by exportToWAV.
+	 * 24 bit and float files are written from the 32 bit mix without 
+	 * reducing it to 16 bit first, float files are not clipped at all.
+	 * @param  format	16 bit (default), 24 bit or float
+	 */
+	void				setExportWAVFormat(WAVWriter::WAVFormats format) { exportWAVFormat = format; }
+
+	/**
+	 * Get the sample format of exported WAV files
+	 * @return			sample format
+	 * @see				setExportWAVFormat
+	 */
+	WAVWriter::WAVFormats	getExportWAVFormat() const { return exportWAVFormat; }
+	
 	/**
 	 * Set the desired output frequency
 	 * It's up the the driver if the wanted frequency is possible or not
@@ -495,6 +525,24 @@ public:
 	 * @see				setAllowFilters
 	 */
 	bool				getAllowFilters() const;
+
+	/**
+	 * Mix all beat packets up to the next tick in one go instead of
+	 * one 1/250th of a second at a time. The output stays the same,
+	 * but the per channel setup is done less often, which pays off
+	 * with large buffer sizes, e.g. when exporting.
+	 * Not supported for modules with BPM independent (AMS) envelopes,
+	 * these are still mixed per beat packet.
+	 * @param  b		true or false
+	 */
+	void				setTickSpanMixing(bool b);
+
+	/**
+	 * Tell if tick span mixing is enabled.
+	 * @return			true if tick span mixing is enabled.
+	 * @see				setTickSpanMixing
+	 */
+	bool				isTickSpanMixing() const { return tickSpanMixing; }
 	
 	/**
 	 * Set master volume for the mixer
@@ -597,6 +645,72 @@ public:
 	 */
 	void				setPatternPos(mp_uint32 pos, mp_uint32 row = 0, bool resetChannels = true, bool resetFXMemory = true);
 	
+	/**
+	 * Capture a snapshot of the replay state at the start of each order.
+	 * The song is played through once without mixing, so this is quick.
+	 * The snapshots have to be recreated when the module is changed.
+	 * @param  module	the module to create the snapshots for
+	 * @return			MP_OK on success
+	 * @see				setPatternPosFromSnapshot
+	 */
+	mp_sint32			createStateSnapshots(XModule* module);
+
+	/**
+	 * Part of a song which can be played on its own, see analyzeSong
+	 */
+	struct TSubSong
+	{
+		// first order, and the highest order which is played
+		mp_sint32	startOrder;
+		mp_sint32	endOrder;
+		// position the song jumps back to at the end, -1 if it just stops
+		mp_sint32	loopOrder;
+		mp_sint32	loopRow;
+		// length in samples at the mixing frequency
+		mp_int64	numSamples;
+	};
+	
+	/**
+	 * Result of analyzeSong
+	 */
+	struct TSongAnalysis
+	{
+		// the first sub-song is the song starting at order 0
+		mp_sint32	numSubSongs;
+		TSubSong	subSongs[256];
+		// sample position at which an order is played first, counted
+		// from the start of its sub-song (-1 = order is never played)
+		mp_int64	timingLUT[256];
+	};
+	
+	/**
+	 * Analyze a song without mixing anything: the song is processed tick by tick
+	 * to get its length, where it loops and the time each order starts at.
+	 * When the song ends before all orders have been played, the playing
+	 * continues with a new sub-song from the first order which hasn't been
+	 * played (orders without notes are skipped, like XModule::buildSubSongTable does).
+	 * @param  module		the module to analyze
+	 * @param  analysis		receives the results
+	 * @return				MP_OK on success
+	 */
+	mp_sint32			analyzeSong(XModule* module, TSongAnalysis& analysis);
+	
+	/**
+	 * Drop the snapshots from createStateSnapshots
+	 */
+	void				clearStateSnapshots();
+	
+	/**
+	 * Select a new position within the song and restore the effect memory,
+	 * tempo, global volume and envelope state a linear playthrough would have.
+	 * Falls back to setPatternPos if there is no snapshot for the song
+	 * currently playing.
+	 * @param  pos				new order position
+	 * @param  row				new row
+	 * @return					true if the state has been restored from a snapshot
+	 */
+	bool				setPatternPosFromSnapshot(mp_uint32 pos, mp_uint32 row = 0);
+	
 	/**
 	 * Return the tempo of the song at the current position (in BPM)
 	 * When there is no song playing the last active tempo will be returned
@@ -648,6 +762,40 @@ public:
 									AudioDriverBase* preferredDriver = NULL,
 									mp_sint32* timingLUT = NULL,
 									mp_uint32 limiterDrive = 0);
+
+	/**
+	 * Statistics of a normalized WAV export
+	 */
+	struct TExportStatistics
+	{
+		// peak of the mix before normalizing (in mixer units)
+		mp_sint32	peak;
+		// the master volume which results in the applied gain
+		mp_sint32	masterVolume;
+		// peak and RMS of the exported file in dB full scale
+		float		peakDB;
+		float		rmsDB;
+	};
+
+	/**
+	 * Export the song as normalized WAV file in a single pass.
+	 * The song is mixed once into a 32 bit intermediate file while measuring
+	 * the peak, then the gain is applied and the WAV file is written from the
+	 * intermediate. Like the peak auto adjustment, the gain never exceeds the
+	 * current master volume.
+	 * @param  fileName				the path and the filename to export to
+	 * @param  tempFileName			file to hold the intermediate, it's removed afterwards
+	 * @param  statistics			optional: receives peak and RMS of the export
+	 * (see exportToWAV for the remaining parameters)
+	 */	
+	mp_sint32			exportToWAVNormalized(const SYSCHAR* fileName, 
+											  const SYSCHAR* tempFileName,
+											  XModule* module, 
+											  mp_sint32 startOrder = 0, mp_sint32 endOrder = -1, 
+											  const mp_ubyte* mutingArray = NULL, mp_uint32 mutingNumChannels = 0,
+											  const mp_ubyte* customPanningTable = NULL,
+											  mp_uint32 limiterDrive = 0,
+											  TExportStatistics* statistics = NULL);
 	
 	/**
 	 * Grab current channel data from a module channel
@@ -44,6 +44,14 @@ PlayerIT::TChnState& PlayerIT::TVirtualChannel::chnstat()
 	return host ? host->state : state;
 }
 
+void PlayerIT::TVirtualChannel::relocate(const TModuleChannel* oldBase, TModuleChannel* newBase)
+{
+	if (host)
+		host = newBase + (host - oldBase);
+	if (oldHost)
+		oldHost = newBase + (oldHost - oldBase);
+}
+
 #define CHANNEL_FLAGS_DVS				0x10000
 #define CHANNEL_FLAGS_DFS				0x20000
 #define CHANNEL_FLAGS_DPS				0x40000
@@ -466,6 +474,156 @@ void PlayerIT::freeMemory()
 	}
 }
 
+///////////////////////////////////////////////////////////////////////////////////
+//					 state snapshots                                             //
+///////////////////////////////////////////////////////////////////////////////////
+class PlayerIT::StateSnapshotIT : public PlayerBase::StateSnapshot
+{
+public:
+	mp_sint32		numModuleChannels;
+	mp_sint32		numVirtualChannels;
+	
+	TModuleChannel*	chninfo;
+	TVirtualChannel* vchninfo;
+	mp_ubyte*		attick;
+	
+	mp_sint32		patternIndex;
+	mp_sint32		numEffects;
+	mp_sint32		numChannels;
+	mp_sint32		curMaxVirChannels;
+	
+	mp_ubyte		pbreak;
+	mp_ubyte		pbreakpos;
+	mp_sint32		pbreakPriority;
+	mp_ubyte		pjump;
+	mp_ubyte		pjumppos,pjumprow;
+	mp_sint32		pjumpPriority;
+	bool			patDelay;
+	bool			haltFlag;
+	mp_sint32		startNextRow;
+	
+	mp_sint32		patDelayCount;
+	
+	// only the part of the visited rows bitmap which is covered by the orders
+	mp_uint32		rowHitsSize;
+	mp_ubyte*		rowHits;
+	bool			isLooping;
+	
+	StateSnapshotIT(mp_sint32 numModuleChannels, mp_sint32 numVirtualChannels, mp_uint32 rowHitsSize) :
+		numModuleChannels(numModuleChannels),
+		numVirtualChannels(numVirtualChannels),
+		rowHitsSize(rowHitsSize)
+	{
+		chninfo = new TModuleChannel[numModuleChannels];
+		vchninfo = new TVirtualChannel[numVirtualChannels];
+		attick = new mp_ubyte[numModuleChannels];
+		rowHits = new mp_ubyte[rowHitsSize];
+	}
+	
+	virtual ~StateSnapshotIT()
+	{
+		delete[] chninfo;
+		delete[] vchninfo;
+		delete[] attick;
+		delete[] rowHits;
+	}
+	
+	// copy the channel arrays and make the links between them point to the destination
+	static void copyChannels(TModuleChannel* dstChninfo, TVirtualChannel* dstVchninfo,
+							 const TModuleChannel* srcChninfo, const TVirtualChannel* srcVchninfo,
+							 mp_sint32 numModuleChannels, mp_sint32 numVirtualChannels)
+	{
+		memcpy((void*)dstChninfo, (const void*)srcChninfo, sizeof(TModuleChannel)*numModuleChannels);
+		memcpy((void*)dstVchninfo, (const void*)srcVchninfo, sizeof(TVirtualChannel)*numVirtualChannels);
+		
+		mp_sint32 i;
+		for (i = 0; i < numModuleChannels; i++)
+			dstChninfo[i].relocate(srcVchninfo, dstVchninfo);
+		for (i = 0; i < numVirtualChannels; i++)
+			dstVchninfo[i].relocate(srcChninfo, dstChninfo);
+	}
+};
+
+PlayerBase::StateSnapshot* PlayerIT::createStateSnapshot() const
+{
+	if (!module || !chninfo || !vchninfo)
+		return NULL;
+
+	mp_uint32 rowHitsSize = module->header.ordnum*256/8;
+	if (rowHitsSize > sizeof(rowHits))
+		rowHitsSize = sizeof(rowHits);
+
+	StateSnapshotIT* snapshot = new StateSnapshotIT(numModuleChannels, numVirtualChannels, rowHitsSize);
+
+	saveState(*snapshot);
+	
+	StateSnapshotIT::copyChannels(snapshot->chninfo, snapshot->vchninfo, chninfo, vchninfo, 
+								  numModuleChannels, numVirtualChannels);
+	memcpy(snapshot->attick, attick, sizeof(mp_ubyte)*numModuleChannels);
+	
+	snapshot->patternIndex = patternIndex;
+	snapshot->numEffects = numEffects;
+	snapshot->numChannels = numChannels;
+	snapshot->curMaxVirChannels = curMaxVirChannels;
+	snapshot->pbreak = pbreak;
+	snapshot->pbreakpos = pbreakpos;
+	snapshot->pbreakPriority = pbreakPriority;
+	snapshot->pjump = pjump;
+	snapshot->pjumppos = pjumppos;
+	snapshot->pjumprow = pjumprow;
+	snapshot->pjumpPriority = pjumpPriority;
+	snapshot->patDelay = patDelay;
+	snapshot->haltFlag = haltFlag;
+	snapshot->startNextRow = startNextRow;
+	snapshot->patDelayCount = patDelayCount;
+	
+	memcpy(snapshot->rowHits, rowHits, rowHitsSize);
+	snapshot->isLooping = isLooping;
+	
+	return snapshot;
+}
+
+bool PlayerIT::restoreStateSnapshot(const StateSnapshot& snapshot)
+{
+	if (!chninfo || !vchninfo || !canRestoreState(snapshot))
+		return false;
+		
+	const StateSnapshotIT& src = static_cast<const StateSnapshotIT&>(snapshot);
+
+	// virtual channels are assigned dynamically, the layout has to match
+	if (src.numModuleChannels != numModuleChannels ||
+		src.numVirtualChannels != numVirtualChannels)
+		return false;
+
+	restoreState(src);
+	
+	StateSnapshotIT::copyChannels(chninfo, vchninfo, src.chninfo, src.vchninfo, 
+								  numModuleChannels, numVirtualChannels);
+	memcpy(attick, src.attick, sizeof(mp_ubyte)*numModuleChannels);
+	
+	patternIndex = src.patternIndex;
+	numEffects = src.numEffects;
+	numChannels = src.numChannels;
+	curMaxVirChannels = src.curMaxVirChannels;
+	pbreak = src.pbreak;
+	pbreakpos = src.pbreakpos;
+	pbreakPriority = src.pbreakPriority;
+	pjump = src.pjump;
+	pjumppos = src.pjumppos;
+	pjumprow = src.pjumprow;
+	pjumpPriority = src.pjumpPriority;
+	patDelay = src.patDelay;
+	haltFlag = src.haltFlag;
+	startNextRow = src.startNextRow;
+	patDelayCount = src.patDelayCount;
+	
+	memset(rowHits, 0, sizeof(rowHits));
+	memcpy(rowHits, src.rowHits, src.rowHitsSize);
+	isLooping = src.isLooping;
+	
+	return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////
 //					 controlling current song position                           //
 ///////////////////////////////////////////////////////////////////////////////////
@@ -1048,6 +1206,8 @@ void PlayerIT::playInstrument(TModuleChannel* chnInf, bool bNoRestart/* = false*
 		
 		const mp_sint32 i = smp;
 		
+		module->decodeSample(i);
+		
 		// start out with the flags for 16bit sample
 		mp_sint32 flags = ((module->smp[i].type&16)>>4)<<2;
 		// add looping + backward flags
@@ -340,6 +340,9 @@ private:
 		void			setChannelIndex(mp_sint32 channelIndex) { this->channelIndex = channelIndex; }
 		mp_sint32		getChannelIndex() { return channelIndex; }
 		
+		// after copying the channel arrays the host links need to point into the new array
+		void			relocate(const TModuleChannel* oldBase, TModuleChannel* newBase);
+		
 		DEFINE_STATINTERFACE
 
 		mp_sint32		getResultingVolume()
@@ -395,6 +398,12 @@ private:
 		}
 
 		mp_sint32	getPlaybackChannelIndex() { return ((vchn == NULL) ? -1 : vchn->getChannelIndex()); }
+		
+		void		relocate(const TVirtualChannel* oldBase, TVirtualChannel* newBase)
+		{
+			if (vchn)
+				vchn = newBase + (vchn - oldBase);
+		}
 	
 		DEFINE_STATINTERFACE
 		
@@ -454,6 +463,8 @@ private:
 
 #undef DEFINE_STATINTERFACE
 	
+	class StateSnapshotIT;
+	
 private:
 
 	static const mp_sint32	vibtab[32];
@@ -731,6 +742,9 @@ public:
 	// virtual from mixer class, perform playing here
 	virtual void	timerHandler(mp_sint32 currentBeatPacket);
 	
+	virtual StateSnapshot* createStateSnapshot() const;
+	virtual bool	restoreStateSnapshot(const StateSnapshot& snapshot);
+	
 	// override base class method
 	virtual mp_sint32   startPlaying(XModule* module, 
 								 bool repeat = false, 
@@ -456,6 +456,146 @@ void PlayerSTD::freeMemory()
 	}
 }
 
+///////////////////////////////////////////////////////////////////////////////////
+//					 state snapshots                                             //
+///////////////////////////////////////////////////////////////////////////////////
+class PlayerSTD::StateSnapshotSTD : public PlayerBase::StateSnapshot
+{
+public:
+	mp_sint32		numAllocatedChannels;
+	
+	TModuleChannel*	chninfo;
+	mp_uint32*		smpoffs;
+	mp_ubyte*		attick;
+	
+	mp_sint32		patternIndex;
+	mp_sint32		numEffects;
+	mp_sint32		numChannels;
+	
+	mp_ubyte		pbreak;
+	mp_ubyte		pbreakpos;
+	mp_sint32		pbreakPriority;
+	mp_ubyte		pjump;
+	mp_ubyte		pjumppos,pjumprow;
+	mp_sint32		pjumpPriority;
+	bool			patDelay;
+	bool			haltFlag;
+	mp_sint32		startNextRow;
+	
+	mp_sint32		patDelayCount;
+	
+	// only the part of the visited rows bitmap which is covered by the orders
+	mp_uint32		rowHitsSize;
+	mp_ubyte*		rowHits;
+	bool			isLooping;
+	
+	StateSnapshotSTD(mp_sint32 numAllocatedChannels, mp_uint32 rowHitsSize) :
+		numAllocatedChannels(numAllocatedChannels),
+		rowHitsSize(rowHitsSize)
+	{
+		chninfo = new TModuleChannel[numAllocatedChannels];
+		smpoffs = new mp_uint32[numAllocatedChannels];
+		attick = new mp_ubyte[numAllocatedChannels];
+		rowHits = new mp_ubyte[rowHitsSize];
+	}
+	
+	virtual ~StateSnapshotSTD()
+	{
+		delete[] chninfo;
+		delete[] smpoffs;
+		delete[] attick;
+		delete[] rowHits;
+	}
+};
+
+PlayerBase::StateSnapshot* PlayerSTD::createStateSnapshot() const
+{
+	if (!module || !chninfo)
+		return NULL;
+
+	mp_uint32 rowHitsSize = module->header.ordnum*256/8;
+	if (rowHitsSize > sizeof(rowHits))
+		rowHitsSize = sizeof(rowHits);
+
+	StateSnapshotSTD* snapshot = new StateSnapshotSTD(lastNumAllocatedChannels, rowHitsSize);
+
+	saveState(*snapshot);
+	
+	for (mp_sint32 i = 0; i < lastNumAllocatedChannels; i++)
+		snapshot->chninfo[i].copyState(chninfo[i]);
+	
+	memcpy(snapshot->smpoffs, smpoffs, sizeof(mp_uint32)*lastNumAllocatedChannels);
+	memcpy(snapshot->attick, attick, sizeof(mp_ubyte)*lastNumAllocatedChannels);
+	
+	snapshot->patternIndex = patternIndex;
+	snapshot->numEffects = numEffects;
+	snapshot->numChannels = numChannels;
+	snapshot->pbreak = pbreak;
+	snapshot->pbreakpos = pbreakpos;
+	snapshot->pbreakPriority = pbreakPriority;
+	snapshot->pjump = pjump;
+	snapshot->pjumppos = pjumppos;
+	snapshot->pjumprow = pjumprow;
+	snapshot->pjumpPriority = pjumpPriority;
+	snapshot->patDelay = patDelay;
+	snapshot->haltFlag = haltFlag;
+	snapshot->startNextRow = startNextRow;
+	snapshot->patDelayCount = patDelayCount;
+	
+	memcpy(snapshot->rowHits, rowHits, rowHitsSize);
+	snapshot->isLooping = isLooping;
+	
+	return snapshot;
+}
+
+bool PlayerSTD::restoreStateSnapshot(const StateSnapshot& snapshot)
+{
+	if (!chninfo || !canRestoreState(snapshot))
+		return false;
+		
+	const StateSnapshotSTD& src = static_cast<const StateSnapshotSTD&>(snapshot);
+
+	restoreState(src);
+	
+	// channels the snapshot doesn't know about start from scratch
+	for (mp_sint32 i = 0; i < lastNumAllocatedChannels; i++)
+	{
+		if (i < src.numAllocatedChannels)
+		{
+			chninfo[i].copyState(src.chninfo[i]);
+			smpoffs[i] = src.smpoffs[i];
+			attick[i] = src.attick[i];
+		}
+		else
+		{
+			chninfo[i].clear();
+			smpoffs[i] = 0;
+			attick[i] = 0;
+		}
+	}
+	
+	patternIndex = src.patternIndex;
+	numEffects = src.numEffects;
+	numChannels = src.numChannels <= lastNumAllocatedChannels ? src.numChannels : lastNumAllocatedChannels;
+	pbreak = src.pbreak;
+	pbreakpos = src.pbreakpos;
+	pbreakPriority = src.pbreakPriority;
+	pjump = src.pjump;
+	pjumppos = src.pjumppos;
+	pjumprow = src.pjumprow;
+	pjumpPriority = src.pjumpPriority;
+	patDelay = src.patDelay;
+	haltFlag = src.haltFlag;
+	startNextRow = src.startNextRow;
+	patDelayCount = src.patDelayCount;
+	
+	memset(rowHits, 0, sizeof(rowHits));
+	memcpy(rowHits, src.rowHits, src.rowHitsSize);
+	isLooping = src.isLooping;
+	
+	return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////
 //					 controlling current song position                           //
 ///////////////////////////////////////////////////////////////////////////////////
@@ -612,6 +752,8 @@ void PlayerSTD::playInstrument(mp_sint32 chn, TModuleChannel* chnInf, bool bNoRe
 			
 			mp_sint32 i = chnInf->smp;
 			
+			module->decodeSample(i);
+			
 			// start out with the flags for 16bit sample
 			mp_sint32 flags = ((module->smp[i].type&16)>>4)<<2;
 			// add looping + backward flags
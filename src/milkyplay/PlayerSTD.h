@@ -243,9 +243,33 @@ private:
 			fenv.reallocTimeRecord(size);
 			vibenv.reallocTimeRecord(size);			
 		}
+		
+		// copy the replay state, the envelope time records stay our own
+		void copyState(const TModuleChannel& src)
+		{
+			TPrEnv* envs[4] = {&venv, &penv, &fenv, &vibenv};
+			TPrEnv::TTimeRecord* timeRecords[4];
+			mp_uint32 timeTrackSizes[4];
+			
+			mp_sint32 i;
+			for (i = 0; i < 4; i++)
+			{
+				timeRecords[i] = envs[i]->timeRecord;
+				timeTrackSizes[i] = envs[i]->timeTrackSize;
+			}
+			
+			memcpy((void*)this, (const void*)&src, sizeof(TModuleChannel));
+			
+			for (i = 0; i < 4; i++)
+			{
+				envs[i]->timeRecord = timeRecords[i];
+				envs[i]->timeTrackSize = timeTrackSizes[i];
+			}
+		}
 	};
 	
 private:
+	class StateSnapshotSTD;
 
 	static const mp_sint32	vibtab[32];
 	static const mp_uword	lintab[769];
@@ -459,6 +483,11 @@ public:
 	
 	// virtual from mixer class, perform playing here
 	virtual void	timerHandler(mp_sint32 currentBeatPacket);
+	// the status event listener gets to act on every beat packet
+	virtual mp_uint32 getNumBeatPacketsToNextTick() const { return statusEventListener ? 0 : PlayerBase::getNumBeatPacketsToNextTick(); }
+	
+	virtual StateSnapshot* createStateSnapshot() const;
+	virtual bool	restoreStateSnapshot(const StateSnapshot& snapshot);
 	
 	virtual void	restart(mp_uint32 startPosition = 0, mp_uint32 startRow = 0, 
 							bool resetMixer = true, 
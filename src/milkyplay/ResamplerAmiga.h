@@ -34,11 +34,24 @@
  * TODO: filter volume changes (maybe), add dithering on the output
  *
  * Chris (Deltafire) 13/1/2008
+ *
+ * The mixing is done in blocks: first the sample data of the block is
+ * fetched and the bleps born in it are collected, then it's worked out 
+ * which output samples each blep contributes to (the lifetime rules of 
+ * the original per sample list walk are kept, including the truncation 
+ * of older bleps when a newer one dies), and finally each blep's step 
+ * response is added to the block in one go. All bleps age by the same 
+ * amount per sample, so their table entries are laid out consecutively
+ * per phase (see phaseTable) and the accumulation can be vectorized.
+ * Short blocks and low output rates (where bleps only live for a few 
+ * samples) still walk the list sample by sample. The output is the 
+ * same either way.
  */
 
 // Amiiiiiiiiiiiiigaaaaaaaaa
 
 #include "computed-blep.h"
+#include "ResamplerSIMD.h"
 
 template<mp_sint32 filterTable>
 class ResamplerAmiga : public ChannelMixer::ResamplerBase
@@ -50,171 +63,398 @@ private:
 		BLEP_SCALE = 17,
 		MAX_BLEPS = 32,
 		MAX_AGE = 2048,
-		PAULA_FREQ = 3546895
+		PAULA_FREQ = 3546895,
+		BLOCKSIZE = 256,
+		// the block wise accumulation only pays off for blocks and blep
+		// lifetimes (in output samples) at least this long
+		BLOCKSIZE_MIN = 32,
+		LIFETIME_MIN = 16
 	};
 	
-	// the structure that holds data of bleps
-	struct blepState_t 
+	// entries and ends are relative to the list's time, so they
+	// don't need to be touched while the bleps age
+	struct TBlep
 	{
 		mp_sint32 level;
-		mp_uword age;
+		mp_sint32 entry;			// phaseTable entry is entry+time
+		mp_sint32 last;				// last output sample is at time == last
 	};
 	
-	const int* table;
+	// the bleps of a channel, newest first
+	struct TBlepList
+	{
+		TBlep bleps[MAX_BLEPS];
+		mp_sint32 count;
+		mp_sint32 time;				// output samples since the last rebase
+	};
 	
 	// Storage
 	mp_sint32 numChannels;
 	
-	blepState_t** bleps;
+	TBlepList* bleps;
 	mp_sint32* currentLevel;
-	mp_sint32* activeBleps;
 	
 	mp_sint32 paulaAdvance;
 	
-	void cleanUp(mp_sint32 num)
+	// table entry for the age phase+i*paulaAdvance is at 
+	// phaseTable[phase*phaseTableStride+i]
+	mp_sint32* phaseTable;
+	mp_sint32 phaseTableStride;
+	
+	// phaseTable entry and lifetime of a newborn blep by age
+	mp_sint32* birthEntry;
+	mp_sint32* birthLife;
+	mp_sint32 minBirthLife;
+	
+	void cleanUp()
 	{
-		for (mp_sint32 i = 0; i < num; i++)
-			delete[] bleps[i];
-			
 		delete[] bleps;
 		delete[] currentLevel;
-		delete[] activeBleps;
 	}
 	
-	void realloc(mp_sint32 oldNum, mp_sint32 newNum)
+	void realloc(mp_sint32 newNum)
 	{
-		cleanUp(oldNum);
+		cleanUp();
 		
-		bleps = new blepState_t*[newNum];
-		for (mp_sint32 i = 0; i < newNum; i++)
-			bleps[i] = new blepState_t[MAX_BLEPS];
+		bleps = new TBlepList[newNum];
 		currentLevel = new mp_sint32[newNum];
-		activeBleps = new mp_sint32[newNum];
 	}
 	
 	void clearState()
 	{
 		memset(currentLevel, 0, numChannels*sizeof(mp_uint32));
-		memset(activeBleps, 0, numChannels*sizeof(mp_sint32));
-		
-		for (mp_sint32 i = 0; i < numChannels; i++)
-			memset(bleps[i], 0, MAX_BLEPS*sizeof(blepState_t));
+		memset(bleps, 0, numChannels*sizeof(TBlepList));
 	}
 	
-public:
-	ResamplerAmiga() : 
-		numChannels(0),
-		bleps(NULL),
-		currentLevel(NULL),
-		activeBleps(NULL)
+	// subtract the step response of a blep of the given level starting at 
+	// the given phaseTable entry from acc[0..count-1], table entries are 
+	// shifted right by tableShift
+	inline void accumulate(mp_sint32* acc, mp_sint32 level, mp_sint32 entry, mp_sint32 count, mp_sint32 tableShift) const
 	{
+		const mp_sint32* table = phaseTable + entry;
+		
+		for (mp_sint32 i = ResamplerSIMD::accumulateBlep(acc, table, level, count, tableShift); i < count; i++)
+			acc[i] -= (table[i] >> tableShift) * level;
 	}
 	
-	virtual ~ResamplerAmiga()
+	// adds the bleps of the current block (todo samples) to acc, 
+	// bleps born in it are given by birthTime/Level/Age
+	void addBleps(TBlepList& list, mp_sint32* acc, mp_sint32 todo,
+				  const mp_sint32* birthTime, const mp_sint32* birthLevel, const mp_sint32* birthAge, mp_sint32 numBirths,
+				  mp_sint32 tableShift)
 	{
-		cleanUp(numChannels);
-	}
+		// the bleps of this block, oldest first, living ones are first..end-1: 
+		// where in the block they started to contribute, their table entry 
+		// there and their natural end
+		mp_sint32 level[MAX_BLEPS+BLOCKSIZE], start[MAX_BLEPS+BLOCKSIZE], entry[MAX_BLEPS+BLOCKSIZE], last[MAX_BLEPS+BLOCKSIZE];
+		
+		mp_sint32 i, first = 0, end = list.count;
+		const mp_sint32 numCarried = end;
+		mp_sint32 nextDeath = todo;
+		for (i = 0; i < end; i++)
+		{
+			const mp_sint32 j = end - 1 - i;
+			level[i] = list.bleps[j].level;
+			start[i] = 0;
+			entry[i] = list.bleps[j].entry + list.time;
+			last[i] = list.bleps[j].last - list.time;
+			if (last[i] < nextDeath)
+				nextDeath = last[i];
+		}
+		
+		mp_sint32 b = 0;
+		for (;;)
+		{
+			const mp_sint32 t = (b < numBirths && birthTime[b] < nextDeath) ? birthTime[b] : nextDeath;
+			if (t >= todo)
+				break;
+			
+			const mp_sint32 oldFirst = first;
+			
+			if (b < numBirths && birthTime[b] == t)
+			{
+				if (end - first == MAX_BLEPS - 1)
+				{
+#ifndef WIN32
+					fprintf(stderr, "AMIGA: Blep list truncated!\n");
+#endif
+					// the oldest one doesn't make it into this sample
+					accumulate(acc + start[first], level[first], entry[first], t - start[first], tableShift);
+					first++;
+				}
 
-	virtual void setFrequency(mp_sint32 frequency)
-	{
-		paulaAdvance = PAULA_FREQ / frequency;
+				level[end] = birthLevel[b];
+				start[end] = t;
+				entry[end] = birthEntry[birthAge[b]];
+				last[end] = t + birthLife[birthAge[b]];
+				if (last[end] < nextDeath)
+					nextDeath = last[end];
+				end++;
+				b++;
+			}
+			
+			// the newest blep dying of old age in this sample takes 
+			// the older ones with it, those are already left out here
+			if (t == nextDeath)
+			{
+				mp_sint32 k;
+				for (k = end - 1; k >= first && last[k] != t; k--);
+				
+				if (k >= first)
+				{
+					for (i = first; i < k; i++)
+						accumulate(acc + start[i], level[i], entry[i], t - start[i], tableShift);
+					accumulate(acc + start[k], level[k], entry[k], t - start[k] + 1, tableShift);
+					first = k + 1;
+				}
+			}
+			
+			if (first != oldFirst)
+			{
+				// bleps born in this block die in order give or take a few
+				// samples, so only the oldest ones have to be looked at
+				nextDeath = todo;
+				for (i = first; i < end; i++)
+				{
+					if (i >= numCarried && start[i] + minBirthLife >= nextDeath)
+						break;
+					if (last[i] < nextDeath)
+						nextDeath = last[i];
+				}
+			}
+		}
+		
+		// the survivors carry over into the next block
+		list.count = end - first;
+		for (i = 0; i < list.count; i++)
+		{
+			const mp_sint32 j = end - 1 - i;
+			const mp_sint32 n = todo - start[j];
+			accumulate(acc + start[j], level[j], entry[j], n, tableShift);
+			list.bleps[i].level = level[j];
+			list.bleps[i].entry = entry[j] - start[j] - list.time;
+			list.bleps[i].last = last[j] + list.time;
+		}
 	}
 	
-	virtual void setNumChannels(mp_sint32 num) 
-	{ 
-		// one more channel for the scope dummy 
-		num++;	
-		realloc(numChannels, num);	
-		numChannels = num;		
-		clearState();
-	}	
-	
-	inline mp_sint32 interpolate_amiga_8bit(const mp_sint32 sample,
-											const mp_sint32 channel,
-											const ChannelMixer::TMixerChannel* chn)
+	// walking the list sample by sample is cheaper for blocks that are 
+	// short compared to the lifetime of the bleps
+	inline void addBlep(TBlepList& list, mp_sint32 level, mp_sint32 age)
 	{
-		if(sample != currentLevel[channel])
+		// make room for the newborn one
+		memmove(&list.bleps[1], &list.bleps[0], list.count*sizeof(TBlep));
+		if (++list.count == MAX_BLEPS)
 		{
-			// We have a newborn blep!
-			// Make room for it
-			memmove(&bleps[channel][1], &bleps[channel][0], sizeof(blepState_t) * activeBleps[channel]);
-			if(++activeBleps[channel] == MAX_BLEPS)
-			{
 #ifndef WIN32
-				fprintf(stderr, "AMIGA: Blep list truncated!\n");
+			fprintf(stderr, "AMIGA: Blep list truncated!\n");
 #endif
-				activeBleps[channel]--;
-			}
-			bleps[channel][0].level = sample - currentLevel[channel];
-			bleps[channel][0].age = ((chn->fixedtimefrac + (chn->fixedtime & 0xffff))  * paulaAdvance) >> 16;
-			currentLevel[channel] = sample;
+			list.count--;
 		}
-		
+		list.bleps[0].level = level;
+		list.bleps[0].entry = birthEntry[age] - list.time;
+		list.bleps[0].last = birthLife[age] + list.time;
+	}
+	
+	inline mp_sint32 sumBleps(TBlepList& list, mp_sint32 tableShift)
+	{
+		const TBlep* bleps = list.bleps;
+		const mp_sint32 time = list.time++;
+		mp_sint32 n = list.count;
 		mp_sint32 s = 0;
-		// Age teh bleps!
-		for(mp_sint32 i = 0; i < activeBleps[channel]; i++)
+		for (mp_sint32 i = 0; i < n; i++)
 		{
-			s -= winsinc_integral[filterTable*WINSINCSIZE+bleps[channel][i].age] * bleps[channel][i].level;
-			if((bleps[channel][i].age += paulaAdvance) >= MAX_AGE)
-				activeBleps[channel]  = i; // It died of old age :(
+			s -= (phaseTable[bleps[i].entry + time] >> tableShift) * bleps[i].level;
+			if (bleps[i].last == time)
+				n = i; // It died of old age :(
 		}
-		
-		s >>= (BLEP_SCALE - 8);
-		
-		s += sample << 8;
-		
-		return  s;
+		list.count = n;
+		return s;
 	}
 	
-	// Due to 32-bit limitations the 16-bit resampler is less precise
-	// PS, copy & paste is quicker than messing around with templates ;)
-	inline mp_sint32 interpolate_amiga_16bit(const mp_sint32 sample,
-											 const mp_sint32 channel,
-											 const ChannelMixer::TMixerChannel* chn)
+	// 8 bit samples are scaled up to 16 bit after adding the bleps, 
+	// 16 bit ones use a less precise table to stay within 32 bits
+	template<class T, mp_sint32 tableShift, mp_sint32 accShift, mp_sint32 sampleShift>
+	inline void addBlock(mp_sint32* buffer, ChannelMixer::TMixerChannel* chn, const T* sample, mp_sint32 smppos, 
+						 mp_sint32 smpadd, mp_uint32 count, mp_sint32 channel)
 	{
-		if(sample != currentLevel[channel])
+		const mp_sint32 voll = chn->finalvoll >> 15;
+		const mp_sint32 volr = chn->finalvolr >> 15;
+
+		mp_sint32 x[BLOCKSIZE], acc[BLOCKSIZE];
+		mp_sint32 birthTime[BLOCKSIZE], birthLevel[BLOCKSIZE], birthAge[BLOCKSIZE];
+		
+		mp_sint32 fixedtime = chn->fixedtime;
+		mp_sint32 fixedtimefrac = chn->fixedtimefrac;
+		
+		TBlepList& list = bleps[channel];
+		mp_sint32 level = currentLevel[channel];
+		
+		// keep the entries and ends of the bleps from overflowing
+		if (list.time > 0x10000000)
 		{
-			// We have a newborn blep!
-			// Make room for it
-			memmove(&bleps[channel][1], &bleps[channel][0], sizeof(blepState_t) * activeBleps[channel]);
-			if(++activeBleps[channel] == MAX_BLEPS)
+			for (mp_sint32 i = 0; i < list.count; i++)
 			{
-#ifndef WIN32
-				fprintf(stderr, "AMIGA: Blep list truncated!\n");
-#endif
-				activeBleps[channel]--;
+				list.bleps[i].entry += list.time;
+				list.bleps[i].last -= list.time;
 			}
-			bleps[channel][0].level = sample - currentLevel[channel];
-			bleps[channel][0].age = ((chn->fixedtimefrac + (chn->fixedtime & 0xffff))  * paulaAdvance) >> 16;
-			currentLevel[channel] = sample;
+			list.time = 0;
 		}
 		
-		mp_sint32 s = 0;
-		// Age teh bleps!
-		for(mp_sint32 i = 0; i < activeBleps[channel]; i++)
+		if (count < BLOCKSIZE_MIN || minBirthLife < LIFETIME_MIN)
 		{
-			s -= (winsinc_integral[filterTable*WINSINCSIZE+bleps[channel][i].age]>>3) * bleps[channel][i].level;
-			if((bleps[channel][i].age += paulaAdvance) >= MAX_AGE)
-				activeBleps[channel]  = i; // It died of old age :(
+			for (mp_uint32 t = 0; t < count; t++)
+			{
+				const mp_sint32 s = sample[smppos>>16];
+				if (s != level)
+				{
+					// We have a newborn blep!
+					addBlep(list, s - level, (mp_uword)(((fixedtimefrac + (fixedtime & 0xffff)) * paulaAdvance) >> 16));
+					level = s;
+				}
+				
+				const mp_sint32 y = list.count ? (sumBleps(list, tableShift) >> accShift) + (s << sampleShift) : s << sampleShift;
+				// Really, the volume should be applied before the interpolation
+				(*buffer++)+=(y*voll)>>15;
+				(*buffer++)+=(y*volr)>>15;
+				
+				smppos+=smpadd;
+				// advance time, this is necessary because it's not being done
+				// when not being used, so we'll do it here
+				MP_INCREASESMPPOS(fixedtime, fixedtimefrac, smpadd, 16);
+			}
+		}
+		else while (count)
+		{
+			const mp_sint32 todo = count > BLOCKSIZE ? (mp_sint32)BLOCKSIZE : count;
+			
+			// fetch the samples and note every change of level, i.e. every new blep
+			mp_sint32 numBirths = 0;
+			for (mp_sint32 t = 0; t < todo; t++)
+			{
+				const mp_sint32 s = sample[smppos>>16];
+				if (s != level)
+				{
+					birthTime[numBirths] = t;
+					birthLevel[numBirths] = s - level;
+					birthAge[numBirths] = (mp_uword)(((fixedtimefrac + (fixedtime & 0xffff)) * paulaAdvance) >> 16);
+					numBirths++;
+					level = s;
+				}
+				x[t] = s;
+				
+				smppos+=smpadd;
+				MP_INCREASESMPPOS(fixedtime, fixedtimefrac, smpadd, 16);
+			}
+			
+			if (list.count || numBirths)
+			{
+				memset(acc, 0, todo*sizeof(mp_sint32));
+				addBleps(list, acc, todo, birthTime, birthLevel, birthAge, numBirths, tableShift);
+				list.time+=todo;
+				
+				for (mp_sint32 t = 0; t < todo; t++)
+				{
+					const mp_sint32 y = (acc[t] >> accShift) + (x[t] << sampleShift);
+					(*buffer++)+=(y*voll)>>15;
+					(*buffer++)+=(y*volr)>>15;
+				}
+			}
+			else
+			{
+				// nothing to filter
+				for (mp_sint32 t = 0; t < todo; t++)
+				{
+					const mp_sint32 y = x[t] << sampleShift;
+					(*buffer++)+=(y*voll)>>15;
+					(*buffer++)+=(y*volr)>>15;
+				}
+			}
+			
+			count-=todo;
 		}
 		
-		s >>= BLEP_SCALE - 3;
+		currentLevel[channel] = level;
+		chn->fixedtime = fixedtime;
+		chn->fixedtimefrac = fixedtimefrac;
+	}
+	
+public:
+	ResamplerAmiga() : 
+		numChannels(0),
+		bleps(NULL),
+		currentLevel(NULL),
+		paulaAdvance(0),
+		phaseTable(NULL),
+		phaseTableStride(0),
+		birthEntry(NULL),
+		birthLife(NULL),
+		minBirthLife(0)
+	{
+	}
+	
+	virtual ~ResamplerAmiga()
+	{
+		cleanUp();
+		delete[] phaseTable;
+		delete[] birthEntry;
+		delete[] birthLife;
+	}
+
+	virtual void setFrequency(mp_sint32 frequency)
+	{
+		paulaAdvance = PAULA_FREQ / frequency;
 		
-		s += sample;
+		// a blep's age is below MAX_AGE or, when it's just been born, 
+		// below twice the advance
+		const mp_sint32 maxAge = 2*paulaAdvance > MAX_AGE ? 2*paulaAdvance : MAX_AGE;
+		phaseTableStride = (maxAge + paulaAdvance - 1) / paulaAdvance;
 		
-		return  s;
+		delete[] phaseTable;
+		phaseTable = new mp_sint32[paulaAdvance*phaseTableStride];
+		
+		for (mp_sint32 phase = 0; phase < paulaAdvance; phase++)
+			for (mp_sint32 i = 0; i < phaseTableStride; i++)
+			{
+				const mp_sint32 index = filterTable*WINSINCSIZE + phase + i*paulaAdvance;
+				phaseTable[phase*phaseTableStride + i] = index < 5*WINSINCSIZE ? winsinc_integral[index] : 0;
+			}
+		
+		delete[] birthEntry;
+		delete[] birthLife;
+		birthEntry = new mp_sint32[2*paulaAdvance];
+		birthLife = new mp_sint32[2*paulaAdvance];
+		
+		minBirthLife = MAX_AGE;
+		for (mp_sint32 age = 0; age < 2*paulaAdvance; age++)
+		{
+			birthEntry[age] = (age % paulaAdvance)*phaseTableStride + age / paulaAdvance;
+			// the blep contributes to the samples up to the one 
+			// where it's about to reach MAX_AGE
+			birthLife[age] = age + paulaAdvance >= MAX_AGE ? 0 : (MAX_AGE - age - 1) / paulaAdvance;
+			if (birthLife[age] < minBirthLife)
+				minBirthLife = birthLife[age];
+		}
+		
+		// table entries of living bleps refer to the old layout
+		if (numChannels)
+			memset(bleps, 0, numChannels*sizeof(TBlepList));
 	}
-
+	
+	virtual void setNumChannels(mp_sint32 num) 
+	{ 
+		// one more channel for the scope dummy 
+		num++;	
+		realloc(num);	
+		numChannels = num;		
+		clearState();
+	}	
+	
 	virtual bool isRamping() { return false; }
 	virtual bool supportsFullChecking() { return false; }
 	virtual bool supportsNoChecking() { return true; }
 	
 	inline void addBlockNoCheck(mp_sint32* buffer, ChannelMixer::TMixerChannel* chn, mp_uint32 count)
 	{
-		// adding some local variables, will be faster to access than attributes of chn
-		mp_sint32 voll = chn->finalvoll;
-		mp_sint32 volr = chn->finalvolr;
-		
 		mp_sint32 smppos = chn->smppos;
 		mp_sint32 smpposfrac = chn->smpposfrac;
 		const mp_sint32 smpadd = (chn->flags&ChannelMixer::MP_SAMPLE_BACKWARD) ? -chn->smpadd : chn->smpadd;
@@ -228,43 +468,12 @@ public:
 		if (chn->flags & 4)
 		{
 			// 16 bit
-			const mp_sword* sample = ((const mp_sword*) chn->sample) + smppos;
-			smppos = smpposfrac;
-			
-			while (count--)
-			{
-				mp_sint32 s = sample[smppos>>16];
-				
-				s = interpolate_amiga_16bit(s, channel, chn);
-				
-				(*buffer++)+=(s*(voll>>15))>>15; 
-				(*buffer++)+=(s*(volr>>15))>>15; 
-				
-				smppos+=smpadd;
-				MP_INCREASESMPPOS(chn->fixedtime, chn->fixedtimefrac, smpadd, 16);
-			}
+			addBlock<mp_sword, 3, BLEP_SCALE - 3, 0>(buffer, chn, ((const mp_sword*) chn->sample) + smppos, smpposfrac, smpadd, count, channel);
 		} 
 		else 
 		{
 			// 8 bit
-			const mp_sbyte* sample = &chn->sample[smppos];
-			smppos = smpposfrac;
-			
-			while (count--)
-			{
-				mp_sint32 s = sample[smppos>>16];
-				
-				s = interpolate_amiga_8bit(s, channel, chn);
-				
-				// Really, the volume should be applied before the interpolation
-				(*buffer++)+=(s*(voll>>15))>>15;
-				(*buffer++)+=(s*(volr>>15))>>15;
-				
-				smppos+=smpadd;
-				// advance time, this is necessary because it's not being done
-				// when not being used, so we'll do it here
-				MP_INCREASESMPPOS(chn->fixedtime, chn->fixedtimefrac, smpadd, 16);
-			}
+			addBlock<mp_sbyte, 0, BLEP_SCALE - 8, 8>(buffer, chn, &chn->sample[smppos], smpposfrac, smpadd, count, channel);
 		}
 	}
 };
@@ -46,6 +46,8 @@
  *
  */
  
+#include "ResamplerSIMD.h"
+
 #define __DEIP__
 #define fpmul MP_FP_MUL
 
@@ -159,6 +161,9 @@ public:
 		const bufferType* sample = ((const bufferType*)chn->sample) + smppos;
 		smppos = smpposfrac;
 		
+		count-=ResamplerSIMD::mix(type == CubicResamplerLagrange ? ResamplerSIMD::KernelLagrange : ResamplerSIMD::KernelSpline,
+								  buffer, sample, smppos, smpadd, count, voll, volr, rampFromVolStepL, rampFromVolStepR);
+		
 		while (count--)
 		{
 			mp_sint32 s;
@@ -105,6 +105,12 @@ ChannelMixer::ResamplerBase* ResamplerFactory::createResampler(ResamplerTypes ty
 		case MIXER_AMIGA1200LED_RAMPING:
 			return new ResamplerAmiga<3>();
 
+		case MIXER_SINCPOLYPHASE:
+			return new ResamplerSincPolyphase<false, 32>();
+
+		case MIXER_SINCPOLYPHASE_RAMPING:
+			return new ResamplerSincPolyphase<true, 32>();
+
 		/*	There is also ResamplerAmiga<5> which is a generic 22khz LP filter, it still
 			emulates Paula's pulse chain but does not emulate any of the Amiga's internal
 			filter circuitry. Already we have many options here so it's probably not worth
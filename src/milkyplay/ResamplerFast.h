@@ -180,7 +180,7 @@ public:
 		
 		mp_sint32 sd1,sd2;
 		
-		NOCHECKMIXER_TEMPLATE(NOCHECKMIXER_8BIT_LERP,NOCHECKMIXER_16BIT_LERP);
+		NOCHECKMIXER_TEMPLATE_SIMD(ResamplerSIMD::KernelLerp, 0, 0, NOCHECKMIXER_8BIT_LERP,NOCHECKMIXER_16BIT_LERP);
 	}
 };
 
@@ -206,14 +206,18 @@ public:
 		// filter in use?
 		if (chn->cutoff != ChannelMixer::MP_INVALID_VALUE && chn->resonance != ChannelMixer::MP_INVALID_VALUE)
 		{
-			const mp_sint32 a = chn->a;
-			const mp_sint32 b = chn->b;
-			const mp_sint32 c = chn->c;
+			mp_sint32 a = chn->a;
+			mp_sint32 b = chn->b;
+			mp_sint32 c = chn->c;
+			
+			const mp_sint32 rampFilterStepA = chn->rampFilterStepA;
+			const mp_sint32 rampFilterStepB = chn->rampFilterStepB;
+			const mp_sint32 rampFilterStepC = chn->rampFilterStepC;
 			
 			mp_sint32 currsample = chn->currsample;
 			mp_sint32 prevsample = chn->prevsample;
 			
-			if (rampFromVolStepL || rampFromVolStepR)
+			if (rampFromVolStepL || rampFromVolStepR || rampFilterStepA || rampFilterStepB || rampFilterStepC)
 			{
 				FULLMIXER_TEMPLATE(FULLMIXER_8BIT_LERP_RAMP_FILTER(true), FULLMIXER_16BIT_LERP_RAMP_FILTER(true), 16, 0);
 			}
@@ -222,6 +226,10 @@ public:
 				FULLMIXER_TEMPLATE(FULLMIXER_8BIT_LERP_RAMP_FILTER(false), FULLMIXER_16BIT_LERP_RAMP_FILTER(false), 16, 1);
 			}
 
+			chn->a = a;
+			chn->b = b;
+			chn->c = c;
+			
 			chn->currsample = currsample;
 			chn->prevsample = prevsample;
 		}
@@ -263,15 +271,19 @@ public:
 		// filter in use?
 		if (chn->cutoff != ChannelMixer::MP_INVALID_VALUE && chn->resonance != ChannelMixer::MP_INVALID_VALUE)
 		{
-			const mp_sint32 a = chn->a;
-			const mp_sint32 b = chn->b;
-			const mp_sint32 c = chn->c;
+			mp_sint32 a = chn->a;
+			mp_sint32 b = chn->b;
+			mp_sint32 c = chn->c;
+			
+			const mp_sint32 rampFilterStepA = chn->rampFilterStepA;
+			const mp_sint32 rampFilterStepB = chn->rampFilterStepB;
+			const mp_sint32 rampFilterStepC = chn->rampFilterStepC;
 			
 			mp_sint32 currsample = chn->currsample;
 			mp_sint32 prevsample = chn->prevsample;
 			
 			// check if ramping has to be performed
-			if (rampFromVolStepL || rampFromVolStepR)
+			if (rampFromVolStepL || rampFromVolStepR || rampFilterStepA || rampFilterStepB || rampFilterStepC)
 			{
 				NOCHECKMIXER_TEMPLATE(NOCHECKMIXER_8BIT_LERP_RAMP_FILTER(true), NOCHECKMIXER_16BIT_LERP_RAMP_FILTER(true));
 			}
@@ -280,6 +292,10 @@ public:
 				NOCHECKMIXER_TEMPLATE(NOCHECKMIXER_8BIT_LERP_RAMP_FILTER(false), NOCHECKMIXER_16BIT_LERP_RAMP_FILTER(false));
 			}
 			
+			chn->a = a;
+			chn->b = b;
+			chn->c = c;
+			
 			chn->currsample = currsample;
 			chn->prevsample = prevsample;
 		}
@@ -291,11 +307,11 @@ public:
 			// check if ramping has to be performed
 			if (rampFromVolStepL || rampFromVolStepR)
 			{
-				NOCHECKMIXER_TEMPLATE(NOCHECKMIXER_8BIT_LERP_RAMP(true), NOCHECKMIXER_16BIT_LERP_RAMP(true));
+				NOCHECKMIXER_TEMPLATE_SIMD(ResamplerSIMD::KernelLerp, rampFromVolStepL, rampFromVolStepR, NOCHECKMIXER_8BIT_LERP_RAMP(true), NOCHECKMIXER_16BIT_LERP_RAMP(true));
 			}
 			else
 			{
-				NOCHECKMIXER_TEMPLATE(NOCHECKMIXER_8BIT_LERP_RAMP(false), NOCHECKMIXER_16BIT_LERP_RAMP(false));
+				NOCHECKMIXER_TEMPLATE_SIMD(ResamplerSIMD::KernelLerp, rampFromVolStepL, rampFromVolStepR, NOCHECKMIXER_8BIT_LERP_RAMP(false), NOCHECKMIXER_16BIT_LERP_RAMP(false));
 			}
 		}
 		
@@ -38,6 +38,8 @@
 #ifndef __RESAMPLERMACROS_H__
 #define __RESAMPLERMACROS_H__
 
+#include "ResamplerSIMD.h"
+
 #define VALIDATE \
 	/*ASSERT((void*)(sample+(posfixed>>16)) >= (void*)chn->sample);*/
 
@@ -91,6 +93,22 @@
 		const mp_sword* sample = (const mp_sword*)chn->sample + basepos; \
 		PROCESS_BLOCK(MIXER_16BIT) \
 	} 
+
+// same as above, but the vectorized kernel (see ResamplerSIMD.h) mixes
+// as many frames as it can first, the scalar mixer does the remainder
+#define NOCHECKMIXER_TEMPLATE_SIMD(KERNEL,RAMPL,RAMPR,MIXER_8BIT,MIXER_16BIT) \
+	if (!(chn->flags&4)) \
+	{ \
+		const mp_sbyte* sample = chn->sample + basepos; \
+		count-=ResamplerSIMD::mix(KERNEL, buffer, sample, posfixed, smpadd, count, voll, volr, RAMPL, RAMPR); \
+		PROCESS_BLOCK(MIXER_8BIT) \
+	} \
+	else \
+	{ \
+		const mp_sword* sample = (const mp_sword*)chn->sample + basepos; \
+		count-=ResamplerSIMD::mix(KERNEL, buffer, sample, posfixed, smpadd, count, voll, volr, RAMPL, RAMPR); \
+		PROCESS_BLOCK(MIXER_16BIT) \
+	} 
 	
 /////////////////////////////////////////////////////////
 //		NO INTERPOLATION AND NO VOLUME RAMPING		   //
@@ -221,6 +239,9 @@
 	{ \
 		voll+=rampFromVolStepL; \
 		volr+=rampFromVolStepR; \
+		a+=rampFilterStepA; \
+		b+=rampFilterStepB; \
+		c+=rampFilterStepC; \
 	}
 
 #define NOCHECKMIXER_16BIT_LERP_RAMP_FILTER(_RAMP_) \
@@ -241,6 +262,9 @@
 	{ \
 		voll+=rampFromVolStepL; \
 		volr+=rampFromVolStepR; \
+		a+=rampFilterStepA; \
+		b+=rampFilterStepB; \
+		c+=rampFilterStepC; \
 	}
 
 #define BIDIR_REPOSITION(FRACBITS, SMPPOS, SMPPOSFRAC, LOOPSTART, LOOPEND) \
@@ -593,6 +617,9 @@ continueWithBiDir16_## LABELNO: \
 	{ \
 		voll+=rampFromVolStepL; \
 		volr+=rampFromVolStepR; \
+		a+=rampFilterStepA; \
+		b+=rampFilterStepB; \
+		c+=rampFilterStepC; \
 	}
 
 #define FULLMIXER_16BIT_LERP_RAMP_FILTER(_RAMP_) \
@@ -613,6 +640,9 @@ continueWithBiDir16_## LABELNO: \
 	{ \
 		voll+=rampFromVolStepL; \
 		volr+=rampFromVolStepR; \
+		a+=rampFilterStepA; \
+		b+=rampFilterStepB; \
+		c+=rampFilterStepC; \
 	}
 
 
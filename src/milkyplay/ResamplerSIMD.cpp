@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2009, The MilkyTracker Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the <ORGANIZATION> nor the names of its contributors
+ *   may be used to endorse or promote products derived from this software
+ *   without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ *  ResamplerSIMD.cpp
+ *  MilkyPlay
+ *
+ *  SSE2 and NEON kernels and the runtime selection of the kernel table.
+ *
+ */
+#include "ResamplerSIMD.h"
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define __RESAMPLERSIMD_SSE2__
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && (!defined(__BYTE_ORDER__) || __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define __RESAMPLERSIMD_NEON__
+#include <arm_neon.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define __RESAMPLERSIMD_X86__
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+#endif
+
+#include "ResamplerSIMDKernels.h"
+
+// ResamplerSIMD_AVX2.cpp, returns NULL when the compiler can't generate AVX2 code
+const ResamplerSIMD::TKernelTable* ResamplerSIMD_getKernelsAVX2();
+
+namespace
+{
+
+#ifdef __RESAMPLERSIMD_SSE2__
+struct VecSSE2
+{
+	typedef __m128i vec;
+	enum { N = 4 };
+
+	static inline vec set1(mp_sint32 a) { return _mm_set1_epi32(a); }
+	static inline vec lanes() { return _mm_setr_epi32(0, 1, 2, 3); }
+	static inline vec add(vec a, vec b) { return _mm_add_epi32(a, b); }
+	static inline vec sub(vec a, vec b) { return _mm_sub_epi32(a, b); }
+	static inline vec and_(vec a, vec b) { return _mm_and_si128(a, b); }
+	static inline vec srai(vec a, int n) { return _mm_sra_epi32(a, _mm_cvtsi32_si128(n)); }
+	static inline vec slli(vec a, int n) { return _mm_sll_epi32(a, _mm_cvtsi32_si128(n)); }
+
+	// SSE2 only has an unsigned 32x32->64 multiply on the even lanes
+	static inline vec combineEvenOdd(vec even, vec odd)
+	{
+		return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0,0,2,0)),
+								  _mm_shuffle_epi32(odd, _MM_SHUFFLE(0,0,2,0)));
+	}
+
+	static inline vec load(const mp_sint32* p) { return _mm_loadu_si128((const __m128i*)p); }
+	static inline void store(mp_sint32* p, vec a) { _mm_storeu_si128((__m128i*)p, a); }
+
+	static inline vec mullo(vec a, vec b)
+	{
+		return combineEvenOdd(_mm_mul_epu32(a, b),
+							  _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32)));
+	}
+
+	// the unsigned product of a negative a is too large by x<<32,
+	// i.e. x<<16 after the shift, which is subtracted again
+	static inline vec fpmulx(vec a, vec x)
+	{
+		const vec even = _mm_srli_epi64(_mm_mul_epu32(a, x), 16);
+		const vec odd = _mm_srli_epi64(_mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(x, 32)), 16);
+		return _mm_sub_epi32(combineEvenOdd(even, odd), _mm_and_si128(_mm_srai_epi32(a, 31), _mm_slli_epi32(x, 16)));
+	}
+
+	static inline mp_sint32 load32(const mp_ubyte* p)
+	{
+		mp_sint32 v;
+		memcpy(&v, p, 4);
+		return v;
+	}
+
+	static inline vec gather32(const void* base, vec ofs)
+	{
+		mp_sint32 o[4];
+		_mm_storeu_si128((__m128i*)o, ofs);
+		const mp_ubyte* p = (const mp_ubyte*)base;
+		return _mm_setr_epi32(load32(p + o[0]), load32(p + o[1]), load32(p + o[2]), load32(p + o[3]));
+	}
+
+	static inline void accumulate(mp_sint32* buffer, vec l, vec r)
+	{
+		__m128i* dst = (__m128i*)buffer;
+		_mm_storeu_si128(dst, _mm_add_epi32(_mm_loadu_si128(dst), _mm_unpacklo_epi32(l, r)));
+		_mm_storeu_si128(dst + 1, _mm_add_epi32(_mm_loadu_si128(dst + 1), _mm_unpackhi_epi32(l, r)));
+	}
+};
+
+const ResamplerSIMD::TKernelTable kernelsSSE2 = SIMD_KERNEL_TABLE(VecSSE2, ResamplerSIMD::InstructionSetSSE2);
+#endif
+
+#ifdef __RESAMPLERSIMD_NEON__
+struct VecNEON
+{
+	typedef int32x4_t vec;
+	enum { N = 4 };
+
+	static inline vec set1(mp_sint32 a) { return vdupq_n_s32(a); }
+	static inline vec lanes() { const mp_sint32 l[4] = {0, 1, 2, 3}; return vld1q_s32(l); }
+	static inline vec add(vec a, vec b) { return vaddq_s32(a, b); }
+	static inline vec sub(vec a, vec b) { return vsubq_s32(a, b); }
+	static inline vec and_(vec a, vec b) { return vandq_s32(a, b); }
+	static inline vec srai(vec a, int n) { return vshlq_s32(a, vdupq_n_s32(-n)); }
+	static inline vec slli(vec a, int n) { return vshlq_s32(a, vdupq_n_s32(n)); }
+	static inline vec mullo(vec a, vec b) { return vmulq_s32(a, b); }
+	static inline vec load(const mp_sint32* p) { return vld1q_s32(p); }
+	static inline void store(mp_sint32* p, vec a) { vst1q_s32(p, a); }
+
+	static inline vec fpmulx(vec a, vec x)
+	{
+		const int64x2_t lo = vmull_s32(vget_low_s32(a), vget_low_s32(x));
+		const int64x2_t hi = vmull_s32(vget_high_s32(a), vget_high_s32(x));
+		return vcombine_s32(vshrn_n_s64(lo, 16), vshrn_n_s64(hi, 16));
+	}
+
+	static inline mp_sint32 load32(const mp_ubyte* p)
+	{
+		mp_sint32 v;
+		memcpy(&v, p, 4);
+		return v;
+	}
+
+	static inline vec gather32(const void* base, vec ofs)
+	{
+		mp_sint32 o[4], v[4];
+		vst1q_s32(o, ofs);
+		const mp_ubyte* p = (const mp_ubyte*)base;
+		v[0] = load32(p + o[0]);
+		v[1] = load32(p + o[1]);
+		v[2] = load32(p + o[2]);
+		v[3] = load32(p + o[3]);
+		return vld1q_s32(v);
+	}
+
+	static inline void accumulate(mp_sint32* buffer, vec l, vec r)
+	{
+		const int32x4x2_t lr = vzipq_s32(l, r);
+		vst1q_s32(buffer, vaddq_s32(vld1q_s32(buffer), lr.val[0]));
+		vst1q_s32(buffer + 4, vaddq_s32(vld1q_s32(buffer + 4), lr.val[1]));
+	}
+};
+
+const ResamplerSIMD::TKernelTable kernelsNEON = SIMD_KERNEL_TABLE(VecNEON, ResamplerSIMD::InstructionSetNEON);
+#endif
+
+#ifdef __RESAMPLERSIMD_X86__
+bool cpuSupportsAVX2()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	// OSXSAVE + AVX, and the OS must save the YMM registers
+	__cpuid(info, 1);
+	if ((info[2] & 0x18000000) != 0x18000000)
+		return false;
+	if ((_xgetbv(0) & 6) != 6)
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & 0x20) != 0;
+#elif defined(__GNUC__)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") != 0;
+#else
+	return false;
+#endif
+}
+#endif
+
+}
+
+const ResamplerSIMD::TKernelTable* ResamplerSIMD::detect()
+{
+#ifdef __RESAMPLERSIMD_X86__
+	const TKernelTable* avx2 = ResamplerSIMD_getKernelsAVX2();
+	if (avx2 && cpuSupportsAVX2())
+		return avx2;
+#endif
+
+#if defined(__RESAMPLERSIMD_SSE2__)
+	return &kernelsSSE2;
+#elif defined(__RESAMPLERSIMD_NEON__)
+	return &kernelsNEON;
+#else
+	return NULL;
+#endif
+}
+
+const ResamplerSIMD::TKernelTable* ResamplerSIMD::kernels = ResamplerSIMD::detect();
+bool ResamplerSIMD::enabled = true;
+
+const char* ResamplerSIMD::getInstructionSetName()
+{
+	switch (getInstructionSet())
+	{
+		case InstructionSetSSE2:
+			return "SSE2";
+		case InstructionSetNEON:
+			return "NEON";
+		case InstructionSetAVX2:
+			return "AVX2";
+		default:
+			return "None";
+	}
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2009, The MilkyTracker Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the <ORGANIZATION> nor the names of its contributors
+ *   may be used to endorse or promote products derived from this software
+ *   without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ *  ResamplerSIMD.h
+ *  MilkyPlay
+ *
+ *  Vectorized inner loops for the linear, lagrange and spline resamplers
+ *  and for the blep accumulation of the Amiga resamplers.
+ *
+ *  The kernels compute several output frames at once (4 with SSE2/NEON,
+ *  8 with AVX2) using exactly the same fixed point arithmetic as the
+ *  scalar macros, so the output is bit identical. A kernel only handles
+ *  a multiple of its vector width and returns the number of frames it
+ *  mixed; the caller finishes the remainder with the scalar code.
+ *  All in/out parameters (buffer, position, volumes) are advanced
+ *  accordingly.
+ *
+ *  The instruction set is picked once at startup: AVX2 if the CPU and
+ *  the build support it, otherwise SSE2 (x86) or NEON (ARM), otherwise
+ *  nothing is vectorized and every kernel returns 0.
+ *
+ */
+#ifndef __RESAMPLERSIMD_H__
+#define __RESAMPLERSIMD_H__
+
+#include "MilkyPlayTypes.h"
+
+class ResamplerSIMD
+{
+public:
+	enum Kernels
+	{
+		KernelLerp,
+		KernelLagrange,
+		KernelSpline,
+
+		NUMKERNELS
+	};
+
+	enum InstructionSets
+	{
+		InstructionSetNone,
+		InstructionSetSSE2,
+		InstructionSetNEON,
+		InstructionSetAVX2
+	};
+
+	typedef mp_uint32 (*TMixFunc8)(mp_sint32*& buffer, const mp_sbyte* sample,
+								   mp_sint32& posfixed, mp_sint32 smpadd, mp_uint32 count,
+								   mp_sint32& voll, mp_sint32& volr,
+								   mp_sint32 rampFromVolStepL, mp_sint32 rampFromVolStepR);
+
+	typedef mp_uint32 (*TMixFunc16)(mp_sint32*& buffer, const mp_sword* sample,
+									mp_sint32& posfixed, mp_sint32 smpadd, mp_uint32 count,
+									mp_sint32& voll, mp_sint32& volr,
+									mp_sint32 rampFromVolStepL, mp_sint32 rampFromVolStepR);
+
+	typedef mp_uint32 (*TBlepFunc)(mp_sint32* buffer, const mp_sint32* table, mp_sint32 level, 
+								   mp_uint32 count, mp_sint32 tableShift);
+
+	struct TKernelTable
+	{
+		InstructionSets instructionSet;
+		TMixFunc8 mix8[NUMKERNELS];
+		TMixFunc16 mix16[NUMKERNELS];
+		TBlepFunc blep;
+	};
+
+private:
+	static const TKernelTable* kernels;
+	static bool enabled;
+
+	static const TKernelTable* detect();
+
+public:
+	static InstructionSets getInstructionSet() { return enabled && kernels ? kernels->instructionSet : InstructionSetNone; }
+	static const char* getInstructionSetName();
+
+	// allows disabling the vectorized paths, e.g. for comparing against the scalar code
+	static void setEnabled(bool enable) { enabled = enable; }
+	static bool isEnabled() { return enabled; }
+
+	static inline mp_uint32 mix(Kernels kernel, mp_sint32*& buffer, const mp_sbyte* sample,
+								mp_sint32& posfixed, mp_sint32 smpadd, mp_uint32 count,
+								mp_sint32& voll, mp_sint32& volr,
+								mp_sint32 rampFromVolStepL, mp_sint32 rampFromVolStepR)
+	{
+		if (!enabled || !kernels)
+			return 0;
+		return kernels->mix8[kernel](buffer, sample, posfixed, smpadd, count, voll, volr, rampFromVolStepL, rampFromVolStepR);
+	}
+
+	static inline mp_uint32 mix(Kernels kernel, mp_sint32*& buffer, const mp_sword* sample,
+								mp_sint32& posfixed, mp_sint32 smpadd, mp_uint32 count,
+								mp_sint32& voll, mp_sint32& volr,
+								mp_sint32 rampFromVolStepL, mp_sint32 rampFromVolStepR)
+	{
+		if (!enabled || !kernels)
+			return 0;
+		return kernels->mix16[kernel](buffer, sample, posfixed, smpadd, count, voll, volr, rampFromVolStepL, rampFromVolStepR);
+	}
+
+	// buffer[i] -= (table[i] >> tableShift)*level, same rules as above
+	static inline mp_uint32 accumulateBlep(mp_sint32* buffer, const mp_sint32* table, mp_sint32 level, 
+										   mp_uint32 count, mp_sint32 tableShift)
+	{
+		if (!enabled || !kernels)
+			return 0;
+		return kernels->blep(buffer, table, level, count, tableShift);
+	}
+};
+
+#endif
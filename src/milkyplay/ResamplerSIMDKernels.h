@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2009, The MilkyTracker Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the <ORGANIZATION> nor the names of its contributors
+ *   may be used to endorse or promote products derived from this software
+ *   without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ *  ResamplerSIMDKernels.h
+ *  MilkyPlay
+ *
+ *  Instruction set independent part of the vectorized resamplers.
+ *  Only to be included by the ResamplerSIMD*.cpp files, each of them
+ *  provides a vector class V (in an anonymous namespace, so the
+ *  instantiations below never get merged across translation units
+ *  which are compiled with different code generation flags):
+ *
+ *  V::N                    number of 32 bit lanes
+ *  V::set1(a)              broadcast
+ *  V::lanes()              0, 1, 2, ... N-1
+ *  V::add/sub/and_(a, b)
+ *  V::srai/slli(a, n)      arithmetic right/left shift by a constant
+ *  V::mullo(a, b)          low 32 bits of a*b
+ *  V::fpmulx(a, x)         low 32 bits of ((64 bit)a*x)>>16, 0 <= x < 65536
+ *  V::gather32(base, ofs)  unaligned 32 bit loads from base+ofs (in bytes)
+ *  V::accumulate(buf, l, r) interleaves l/r and adds them to buf
+ *  V::load/store(p)        unaligned loads/stores of N values
+ *
+ *  The fetch functions rely on little endian byte order and on the
+ *  sample padding (see TXMSample), the 32 bit loads may read up to two
+ *  bytes beyond the last tap.
+ *
+ */
+#ifndef __RESAMPLERSIMDKERNELS_H__
+#define __RESAMPLERSIMDKERNELS_H__
+
+#include "ResamplerSIMD.h"
+
+template<class V>
+struct SIMDFetch
+{
+	typedef typename V::vec vec;
+
+	// 8 bit samples are scaled up to 16 bit like the scalar code does (<<8)
+	static inline void pair(const mp_sbyte* sample, vec idx, vec& s1, vec& s2)
+	{
+		const vec g = V::gather32(sample, idx);
+		s1 = V::srai(V::slli(g, 24), 16);
+		s2 = V::and_(V::srai(V::slli(g, 16), 16), V::set1(~0xFF));
+	}
+
+	static inline void pair(const mp_sword* sample, vec idx, vec& s1, vec& s2)
+	{
+		const vec g = V::gather32(sample, V::slli(idx, 1));
+		s1 = V::srai(V::slli(g, 16), 16);
+		s2 = V::srai(g, 16);
+	}
+
+	static inline void quad(const mp_sbyte* sample, vec idx, vec& v0, vec& v1, vec& v2, vec& v3)
+	{
+		const vec mask = V::set1(~0xFF);
+		const vec g = V::gather32(sample - 1, idx);
+		v0 = V::srai(V::slli(g, 24), 16);
+		v1 = V::and_(V::srai(V::slli(g, 16), 16), mask);
+		v2 = V::and_(V::srai(V::slli(g, 8), 16), mask);
+		v3 = V::and_(V::srai(g, 16), mask);
+	}
+
+	static inline void quad(const mp_sword* sample, vec idx, vec& v0, vec& v1, vec& v2, vec& v3)
+	{
+		const vec ofs = V::slli(idx, 1);
+		const vec g0 = V::gather32(sample - 1, ofs);
+		const vec g1 = V::gather32(sample + 1, ofs);
+		v0 = V::srai(V::slli(g0, 16), 16);
+		v1 = V::srai(g0, 16);
+		v2 = V::srai(V::slli(g1, 16), 16);
+		v3 = V::srai(g1, 16);
+	}
+};
+
+template<class V, class T, ResamplerSIMD::Kernels kernel>
+struct SIMDMixer
+{
+	typedef typename V::vec vec;
+
+	// see NOCHECKMIXER_16BIT_LERP and CubicResamplerDummy
+	static inline vec interpolate(const T* sample, vec pos)
+	{
+		const vec idx = V::srai(pos, 16);
+
+		switch (kernel)
+		{
+			case ResamplerSIMD::KernelLerp:
+			{
+				vec s1, s2;
+				SIMDFetch<V>::pair(sample, idx, s1, s2);
+				const vec f = V::and_(V::srai(pos, 4), V::set1(0xFFF));
+				return V::srai(V::add(V::slli(s1, 12), V::mullo(f, V::sub(s2, s1))), 12);
+			}
+
+			case ResamplerSIMD::KernelLagrange:
+			{
+				vec v0, v1, v2, v3;
+				SIMDFetch<V>::quad(sample, idx, v0, v1, v2, v3);
+				const vec x = V::and_(pos, V::set1(65535));
+
+				const vec c0 = v1;
+				const vec c1 = V::sub(V::sub(V::sub(v2, V::srai(V::mullo(v0, V::set1(65536/3)), 16)),
+											 V::srai(V::mullo(v3, V::set1(65536/6)), 16)),
+									  V::srai(v1, 1));
+				const vec c2 = V::sub(V::srai(V::add(v0, v2), 1), v1);
+				const vec c3 = V::add(V::srai(V::mullo(V::set1(65536/6), V::sub(v3, v0)), 16),
+									  V::srai(V::sub(v1, v2), 1));
+
+				return V::add(V::fpmulx(V::add(V::fpmulx(V::add(V::fpmulx(c3, x), c2), x), c1), x), c0);
+			}
+
+			case ResamplerSIMD::KernelSpline:
+			{
+				vec v0, v1, v2, v3;
+				SIMDFetch<V>::quad(sample, idx, v0, v1, v2, v3);
+				const vec x = V::and_(pos, V::set1(65535));
+
+				const vec ym1py1 = V::add(v0, v2);
+				const vec c0 = V::srai(V::add(V::mullo(V::set1(65536/6), ym1py1), V::mullo(V::set1(65536*2/3), v1)), 16);
+				const vec c1 = V::srai(V::sub(v2, v0), 1);
+				const vec c2 = V::sub(V::srai(ym1py1, 1), v1);
+				const vec c3 = V::add(V::srai(V::sub(v1, v2), 1),
+									  V::srai(V::mullo(V::set1(65536/6), V::sub(v3, v0)), 16));
+
+				return V::add(V::fpmulx(V::add(V::fpmulx(V::add(V::fpmulx(c3, x), c2), x), c1), x), c0);
+			}
+
+			default:
+				return V::set1(0);
+		}
+	}
+
+	static mp_uint32 mix(mp_sint32*& buffer, const T* sample,
+						 mp_sint32& posfixed, mp_sint32 smpadd, mp_uint32 count,
+						 mp_sint32& voll, mp_sint32& volr,
+						 mp_sint32 rampFromVolStepL, mp_sint32 rampFromVolStepR)
+	{
+		const mp_uint32 todo = count & ~(mp_uint32)(V::N - 1);
+		if (!todo)
+			return 0;
+
+		// lane i starts where the scalar loop would be after i iterations,
+		// all lanes then advance by N iterations at once
+		const vec lanes = V::lanes();
+		vec pos = V::add(V::set1(posfixed), V::mullo(lanes, V::set1(smpadd)));
+		vec vl = V::add(V::set1(voll), V::mullo(lanes, V::set1(rampFromVolStepL)));
+		vec vr = V::add(V::set1(volr), V::mullo(lanes, V::set1(rampFromVolStepR)));
+
+		const vec posStep = V::set1((mp_sint32)((mp_uint32)smpadd * V::N));
+		const vec vlStep = V::set1((mp_sint32)((mp_uint32)rampFromVolStepL * V::N));
+		const vec vrStep = V::set1((mp_sint32)((mp_uint32)rampFromVolStepR * V::N));
+		const bool ramping = rampFromVolStepL || rampFromVolStepR;
+
+		mp_sint32* dst = buffer;
+
+		for (mp_uint32 i = 0; i < todo; i+=V::N)
+		{
+			const vec s = interpolate(sample, pos);
+
+			V::accumulate(dst,
+						  V::srai(V::mullo(s, V::srai(vl, 15)), 15),
+						  V::srai(V::mullo(s, V::srai(vr, 15)), 15));
+			dst+=V::N*2;
+
+			pos = V::add(pos, posStep);
+			if (ramping)
+			{
+				vl = V::add(vl, vlStep);
+				vr = V::add(vr, vrStep);
+			}
+		}
+
+		buffer = dst;
+		posfixed = (mp_sint32)((mp_uint32)posfixed + (mp_uint32)smpadd * todo);
+		voll = (mp_sint32)((mp_uint32)voll + (mp_uint32)rampFromVolStepL * todo);
+		volr = (mp_sint32)((mp_uint32)volr + (mp_uint32)rampFromVolStepR * todo);
+
+		return todo;
+	}
+};
+
+template<class V>
+struct SIMDBlep
+{
+	static mp_uint32 accumulate(mp_sint32* buffer, const mp_sint32* table, mp_sint32 level, 
+								mp_uint32 count, mp_sint32 tableShift)
+	{
+		typedef typename V::vec vec;
+		
+		const mp_uint32 todo = count - (count % V::N);
+		const vec vlevel = V::set1(level);
+		
+		for (mp_uint32 i = 0; i < todo; i+=V::N)
+			V::store(buffer + i, V::sub(V::load(buffer + i), V::mullo(V::srai(V::load(table + i), tableShift), vlevel)));
+
+		return todo;
+	}
+};
+
+#define SIMD_KERNEL_TABLE(V, INSTRUCTIONSET) \
+	{ \
+		INSTRUCTIONSET, \
+		{ \
+			&SIMDMixer<V, mp_sbyte, ResamplerSIMD::KernelLerp>::mix, \
+			&SIMDMixer<V, mp_sbyte, ResamplerSIMD::KernelLagrange>::mix, \
+			&SIMDMixer<V, mp_sbyte, ResamplerSIMD::KernelSpline>::mix \
+		}, \
+		{ \
+			&SIMDMixer<V, mp_sword, ResamplerSIMD::KernelLerp>::mix, \
+			&SIMDMixer<V, mp_sword, ResamplerSIMD::KernelLagrange>::mix, \
+			&SIMDMixer<V, mp_sword, ResamplerSIMD::KernelSpline>::mix \
+		}, \
+		&SIMDBlep<V>::accumulate \
+	}
+
+#endif
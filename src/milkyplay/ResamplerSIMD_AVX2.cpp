@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2009, The MilkyTracker Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the <ORGANIZATION> nor the names of its contributors
+ *   may be used to endorse or promote products derived from this software
+ *   without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ *  ResamplerSIMD_AVX2.cpp
+ *  MilkyPlay
+ *
+ *  AVX2 kernels, this file is compiled with AVX2 code generation enabled
+ *  (see CMakeLists.txt). Nothing in here must be called unless the CPU
+ *  has been checked for AVX2 support first (see ResamplerSIMD::detect).
+ *
+ */
+#include "ResamplerSIMD.h"
+
+#ifdef __AVX2__
+
+#include <immintrin.h>
+#include "ResamplerSIMDKernels.h"
+
+namespace
+{
+
+struct VecAVX2
+{
+	typedef __m256i vec;
+	enum { N = 8 };
+
+	static inline vec set1(mp_sint32 a) { return _mm256_set1_epi32(a); }
+	static inline vec lanes() { return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7); }
+	static inline vec add(vec a, vec b) { return _mm256_add_epi32(a, b); }
+	static inline vec sub(vec a, vec b) { return _mm256_sub_epi32(a, b); }
+	static inline vec and_(vec a, vec b) { return _mm256_and_si256(a, b); }
+	static inline vec srai(vec a, int n) { return _mm256_sra_epi32(a, _mm_cvtsi32_si128(n)); }
+	static inline vec slli(vec a, int n) { return _mm256_sll_epi32(a, _mm_cvtsi32_si128(n)); }
+	static inline vec mullo(vec a, vec b) { return _mm256_mullo_epi32(a, b); }
+	static inline vec load(const mp_sint32* p) { return _mm256_loadu_si256((const __m256i*)p); }
+	static inline void store(mp_sint32* p, vec a) { _mm256_storeu_si256((__m256i*)p, a); }
+
+	// even lanes: bits 16..47 of the product end up in the low dword after
+	// shifting right by 16, odd lanes: in the high dword after shifting left by 16
+	static inline vec fpmulx(vec a, vec x)
+	{
+		const vec even = _mm256_srli_epi64(_mm256_mul_epi32(a, x), 16);
+		const vec odd = _mm256_slli_epi64(_mm256_mul_epi32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(x, 32)), 16);
+		return _mm256_blend_epi32(even, odd, 0xAA);
+	}
+
+	static inline vec gather32(const void* base, vec ofs)
+	{
+		return _mm256_i32gather_epi32((const int*)base, ofs, 1);
+	}
+
+	static inline void accumulate(mp_sint32* buffer, vec l, vec r)
+	{
+		const vec lo = _mm256_unpacklo_epi32(l, r);
+		const vec hi = _mm256_unpackhi_epi32(l, r);
+		__m256i* dst = (__m256i*)buffer;
+		_mm256_storeu_si256(dst, _mm256_add_epi32(_mm256_loadu_si256(dst), _mm256_permute2x128_si256(lo, hi, 0x20)));
+		_mm256_storeu_si256(dst + 1, _mm256_add_epi32(_mm256_loadu_si256(dst + 1), _mm256_permute2x128_si256(lo, hi, 0x31)));
+	}
+};
+
+const ResamplerSIMD::TKernelTable kernelsAVX2 = SIMD_KERNEL_TABLE(VecAVX2, ResamplerSIMD::InstructionSetAVX2);
+
+}
+
+const ResamplerSIMD::TKernelTable* ResamplerSIMD_getKernelsAVX2()
+{
+	return &kernelsAVX2;
+}
+
+#else
+
+const ResamplerSIMD::TKernelTable* ResamplerSIMD_getKernelsAVX2()
+{
+	return 0;
+}
+
+#endif
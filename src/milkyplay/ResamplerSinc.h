@@ -594,6 +594,296 @@ public:
 	}
 };
 
+// windowed sinc using precomputed polyphase coefficient tables
+//
+// Instead of evaluating the kernel for every tap of every output sample
+// the coefficients are tabulated for PHASES fractional positions (plus one
+// extra phase for interpolation) and a couple of cutoff bands which are
+// used when the sample is played faster than the mixing frequency.
+// The tables are built once per window size and shared across instances,
+// the inner loop is pure integer arithmetic, so output is bit-stable.
+template<mp_sint32 windowSize>
+class ResamplerSincPolyphaseBase : public ChannelMixer::ResamplerBase
+{
+protected:
+	enum 
+	{
+		WINDOWSIZE = windowSize, // must be even
+		WIDTH = (WINDOWSIZE / 2),
+		PHASES_SHIFT = 8,
+		PHASES = (1 << PHASES_SHIFT),
+		// coefficients are 2.14 fixed point, the sum of the absolute
+		// kernel values stays well below 4 which keeps the 32 bit
+		// accumulator from overflowing with 16 bit sample data
+		COEFF_BITS = 14,
+		// cutoff bands, 4 per octave, up to 8x decimation
+		BANDS_PER_OCTAVE = 4,
+		NUMBANDS = 13,
+		TABLESIZE = (PHASES+1)*WINDOWSIZE
+	};
+
+	static mp_sword* coeff_table[NUMBANDS];
+	// band b is used up to this (16.16) sample step
+	static mp_sint32 band_limit[NUMBANDS];
+
+	static double sinc(double x)
+	{
+		if (x == 0.0) 
+			return 1.0;
+
+		double temp = M_PI * x;
+		return sin(temp) / temp;
+	}
+
+	// 4-term Blackman-Harris window, x ranges from 0 to 1
+	static double window(double x)
+	{
+		if (x <= 0.0 || x >= 1.0)
+			return 0.0;
+
+		return 0.35875 - 
+			   0.48829 * cos(2.0*M_PI*x) + 
+			   0.14128 * cos(4.0*M_PI*x) - 
+			   0.01168 * cos(6.0*M_PI*x);
+	}
+
+	static void make_table(mp_sword* table, double cutoff)
+	{
+		for (mp_sint32 p = 0; p <= PHASES; p++)
+		{
+			double tmp[WINDOWSIZE];
+			double sum = 0.0;
+			mp_sint32 k;
+			for (k = 0; k < WINDOWSIZE; k++)
+			{
+				// tap k is located at sample offset k - (WIDTH-1)
+				// relative to the integer part of the sample position
+				const double x = (double)(k - (WIDTH-1)) - (double)p / PHASES;
+				tmp[k] = cutoff * sinc(cutoff * x) * window((x + WIDTH) / WINDOWSIZE);
+				sum += tmp[k];
+			}
+
+			// normalize to unity gain at DC, remaining rounding 
+			// error goes into the center tap
+			mp_sword* dst = table + p*WINDOWSIZE;
+			mp_sint32 isum = 0;
+			for (k = 0; k < WINDOWSIZE; k++)
+			{
+				const double v = tmp[k] / sum * (1 << COEFF_BITS);
+				dst[k] = (mp_sword)(v < 0.0 ? v - 0.5 : v + 0.5);
+				isum += dst[k];
+			}
+			dst[WIDTH - 1 + (p >= (PHASES >> 1) ? 1 : 0)] += (mp_sword)((1 << COEFF_BITS) - isum);
+		}
+	}
+
+	static bool tableInit;
+
+	ResamplerSincPolyphaseBase()
+	{
+		if (!tableInit)
+		{
+			for (mp_sint32 b = 0; b < NUMBANDS; b++)
+			{
+				const double ratio = pow(2.0, (double)b / BANDS_PER_OCTAVE);
+				coeff_table[b] = new mp_sword[TABLESIZE];
+				make_table(coeff_table[b], 1.0 / ratio);
+				band_limit[b] = (mp_sint32)(ratio * 65536.0);
+			}
+			tableInit = true;
+		}
+	}
+
+public:
+	static inline const mp_sword* getTable(mp_sint32 smpadd)
+	{
+		if (smpadd < 0)
+			smpadd = -smpadd;
+
+		mp_sint32 b = 0;
+		while (b < NUMBANDS-1 && smpadd > band_limit[b])
+			b++;
+
+		return coeff_table[b];
+	}
+};
+
+template<mp_sint32 windowSize>
+bool ResamplerSincPolyphaseBase<windowSize>::tableInit = false;
+template<mp_sint32 windowSize>
+mp_sword* ResamplerSincPolyphaseBase<windowSize>::coeff_table[ResamplerSincPolyphaseBase<windowSize>::NUMBANDS];
+template<mp_sint32 windowSize>
+mp_sint32 ResamplerSincPolyphaseBase<windowSize>::band_limit[ResamplerSincPolyphaseBase<windowSize>::NUMBANDS];
+
+template<bool ramping, mp_sint32 windowSize, class bufferType, mp_uint32 shift>
+class SincPolyphaseResamplerDummy : public ResamplerSincPolyphaseBase<windowSize>
+{
+private:
+	typedef ResamplerSincPolyphaseBase<windowSize> Base;
+
+	static inline mp_sint32 convolve(const bufferType* taps, const mp_sword* coeffs)
+	{
+		mp_sint32 result = 0;
+		for (mp_sint32 k = 0; k < Base::WINDOWSIZE; k++)
+			result += (mp_sint32)taps[k] * coeffs[k];
+		return result;
+	}
+
+public:
+	static inline void addBlock(mp_sint32* buffer, ChannelMixer::TMixerChannel* chn, mp_uint32 count)
+	{
+		const bufferType* sample = (const bufferType*)chn->sample;
+
+		mp_sint32 voll = chn->finalvoll;
+		mp_sint32 volr = chn->finalvolr;
+		
+		const mp_sint32 rampFromVolStepL = ramping ? chn->rampFromVolStepL : 0;
+		const mp_sint32 rampFromVolStepR = ramping ? chn->rampFromVolStepR : 0;		
+		
+		mp_sint32 smppos = chn->smppos;
+		mp_sint32 smpposfrac = chn->smpposfrac;
+		const mp_sint32 smpadd = (chn->flags&ChannelMixer::MP_SAMPLE_BACKWARD) ? -chn->smpadd : chn->smpadd;
+		
+		const mp_sint32 flags = chn->flags;
+		const mp_sint32 loopstart = chn->loopstart;
+		const mp_sint32 loopend = chn->loopend;
+		const mp_sint32 loopendcopy = chn->loopendcopy;
+		const mp_sint32 smplen = chn->smplen;
+		
+		mp_sint32 fixedtimefrac = chn->fixedtimefrac;
+		const mp_sint32 timeadd = chn->smpadd;
+		
+		// samples are gathered going away from the current position,
+		// which means backward for the left half and forward for the right half
+		const mp_sint32 leftflags = (flags & ~ChannelMixer::MP_SAMPLE_BACKWARD) | ChannelMixer::MP_SAMPLE_BACKWARD;
+		const mp_sint32 rightflags = (flags & ~ChannelMixer::MP_SAMPLE_BACKWARD);
+		
+		// if we're inside the loop, the kernel may safely read 
+		// within the loop boundaries, otherwise within the sample 
+		const bool loops = (flags & 3) != 0;
+		
+		const mp_sword* table = Base::getTable(smpadd);
+		
+		bufferType taps[Base::WINDOWSIZE];
+		
+		mp_sint32 tmpsmppos;
+		mp_sint32 tmpflags;
+		mp_sint32 tmploopstart;
+		mp_sint32 tmploopend;
+
+		while (count--)
+		{
+			const bool outSideLoop = !(loops && smppos >= loopstart && smppos < loopend);
+			const mp_sint32 lo = outSideLoop ? 0 : loopstart;
+			const mp_sint32 hi = outSideLoop ? smplen : loopend;
+			
+			const bufferType* src;
+			
+			if (smppos - (Base::WIDTH-1) >= lo && smppos + Base::WIDTH < hi)
+			{
+				// fast path: the kernel doesn't touch any boundary
+				src = sample + smppos - (Base::WIDTH-1);
+			}
+			else
+			{
+				// slow path: walk along the sample in both directions, 
+				// honouring loops and ping-pong loops
+				memset(taps, 0, sizeof(taps));
+				
+				tmpsmppos = smppos; 
+				tmploopstart = outSideLoop ? 0 : loopstart;
+				tmploopend = outSideLoop ? smplen : loopend;
+				tmpflags = outSideLoop ? (leftflags & ~3) : leftflags; 
+				
+				if (tmpsmppos >= 0 && tmpsmppos < smplen)
+					taps[Base::WIDTH-1] = sample[tmpsmppos];
+				
+				mp_sint32 j;
+				for (j = 1; j < Base::WIDTH; j++)
+				{
+					advancePos(tmpsmppos, tmpflags, tmploopstart, tmploopend, loopendcopy);
+					if (!(tmpflags & ChannelMixer::MP_SAMPLE_PLAY))
+						break;
+					taps[Base::WIDTH-1-j] = sample[tmpsmppos];
+				}
+				
+				tmpsmppos = smppos; 
+				tmploopstart = outSideLoop ? 0 : loopstart;
+				tmploopend = outSideLoop ? smplen : loopend;
+				tmpflags = outSideLoop ? (rightflags & ~3) : rightflags; 
+				
+				for (j = 1; j <= Base::WIDTH; j++)
+				{
+					advancePos(tmpsmppos, tmpflags, tmploopstart, tmploopend, loopendcopy);
+					if (!(tmpflags & ChannelMixer::MP_SAMPLE_PLAY))
+						break;
+					taps[Base::WIDTH-1+j] = sample[tmpsmppos];
+				}
+				
+				src = taps;
+			}
+			
+			// convolve with the two neighbouring phases and interpolate linearly in between
+			const mp_sint32 phase = smpposfrac >> (16 - Base::PHASES_SHIFT);
+			const mp_sint32 phasefrac = smpposfrac & ((1 << (16 - Base::PHASES_SHIFT)) - 1);
+			const mp_sword* coeffs = table + phase*Base::WINDOWSIZE;
+			
+			const mp_sint32 s0 = convolve(src, coeffs);
+			const mp_sint32 s1 = convolve(src, coeffs + Base::WINDOWSIZE);
+			
+			const mp_sint32 result = s0 + (mp_sint32)((((mp_int64)s1 - (mp_int64)s0) * phasefrac) >> (16 - Base::PHASES_SHIFT));
+			
+			// scale to 16 bit range
+			const mp_sint32 final = result >> (Base::COEFF_BITS - 16 + shift);
+			
+			(*buffer++)+=((final*(voll>>15))>>15); 
+			(*buffer++)+=((final*(volr>>15))>>15); 
+
+			if (ramping)
+			{
+				voll+=rampFromVolStepL; 
+				volr+=rampFromVolStepR; 
+			}
+			
+			MP_INCREASESMPPOS(smppos, smpposfrac, smpadd, 16);
+			fixedtimefrac=(fixedtimefrac+timeadd) & 65535;
+		}
+		
+		chn->smppos = smppos;
+		chn->smpposfrac = smpposfrac;
+
+		chn->fixedtimefrac = fixedtimefrac;
+		
+		if (ramping)
+		{
+			chn->finalvoll = voll;
+			chn->finalvolr = volr;	
+		}
+	}
+};
+
+template<bool ramping, mp_sint32 windowSize>
+class ResamplerSincPolyphase : public ResamplerSincPolyphaseBase<windowSize>
+{
+public:
+	ResamplerSincPolyphase() :
+		ResamplerSincPolyphaseBase<windowSize>()
+	{
+	}
+
+	virtual bool isRamping() { return ramping; }
+	virtual bool supportsFullChecking() { return false; }
+	virtual bool supportsNoChecking() { return true; }
+
+	virtual void addBlockNoCheck(mp_sint32* buffer, ChannelMixer::TMixerChannel* chn, mp_uint32 count)
+	{
+		if (chn->flags & 4)
+			SincPolyphaseResamplerDummy<ramping, windowSize, mp_sword, 16>::addBlock(buffer, chn, count);		
+		else
+			SincPolyphaseResamplerDummy<ramping, windowSize, mp_sbyte, 8>::addBlock(buffer, chn, count);
+	}
+};
+
 #undef SINC
 
 #undef SPZCSHIFT
@@ -0,0 +1,368 @@
+/*
+ * Copyright (c) 2009, The MilkyTracker Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the <ORGANIZATION> nor the names of its contributors
+ *   may be used to endorse or promote products derived from this software
+ *   without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ *  ThreadPool.cpp
+ *  MilkyPlay
+ *
+ */
+#include "ThreadPool.h"
+#include <string.h>
+
+#if defined(WIN32) || defined(_WIN32_WCE)
+#include <windows.h>
+#define __THREADPOOL_WIN32__
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+class ThreadPool::Impl
+{
+public:
+	// --- platform primitives ---------------------------------------------
+#ifdef __THREADPOOL_WIN32__
+	class Mutex
+	{
+	private:
+		CRITICAL_SECTION cs;
+
+	public:
+		Mutex() { InitializeCriticalSection(&cs); }
+		~Mutex() { DeleteCriticalSection(&cs); }
+
+		void lock() { EnterCriticalSection(&cs); }
+		void unlock() { LeaveCriticalSection(&cs); }
+	};
+
+	class Semaphore
+	{
+	private:
+		HANDLE handle;
+
+	public:
+		Semaphore() { handle = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL); }
+		~Semaphore() { CloseHandle(handle); }
+
+		void post() { ReleaseSemaphore(handle, 1, NULL); }
+		void wait() { WaitForSingleObject(handle, INFINITE); }
+	};
+
+	typedef HANDLE TThread;
+
+	static DWORD WINAPI threadProc(LPVOID param)
+	{
+		static_cast<Impl*>(param)->workerLoop();
+		return 0;
+	}
+
+	bool startThread(TThread& thread)
+	{
+		thread = CreateThread(NULL, 0, threadProc, this, 0, NULL);
+		return thread != NULL;
+	}
+
+	static void joinThread(TThread& thread)
+	{
+		WaitForSingleObject(thread, INFINITE);
+		CloseHandle(thread);
+	}
+#else
+	class Mutex
+	{
+	private:
+		pthread_mutex_t mutex;
+
+	public:
+		Mutex() { pthread_mutex_init(&mutex, NULL); }
+		~Mutex() { pthread_mutex_destroy(&mutex); }
+
+		void lock() { pthread_mutex_lock(&mutex); }
+		void unlock() { pthread_mutex_unlock(&mutex); }
+	};
+
+	// unnamed POSIX semaphores are not available on OS X
+	class Semaphore
+	{
+	private:
+		pthread_mutex_t mutex;
+		pthread_cond_t cond;
+		mp_sint32 count;
+
+	public:
+		Semaphore() :
+			count(0)
+		{
+			pthread_mutex_init(&mutex, NULL);
+			pthread_cond_init(&cond, NULL);
+		}
+
+		~Semaphore()
+		{
+			pthread_cond_destroy(&cond);
+			pthread_mutex_destroy(&mutex);
+		}
+
+		void post()
+		{
+			pthread_mutex_lock(&mutex);
+			count++;
+			pthread_cond_signal(&cond);
+			pthread_mutex_unlock(&mutex);
+		}
+
+		void wait()
+		{
+			pthread_mutex_lock(&mutex);
+			while (count == 0)
+				pthread_cond_wait(&cond, &mutex);
+			count--;
+			pthread_mutex_unlock(&mutex);
+		}
+	};
+
+	typedef pthread_t TThread;
+
+	static void* threadProc(void* param)
+	{
+		static_cast<Impl*>(param)->workerLoop();
+		return NULL;
+	}
+
+	bool startThread(TThread& thread)
+	{
+		return pthread_create(&thread, NULL, threadProc, this) == 0;
+	}
+
+	static void joinThread(TThread& thread)
+	{
+		pthread_join(thread, NULL);
+	}
+#endif
+
+	// --- pool state, everything below is guarded by mutex ----------------
+	Mutex mutex;
+	Semaphore jobsAvailable;
+	Semaphore jobsDone;
+
+	Job** queue;
+	mp_sint32 queueSize;
+	mp_sint32 head, tail;
+	mp_sint32 pending;
+	bool quit;
+
+	TThread* threads;
+	mp_sint32 numWorkers;
+
+	Impl() :
+		queue(NULL),
+		queueSize(0),
+		head(0),
+		tail(0),
+		pending(0),
+		quit(false),
+		threads(NULL),
+		numWorkers(0)
+	{
+	}
+
+	~Impl()
+	{
+		delete[] threads;
+		delete[] queue;
+	}
+
+	void push(Job* job)
+	{
+		if (tail == queueSize)
+		{
+			// move the remaining jobs to the front or make room
+			const mp_sint32 num = tail - head;
+			if (num*2 > queueSize || queueSize == 0)
+			{
+				queueSize = queueSize ? queueSize*2 : 16;
+				Job** newQueue = new Job*[queueSize];
+				if (num)
+					memcpy(newQueue, queue + head, num*sizeof(Job*));
+				delete[] queue;
+				queue = newQueue;
+			}
+			else
+			{
+				memmove(queue, queue + head, num*sizeof(Job*));
+			}
+			head = 0;
+			tail = num;
+		}
+
+		queue[tail++] = job;
+	}
+
+	Job* pop()
+	{
+		if (head == tail)
+			return NULL;
+
+		Job* job = queue[head++];
+		if (head == tail)
+			head = tail = 0;
+		return job;
+	}
+
+	void execute(Job* job)
+	{
+		job->run();
+
+		mutex.lock();
+		const bool done = --pending == 0;
+		mutex.unlock();
+
+		if (done)
+			jobsDone.post();
+	}
+
+	void workerLoop()
+	{
+		for (;;)
+		{
+			jobsAvailable.wait();
+
+			mutex.lock();
+			if (quit)
+			{
+				mutex.unlock();
+				break;
+			}
+			// might have been taken by a thread helping out in waitForAll()
+			Job* job = pop();
+			mutex.unlock();
+
+			if (job)
+				execute(job);
+		}
+	}
+};
+
+ThreadPool::ThreadPool(mp_sint32 numThreads/* = 0*/) :
+	impl(new Impl()),
+	numThreads(numThreads > 0 ? numThreads : getNumProcessors())
+{
+	if (this->numThreads > 1)
+	{
+		impl->threads = new Impl::TThread[this->numThreads - 1];
+
+		for (mp_sint32 i = 0; i < this->numThreads - 1; i++)
+		{
+			if (!impl->startThread(impl->threads[i]))
+				break;
+			impl->numWorkers++;
+		}
+	}
+
+	this->numThreads = impl->numWorkers + 1;
+}
+
+ThreadPool::~ThreadPool()
+{
+	waitForAll();
+
+	impl->mutex.lock();
+	impl->quit = true;
+	impl->mutex.unlock();
+
+	for (mp_sint32 i = 0; i < impl->numWorkers; i++)
+		impl->jobsAvailable.post();
+
+	for (mp_sint32 i = 0; i < impl->numWorkers; i++)
+		Impl::joinThread(impl->threads[i]);
+
+	delete impl;
+}
+
+void ThreadPool::addJob(Job* job)
+{
+	impl->mutex.lock();
+	impl->push(job);
+	impl->pending++;
+	impl->mutex.unlock();
+
+	if (impl->numWorkers)
+		impl->jobsAvailable.post();
+}
+
+void ThreadPool::waitForAll()
+{
+	for (;;)
+	{
+		impl->mutex.lock();
+		Job* job = impl->pop();
+		impl->mutex.unlock();
+
+		if (job == NULL)
+			break;
+
+		impl->execute(job);
+	}
+
+	for (;;)
+	{
+		impl->mutex.lock();
+		const bool done = impl->pending == 0;
+		impl->mutex.unlock();
+
+		if (done)
+			break;
+
+		impl->jobsDone.wait();
+	}
+}
+
+mp_sint32 ThreadPool::getNumProcessors()
+{
+#ifdef __THREADPOOL_WIN32__
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? (mp_sint32)info.dwNumberOfProcessors : 1;
+#elif defined(_SC_NPROCESSORS_ONLN)
+	const long num = sysconf(_SC_NPROCESSORS_ONLN);
+	return num > 0 ? (mp_sint32)num : 1;
+#else
+	return 1;
+#endif
+}
+
+void ThreadPool::yield()
+{
+#ifdef __THREADPOOL_WIN32__
+	Sleep(0);
+#else
+	sched_yield();
+#endif
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2009, The MilkyTracker Team.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - Neither the name of the <ORGANIZATION> nor the names of its contributors
+ *   may be used to endorse or promote products derived from this software
+ *   without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ *  ThreadPool.h
+ *  MilkyPlay
+ *
+ *  Minimal pool of worker threads (pthreads or Win32 threads).
+ *
+ *  Jobs are queued with addJob() and picked up by the workers in FIFO
+ *  order, waitForAll() lets the calling thread help out until the queue
+ *  is empty and then blocks until every job has finished. The calling
+ *  thread counts as one of the pool's threads, so a pool of one thread
+ *  has no workers at all and simply runs the jobs in waitForAll().
+ *
+ */
+#ifndef __THREADPOOL_H__
+#define __THREADPOOL_H__
+
+#include "MilkyPlayTypes.h"
+
+class ThreadPool
+{
+public:
+	class Job
+	{
+	public:
+		virtual ~Job() {}
+		virtual void run() = 0;
+	};
+
+private:
+	class Impl;
+	Impl* impl;
+
+	mp_sint32 numThreads;
+
+	// no copying
+	ThreadPool(const ThreadPool& src);
+	ThreadPool& operator=(const ThreadPool& src);
+
+public:
+	// numThreads <= 0 means one thread per processor
+	ThreadPool(mp_sint32 numThreads = 0);
+	~ThreadPool();
+
+	mp_sint32 getNumThreads() const { return numThreads; }
+
+	// job is not owned by the pool and must stay alive until waitForAll() returns
+	void addJob(Job* job);
+
+	void waitForAll();
+
+	static mp_sint32 getNumProcessors();
+
+	// give up the rest of the time slice, for threads spinning on another one
+	static void yield();
+};
+
+#endif
@@ -32,6 +32,7 @@
 // to make future porting easier										//
 //////////////////////////////////////////////////////////////////////////
 #include "XMFile.h"
+#include "LittleEndian.h"
 
 XMFileBase::XMFileBase() :
 	baseOffset(0)
@@ -99,16 +100,35 @@ mp_dword XMFileBase::readDword()
 					  ((mp_uint32)c[3]<<24));
 }
 
+// Bulk reads: read everything at once and convert in place,
+// which leaves nothing to do on little endian hosts
 void XMFileBase::readWords(mp_uword* buffer,mp_sint32 count)
 {
-	for (mp_sint32 i = 0; i < count; i++)
-		*buffer++ = readWord();
+	if (count <= 0)
+		return;
+
+	mp_sint32 bytesRead = read(buffer,2,count);
+	mp_sint32 wordsRead = bytesRead < 0 ? 0 : (bytesRead >> 1);
+
+	// same as readWord() for whatever couldn't be read
+	if (wordsRead < count)
+		memset(buffer+wordsRead, 0, (count-wordsRead)*2);
+
+	LittleEndian::CONVERT_WORDS(buffer, wordsRead);
 }
 
 void XMFileBase::readDwords(mp_dword* buffer,mp_sint32 count)
 {
-	for (mp_sint32 i = 0; i < count; i++)
-		*buffer++ = readDword();
+	if (count <= 0)
+		return;
+
+	mp_sint32 bytesRead = read(buffer,4,count);
+	mp_sint32 dwordsRead = bytesRead < 0 ? 0 : (bytesRead >> 2);
+
+	if (dwordsRead < count)
+		memset(buffer+dwordsRead, 0, (count-dwordsRead)*4);
+
+	LittleEndian::CONVERT_DWORDS(buffer, dwordsRead);
 }
 
 void XMFileBase::writeByte(mp_ubyte b)
@@ -162,6 +182,166 @@ void XMFileBase::writeString(const char* string)
 
 #define BUFFERSIZE 16384
 
+//////////////////////////////////////////////////////////////////////////
+// Files in memory														//
+//////////////////////////////////////////////////////////////////////////
+XMFileMemory::XMFileMemory(const void* data, mp_uint32 dataSize, const SYSCHAR* fileName/* = NULL*/) :
+	XMFileBase(),
+	fileName(fileName),
+	fileNameASCII(NULL),
+	data((const mp_ubyte*)data),
+	dataSize(dataSize),
+	position(0)
+{
+}
+
+XMFileMemory::~XMFileMemory()
+{
+	if (fileNameASCII)
+		delete[] fileNameASCII;
+}
+
+void XMFileMemory::setData(const void* data, mp_uint32 dataSize)
+{
+	this->data = (const mp_ubyte*)data;
+	this->dataSize = dataSize;
+}
+
+mp_sint32 XMFileMemory::read(void* ptr,mp_sint32 size,mp_sint32 count)
+{
+	if (size <= 0 || count <= 0 || position >= dataSize)
+		return 0;
+
+	// only whole items, just like fread
+	mp_uint32 bytesToRead = (mp_uint32)size*(mp_uint32)count;
+	if (bytesToRead > dataSize - position)
+		bytesToRead = ((dataSize - position) / size) * size;
+
+	memcpy(ptr, data + position, bytesToRead);
+	position += bytesToRead;
+	return (mp_sint32)bytesToRead;
+}
+
+void XMFileMemory::seek(mp_uint32 pos, SeekOffsetTypes seekOffsetType/* = SeekOffsetTypeStart*/)
+{
+	// offsets are taken as signed values like fseek does
+	mp_sint32 base = 0;
+	if (seekOffsetType == SeekOffsetTypeCurrent)
+		base = (mp_sint32)position;
+	else if (seekOffsetType == SeekOffsetTypeEnd)
+		base = (mp_sint32)dataSize;
+	
+	mp_sint32 newPos = base + (mp_sint32)pos;
+	if (newPos >= 0)
+		position = (mp_uint32)newPos;
+}
+
+const char* XMFileMemory::getFileNameASCII()
+{
+	if (fileNameASCII)
+		return fileNameASCII;
+
+	if (fileName == NULL)
+	{
+		fileNameASCII = new char[1];
+		fileNameASCII[0] = '\0';
+		return fileNameASCII;
+	}
+		
+	const SYSCHAR* ptr = fileName;
+	for (const SYSCHAR* scan = fileName; *scan; scan++)
+	{
+		if (*scan == '/' || *scan == '\\')
+			ptr = scan + 1;
+	}
+
+	mp_uint32 len = 0;
+	while (ptr[len])
+		len++;
+	
+	fileNameASCII = new char[len+1];
+	
+	for (mp_uint32 i = 0; i <= len; i++)
+		fileNameASCII[i] = (char)ptr[i];
+	
+	return fileNameASCII;
+}
+
+XMFileBuffer::XMFileBuffer(const SYSCHAR* fileName/* = NULL*/) :
+	XMFileMemory(NULL, 0, fileName),
+	buffer(NULL),
+	capacity(0)
+{
+}
+
+XMFileBuffer::~XMFileBuffer()
+{
+	delete[] buffer;
+}
+
+mp_sint32 XMFileBuffer::write(const void* ptr,mp_sint32 size,mp_sint32 count)
+{
+	if (size <= 0 || count <= 0)
+		return 0;
+
+	const mp_uint32 bytesToWrite = (mp_uint32)size*(mp_uint32)count;
+	const mp_uint32 oldSize = this->size();
+	const mp_uint32 start = pos();
+	const mp_uint32 end = start + bytesToWrite;
+	
+	if (end > capacity)
+	{
+		mp_uint32 newCapacity = capacity ? capacity : BUFFERSIZE;
+		while (newCapacity < end)
+			newCapacity <<= 1;
+		
+		mp_ubyte* newBuffer = new mp_ubyte[newCapacity];
+		if (oldSize)
+			memcpy(newBuffer, buffer, oldSize);
+		delete[] buffer;
+		
+		buffer = newBuffer;
+		capacity = newCapacity;
+	}
+	
+	// writing behind the end leaves a gap of zeros, like files do
+	if (start > oldSize)
+		memset(buffer + oldSize, 0, start - oldSize);
+	
+	memcpy(buffer + start, ptr, bytesToWrite);
+	
+	setData(buffer, end > oldSize ? end : oldSize);
+	seek(end);
+	
+	return (mp_sint32)bytesToWrite;
+}
+
+bool XMFileBuffer::truncate(mp_uint32 newSize)
+{
+	if (newSize < size())
+		setData(buffer, newSize);
+	
+	if (pos() > newSize)
+		seek(newSize);
+	
+	return true;
+}
+
+void XMFileMapped::loadIntoMemory(const SYSCHAR* fileName)
+{
+	XMFile f(fileName);
+	if (!f.isOpen())
+		return;
+	
+	mp_uint32 fileSize = f.size();
+	buffer = new mp_ubyte[fileSize ? fileSize : 1];
+	fileSize = f.read(buffer, 1, fileSize);
+	
+	setData(buffer, fileSize);
+	opened = true;
+}
+
+
 //////////////////////////////////////////////////////////////////////////
 // WIN32 implentation													//
 //////////////////////////////////////////////////////////////////////////
@@ -352,6 +532,61 @@ const char* XMFile::getFileNameASCII()
 	return fileNameASCII;
 }
 
+XMFileMapped::XMFileMapped(const SYSCHAR* fileName) :
+	XMFileMemory(NULL, 0, fileName),
+	opened(false),
+	mapping(NULL),
+	buffer(NULL),
+	mappingSize(0)
+{
+	HANDLE handle = CreateFile(fileName,
+							   GENERIC_READ,
+							   FILE_SHARE_READ,
+							   NULL,
+							   OPEN_EXISTING, 
+							   FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, 
+							   NULL);
+
+	if (handle == INVALID_HANDLE_VALUE)
+		return;
+
+	DWORD fileSize = GetFileSize(handle, NULL);
+	
+	// empty files can't be mapped
+	if (fileSize != INVALID_FILE_SIZE && fileSize > 0)
+	{
+		HANDLE mappingHandle = CreateFileMapping(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mappingHandle != NULL)
+		{
+			// the view keeps the mapping alive
+			mapping = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mappingHandle);
+		}
+	}
+
+	CloseHandle(handle);
+
+	if (mapping)
+	{
+		mappingSize = (mp_uint32)fileSize;
+		setData(mapping, mappingSize);
+		opened = true;
+	}
+	else
+	{
+		loadIntoMemory(fileName);
+	}
+}
+
+XMFileMapped::~XMFileMapped()
+{
+	if (mapping)
+		UnmapViewOfFile(mapping);
+	
+	if (buffer)
+		delete[] buffer;
+}
+
 //////////////////////////////////////////////////////////////////////////
 // C compatible implentation											//
 //////////////////////////////////////////////////////////////////////////
@@ -359,6 +594,13 @@ const char* XMFile::getFileNameASCII()
 
 #include <unistd.h>
 
+#if defined(_POSIX_MAPPED_FILES) && (_POSIX_MAPPED_FILES > 0)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#define HAVE_MMAP
+#endif
+
 XMFile::XMFile(const SYSCHAR*	fileName, bool writeAccess /* = false*/) :
 	XMFileBase(),
 	fileName(fileName),
@@ -513,4 +755,59 @@ const char* XMFile::getFileNameASCII()
 	return fileNameASCII;
 }
 
+XMFileMapped::XMFileMapped(const SYSCHAR* fileName) :
+	XMFileMemory(NULL, 0, fileName),
+	opened(false),
+	mapping(NULL),
+	buffer(NULL),
+	mappingSize(0)
+{
+#ifdef HAVE_MMAP
+	int fd = open(fileName, O_RDONLY);
+	if (fd < 0)
+		return;
+	
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+	{
+		close(fd);
+		return;
+	}
+	
+	// empty files can't be mapped
+	if (st.st_size > 0)
+	{
+		void* ptr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (ptr != MAP_FAILED)
+		{
+			mapping = ptr;
+			mappingSize = (mp_uint32)st.st_size;
+		}
+	}
+	
+	// the mapping stays valid after closing the descriptor
+	close(fd);
+	
+	if (mapping)
+	{
+		setData(mapping, mappingSize);
+		opened = true;
+		return;
+	}
+#endif
+
+	loadIntoMemory(fileName);
+}
+
+XMFileMapped::~XMFileMapped()
+{
+#ifdef HAVE_MMAP
+	if (mapping)
+		munmap(mapping, mappingSize);
+#endif
+	
+	if (buffer)
+		delete[] buffer;
+}
+
 #endif
@@ -63,12 +63,18 @@ public:
 
 	virtual bool			isEOF() { return pos() >= size(); }
 
+	// cut the file down to newSize bytes, false if the file can't do that
+	virtual bool			truncate(mp_uint32) { return false; }
+
 	virtual	const SYSCHAR*  getFileName() = 0;
 	
 	virtual	const char*		getFileNameASCII() = 0;
 	
 	virtual	bool			isOpen() = 0;
 	virtual	bool			isOpenForWriting()  = 0;
+	
+	// whole file contents if they're in memory, NULL otherwise
+	virtual const mp_ubyte*	getData() const { return NULL; }
 
 	mp_ubyte				readByte();
 	mp_uword				readWord();
@@ -130,4 +136,78 @@ public:
 	static bool				remove(const SYSCHAR* file);
 };
 
+// Read only file on top of a block of memory, the data is not copied
+class XMFileMemory : public XMFileBase
+{
+private:
+	const SYSCHAR*  fileName;
+
+	char*			fileNameASCII;
+
+	const mp_ubyte*	data;
+	mp_uint32		dataSize;
+	mp_uint32		position;
+	
+protected:
+	void			setData(const void* data, mp_uint32 dataSize);
+	
+public:
+							XMFileMemory(const void* data, mp_uint32 dataSize, const SYSCHAR* fileName = NULL);
+	virtual					~XMFileMemory();
+	
+	virtual mp_sint32		read(void* ptr,mp_sint32 size,mp_sint32 count);
+	virtual mp_sint32		write(const void*,mp_sint32,mp_sint32) { return -1; }
+	
+	virtual void			seek(mp_uint32 pos, SeekOffsetTypes seekOffsetType = SeekOffsetTypeStart);
+	virtual mp_uint32		pos() { return position; }
+	virtual mp_uint32		size() { return dataSize; }
+	
+	virtual const SYSCHAR*  getFileName() { return fileName; }
+	
+	virtual const char*		getFileNameASCII();
+	
+	virtual bool			isOpen() { return data != NULL; }
+	virtual bool			isOpenForWriting() { return false; }
+	
+	virtual const mp_ubyte*	getData() const { return data; }
+};
+
+// Growing file in memory which can be written and read back
+class XMFileBuffer : public XMFileMemory
+{
+private:
+	mp_ubyte*		buffer;
+	mp_uint32		capacity;
+	
+public:
+							XMFileBuffer(const SYSCHAR* fileName = NULL);
+	virtual					~XMFileBuffer();
+	
+	virtual mp_sint32		write(const void* ptr,mp_sint32 size,mp_sint32 count);
+	
+	virtual bool			truncate(mp_uint32 newSize);
+	
+	virtual bool			isOpen() { return true; }
+	virtual bool			isOpenForWriting() { return true; }
+};
+
+// Read only file which is mapped into memory, falls back to reading
+// the whole file at once where the system can't map it
+class XMFileMapped : public XMFileMemory
+{
+private:
+	bool			opened;
+	void*			mapping;
+	mp_ubyte*		buffer;
+	mp_uint32		mappingSize;
+
+	void			loadIntoMemory(const SYSCHAR* fileName);
+	
+public:
+							XMFileMapped(const SYSCHAR* fileName);
+	virtual					~XMFileMapped();
+	
+	virtual bool			isOpen() { return opened; }
+};
+
 #endif
@@ -35,6 +35,15 @@
  */
 #include "XModule.h"
 #include "Loaders.h"
+#include "ThreadPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define __XMODULE_SSE2__
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define __XMODULE_NEON__
+#include <arm_neon.h>
+#endif
 
 #undef VERBOSE
 
@@ -1193,103 +1202,285 @@ const TXMPattern& TXMPattern::operator=(const TXMPattern& src)
 
 #endif
 
-// Constructor for loader manager (private)
-XModule::LoaderManager::LoaderManager() :
-		loaders(NULL),
-		numLoaders(0),
-		numAllocatedLoaders(0),
-		iteratorCounter(-1)
+// Loaders don't keep any state, so one instance of each is enough
+#ifndef MP_XMONLY 
+static Loader669	loader669;
+static LoaderAMF_1	loaderAMF_1;
+static LoaderAMF_2	loaderAMF_2;
+static LoaderAMSv1	loaderAMSv1;
+static LoaderAMSv2	loaderAMSv2;
+static LoaderCBA	loaderCBA;
+static LoaderDBM	loaderDBM;
+static LoaderDIGI	loaderDIGI;
+static LoaderDSMv1	loaderDSMv1;
+static LoaderDSMv2	loaderDSMv2;
+static LoaderDSm	loaderDSm;
+static LoaderDTM_1	loaderDTM_1;
+static LoaderDTM_2	loaderDTM_2;
+static LoaderFAR	loaderFAR;
+static LoaderGDM	loaderGDM;
+static LoaderIMF	loaderIMF;
+static LoaderIT		loaderIT;
+static LoaderMDL	loaderMDL;
+static LoaderMTM	loaderMTM;
+static LoaderMXM	loaderMXM;
+static LoaderOKT	loaderOKT;
+static LoaderPLM	loaderPLM;
+static LoaderPSMv1	loaderPSMv1;
+static LoaderPSMv2	loaderPSMv2;
+static LoaderPTM	loaderPTM;
+static LoaderS3M	loaderS3M;
+static LoaderSTM	loaderSTM;
+static LoaderSFX	loaderSFX;
+static LoaderUNI	loaderUNI;
+static LoaderULT	loaderULT;
+static LoaderGMC	loaderGMC;
+static LoaderMOD	loaderMOD;
+#endif
+static LoaderXM		loaderXM;
+
+// Loaders are probed in this order
+const XModule::TLoaderInfo XModule::LoaderManager::loaders[] = 
 {
 #ifndef MP_XMONLY 
-	registerLoader(new Loader669(), ModuleType_669);
-	registerLoader(new LoaderAMF_1(), ModuleType_AMF);
-	registerLoader(new LoaderAMF_2(), ModuleType_AMF);
-	registerLoader(new LoaderAMSv1(), ModuleType_AMS);
-	registerLoader(new LoaderAMSv2(), ModuleType_AMS);
-	registerLoader(new LoaderCBA(), ModuleType_CBA);
-	registerLoader(new LoaderDBM(), ModuleType_DBM);
-	registerLoader(new LoaderDIGI(), ModuleType_DIGI);
-	registerLoader(new LoaderDSMv1(), ModuleType_DSM);
-	registerLoader(new LoaderDSMv2(), ModuleType_DSM);
-	registerLoader(new LoaderDSm(), ModuleType_DSm);
-	registerLoader(new LoaderDTM_1(), ModuleType_DTM_1);
-	registerLoader(new LoaderDTM_2(), ModuleType_DTM_2);
-	registerLoader(new LoaderFAR(), ModuleType_FAR);
-	registerLoader(new LoaderGDM(), ModuleType_GDM);
-	registerLoader(new LoaderIMF(), ModuleType_IMF);
-	registerLoader(new LoaderIT(), ModuleType_IT);
-	//registerLoader(new LoaderFNK(), funk format sucks
-	registerLoader(new LoaderMDL(), ModuleType_MDL);
-	registerLoader(new LoaderMTM(), ModuleType_MTM);
-	registerLoader(new LoaderMXM(), ModuleType_MXM);
-	registerLoader(new LoaderOKT(), ModuleType_OKT);
-	registerLoader(new LoaderPLM(), ModuleType_PLM);
-	registerLoader(new LoaderPSMv1(), ModuleType_PSM);
-	registerLoader(new LoaderPSMv2(), ModuleType_PSM);
-	registerLoader(new LoaderPTM(), ModuleType_PTM);
-	registerLoader(new LoaderS3M(), ModuleType_S3M);
-	registerLoader(new LoaderSTM(), ModuleType_STM);
-	registerLoader(new LoaderSFX(), ModuleType_SFX);
-	registerLoader(new LoaderUNI(), ModuleType_UNI);
-	registerLoader(new LoaderULT(), ModuleType_ULT);	
-	registerLoader(new LoaderXM(), ModuleType_XM);	
+	{&loader669, ModuleType_669},
+	{&loaderAMF_1, ModuleType_AMF},
+	{&loaderAMF_2, ModuleType_AMF},
+	{&loaderAMSv1, ModuleType_AMS},
+	{&loaderAMSv2, ModuleType_AMS},
+	{&loaderCBA, ModuleType_CBA},
+	{&loaderDBM, ModuleType_DBM},
+	{&loaderDIGI, ModuleType_DIGI},
+	{&loaderDSMv1, ModuleType_DSM},
+	{&loaderDSMv2, ModuleType_DSM},
+	{&loaderDSm, ModuleType_DSm},
+	{&loaderDTM_1, ModuleType_DTM_1},
+	{&loaderDTM_2, ModuleType_DTM_2},
+	{&loaderFAR, ModuleType_FAR},
+	{&loaderGDM, ModuleType_GDM},
+	{&loaderIMF, ModuleType_IMF},
+	{&loaderIT, ModuleType_IT},
+	//LoaderFNK, funk format sucks
+	{&loaderMDL, ModuleType_MDL},
+	{&loaderMTM, ModuleType_MTM},
+	{&loaderMXM, ModuleType_MXM},
+	{&loaderOKT, ModuleType_OKT},
+	{&loaderPLM, ModuleType_PLM},
+	{&loaderPSMv1, ModuleType_PSM},
+	{&loaderPSMv2, ModuleType_PSM},
+	{&loaderPTM, ModuleType_PTM},
+	{&loaderS3M, ModuleType_S3M},
+	{&loaderSTM, ModuleType_STM},
+	{&loaderSFX, ModuleType_SFX},
+	{&loaderUNI, ModuleType_UNI},
+	{&loaderULT, ModuleType_ULT},
+	{&loaderXM, ModuleType_XM},
 	// Game Music Creator may not be recognized perfectly
-	registerLoader(new LoaderGMC(), ModuleType_GMC);
+	{&loaderGMC, ModuleType_GMC},
 	// Last loader is MOD because there is a slight chance that other formats will be misinterpreted as 15 ins. MODs
-	registerLoader(new LoaderMOD(), ModuleType_MOD);
+	{&loaderMOD, ModuleType_MOD}
 #else
-	registerLoader(new LoaderXM(), ModuleType_XM);	
+	{&loaderXM, ModuleType_XM}
 #endif
-}
+};
+
+const mp_uint32 XModule::LoaderManager::numLoaders = sizeof(loaders) / sizeof(TLoaderInfo);
 
-XModule::LoaderManager::~LoaderManager()
+// Loaders listed here return NULL unless one of their signatures matches, 
+// the others (GMC, MOD with its 15 instrument fallback) are always probed
+const XModule::LoaderManager::TSignature XModule::LoaderManager::signatures[] = 
 {
-	for (mp_uint32 i = 0; i < numLoaders; i++)
-		delete loaders[i].loader;
-		
-	delete[] loaders;
-}
+#ifndef MP_XMONLY 
+	{&loader669, 0, "if", 2},
+	{&loader669, 0, "JN", 2},
+	{&loaderAMF_1, 0, "ASYLUM Music Format", 19},
+	{&loaderAMF_2, 0, "DMF", 3},
+	{&loaderAMSv1, 0, "Extreme\x30\x1", 9},
+	{&loaderAMSv2, 0, "AMShdr\x1a", 7},
+	{&loaderCBA, 0, "CBA\xF9", 4},
+	{&loaderDBM, 0, "DBM0", 4},
+	// includes the terminating zero
+	{&loaderDIGI, 0, "DIGI Booster module", 20},
+	{&loaderDSMv1, 0, "DSM\x10", 4},
+	{&loaderDSMv2, 0, "RIFF", 4},
+	{&loaderDSm, 0, "DSm\x1A\x20", 5},
+	{&loaderDTM_1, 0, "SONG", 4},
+	{&loaderDTM_2, 0, "D.T.", 4},
+	{&loaderFAR, 0, "FAR\xFE", 4},
+	{&loaderGDM, 0, "GDM\xFE", 4},
+	{&loaderIMF, 0x3C, "IM10", 4},
+	{&loaderIT, 0, "IMPM", 4},
+	{&loaderMDL, 0, "DMDL", 4},
+	{&loaderMTM, 0, "MTM\x10", 4},
+	{&loaderMXM, 0, "MXM", 3},
+	{&loaderOKT, 0, "OKTASONG", 8},
+	{&loaderPLM, 0, "PLM\x1A", 4},
+	{&loaderPSMv1, 0, "PSM\xFE", 4},
+	{&loaderPSMv2, 0, "PSM\x20", 4},
+	{&loaderPTM, 44, "PTMF", 4},
+	{&loaderS3M, 0x2C, "SCRM", 4},
+	{&loaderSTM, 20, "!Scream!", 8},
+	{&loaderSTM, 20, "BMOD2STM", 8},
+	{&loaderSFX, 60, "SONG", 4},
+	{&loaderUNI, 0, "UN0", 3},
+	{&loaderULT, 0, "MAS_UTrack_V00", 14},
+#endif
+	{&loaderXM, 0, "Extended Module:", 16}
+};
 
-void XModule::LoaderManager::registerLoader(LoaderInterface* loader, ModuleTypes type)
+const mp_uint32 XModule::LoaderManager::numSignatures = sizeof(signatures) / sizeof(TSignature);
+
+XModule::LoaderManager XModule::LoaderManager::instance;
+
+// Constructor for loader manager (private)
+XModule::LoaderManager::LoaderManager() :
+	numSignatureOffsets(0)
 {
-	if (numLoaders+1 > numAllocatedLoaders)
+	mp_uint32 i, j;
+
+	ASSERT(numLoaders <= MaxLoaders && numSignatures <= MaxSignatures);
+
+	memset(hasSignature, 0, sizeof(hasSignature));
+
+	mp_sint32 offsetIndex[MaxSignatures];
+	mp_uint32 counts[MaxSignatureOffsets][256];
+	memset(counts, 0, sizeof(counts));
+	
+	for (i = 0; i < numSignatures; i++)
 	{
-		numAllocatedLoaders+=16;
+		const TSignature& signature = signatures[i];
+	
+		for (j = 0; j < numLoaders && loaders[j].loader != signature.loader; j++);
+		ASSERT(j < numLoaders);
+		hasSignature[j] = true;
 		
-		TLoaderInfo* newLoaders = new TLoaderInfo[numAllocatedLoaders];
-		for (mp_uint32 i = 0; i < numLoaders; i++)
-			newLoaders[i] = loaders[i];
-			
-		delete[] loaders;
-		loaders = newLoaders;
+		for (j = 0; j < numSignatureOffsets && signatureOffsets[j] != signature.offset; j++);
+		if (j == numSignatureOffsets)
+		{
+			ASSERT(numSignatureOffsets < MaxSignatureOffsets);
+			signatureOffsets[numSignatureOffsets++] = signature.offset;
+		}
+		offsetIndex[i] = j;
+		
+		counts[j][(mp_ubyte)signature.magic[0]]++;
+	}
+
+	// counting sort by offset and first byte
+	mp_uint32 first = 0;
+	for (i = 0; i < numSignatureOffsets; i++)
+	{
+		for (j = 0; j < 256; j++)
+		{
+			buckets[i][j] = (mp_ubyte)first;
+			first+=counts[i][j];
+		}
+		buckets[i][256] = (mp_ubyte)first;
 	}
 	
-	loaders[numLoaders].loader = loader;
-	loaders[numLoaders].moduleType = type;
-	
-	numLoaders++;
+	memset(counts, 0, sizeof(counts));
+	for (i = 0; i < numSignatures; i++)
+	{
+		const TSignature& signature = signatures[i];
+		const mp_ubyte b = (mp_ubyte)signature.magic[0];
+		const mp_uint32 k = buckets[offsetIndex[i]][b] + counts[offsetIndex[i]][b]++;
+		
+		sortedSignatures[k] = (mp_ubyte)i;
+		for (j = 0; loaders[j].loader != signature.loader; j++);
+		signatureLoaders[k] = (mp_ubyte)j;
+	}
 }
 
-XModule::TLoaderInfo* XModule::LoaderManager::getFirstLoaderInfo()
+#ifndef NDEBUG
+// Each signature must make its own loader win the plain linear probe
+// and the index must come to the same conclusion as that probe. Only 
+// the magic is set, the byte behind it (usually a version) is tried 
+// with every value. Runs on the first identify() of debug builds
+void XModule::LoaderManager::verifySignatures()
 {
-	if (numLoaders)
+	mp_ubyte buffer[IdentificationBufferSize];
+
+	for (mp_uint32 i = 0; i < numSignatures; i++)
 	{
-		iteratorCounter = 0;
-		return loaders;
+		const TSignature& signature = signatures[i];
+		bool identified = false;
+		
+		for (mp_uint32 v = 0; v < 256; v++)
+		{
+			memset(buffer, 0, sizeof(buffer));
+			memcpy(buffer + signature.offset, signature.magic, signature.length);
+			buffer[signature.offset + signature.length] = (mp_ubyte)v;
+		
+			const TLoaderInfo* linear = NULL;
+			for (mp_uint32 j = 0; j < numLoaders && linear == NULL; j++)
+			{
+				if (loaders[j].loader->identifyModule(buffer))
+					linear = loaders + j;
+			}
+			
+			const char* id;
+			ASSERT(identify(buffer, id) == linear);
+			
+			if (linear && linear->loader == signature.loader)
+				identified = true;
+		}
+		
+		// these also look for chunks behind their magic which 
+		// aren't made up here
+		bool needsChunks = false;
+#ifndef MP_XMONLY
+		needsChunks = signature.loader == &loaderDSMv2 || 
+					  signature.loader == &loaderDTM_1 || 
+					  signature.loader == &loaderDTM_2;
+#endif
+		ASSERT(identified || needsChunks);
 	}
-	else return NULL;
 }
+#endif
 
-XModule::TLoaderInfo* XModule::LoaderManager::getNextLoaderInfo()
+const XModule::TLoaderInfo* XModule::LoaderManager::identify(const mp_ubyte* buffer, const char*& id)
 {
-	iteratorCounter++;
-	if (iteratorCounter < (signed)numLoaders)
-		return loaders+iteratorCounter;
-	else
+#ifndef NDEBUG
+	// verifySignatures() identifies as well, so mark it done first
+	static bool verified = false;
+	if (!verified)
 	{
-		iteratorCounter = -1;
-		return NULL;
+		verified = true;
+		instance.verifySignatures();
 	}
+#endif
+
+	mp_uint32 i;
+	bool candidates[MaxLoaders];
+	for (i = 0; i < numLoaders; i++)
+		candidates[i] = !instance.hasSignature[i];
+		
+	// a single lookup per offset leaves the few signatures worth comparing
+	for (i = 0; i < instance.numSignatureOffsets; i++)
+	{
+		const mp_ubyte* src = buffer + instance.signatureOffsets[i];
+		const mp_ubyte* bucket = instance.buckets[i] + *src;
+		
+		for (mp_uint32 j = bucket[0]; j < bucket[1]; j++)
+		{
+			const TSignature& signature = signatures[instance.sortedSignatures[j]];
+			if (!memcmp(src, signature.magic, signature.length))
+				candidates[instance.signatureLoaders[j]] = true;
+		}
+	}
+	
+	// the remaining loaders still decide in order of precedence
+	for (i = 0; i < numLoaders; i++)
+	{
+		if (!candidates[i])
+			continue;
+			
+		id = loaders[i].loader->identifyModule(buffer);
+		if (id)
+			return loaders + i;
+	}
+	
+	id = NULL;
+	return NULL;
 }
 
 const mp_sint32 XModule::periods[12] = {1712,1616,1524,1440,1356,1280,1208,1140,1076,1016,960,907};
@@ -1412,6 +1603,156 @@ mp_uint32 XModule::amigaPeriodToNote(mp_uint32 period)
 	return 0;
 }
 
+//////////////////////////////////////////////////////////////////////////
+// In place sample data conversion, the vector loops compute the exact  //
+// same values as the scalar ones (wrapping around on overflow)			//
+//////////////////////////////////////////////////////////////////////////
+static void deltaDecode8(mp_sbyte* data, mp_uint32 length)
+{
+	mp_uint32 i = 0;
+#if defined(__XMODULE_SSE2__)
+	// prefix sum within 16 bytes in four steps, carry holds the previous 
+	// value in every byte
+	__m128i carry = _mm_setzero_si128();
+	for (; i + 16 <= length; i+=16)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i*)(data + i));
+		x = _mm_add_epi8(x, _mm_slli_si128(x, 1));
+		x = _mm_add_epi8(x, _mm_slli_si128(x, 2));
+		x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+		x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+		x = _mm_add_epi8(x, carry);
+		_mm_storeu_si128((__m128i*)(data + i), x);
+
+		carry = _mm_srli_si128(x, 15);
+		carry = _mm_unpacklo_epi8(carry, carry);
+		carry = _mm_shuffle_epi32(_mm_shufflelo_epi16(carry, 0), 0);
+	}
+#elif defined(__XMODULE_NEON__)
+	const int8x16_t zero = vdupq_n_s8(0);
+	int8x16_t carry = zero;
+	for (; i + 16 <= length; i+=16)
+	{
+		int8x16_t x = vld1q_s8(data + i);
+		x = vaddq_s8(x, vextq_s8(zero, x, 15));
+		x = vaddq_s8(x, vextq_s8(zero, x, 14));
+		x = vaddq_s8(x, vextq_s8(zero, x, 12));
+		x = vaddq_s8(x, vextq_s8(zero, x, 8));
+		x = vaddq_s8(x, carry);
+		vst1q_s8(data + i, x);
+		
+		carry = vdupq_n_s8(vgetq_lane_s8(x, 15));
+	}
+#endif
+	mp_sbyte b1 = i ? data[i-1] : 0;
+	for (; i < length; i++) 
+		data[i] = b1+=data[i];
+}
+
+static void deltaDecode16(mp_sword* data, mp_uint32 length)
+{
+	mp_uint32 i = 0;
+#if defined(__XMODULE_SSE2__)
+	__m128i carry = _mm_setzero_si128();
+	for (; i + 8 <= length; i+=8)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i*)(data + i));
+		x = _mm_add_epi16(x, _mm_slli_si128(x, 2));
+		x = _mm_add_epi16(x, _mm_slli_si128(x, 4));
+		x = _mm_add_epi16(x, _mm_slli_si128(x, 8));
+		x = _mm_add_epi16(x, carry);
+		_mm_storeu_si128((__m128i*)(data + i), x);
+
+		carry = _mm_shuffle_epi32(_mm_shufflelo_epi16(_mm_srli_si128(x, 14), 0), 0);
+	}
+#elif defined(__XMODULE_NEON__)
+	const int16x8_t zero = vdupq_n_s16(0);
+	int16x8_t carry = zero;
+	for (; i + 8 <= length; i+=8)
+	{
+		int16x8_t x = vld1q_s16(data + i);
+		x = vaddq_s16(x, vextq_s16(zero, x, 7));
+		x = vaddq_s16(x, vextq_s16(zero, x, 6));
+		x = vaddq_s16(x, vextq_s16(zero, x, 4));
+		x = vaddq_s16(x, carry);
+		vst1q_s16(data + i, x);
+		
+		carry = vdupq_n_s16(vgetq_lane_s16(x, 7));
+	}
+#endif
+	mp_sword b1 = i ? data[i-1] : 0;
+	for (; i < length; i++) 
+		data[i] = b1+=data[i];
+}
+
+// flip the sign bit of unsigned sample data
+static void convertUnsigned8(mp_sbyte* data, mp_uint32 length)
+{
+	mp_uint32 i = 0;
+#if defined(__XMODULE_SSE2__)
+	const __m128i mask = _mm_set1_epi8((char)0x80);
+	for (; i + 16 <= length; i+=16)
+	{
+		__m128i* p = (__m128i*)(data + i);
+		_mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), mask));
+	}
+#elif defined(__XMODULE_NEON__)
+	const int8x16_t mask = vdupq_n_s8(-128);
+	for (; i + 16 <= length; i+=16)
+		vst1q_s8(data + i, veorq_s8(vld1q_s8(data + i), mask));
+#endif
+	for (; i < length; i++) 
+		data[i] ^= 128;
+}
+
+static void convertUnsigned16(mp_sword* data, mp_uint32 length)
+{
+	mp_uint32 i = 0;
+#if defined(__XMODULE_SSE2__)
+	const __m128i mask = _mm_set1_epi16((short)0x8000);
+	for (; i + 8 <= length; i+=8)
+	{
+		__m128i* p = (__m128i*)(data + i);
+		_mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), mask));
+	}
+#elif defined(__XMODULE_NEON__)
+	const int16x8_t mask = vdupq_n_s16(-32768);
+	for (; i + 8 <= length; i+=8)
+		vst1q_s16(data + i, veorq_s16(vld1q_s16(data + i), mask));
+#endif
+	for (; i < length; i++) 
+		data[i] = (data[i]^32768);
+}
+
+// 16 bit sample data into host byte order
+static void convertByteOrder16(mp_sword* data, mp_uint32 length, bool bigEndian)
+{
+#ifdef MILKYPLAY_BIGENDIAN
+	if (bigEndian)
+		return;
+#else
+	if (!bigEndian)
+		return;
+#endif
+
+	mp_uint32 i = 0;
+#if defined(__XMODULE_SSE2__)
+	for (; i + 8 <= length; i+=8)
+	{
+		__m128i* p = (__m128i*)(data + i);
+		const __m128i x = _mm_loadu_si128(p);
+		_mm_storeu_si128(p, _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8)));
+	}
+#elif defined(__XMODULE_NEON__)
+	for (; i + 8 <= length; i+=8)
+		vst1q_s16(data + i, vreinterpretq_s16_s8(vrev16q_s8(vreinterpretq_s8_s16(vld1q_s16(data + i)))));
+#endif
+	if (bigEndian)
+		BigEndian::CONVERT_WORDS((mp_uword*)data + i, length - i);
+	else
+		LittleEndian::CONVERT_WORDS((mp_uword*)data + i, length - i);
+}
+
 ////////////////////////////////////////////
 // Load sample into given memory.		  //
 // Sample size is in BYTES not in samples //
@@ -1485,42 +1826,20 @@ bool XModule::loadSample(XMFileBase& f,void* buffer,mp_uint32 size,mp_uint32 len
 	if (flags & ST_16BIT)
 	{
 		mp_sword* dstPtr = (mp_sword*)buffer;
-		mp_ubyte* srcPtr = (mp_ubyte*)buffer;
 
 		// PTM delta storing
 		if (flags & ST_DELTA_PTM)
-		{
-			mp_sbyte b1=0;
-			for (mp_uint32 i = 0; i < length*2; i++) 
-				srcPtr[i] = b1+=srcPtr[i];
-		}
+			deltaDecode8((mp_sbyte*)buffer, length*2);
 
-		mp_uint32 i;
-		if (flags & ST_BIGENDIAN)
-		{
-			for (i = 0; i < length; i++)
-				dstPtr[i] = BigEndian::GET_WORD(srcPtr+i*2);
-		}
-		else
-		{
-			for (i = 0; i < length; i++)
-				dstPtr[i] = LittleEndian::GET_WORD(srcPtr+i*2);
-		}
+		convertByteOrder16(dstPtr, length, (flags & ST_BIGENDIAN) != 0);
 		
 		// delta-storing
 		if (flags & ST_DELTA)
-		{
-			mp_sword b1=0;
-			for (i = 0; i < length; i++) 
-				dstPtr[i] = b1+=dstPtr[i];
-		}
+			deltaDecode16(dstPtr, length);
 
 		// unsigned sample data
 		if (flags & ST_UNSIGNED)
-		{
-			for (i = 0; i < length; i++) 
-				dstPtr[i] = (dstPtr[i]^32768);
-		}
+			convertUnsigned16(dstPtr, length);
 	}
 	// 8 bit sample
 	else
@@ -1529,18 +1848,11 @@ bool XModule::loadSample(XMFileBase& f,void* buffer,mp_uint32 size,mp_uint32 len
 	
 		// delta-storing
 		if (flags & ST_DELTA)
-		{
-			mp_sbyte b1=0;
-			for (mp_uint32 i = 0; i < length; i++) 
-				smpPtr[i] = b1+=smpPtr[i];
-		}
+			deltaDecode8(smpPtr, length);
 
 		// unsigned sample data
 		if (flags & ST_UNSIGNED)
-		{
-			for (mp_uint32 i = 0; i < length; i++) 
-				smpPtr[i] ^= 128;
-		}
+			convertUnsigned8(smpPtr, length);
 	}
 
 	if (tmpBuffer)
@@ -1568,6 +1880,9 @@ mp_sint32 XModule::loadModuleSample(XMFileBase& f, mp_sint32 index,
 			return MP_OUT_OF_MEMORY;
 		}
 		
+		if (deferModuleSample(f, index, finalSize, flags16, true))
+			return MP_OK;
+		
 		if (!loadSample(f,smp[index].sample, finalSize, smp[index].samplen, flags16))
 		{
 			return MP_OUT_OF_MEMORY;
@@ -1585,6 +1900,9 @@ mp_sint32 XModule::loadModuleSample(XMFileBase& f, mp_sint32 index,
 			return MP_OUT_OF_MEMORY;
 		}
 		
+		if (deferModuleSample(f, index, finalSize, flags8, true))
+			return MP_OK;
+		
 		if (!loadSample(f,smp[index].sample, finalSize, smp[index].samplen, flags8))
 		{
 			return MP_OUT_OF_MEMORY;
@@ -1605,6 +1923,277 @@ mp_sint32 XModule::loadModuleSamples(XMFileBase& f, mp_sint32 flags8/* = ST_DEFA
 	return MP_OK;
 }
 
+////////////////////////////////////////////
+// Deferred sample loading				  //
+////////////////////////////////////////////
+class XModule::SampleDecodingJob : public ThreadPool::Job
+{
+private:
+	XModule& module;
+	const mp_sword* order;
+	mp_sint32 numSamples;
+	
+public:
+	SampleDecodingJob(XModule& module, const mp_sword* order, mp_sint32 numSamples) :
+		module(module),
+		order(order),
+		numSamples(numSamples)
+	{
+	}
+	
+	// skips samples which are decoded by someone else already
+	virtual void run()
+	{
+		for (mp_sint32 i = 0; i < numSamples; i++)
+		{
+			if (LockFreeAtomic::loadAcquire(&module.abortSampleDecoding))
+				break;
+				
+			module.decodeDeferredSample(order[i], false);
+		}
+	}
+};
+
+bool XModule::deferModuleSample(XMFileBase& f, mp_sint32 index, mp_uint32 size, mp_sint32 flags, bool skipData)
+{
+	if (&f != deferrableFile || smp[index].samplen == 0)
+		return false;
+
+	// bit 5 also marks modplug stereo samples which the XM loader
+	// mixes down right after loading them
+	if (smp[index].type & 32)
+		return false;
+
+	const mp_uint32 length = smp[index].samplen;
+	mp_uint32 dataSize = 0;
+
+	// the next sample can only be found when the size of this one's
+	// data is known up front
+	if (skipData)
+	{
+		if (flags & (ST_PACKING_MDL | ST_PACKING_IT | ST_PACKING_IT215))
+			return false;
+		
+		if (flags & ST_PACKING_ADPCM)
+		{
+			// the packed size of 16 bit ADPCM isn't known up front
+			if (flags & ST_16BIT)
+				return false;
+			
+			dataSize = 16 + (length+1)/2;
+		}
+		else
+			dataSize = (flags & ST_16BIT) ? length*2 : length;
+	}
+
+	if (deferredSamples == NULL)
+	{
+		deferredSamples = new TDeferredSample[MP_MAXSAMPLES];
+		memset(deferredSamples, 0, sizeof(TDeferredSample)*MP_MAXSAMPLES);
+		
+		sampleData = f.getData();
+		sampleDataSize = f.size();
+	}
+
+	TDeferredSample& deferred = deferredSamples[index];
+	deferred.offset = f.pos();
+	deferred.size = size;
+	deferred.length = length;
+	deferred.flags = flags;
+	deferred.buffer = (mp_ubyte*)smp[index].sample;
+	deferred.state = DeferredSamplePending;
+	
+	// stay silent until the data is there
+	memset(deferred.buffer, 0, TXMSample::getSampleSizeInBytes(deferred.buffer));
+	
+	if (skipData)
+		f.seek(deferred.offset + dataSize);
+	return true;
+}
+
+bool XModule::loadModuleSampleData(XMFileBase& f, mp_sint32 index, mp_uint32 size, mp_sint32 flags)
+{
+	if (deferModuleSample(f, index, size, flags, false))
+		return true;
+		
+	return loadSample(f, smp[index].sample, size, smp[index].samplen, flags);
+}
+
+void XModule::decodeDeferredSample(mp_sint32 index, bool wait/* = true*/)
+{
+	TDeferredSample& deferred = deferredSamples[index];
+	
+	if (!LockFreeAtomic::compareAndSwap(&deferred.state, DeferredSamplePending, DeferredSampleDecoding))
+	{
+		// another thread got there first
+		while (wait && LockFreeAtomic::loadAcquire(&deferred.state) != DeferredSampleLoaded)
+			ThreadPool::yield();
+		return;
+	}
+	
+	// every decoder gets its own view on the file
+	XMFileMemory f(sampleData, sampleDataSize);
+	f.seek(deferred.offset);
+	loadSample(f, deferred.buffer, deferred.size, deferred.length, deferred.flags);
+	
+	TXMSample* smp = &this->smp[index];
+	if (smp->sample == (mp_sbyte*)deferred.buffer)
+	{
+		if (deferredHeavyPostProcessing)
+			smp->smoothLooping();
+		
+		smp->postProcessSamples();
+	}
+	
+	LockFreeAtomic::storeRelease(&deferred.state, DeferredSampleLoaded);
+}
+
+void XModule::decodeAllSamples()
+{
+	if (deferredSamples == NULL)
+		return;
+		
+	for (mp_sint32 i = 0; i < MP_MAXSAMPLES; i++)
+		decodeSample(i);
+}
+
+void XModule::decodeSamplesInParallel()
+{
+	mp_sword* order = new mp_sword[MP_MAXSAMPLES];
+	mp_sint32 numSamples = 0;
+	mp_uint32 totalSize = 0;
+	
+	for (mp_sint32 i = 0; i < MP_MAXSAMPLES; i++)
+	{
+		if (deferredSamples[i].state == DeferredSamplePending)
+		{
+			order[numSamples++] = (mp_sword)i;
+			totalSize+=deferredSamples[i].size;
+		}
+	}
+	
+	// not worth starting threads for a handful of small samples
+	if (numSamples > 1 && totalSize >= ParallelDecodingThreshold)
+	{
+		ThreadPool pool;
+		const mp_sint32 numJobs = pool.getNumThreads() < numSamples ? pool.getNumThreads() : numSamples;
+		
+		SampleDecodingJob** jobs = new SampleDecodingJob*[numJobs];
+		mp_sint32 i;
+		for (i = 0; i < numJobs; i++)
+		{
+			jobs[i] = new SampleDecodingJob(*this, order, numSamples);
+			pool.addJob(jobs[i]);
+		}
+		
+		pool.waitForAll();
+		
+		for (i = 0; i < numJobs; i++)
+			delete jobs[i];
+		delete[] jobs;
+	}
+	
+	delete[] order;
+	
+	decodeAllSamples();
+}
+
+// samples of the instruments in the order they're first used in the song,
+// followed by the remaining deferred ones
+mp_sint32 XModule::getSampleDecodingOrder(mp_sword* order)
+{
+	mp_ubyte* queued = new mp_ubyte[MP_MAXSAMPLES];
+	memset(queued, 0, MP_MAXSAMPLES);
+	
+	bool insUsed[256];
+	memset(insUsed, 0, sizeof(insUsed));
+	
+	mp_sint32 numSamples = 0;
+	mp_sint32 i;
+
+	for (i = 0; i < header.ordnum; i++)
+	{
+		const TXMPattern& pattern = phead[header.ord[i]];
+		if (pattern.patternData == NULL)
+			continue;
+		
+		const mp_sint32 slotSize = 2 + pattern.effnum*2;
+		const mp_sint32 numSlots = pattern.rows*pattern.channum;
+		
+		for (mp_sint32 j = 0; j < numSlots; j++)
+		{
+			const mp_sint32 ins = pattern.patternData[j*slotSize+1];
+			if (!ins || ins > header.insnum || insUsed[ins-1])
+				continue;
+				
+			insUsed[ins-1] = true;
+			
+			for (mp_sint32 k = 0; k < 120; k++)
+			{
+				const mp_sint32 s = instr[ins-1].snum[k];
+				if (s >= 0 && s < MP_MAXSAMPLES && !queued[s] && 
+					deferredSamples[s].state == DeferredSamplePending)
+				{
+					queued[s] = 1;
+					order[numSamples++] = (mp_sword)s;
+				}
+			}
+		}
+	}
+	
+	for (i = 0; i < MP_MAXSAMPLES; i++)
+	{
+		if (!queued[i] && deferredSamples[i].state == DeferredSamplePending)
+			order[numSamples++] = (mp_sword)i;
+	}
+	
+	delete[] queued;
+	
+	return numSamples;
+}
+
+void XModule::startSampleDecoding()
+{
+	if (deferredSamples == NULL || sampleDecoder)
+		return;
+		
+	sampleDecodingOrder = new mp_sword[MP_MAXSAMPLES];
+	const mp_sint32 numSamples = getSampleDecodingOrder(sampleDecodingOrder);
+	
+	abortSampleDecoding = 0;
+	sampleDecodingJob = new SampleDecodingJob(*this, sampleDecodingOrder, numSamples);
+	
+	// the calling thread counts as one, so that's a single worker
+	sampleDecoder = new ThreadPool(2);
+	sampleDecoder->addJob(sampleDecodingJob);
+}
+
+void XModule::releaseDeferredSamples()
+{
+	if (sampleDecoder)
+	{
+		LockFreeAtomic::storeRelease(&abortSampleDecoding, 1);
+		sampleDecoder->waitForAll();
+		
+		delete sampleDecoder;
+		sampleDecoder = NULL;
+		delete sampleDecodingJob;
+		sampleDecodingJob = NULL;
+		delete[] sampleDecodingOrder;
+		sampleDecodingOrder = NULL;
+		abortSampleDecoding = 0;
+	}
+	
+	delete[] deferredSamples;
+	deferredSamples = NULL;
+	
+	sampleData = NULL;
+	sampleDataSize = 0;
+	
+	delete sampleSource;
+	sampleSource = NULL;
+}
+
 ////////////////////////////////////////////
 // Before using the sample postprocessing //
 // please make sure that the memory       //
@@ -1613,6 +2202,8 @@ mp_sint32 XModule::loadModuleSamples(XMFileBase& f, mp_sint32 flags8/* = ST_DEFA
 ////////////////////////////////////////////
 void XModule::postProcessSamples(bool heavy/* = false*/)
 {
+	deferredHeavyPostProcessing = heavy;
+
 	for (mp_uint32 i = 0; i < header.smpnum; i++)
 	{
 
@@ -1622,13 +2213,22 @@ void XModule::postProcessSamples(bool heavy/* = false*/)
 		printf("%i: %i, %i, %i, %x\n",i,smp->samplen, smp->loopstart, smp->looplen,smp->pan);
 #endif
 
+		const bool deferred = deferredSamples && deferredSamples[i].state != DeferredSampleLoaded;
+
 		if (smp->samplen == 0)
 		{
+			if (deferred)
+				deferredSamples[i].state = DeferredSampleLoaded;
+			
 			freeSampleMem((mp_ubyte*)smp->sample, false);
 			smp->sample = NULL;
 			continue;
 		}
 		
+		// done after decoding
+		if (deferred)
+			continue;
+		
 		if (heavy)
 			smp->smoothLooping();
 		
@@ -1783,6 +2383,8 @@ void XModule::fixEnvelopes(TEnvelope* envs, mp_uint32 numEnvs)
 // module right after that
 bool XModule::cleanUp()
 {
+	releaseDeferredSamples();
+
 	if (venvs)
 	{
 		delete[] venvs;
@@ -1917,6 +2519,19 @@ XModule::XModule()
 	
 	message = NULL;
 	messageBytesAlloc = 0;
+	
+	deferSampleLoading = false;
+	deferredHeavyPostProcessing = false;
+	keepSampleSource = false;
+	deferrableFile = NULL;
+	sampleSource = NULL;
+	sampleData = NULL;
+	sampleDataSize = 0;
+	deferredSamples = NULL;
+	sampleDecoder = NULL;
+	sampleDecodingJob = NULL;
+	sampleDecodingOrder = NULL;
+	abortSampleDecoding = 0;
 }
 
 XModule::~XModule()
@@ -1930,28 +2545,39 @@ XModule::~XModule()
 
 const char* XModule::identifyModule(const mp_ubyte* buffer)
 {
-	// browse through all available loaders and find suitable
-	LoaderManager loaderManager;
-	TLoaderInfo* loaderInfo;
-	loaderInfo = loaderManager.getFirstLoaderInfo();
-	while (loaderInfo)
-	{
-		// if loader can identify module return ID
-		const char* id = loaderInfo->loader->identifyModule(buffer);
-		if (id)
-		{
-			return id;
-		}
-		
-		loaderInfo = loaderManager.getNextLoaderInfo();
-	}
-	return NULL;
+	const char* id;
+	LoaderManager::identify(buffer, id);
+	return id;
 }
 
 mp_sint32 XModule::loadModule(const SYSCHAR* fileName, bool scanForSubSongs/* = false*/)
 {
-	XMFile f(fileName);
-	return f.isOpen() ? loadModule(f, scanForSubSongs) : -8; 
+	if (!deferSampleLoading)
+	{
+		XMFileMapped f(fileName);
+		return f.isOpen() ? loadModule(f, scanForSubSongs) : -8; 
+	}
+	
+	releaseDeferredSamples();
+	
+	// samples are decoded from the mapping later on, so keep it 
+	XMFileMapped* f = new XMFileMapped(fileName);
+	if (!f->isOpen())
+	{
+		delete f;
+		return -8;
+	}
+	
+	keepSampleSource = true;
+	mp_sint32 err = loadModule(*f, scanForSubSongs);
+	keepSampleSource = false;
+	
+	if (deferredSamples)
+		sampleSource = f;
+	else
+		delete f;
+		
+	return err;
 }
 
 mp_sint32 XModule::loadModule(XMFileBase& f, bool scanForSubSongs/* = false*/)
@@ -1962,35 +2588,41 @@ mp_sint32 XModule::loadModule(XMFileBase& f, bool scanForSubSongs/* = false*/)
 	f.setBaseOffset(f.pos());
 	f.read(buffer, 1, sizeof(buffer));
 
-	// browse through all available loaders and find suitable
-	LoaderManager loaderManager;
-	TLoaderInfo* loaderInfo;
-	loaderInfo = loaderManager.getFirstLoaderInfo();
-	while (loaderInfo)
+	// find suitable loader
+	const char* id;
+	const TLoaderInfo* loaderInfo = LoaderManager::identify(buffer, id);
+	if (loaderInfo)
 	{
-		// if loader can identify module take that loader
-		if (loaderInfo->loader->identifyModule(buffer))
+		// the sample data of files in memory is decoded after 
+		// the loader is done, see loadModuleSampleData
+		deferrableFile = f.getData() ? &f : NULL;
+	
+		// try to load module
+		f.seekWithBaseOffset(0);
+		mp_sint32 err = loaderInfo->loader->load(f, this);
+		
+		deferrableFile = NULL;
+		if (deferredSamples && !keepSampleSource)
 		{
-			// try to load module
-			f.seekWithBaseOffset(0);
-			mp_sint32 err = loaderInfo->loader->load(f, this);
 			if (err == MP_OK)
-			{
-				moduleLoaded = true;
-				
-				bool res = validate();
-
-				if (!res)
-					return MP_OUT_OF_MEMORY;
-				
-				type = loaderInfo->moduleType;
-				if (scanForSubSongs)
-					buildSubSongTable();
-			}
-			return err;
+				decodeSamplesInParallel();
+			releaseDeferredSamples();
 		}
 		
-		loaderInfo = loaderManager.getNextLoaderInfo();
+		if (err == MP_OK)
+		{
+			moduleLoaded = true;
+			
+			bool res = validate();
+
+			if (!res)
+				return MP_OUT_OF_MEMORY;
+			
+			type = loaderInfo->moduleType;
+			if (scanForSubSongs)
+				buildSubSongTable();
+		}
+		return err;
 	}
 	
 #ifdef MILKYTRACKER
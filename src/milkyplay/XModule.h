@@ -37,6 +37,9 @@
 #define __XMODULE_H__
 
 #include "XMFile.h"
+#include "LockFreeRingBuffer.h"
+
+class ThreadPool;
 
 #define MP_MAXTEXT 32
 #define MP_MAXORDERS 256
@@ -434,6 +437,14 @@ public:
 	
 	mp_sint32			loadModuleSamples(XMFileBase& f, 
 										  mp_sint32 flags8 = ST_DEFAULT, mp_sint32 flags16 = ST_16BIT);
+
+	///////////////////////////////////////////////////////
+	// load data of a sample from the current position,	 //
+	// might only be decoded after the loader is done so //
+	// the loader has to seek to the next data itself	 //
+	///////////////////////////////////////////////////////
+	bool				loadModuleSampleData(XMFileBase& f, mp_sint32 index, 
+											 mp_uint32 size, mp_sint32 flags);
 	
 	static void			convertXMVolumeEffects(mp_ubyte volume, mp_ubyte& eff, mp_ubyte& op);
 	
@@ -493,31 +504,109 @@ private:
 	// fix broken envelopes (1 point envelope for example)
 	static void		fixEnvelopes(TEnvelope* envs, mp_uint32 numEnvs);
 	
-	// holds available loader instances
+	// holds the available loader instances, they don't keep any state so all
+	// modules share them, and an index of the signatures the loaders look for
 	class LoaderManager
 	{
 	private:
-		TLoaderInfo*	loaders;
+		enum
+		{
+			MaxLoaders			= 64,
+			MaxSignatures		= 64,
+			MaxSignatureOffsets	= 8
+		};
+	
+		// loader only identifies files with one of its signatures at the given offset
+		struct TSignature
+		{
+			LoaderInterface*	loader;
+			mp_uint32			offset;
+			const char*			magic;
+			mp_uint32			length;
+		};
 
-		mp_uint32		numLoaders;
-		mp_uint32		numAllocatedLoaders;
+		static const TLoaderInfo	loaders[];
+		static const mp_uint32		numLoaders;
+		static const TSignature		signatures[];
+		static const mp_uint32		numSignatures;
+		
+		static LoaderManager		instance;
 
-		mp_sint32		iteratorCounter;
+		// everything below is built from the tables above, before that
+		// (zero initialized) each loader is probed
+		bool			hasSignature[MaxLoaders];
+		
+		mp_uint32		signatureOffsets[MaxSignatureOffsets];
+		mp_uint32		numSignatureOffsets;
+		
+		// signatures sorted by offset and first byte, buckets[o][b] is the 
+		// first one at signatureOffsets[o] starting with byte b
+		mp_ubyte		sortedSignatures[MaxSignatures];
+		mp_ubyte		signatureLoaders[MaxSignatures];
+		mp_ubyte		buckets[MaxSignatureOffsets][257];
 
-		void registerLoader(LoaderInterface* loader, ModuleTypes type);
+		LoaderManager();
 		
+#ifndef NDEBUG
+		void			verifySignatures();
+#endif
+
 	public:
-		LoaderManager();		
-		~LoaderManager();
-		
-		TLoaderInfo* getFirstLoaderInfo();
-		TLoaderInfo* getNextLoaderInfo();
+		// find the first loader identifying the given buffer (IdentificationBufferSize bytes)
+		static const TLoaderInfo* identify(const mp_ubyte* buffer, const char*& id);
 	};
 
 	friend class	LoaderManager;
 
 	bool			validate();
 
+	// Deferred sample loading: sample data in files which are in memory
+	// is decoded after parsing (in parallel) or when first needed, state 
+	// is one of the DeferredSample* values
+	struct TDeferredSample
+	{
+		volatile mp_uint32	state;
+		mp_uint32			offset;
+		mp_uint32			size;
+		mp_uint32			length;
+		mp_sint32			flags;
+		mp_ubyte*			buffer;
+	};
+
+	enum
+	{
+		DeferredSampleLoaded,
+		DeferredSamplePending,
+		DeferredSampleDecoding
+	};
+	
+	enum
+	{
+		ParallelDecodingThreshold = 256*1024
+	};
+	
+	class SampleDecodingJob;
+	friend class	SampleDecodingJob;
+
+	bool				deferSampleLoading;
+	bool				deferredHeavyPostProcessing;
+	bool				keepSampleSource;
+	XMFileBase*			deferrableFile;
+	XMFileMapped*		sampleSource;
+	const mp_ubyte*		sampleData;
+	mp_uint32			sampleDataSize;
+	TDeferredSample*	deferredSamples;
+	ThreadPool*			sampleDecoder;
+	SampleDecodingJob*	sampleDecodingJob;
+	mp_sword*			sampleDecodingOrder;
+	volatile mp_uint32	abortSampleDecoding;
+
+	bool			deferModuleSample(XMFileBase& f, mp_sint32 index, mp_uint32 size, mp_sint32 flags, bool skipData);
+	void			decodeDeferredSample(mp_sint32 index, bool wait = true);
+	void			decodeSamplesInParallel();
+	mp_sint32		getSampleDecodingOrder(mp_sword* order);
+	void			releaseDeferredSamples();
+
 public:
 	
 	// Module flags
@@ -637,10 +726,38 @@ public:
 	mp_sint32		loadModule(XMFileBase& f, bool scanForSubSongs = false);
 	mp_sint32		loadModule(const SYSCHAR* fileName, bool scanForSubSongs = false);	 
 
+	///////////////////////////////////////////////////
+	// deferred sample loading						 //
+	///////////////////////////////////////////////////
+	// When enabled, loadModule(fileName) keeps the file
+	// mapped and only decodes the sample data of most
+	// formats on first use (instead of right after parsing)
+	void			setDeferredSampleLoading(bool deferred) { deferSampleLoading = deferred; }
+	bool			getDeferredSampleLoading() const { return deferSampleLoading; }
+	
+	bool			hasDeferredSamples() const { return deferredSamples != NULL; }
+
+	// Make sure the sample data has been loaded, can be called from
+	// any thread (blocks while another thread is decoding the sample)
+	void			decodeSample(mp_sint32 index)
+	{
+		if (deferredSamples && 
+			LockFreeAtomic::loadAcquire(&deferredSamples[index].state) != DeferredSampleLoaded)
+			decodeDeferredSample(index);
+	}
+	
+	// Call before accessing sample data directly, e.g. for editing
+	void			decodeAllSamples();
+	
+	// Decode the remaining samples on a background thread, in the 
+	// order in which the song uses their instruments
+	void			startSampleDecoding();
+
 	///////////////////////////////////////////////////
 	// Module exporters								 //
 	///////////////////////////////////////////////////
 	mp_sint32		saveExtendedModule(const SYSCHAR* fileName, const char* trackerString = NULL);		// FT2 (.XM)
+	mp_sint32		saveExtendedModule(XMFileBase& f, const char* trackerString = NULL);
 	mp_sint32		saveProtrackerModule(const SYSCHAR* fileName);   // Protracker compatible (.MOD)
 
 	///////////////////////////////////////////////////
@@ -0,0 +1,653 @@
+/*
+ *  milkyrender/main.cpp
+ *
+ *  Copyright 2009 Peter Barth
+ *
+ *  This file is part of Milkytracker.
+ *
+ *  Milkytracker is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Milkytracker is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Milkytracker.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ *  main.cpp
+ *  milkyrender
+ *
+ *  Headless module to WAV renderer, only depends on milkyplay.
+ *  Several files can be rendered at once (--jobs), every file gets a
+ *  module and player of its own. For every file the render speed is
+ *  reported as a multiple of realtime.
+ *
+ */
+
+#include "MilkyPlay.h"
+#include "AudioDriver_NULL.h"
+#include "ResamplerFactory.h"
+#include "ThreadPool.h"
+
+#if defined(WIN32) || defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const struct
+{
+	const char* name;
+	ChannelMixer::ResamplerTypes type;
+} resamplers[] =
+{
+	{ "none", ChannelMixer::MIXER_NORMAL },
+	{ "linear", ChannelMixer::MIXER_LERPING },
+	{ "lagrange", ChannelMixer::MIXER_LAGRANGE },
+	{ "spline", ChannelMixer::MIXER_SPLINE },
+	{ "fastsinc", ChannelMixer::MIXER_SINCTABLE },
+	{ "sinc", ChannelMixer::MIXER_SINC },
+	{ "a500", ChannelMixer::MIXER_AMIGA500 },
+	{ "a500led", ChannelMixer::MIXER_AMIGA500LED },
+	{ "a1200", ChannelMixer::MIXER_AMIGA1200 },
+	{ "a1200led", ChannelMixer::MIXER_AMIGA1200LED },
+	{ "polysinc", ChannelMixer::MIXER_SINCPOLYPHASE }
+};
+
+static const mp_uint32 numResamplers = sizeof(resamplers) / sizeof(resamplers[0]);
+
+struct RenderParameters
+{
+	mp_uint32 sampleRate;
+	ChannelMixer::ResamplerTypes resamplerType;
+	bool ramping;
+	mp_uint32 bufferSize;
+	// mix everything between two ticks at once
+	bool tickSpans;
+	mp_sint32 fromOrder;
+	mp_sint32 toOrder;
+	// hex digits, the lowest bit is the first channel
+	const char* muteMask;
+	mp_uint32 limiterDrive;
+	mp_sint32 mixerVolume;
+	mp_sint32 mixerShift;
+	WAVWriter::WAVFormats format;
+	bool normalize;
+	// mix without writing anything
+	bool dryRun;
+	// only report length, loop and sub-songs, nothing is mixed
+	bool analyze;
+
+	RenderParameters() :
+		sampleRate(44100),
+		resamplerType(ChannelMixer::MIXER_LAGRANGE),
+		ramping(true),
+		bufferSize(4096),
+		tickSpans(true),
+		fromOrder(0),
+		toOrder(-1),
+		muteMask(NULL),
+		limiterDrive(0),
+		mixerVolume(256),
+		mixerShift(1),
+		format(WAVWriter::WAVFormat16Bit),
+		normalize(false),
+		dryRun(false),
+		analyze(false)
+	{
+	}
+};
+
+static double getTimeInSeconds()
+{
+#if defined(WIN32) || defined(_WIN32)
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (double)tv.tv_sec + (double)tv.tv_usec * (1.0 / 1000000.0);
+#endif
+}
+
+static mp_sint32 hexDigit(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+static bool isValidMuteMask(const char* mask)
+{
+	if (mask[0] == '0' && (mask[1] == 'x' || mask[1] == 'X'))
+		mask+=2;
+	if (*mask == '\0')
+		return false;
+	for (; *mask; mask++)
+	{
+		if (hexDigit(*mask) < 0)
+			return false;
+	}
+	return true;
+}
+
+// the mask is read from the right, bit 0 of the last digit is channel 1
+static void applyMuteMask(const char* mask, mp_ubyte* muting, mp_uint32 numChannels)
+{
+	memset(muting, 0, numChannels);
+	if (mask == NULL)
+		return;
+
+	if (mask[0] == '0' && (mask[1] == 'x' || mask[1] == 'X'))
+		mask+=2;
+
+	mp_uint32 channel = 0;
+	for (mp_sint32 i = (mp_sint32)strlen(mask) - 1; i >= 0 && channel < numChannels; i--)
+	{
+		const mp_sint32 digit = hexDigit(mask[i]);
+		for (mp_uint32 j = 0; j < 4 && channel < numChannels; j++, channel++)
+			muting[channel] = (digit >> j) & 1;
+	}
+}
+
+// milkyplay wants TCHAR file names on Windows
+class SysString
+{
+private:
+	SYSCHAR* str;
+
+	SysString(const SysString& src);
+	SysString& operator=(const SysString& src);
+
+public:
+	SysString(const char* src)
+	{
+		const size_t len = strlen(src);
+		str = new SYSCHAR[len+1];
+#if (defined(WIN32) || defined(_WIN32)) && defined(UNICODE)
+		mbstowcs(str, src, len+1);
+#else
+		strcpy(str, src);
+#endif
+	}
+
+	~SysString()
+	{
+		delete[] str;
+	}
+
+	operator const SYSCHAR*() const { return str; }
+};
+
+class RenderJob : public ThreadPool::Job
+{
+private:
+	const RenderParameters& parameters;
+	const char* inFileName;
+	char* outFileName;
+
+	void analyze(PlayerGeneric* player, XModule* module, double startTime, double loadTime)
+	{
+		PlayerGeneric::TSongAnalysis* analysis = new PlayerGeneric::TSongAnalysis;
+
+		if (player->analyzeSong(module, *analysis) != MP_OK || analysis->numSubSongs == 0)
+		{
+			fprintf(stderr, "%s: can't analyze module\n", inFileName);
+			failed = true;
+			delete analysis;
+			return;
+		}
+
+		const double analyzeTime = getTimeInSeconds() - startTime - loadTime;
+
+		// the whole report is printed at once, so the lines of concurrent jobs don't get mixed up
+		char* report = new char[256 + analysis->numSubSongs*80];
+		char* dst = report;
+
+		for (mp_sint32 i = 0; i < analysis->numSubSongs; i++)
+		{
+			const PlayerGeneric::TSubSong& subSong = analysis->subSongs[i];
+			const double length = (double)subSong.numSamples / (double)parameters.sampleRate;
+
+			if (i == 0)
+				dst+=sprintf(dst, "%s: %.2fs", inFileName, length);
+			else
+				dst+=sprintf(dst, "  sub-song %d: orders %d-%d, %.2fs", (int)i, (int)subSong.startOrder, (int)subSong.endOrder, length);
+
+			if (subSong.loopOrder >= 0)
+				dst+=sprintf(dst, ", loops to order %d row %d", (int)subSong.loopOrder, (int)subSong.loopRow);
+
+			if (i == 0)
+				dst+=sprintf(dst, ", %d sub-song%s, analyzed in %.3fs (load %.3fs)",
+							 (int)analysis->numSubSongs, analysis->numSubSongs > 1 ? "s" : "", analyzeTime, loadTime);
+
+			*dst++ = '\n';
+		}
+		*dst = '\0';
+
+		fputs(report, stdout);
+		fflush(stdout);
+
+		delete[] report;
+		delete analysis;
+	}
+
+public:
+	bool failed;
+
+	RenderJob(const RenderParameters& parameters, const char* inFileName, const char* outFileName) :
+		parameters(parameters),
+		inFileName(inFileName),
+		outFileName(NULL),
+		failed(false)
+	{
+		if (outFileName)
+		{
+			this->outFileName = new char[strlen(outFileName)+1];
+			strcpy(this->outFileName, outFileName);
+		}
+	}
+
+	virtual ~RenderJob()
+	{
+		delete[] outFileName;
+	}
+
+	virtual void run()
+	{
+		const double startTime = getTimeInSeconds();
+
+		XModule* module = new XModule();
+		
+		// samples are decoded on first use, so mixing can start right 
+		// after the headers have been read
+		module->setDeferredSampleLoading(true);
+
+		if (module->loadModule(SysString(inFileName)) != MP_OK)
+		{
+			fprintf(stderr, "%s: can't load module\n", inFileName);
+			failed = true;
+			delete module;
+			return;
+		}
+
+		const double loadTime = getTimeInSeconds() - startTime;
+
+		// the analysis only needs the samples which are actually played,
+		// rendering gets the others ready in the background
+		if (!parameters.analyze)
+			module->startSampleDecoding();
+
+		mp_ubyte* muting = new mp_ubyte[module->header.channum];
+		applyMuteMask(parameters.muteMask, muting, module->header.channum);
+
+		PlayerGeneric* player = new PlayerGeneric(parameters.sampleRate);
+
+		player->setBufferSize(parameters.bufferSize);
+		player->setTickSpanMixing(parameters.tickSpans);
+		player->setResamplerType((ChannelMixer::ResamplerTypes)(parameters.resamplerType | (parameters.ramping ? 1 : 0)));
+		player->setSampleShift(parameters.mixerShift);
+		player->setMasterVolume(parameters.mixerVolume);
+		player->setExportWAVFormat(parameters.format);
+
+		if (parameters.analyze)
+		{
+			analyze(player, module, startTime, loadTime);
+
+			delete player;
+			delete[] muting;
+			delete module;
+			return;
+		}
+
+		// start with the tempo, volume and effect state the song has at that order
+		if (parameters.fromOrder > 0)
+			player->createStateSnapshots(module);
+
+		mp_sint32 res;
+		if (parameters.dryRun)
+		{
+			AudioDriver_NULL* audioDriver = new AudioDriver_NULL(AudioDriver_NULL::SampleFormat32Bit);
+			res = player->exportToWAV(NULL, module,
+									  parameters.fromOrder, parameters.toOrder,
+									  muting, module->header.channum,
+									  NULL,
+									  audioDriver,
+									  NULL,
+									  parameters.limiterDrive);
+			delete audioDriver;
+		}
+		else if (parameters.normalize)
+		{
+			char* tempFileName = new char[strlen(outFileName)+5];
+			strcpy(tempFileName, outFileName);
+			strcat(tempFileName, ".tmp");
+
+			res = player->exportToWAVNormalized(SysString(outFileName), SysString(tempFileName), module,
+												parameters.fromOrder, parameters.toOrder,
+												muting, module->header.channum,
+												NULL,
+												parameters.limiterDrive);
+
+			delete[] tempFileName;
+		}
+		else
+		{
+			res = player->exportToWAV(SysString(outFileName), module,
+									  parameters.fromOrder, parameters.toOrder,
+									  muting, module->header.channum,
+									  NULL,
+									  NULL,
+									  NULL,
+									  parameters.limiterDrive);
+		}
+
+		const double renderTime = getTimeInSeconds() - startTime - loadTime;
+
+		delete player;
+		delete[] muting;
+		delete module;
+
+		if (res < 0)
+		{
+			fprintf(stderr, "%s: can't write %s\n", inFileName, outFileName ? outFileName : "output");
+			failed = true;
+			return;
+		}
+
+		const double songLength = (double)res / (double)parameters.sampleRate;
+
+		// a single call, so the lines of concurrent jobs don't get mixed up
+		printf("%s: %.2fs rendered in %.3fs (load %.3fs), %.1fx realtime\n",
+			   inFileName, songLength, renderTime, loadTime,
+			   renderTime > 0.0 ? songLength / renderTime : 0.0);
+		fflush(stdout);
+	}
+};
+
+static void printUsage(const char* name)
+{
+	fprintf(stderr, "Usage: %s [options] module [module...]\n\n", name);
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "  -o, --output FILE       output file (a single module only)\n");
+	fprintf(stderr, "  -d, --output-dir DIR    directory for the WAV files, default is next to the modules\n");
+	fprintf(stderr, "  -r, --rate HZ           sample rate (default 44100)\n");
+	fprintf(stderr, "  -i, --resampler NAME    ");
+	for (mp_uint32 i = 0; i < numResamplers; i++)
+		fprintf(stderr, "%s%s", resamplers[i].name, i < numResamplers-1 ? ", " : "\n");
+	fprintf(stderr, "                          (default lagrange)\n");
+	fprintf(stderr, "      --no-ramping        disable volume ramping\n");
+	fprintf(stderr, "  -b, --buffer FRAMES     mixing buffer size (default 4096)\n");
+	fprintf(stderr, "      --no-tick-spans     mix in 1/250s packets instead of up to the next tick\n");
+	fprintf(stderr, "      --from ORDER        first order position (default 0)\n");
+	fprintf(stderr, "      --to ORDER          last order position (default end of song)\n");
+	fprintf(stderr, "  -m, --mute MASK         channels to mute as hex mask, 0x1 is the first channel\n");
+	fprintf(stderr, "  -l, --limiter DRIVE     limiter drive (default 0 = off)\n");
+	fprintf(stderr, "  -v, --volume VOL        mixer volume 0..256 (default 256)\n");
+	fprintf(stderr, "  -s, --shift SHIFT       mixer shift 0..2 (default 1)\n");
+	fprintf(stderr, "  -f, --format FORMAT     16, 24 or float (default 16)\n");
+	fprintf(stderr, "  -n, --normalize         normalize the output\n");
+	fprintf(stderr, "      --dry-run           render without writing any files\n");
+	fprintf(stderr, "  -a, --analyze           only print length, loop point and sub-songs (nothing is mixed)\n");
+	fprintf(stderr, "  -j, --jobs N            render N modules at once, 0 = one per processor (default 1)\n");
+}
+
+static bool isOption(const char* arg, const char* shortName, const char* longName)
+{
+	return (shortName && strcmp(arg, shortName) == 0) || strcmp(arg, longName) == 0;
+}
+
+static bool parseInt(const char* str, mp_sint32& value)
+{
+	char* end;
+	const long v = strtol(str, &end, 10);
+	if (end == str || *end != '\0')
+		return false;
+	value = (mp_sint32)v;
+	return true;
+}
+
+// input file name with the extension replaced by .wav, optionally in another directory
+static char* makeOutFileName(const char* inFileName, const char* outDir)
+{
+	// the extension is only looked for in the file name, not in the path
+	const char* baseName = inFileName;
+	for (const char* p = inFileName; *p; p++)
+	{
+		if (*p == '/' || *p == '\\')
+			baseName = p + 1;
+	}
+
+	const char* ext = strrchr(baseName, '.');
+	if (ext == baseName)
+		ext = NULL;
+	const size_t baseLen = ext ? (size_t)(ext - baseName) : strlen(baseName);
+	const size_t dirLen = outDir ? strlen(outDir) : (size_t)(baseName - inFileName);
+
+	char* fileName = new char[dirLen + 1 + baseLen + 5];
+	char* dst = fileName;
+	if (outDir)
+	{
+		memcpy(dst, outDir, dirLen);
+		dst+=dirLen;
+		if (dirLen && outDir[dirLen-1] != '/' && outDir[dirLen-1] != '\\')
+			*dst++ = '/';
+	}
+	else
+	{
+		memcpy(dst, inFileName, dirLen);
+		dst+=dirLen;
+	}
+	memcpy(dst, baseName, baseLen);
+	strcpy(dst + baseLen, ".wav");
+	return fileName;
+}
+
+int main(int argc, char* argv[])
+{
+	RenderParameters parameters;
+	const char* outFileName = NULL;
+	const char* outDir = NULL;
+	mp_sint32 numJobs = 1;
+
+	const char** inFileNames = new const char*[argc];
+	mp_sint32 numFiles = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+		mp_sint32 v = 0;
+		bool valid = true;
+
+		if (arg[0] != '-' || arg[1] == '\0')
+		{
+			inFileNames[numFiles++] = arg;
+			continue;
+		}
+
+		if (isOption(arg, "-h", "--help"))
+		{
+			printUsage(argv[0]);
+			delete[] inFileNames;
+			return 0;
+		}
+		else if (isOption(arg, NULL, "--no-ramping"))
+		{
+			parameters.ramping = false;
+			continue;
+		}
+		else if (isOption(arg, NULL, "--no-tick-spans"))
+		{
+			parameters.tickSpans = false;
+			continue;
+		}
+		else if (isOption(arg, "-n", "--normalize"))
+		{
+			parameters.normalize = true;
+			continue;
+		}
+		else if (isOption(arg, NULL, "--dry-run"))
+		{
+			parameters.dryRun = true;
+			continue;
+		}
+		else if (isOption(arg, "-a", "--analyze"))
+		{
+			parameters.analyze = true;
+			continue;
+		}
+
+		// everything else takes a value
+		if (value == NULL)
+		{
+			fprintf(stderr, "%s: missing value\n", arg);
+			delete[] inFileNames;
+			return 1;
+		}
+		i++;
+
+		if (isOption(arg, "-o", "--output"))
+			outFileName = value;
+		else if (isOption(arg, "-d", "--output-dir"))
+			outDir = value;
+		else if (isOption(arg, "-r", "--rate"))
+		{
+			valid = parseInt(value, v) && v >= 8000 && v <= 192000;
+			parameters.sampleRate = v;
+		}
+		else if (isOption(arg, "-b", "--buffer"))
+		{
+			valid = parseInt(value, v) && v >= 256 && v <= 65536;
+			parameters.bufferSize = v;
+		}
+		else if (isOption(arg, "-i", "--resampler"))
+		{
+			valid = false;
+			for (mp_uint32 j = 0; j < numResamplers; j++)
+			{
+				if (strcmp(value, resamplers[j].name) == 0)
+				{
+					parameters.resamplerType = resamplers[j].type;
+					valid = true;
+				}
+			}
+		}
+		else if (isOption(arg, NULL, "--from"))
+			valid = parseInt(value, parameters.fromOrder) && parameters.fromOrder >= 0;
+		else if (isOption(arg, NULL, "--to"))
+			valid = parseInt(value, parameters.toOrder) && parameters.toOrder >= 0;
+		else if (isOption(arg, "-m", "--mute"))
+		{
+			valid = isValidMuteMask(value);
+			parameters.muteMask = value;
+		}
+		else if (isOption(arg, "-l", "--limiter"))
+		{
+			valid = parseInt(value, v) && v >= 0;
+			parameters.limiterDrive = v;
+		}
+		else if (isOption(arg, "-v", "--volume"))
+			valid = parseInt(value, parameters.mixerVolume) && parameters.mixerVolume >= 0 && parameters.mixerVolume <= 256;
+		else if (isOption(arg, "-s", "--shift"))
+			valid = parseInt(value, parameters.mixerShift) && parameters.mixerShift >= 0 && parameters.mixerShift <= 2;
+		else if (isOption(arg, "-f", "--format"))
+		{
+			if (strcmp(value, "16") == 0)
+				parameters.format = WAVWriter::WAVFormat16Bit;
+			else if (strcmp(value, "24") == 0)
+				parameters.format = WAVWriter::WAVFormat24Bit;
+			else if (strcmp(value, "float") == 0)
+				parameters.format = WAVWriter::WAVFormatFloat;
+			else
+				valid = false;
+		}
+		else if (isOption(arg, "-j", "--jobs"))
+			valid = parseInt(value, numJobs) && numJobs >= 0;
+		else
+		{
+			fprintf(stderr, "%s: unknown option\n", arg);
+			delete[] inFileNames;
+			return 1;
+		}
+
+		if (!valid)
+		{
+			fprintf(stderr, "%s: invalid value %s\n", arg, value);
+			delete[] inFileNames;
+			return 1;
+		}
+	}
+
+	if (numFiles == 0)
+	{
+		printUsage(argv[0]);
+		delete[] inFileNames;
+		return 1;
+	}
+
+	if (outFileName && numFiles > 1)
+	{
+		fprintf(stderr, "--output only works with a single module, use --output-dir\n");
+		delete[] inFileNames;
+		return 1;
+	}
+
+	// some resamplers build their shared lookup tables on first use,
+	// make sure this happens before the workers start
+	delete ResamplerFactory::createResampler(parameters.resamplerType);
+
+	RenderJob** jobs = new RenderJob*[numFiles];
+	for (mp_sint32 i = 0; i < numFiles; i++)
+	{
+		char* fileName = outFileName || parameters.dryRun || parameters.analyze ? NULL : makeOutFileName(inFileNames[i], outDir);
+		jobs[i] = new RenderJob(parameters, inFileNames[i], outFileName ? outFileName : fileName);
+		delete[] fileName;
+	}
+
+	const double startTime = getTimeInSeconds();
+
+	ThreadPool* threadPool = new ThreadPool(numJobs);
+	for (mp_sint32 i = 0; i < numFiles; i++)
+		threadPool->addJob(jobs[i]);
+	threadPool->waitForAll();
+	delete threadPool;
+
+	const double totalTime = getTimeInSeconds() - startTime;
+
+	mp_sint32 numFailed = 0;
+	for (mp_sint32 i = 0; i < numFiles; i++)
+	{
+		if (jobs[i]->failed)
+			numFailed++;
+		delete jobs[i];
+	}
+	delete[] jobs;
+	delete[] inFileNames;
+
+	if (numFiles > 1)
+	{
+		// a dry run mixes everything but doesn't write a thing
+		const char* done = parameters.analyze ? "analyzed" : (parameters.dryRun ? "checked" : "rendered");
+		printf("%d of %d modules %s in %.3fs\n", numFiles - numFailed, numFiles, done, totalTime);
+	}
+
+	return numFailed ? 1 : 0;
+}
@@ -1579,6 +1579,8 @@ void PPFont::createLargeFromSystem(pp_uint32 index)
 }
 
 PPFont::PPFont(pp_uint8* bits, const pp_uint32 chrWidth, const pp_uint32 chrHeight, pp_uint32 fontId) :
+	glyphSpans(NULL),
+	glyphRows(NULL),
 	charWidth(chrWidth), charHeight(chrHeight), charDim(chrHeight*chrWidth)
 {
 	fontBits = bits;
@@ -1587,14 +1589,63 @@ PPFont::PPFont(pp_uint8* bits, const pp_uint32 chrWidth, const pp_uint32 chrHeig
 
 	this->fontId = fontId;
 
+	updateGlyphSpans();
+
 	fontInstances[numFontInstances++] = this;
 }
 
 PPFont::~PPFont()
 {
+	delete[] glyphSpans;
+	delete[] glyphRows;
 	delete bitstream;
 }
 
+void PPFont::updateGlyphSpans()
+{
+	const pp_uint32 numRows = 256*charHeight;
+	
+	delete[] glyphRows;
+	glyphRows = new pp_uint32[numRows+1];
+	
+	// count the spans first
+	pp_uint32 numSpans = 0;
+	pp_uint32 chr, y, x;
+	for (chr = 0; chr < 256; chr++)
+		for (y = 0; y < charHeight; y++)
+			for (x = 0; x < charWidth; x++)
+				if (getPixelBit(chr, x, y) && (x == 0 || !getPixelBit(chr, x-1, y)))
+					numSpans++;
+
+	delete[] glyphSpans;
+	glyphSpans = new GlyphSpan[numSpans ? numSpans : 1];
+	
+	GlyphSpan* span = glyphSpans;
+	pp_uint32* row = glyphRows;
+	for (chr = 0; chr < 256; chr++)
+		for (y = 0; y < charHeight; y++)
+		{
+			*row++ = (pp_uint32)(span - glyphSpans);
+			
+			x = 0;
+			while (x < charWidth)
+			{
+				if (!getPixelBit(chr, x, y))
+				{
+					x++;
+					continue;
+				}
+				
+				span->x = (pp_uint8)x;
+				while (x < charWidth && getPixelBit(chr, x, y))
+					x++;
+				span->width = (pp_uint8)(x - span->x);
+				span++;
+			}
+		}
+	*row = numSpans;
+}
+
 PPFont* PPFont::getFont(pp_uint32 fontId)
 {
 	pp_uint32 i;
@@ -1770,6 +1821,8 @@ void PPFont::selectFontFace(FontID fontID, const char* faceName)
 				fontInstances[j]->fontBits = (pp_uint8*)fontEntries[i].data;
 				fontInstances[j]->bitstream->setSource(fontInstances[j]->fontBits, fontEntries[i].width*fontEntries[i].height / 8);
 			}
+			
+			fontInstances[j]->updateGlyphSpans();
 		}
 }
 
@@ -76,6 +76,13 @@ public:
 		FONT_LAST
 	};
 
+	// run of set pixels [x, x+width) in a row of a glyph
+	struct GlyphSpan
+	{
+		pp_uint8 x;
+		pp_uint8 width;
+	};
+
 private:
 	static PPFont* fontInstances[MAXFONTS];
 	static pp_uint32 numFontInstances;
@@ -114,6 +121,13 @@ private:
 	
 	static void createLargeFromSystem(pp_uint32 index);
 
+	// the glyphs as runs of set pixels, so text can be drawn without
+	// looking at every single bit (rebuilt when the font bits change)
+	GlyphSpan* glyphSpans;
+	pp_uint32* glyphRows;
+	
+	void updateGlyphSpans();
+
 public:
 
 	pp_uint8* fontBits;
@@ -133,6 +147,11 @@ public:
 
 	bool getPixelBit(pp_uint8 chr, pp_uint32 x, pp_uint32 y) const { return bitstream->read(chr*charDim+y*charWidth+x); }
 
+	// the spans of row y of chr are getGlyphSpans()[rows[y]] up to
+	// getGlyphSpans()[rows[y+1]] with rows = getGlyphRows(chr)
+	const GlyphSpan* getGlyphSpans() const { return glyphSpans; }
+	const pp_uint32* getGlyphRows(pp_uint8 chr) const { return glyphRows + chr*charHeight; }
+
 	pp_uint32 getStrWidth(const char* str) const;
 	
 	enum ShrinkTypes
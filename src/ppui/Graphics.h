@@ -29,6 +29,7 @@
 #define __GRAPHICS_H__
 
 #include "GraphicsAbstract.h"
+#include "Font.h"
 
 class PPGraphicsFrameBuffer : public PPGraphicsAbstract
 {
@@ -36,6 +37,96 @@ protected:
 	pp_int32 pitch;
 	pp_uint8* buffer;
 
+	// Text is drawn from the glyph spans of the current font, SpanFiller
+	// provides the pixel format: bytesPerPixel and fill(dst, len) which sets
+	// len pixels starting at dst to the text color
+	template<class SpanFiller>
+	void drawGlyph(pp_uint8 chr, pp_int32 x, pp_int32 y, const SpanFiller& filler)
+	{
+		const pp_int32 bpp = SpanFiller::bytesPerPixel;
+		const pp_int32 charWidth = (signed)currentFont->charWidth;
+		const pp_int32 charHeight = (signed)currentFont->charHeight;
+	
+		// part of the glyph inside the clipping rect
+		pp_int32 cx1 = currentClipRect.x1 - x;
+		pp_int32 cx2 = currentClipRect.x2 - x;
+		pp_int32 cy1 = currentClipRect.y1 - y;
+		pp_int32 cy2 = currentClipRect.y2 - y;
+		if (cx1 < 0) cx1 = 0;
+		if (cy1 < 0) cy1 = 0;
+		if (cx2 > charWidth) cx2 = charWidth;
+		if (cy2 > charHeight) cy2 = charHeight;
+		
+		if (cx1 >= cx2 || cy1 >= cy2)
+			return;
+			
+		const PPFont::GlyphSpan* spans = currentFont->getGlyphSpans();
+		const pp_uint32* rows = currentFont->getGlyphRows(chr);
+		
+		if (cx1 == 0 && cx2 == charWidth)
+		{
+			pp_uint8* buff = buffer + (y+cy1)*pitch + x*bpp;
+			for (pp_int32 i = cy1; i < cy2; i++)
+			{
+				for (pp_uint32 s = rows[i]; s < rows[i+1]; s++)
+					filler.fill(buff + spans[s].x*bpp, spans[s].width);
+				buff+=pitch;
+			}
+		}
+		else
+		{
+			for (pp_int32 i = cy1; i < cy2; i++)
+			{
+				pp_uint8* buff = buffer + (y+i)*pitch;
+				for (pp_uint32 s = rows[i]; s < rows[i+1]; s++)
+				{
+					pp_int32 sx1 = spans[s].x;
+					pp_int32 sx2 = sx1 + spans[s].width;
+					if (sx1 < cx1) sx1 = cx1;
+					if (sx2 > cx2) sx2 = cx2;
+					if (sx1 < sx2)
+						filler.fill(buff + (x+sx1)*bpp, sx2-sx1);
+				}
+			}
+		}
+	}
+	
+	template<class SpanFiller>
+	void drawGlyphs(const char* str, pp_int32 x, pp_int32 y, bool underlined, bool vertical, const SpanFiller& filler)
+	{
+		const pp_int32 charWidth = (signed)currentFont->charWidth;
+		const pp_int32 charHeight = (signed)currentFont->charHeight;
+
+		pp_int32 sx = x;
+
+		while (*str) 
+		{
+			switch (*str)
+			{
+				case '\xf4':
+					setPixel(x+(charWidth>>1), y+(charHeight>>1));
+					break;
+				case '\n':
+					if (!vertical)
+					{
+						y+=charHeight;
+						x=sx-charWidth;
+						break;
+					}
+					// fall through
+				default:
+					drawGlyph(*str, x, y, filler);
+					if (underlined)
+						drawHLine(x, x+charWidth, y+charHeight);
+			}
+			if (vertical)
+				y += charHeight;
+			else
+				x += charWidth;
+			str++;
+		}
+	}
+
 public:
 	PPGraphicsFrameBuffer(pp_int32 w, pp_int32 h, pp_int32 p, void* buff) :
 		PPGraphicsAbstract(w, h),
@@ -246,123 +246,15 @@ void PPGraphics_15BIT::blit(const pp_uint8* src, const PPPoint& p, const PPSize&
 
 void PPGraphics_15BIT::drawChar(pp_uint8 chr, pp_int32 x, pp_int32 y, bool underlined)
 {
-
 	if (currentFont == NULL)
 		return;
 
+	const SpanFillWord filler(_16TO15BIT(color16));
 
-	pp_int32 charWidth = (signed)currentFont->getCharWidth();
-	pp_int32 charHeight = (signed)currentFont->getCharHeight(); 
-	pp_int32 charDim = currentFont->charDim;
-
-	if (x + (signed)charWidth < currentClipRect.x1 ||
-		x > currentClipRect.x2 ||
-		y + (signed)charHeight < currentClipRect.y1 ||
-		y > currentClipRect.y2)
-		return;
-	
-	/*pp_uint8 r = (pp_uint8)currentColor.r;
-	pp_uint8 g = (pp_uint8)currentColor.g;
-	pp_uint8 b = (pp_uint8)currentColor.b;
-
-	if (x>= currentClipRect.x1 && x + (signed)currentFont->charWidth < currentClipRect.x2 &&
-		y>= currentClipRect.y1 && y + (signed)currentFont->charHeight < currentClipRect.y2)
-	{
-		for (pp_uint32 i = 0; i < currentFont->charHeight; i++)
-		{
-			pp_uint8* buff = (pp_uint8*)buffer + (y+i)*pitch + x*3;
-			for (pp_uint32 j = 0; j < currentFont->charWidth; j++)
-			{
-				
-				if (currentFont->getPixelBit(chr, j,i))
-				{
-					buff[0] = b;
-					buff[1] = g;
-					buff[2] = r;					
-				}
-				buff+=3;
-			}
-		}
-	}
-	else
-	{
-		for (pp_uint32 i = 0; i < currentFont->charHeight; i++)
-			for (pp_uint32 j = 0; j < currentFont->charWidth; j++)
-			{
-				
-				if (y+(signed)i >= currentClipRect.y1 && y+(signed)i < currentClipRect.y2 &&
-					x+(signed)j >= currentClipRect.x1 && x+(signed)j < currentClipRect.x2 &&
-					currentFont->getPixelBit(chr, j,i))
-				{
-					
-					pp_uint8* buff = (pp_uint8*)buffer+((y+i)*pitch+(x+j)*3);
-					
-					buff[0] = b;
-					buff[1] = g;
-					buff[2] = r;
-					
-				}
-			}
-
-	}*/
-	Bitstream* bitstream = currentFont->bitstream;
-	pp_uint8* fontbuffer = bitstream->buffer;
-
-	pp_uint16* buff = (pp_uint16*)buffer+(pitch>>1)*y+x;	
-	
-	const pp_uint32 cchrDim = chr*charDim;
-	const pp_uint32 incr = (pitch>>1)-(charWidth);
-
-	if (x>= currentClipRect.x1 && x + charWidth < currentClipRect.x2 &&
-		y>= currentClipRect.y1 && y + charHeight < currentClipRect.y2)
-	{
-		
-		pp_uint32 yChr = cchrDim;
-		for (pp_uint32 i = 0; i < (unsigned)charHeight; i++)
-		{
-			pp_uint32 xChr = yChr;
-			for (pp_uint32 j = 0; j < (unsigned)charWidth; j++)
-			{
-				if ((fontbuffer[xChr>>3]>>(xChr&7)&1))
-				{
-					*buff = _16TO15BIT(color16);
-				}
-				buff++;
-				xChr++;
-			}
-			
-			buff+=incr;
-			yChr+=charWidth;
-		}
-	}
-	else
-	{
-		pp_uint32 yChr = cchrDim;
-		for (pp_uint32 i = 0; i < (unsigned)charHeight; i++)
-		{
-			pp_uint32 xChr = yChr;
-			for (pp_uint32 j = 0; j < (unsigned)charWidth; j++)
-			{
-				
-				if (y+(signed)i >= currentClipRect.y1 && y+(signed)i < currentClipRect.y2 &&
-					x+(signed)j >= currentClipRect.x1 && x+(signed)j < currentClipRect.x2 &&
-					(fontbuffer[xChr>>3]>>(xChr&7)&1))
-				{
-					
-					pp_uint16* buff = (pp_uint16*)buffer+(pitch>>1)*(y+i)+(x+j);	
-					*buff = _16TO15BIT(color16);
-				}
-				xChr++;
-
-			}
-			yChr+=charWidth;
-		}
-
-	}
+	drawGlyph(chr, x, y, filler);
 
 	if (underlined)
-		drawHLine(x, x+charWidth, y+charHeight);
-
+		drawHLine(x, x+currentFont->getCharWidth(), y+currentFont->getCharHeight());
 }
 
 void PPGraphics_15BIT::drawString(const char* str, pp_int32 x, pp_int32 y, bool underlined/* = false*/)
@@ -370,28 +262,9 @@ void PPGraphics_15BIT::drawString(const char* str, pp_int32 x, pp_int32 y, bool
 	if (currentFont == NULL)
 		return;
 
-	pp_int32 charWidth = (signed)currentFont->getCharWidth();
-	pp_int32 charHeight = (signed)currentFont->getCharHeight();
-
-	pp_int32 sx = x;
+	const SpanFillWord filler(_16TO15BIT(color16));
 
-    while (*str) 
-	{
-		switch (*str)
-		{
-			case '\xf4':
-				setPixel(x+(charWidth>>1), y+(charHeight>>1));
-				break;
-			case '\n':
-				y+=charHeight;
-				x=sx-charWidth;
-				break;
-			default:
-				drawChar(*str, x, y, underlined);
-		}
-        x += charWidth;
-        str++;
-    }
+	drawGlyphs(str, x, y, underlined, false, filler);
 }
 
 void PPGraphics_15BIT::drawStringVertical(const char* str, pp_int32 x, pp_int32 y, bool underlined/* = false*/)
@@ -399,20 +272,7 @@ void PPGraphics_15BIT::drawStringVertical(const char* str, pp_int32 x, pp_int32
 	if (currentFont == NULL)
 		return;
 
-	pp_int32 charWidth = (signed)currentFont->getCharWidth();
-	pp_int32 charHeight = (signed)currentFont->getCharHeight();
+	const SpanFillWord filler(_16TO15BIT(color16));
 
-    while (*str) 
-	{
-		switch (*str)
-		{
-			case '\xf4':
-				setPixel(x+(charWidth>>1), y+(charHeight>>1));
-				break;
-			default:
-				drawChar(*str, x, y, underlined);
-		}
-        y += charHeight;
-        str++;
-    }
+	drawGlyphs(str, x, y, underlined, true, filler);
 }
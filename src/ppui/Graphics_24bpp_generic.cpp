@@ -33,6 +33,8 @@
 
 #define BPP 3
 
+#include "fastfill.h"
+
 PPGraphics_24bpp_generic::PPGraphics_24bpp_generic(pp_int32 w, pp_int32 h, pp_int32 p, void* buff) :
 	PPGraphicsFrameBuffer(w, h, p, buff),
 	bitPosR(0), bitPosG(8), bitPosB(16)	
@@ -306,98 +308,24 @@ void PPGraphics_24bpp_generic::blit(const pp_uint8* src, const PPPoint& p, const
 	}
 }
 
-
 void PPGraphics_24bpp_generic::drawChar(pp_uint8 chr, pp_int32 x, pp_int32 y, bool underlined)
 {
-
 	if (currentFont == NULL)
 		return;
 
-
-	pp_int32 charWidth = (signed)currentFont->getCharWidth();
-	pp_int32 charHeight = (signed)currentFont->getCharHeight(); 
-	pp_int32 charDim = currentFont->charDim;
-
-	if (x + (signed)charWidth < currentClipRect.x1 ||
-		x > currentClipRect.x2 ||
-		y + (signed)charHeight < currentClipRect.y1 ||
-		y > currentClipRect.y2)
-		return;
-	
 	const pp_uint32 rgb = (currentColor.r << bitPosR) + 
 		(currentColor.g << bitPosG) +
 		(currentColor.b << bitPosB);
-
-	Bitstream* bitstream = currentFont->bitstream;
-	pp_uint8* fontbuffer = bitstream->buffer;
-
-	pp_uint8* buff = (pp_uint8*)buffer + y*pitch + x*BPP;
-	pp_uint32 cchrDim = chr*charDim;
-
-	if (x>= currentClipRect.x1 && x + charWidth < currentClipRect.x2 &&
-		y>= currentClipRect.y1 && y + charHeight < currentClipRect.y2)
-	{
-		
-		pp_uint32 yChr = cchrDim;
-		for (pp_uint32 i = 0; i < (unsigned)charHeight; i++)
-		{
-			pp_uint32 xChr = yChr;
-			for (pp_uint32 j = 0; j < (unsigned)charWidth; j++)
-			{
-				if ((fontbuffer[xChr>>3]>>(xChr&7)&1))
-				{
-#ifndef __ppc__
-					buff[0] = rgb & 255;
-					buff[1] = (rgb >> 8) & 255;
-					buff[2] = (rgb >> 16) & 255;		
-#else
-					buff[0] = (rgb >> 16) & 255;
-					buff[1] = (rgb >> 8) & 255;
-					buff[2] = rgb & 255;		
-#endif		
-				}
-				buff+=BPP;
-				xChr++;
-			}
-			buff+=pitch-(charWidth*BPP);
-			yChr+=charWidth;
-		}
-	}
-	else
-	{
-		pp_uint32 yChr = cchrDim;
-		for (pp_uint32 i = 0; i < (unsigned)charHeight; i++)
-		{
-			pp_uint32 xChr = yChr;
-			for (pp_uint32 j = 0; j < (unsigned)charWidth; j++)
-			{
-				
-				if (y+(signed)i >= currentClipRect.y1 && y+(signed)i < currentClipRect.y2 &&
-					x+(signed)j >= currentClipRect.x1 && x+(signed)j < currentClipRect.x2 &&
-					(fontbuffer[xChr>>3]>>(xChr&7)&1))
-				{					
-					pp_uint8* buff = (pp_uint8*)buffer+((y+i)*pitch+(x+j)*BPP);
 #ifndef __ppc__
-					buff[0] = rgb & 255;
-					buff[1] = (rgb >> 8) & 255;
-					buff[2] = (rgb >> 16) & 255;		
+	const SpanFillBytes3 filler(rgb & 255, (rgb >> 8) & 255, (rgb >> 16) & 255);
 #else
-					buff[0] = (rgb >> 16) & 255;
-					buff[1] = (rgb >> 8) & 255;
-					buff[2] = rgb & 255;		
-#endif		
-				}
-				xChr++;
-
-			}
-			yChr+=charWidth;
-		}
+	const SpanFillBytes3 filler((rgb >> 16) & 255, (rgb >> 8) & 255, rgb & 255);
+#endif
 
-	}
+	drawGlyph(chr, x, y, filler);
 
 	if (underlined)
-		drawHLine(x, x+charWidth, y+charHeight);
-
+		drawHLine(x, x+currentFont->getCharWidth(), y+currentFont->getCharHeight());
 }
 
 void PPGraphics_24bpp_generic::drawString(const char* str, pp_int32 x, pp_int32 y, bool underlined/* = false*/)
@@ -405,28 +333,16 @@ void PPGraphics_24bpp_generic::drawString(const char* str, pp_int32 x, pp_int32
 	if (currentFont == NULL)
 		return;
 
-	pp_int32 charWidth = (signed)currentFont->getCharWidth();
-	pp_int32 charHeight = (signed)currentFont->getCharHeight();
-
-	pp_int32 sx = x;
+	const pp_uint32 rgb = (currentColor.r << bitPosR) + 
+		(currentColor.g << bitPosG) +
+		(currentColor.b << bitPosB);
+#ifndef __ppc__
+	const SpanFillBytes3 filler(rgb & 255, (rgb >> 8) & 255, (rgb >> 16) & 255);
+#else
+	const SpanFillBytes3 filler((rgb >> 16) & 255, (rgb >> 8) & 255, rgb & 255);
+#endif
 
-    while (*str) 
-	{
-		switch (*str)
-		{
-			case '\xf4':
-				setPixel(x+(charWidth>>1), y+(charHeight>>1));
-				break;
-			case '\n':
-				y+=charHeight;
-				x=sx-charWidth;
-				break;
-			default:
-				drawChar(*str, x, y, underlined);
-		}
-        x += charWidth;
-        str++;
-    }
+	drawGlyphs(str, x, y, underlined, false, filler);
 }
 
 void PPGraphics_24bpp_generic::drawStringVertical(const char* str, pp_int32 x, pp_int32 y, bool underlined/* = false*/)
@@ -434,20 +350,14 @@ void PPGraphics_24bpp_generic::drawStringVertical(const char* str, pp_int32 x, p
 	if (currentFont == NULL)
 		return;
 
-	pp_int32 charWidth = (signed)currentFont->getCharWidth();
-	pp_int32 charHeight = (signed)currentFont->getCharHeight();
+	const pp_uint32 rgb = (currentColor.r << bitPosR) + 
+		(currentColor.g << bitPosG) +
+		(currentColor.b << bitPosB);
+#ifndef __ppc__
+	const SpanFillBytes3 filler(rgb & 255, (rgb >> 8) & 255, (rgb >> 16) & 255);
+#else
+	const SpanFillBytes3 filler((rgb >> 16) & 255, (rgb >> 8) & 255, rgb & 255);
+#endif
 
-    while (*str) 
-	{
-		switch (*str)
-		{
-			case '\xf4':
-				setPixel(x+(charWidth>>1), y+(charHeight>>1));
-				break;
-			default:
-				drawChar(*str, x, y, underlined);
-		}
-        y += charHeight;
-        str++;
-    }
+	drawGlyphs(str, x, y, underlined, true, filler);
 }
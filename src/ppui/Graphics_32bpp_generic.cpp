@@ -249,83 +249,19 @@ void PPGraphics_32bpp_generic::blit(const pp_uint8* src, const PPPoint& p, const
 	}
 }
 
-
 void PPGraphics_32bpp_generic::drawChar(pp_uint8 chr, pp_int32 x, pp_int32 y, bool underlined/* = false*/)
 {
-
 	if (currentFont == NULL)
 		return;
 
-	pp_int32 charWidth = (signed)currentFont->getCharWidth();
-	pp_int32 charHeight = (signed)currentFont->getCharHeight(); 
-
-	if (x + (signed)charWidth < currentClipRect.x1 ||
-		x > currentClipRect.x2 ||
-		y + (signed)charHeight < currentClipRect.y1 ||
-		y > currentClipRect.y2)
-		return;
-
-	pp_int32 charDim = currentFont->charDim;
-
-	Bitstream* bitstream = currentFont->bitstream;
-	pp_uint8* fontbuffer = bitstream->buffer;
-
-	pp_uint32 rgb1 = (currentColor.r << bitPosR) + 
+	const SpanFillDword filler((currentColor.r << bitPosR) + 
 		(currentColor.g << bitPosG) +
-		(currentColor.b << bitPosB);
+		(currentColor.b << bitPosB));
 
-	pp_uint32 cchrDim = chr*charDim;
-
-	if (x>= currentClipRect.x1 && x + charWidth < currentClipRect.x2 &&
-		y>= currentClipRect.y1 && y + charHeight < currentClipRect.y2)
-	{
-		pp_uint8* buff = (pp_uint8*)buffer + y*pitch + x*BPP;
-		
-		pp_uint32 yChr = cchrDim;
-		for (pp_uint32 i = 0; i < charHeight; i++)
-		{
-			pp_uint32 xChr = yChr;
-			for (pp_uint32 j = 0; j < charWidth; j++)
-			{
-				if ((fontbuffer[xChr>>3]>>(xChr&7)&1))
-				{
-					*reinterpret_cast<pp_uint32*>(buff) = rgb1;
-				}
-				buff+=BPP;
-				xChr++;
-			}
-			buff+=pitch-(charWidth*BPP);
-			yChr+=charWidth;
-		}
-	}
-	else
-	{
-		pp_uint32 yChr = cchrDim;
-		for (pp_int32 i = 0; i < charHeight; i++)
-		{
-			pp_uint32 xChr = yChr;
-			for (pp_int32 j = 0; j < charWidth; j++)
-			{
-				
-				if (y+(signed)i >= currentClipRect.y1 && y+(signed)i < currentClipRect.y2 &&
-					x+(signed)j >= currentClipRect.x1 && x+(signed)j < currentClipRect.x2 &&
-					(fontbuffer[xChr>>3]>>(xChr&7)&1))
-				{
-					
-					pp_uint8* buff = (pp_uint8*)buffer+((y+i)*pitch+(x+j)*BPP);
-					
-					*reinterpret_cast<pp_uint32*>(buff) = rgb1;					
-				}
-				xChr++;
-
-			}
-			yChr+=charWidth;
-		}
-
-	}
+	drawGlyph(chr, x, y, filler);
 
 	if (underlined)
-		drawHLine(x, x+charWidth, y+charHeight);
+		drawHLine(x, x+currentFont->getCharWidth(), y+currentFont->getCharHeight());
 }
 
 void PPGraphics_32bpp_generic::drawString(const char* str, pp_int32 x, pp_int32 y, bool underlined/* = false*/)
@@ -333,28 +269,11 @@ void PPGraphics_32bpp_generic::drawString(const char* str, pp_int32 x, pp_int32
 	if (currentFont == NULL)
 		return;
 
-	pp_int32 charWidth = (signed)currentFont->getCharWidth();
-	pp_int32 charHeight = (signed)currentFont->getCharHeight();
-
-	pp_int32 sx = x;
+	const SpanFillDword filler((currentColor.r << bitPosR) + 
+		(currentColor.g << bitPosG) +
+		(currentColor.b << bitPosB));
 
-    while (*str) 
-	{
-		switch (*str)
-		{
-			case '\xf4':
-				setPixel(x+(charWidth>>1), y+(charHeight>>1));
-				break;
-			case '\n':
-				y+=charHeight;
-				x=sx-charWidth;
-				break;
-			default:
-				drawChar(*str, x, y, underlined);
-		}
-        x += charWidth;
-        str++;
-    }
+	drawGlyphs(str, x, y, underlined, false, filler);
 }
 
 void PPGraphics_32bpp_generic::drawStringVertical(const char* str, pp_int32 x, pp_int32 y, bool underlined/* = false*/)
@@ -362,21 +281,9 @@ void PPGraphics_32bpp_generic::drawStringVertical(const char* str, pp_int32 x, p
 	if (currentFont == NULL)
 		return;
 
-	pp_int32 charWidth = (signed)currentFont->getCharWidth();
-	pp_int32 charHeight = (signed)currentFont->getCharHeight();
+	const SpanFillDword filler((currentColor.r << bitPosR) + 
+		(currentColor.g << bitPosG) +
+		(currentColor.b << bitPosB));
 
-    while (*str) 
-	{
-		switch (*str)
-		{
-			case '\xf4':
-				setPixel(x+(charWidth>>1), y+(charHeight>>1));
-				break;
-			default:
-				drawChar(*str, x, y, underlined);
-		}
-        y += charHeight;
-        str++;
-    }
+	drawGlyphs(str, x, y, underlined, true, filler);
 }
-
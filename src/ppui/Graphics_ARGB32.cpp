@@ -262,93 +262,30 @@ void PPGraphics_ARGB32::blit(const pp_uint8* src, const PPPoint& p, const PPSize
 	}
 }
 
-
-void PPGraphics_ARGB32::drawChar(pp_uint8 chr, pp_int32 x, pp_int32 y, bool underlined/* = false*/)
+static inline pp_uint32 getARGB32(const PPColor& color)
 {
-
-	if (currentFont == NULL)
-		return;
-
-	const pp_int32 charWidth = (signed)currentFont->getCharWidth();
-	const pp_int32 charHeight = (signed)currentFont->getCharHeight(); 
-
-	if (x + (signed)charWidth < currentClipRect.x1 ||
-		x > currentClipRect.x2 ||
-		y + (signed)charHeight < currentClipRect.y1 ||
-		y > currentClipRect.y2)
-		return;
-
-	const pp_int32 charDim = currentFont->charDim;
-
-	pp_uint8 r = (pp_uint8)currentColor.r;
-	pp_uint8 g = (pp_uint8)currentColor.g;
-	pp_uint8 b = (pp_uint8)currentColor.b;
-
-	Bitstream* bitstream = currentFont->bitstream;
-	pp_uint8* fontbuffer = bitstream->buffer;
-
 #ifdef __ppc__
-	pp_uint32 rgb1 = (((pp_uint32)r) << 16) +
-					 (((pp_uint32)g) << 8) +
-					 (((pp_uint32)b));
+	return (((pp_uint32)color.r) << 16) +
+		   (((pp_uint32)color.g) << 8) +
+		   (((pp_uint32)color.b));
 #else
-	pp_uint32 rgb1 = (((pp_uint32)b) << 24) +
-					 (((pp_uint32)g) << 16) +
-					 (((pp_uint32)r) << 8);	
+	return (((pp_uint32)color.b) << 24) +
+		   (((pp_uint32)color.g) << 16) +
+		   (((pp_uint32)color.r) << 8);	
 #endif
+}
 
-	const pp_uint32 cchrDim = chr*charDim;
-
-	if (x>= currentClipRect.x1 && x + charWidth < currentClipRect.x2 &&
-		y>= currentClipRect.y1 && y + charHeight < currentClipRect.y2)
-	{
-		pp_uint8* buff = (pp_uint8*)buffer + y*pitch + x*BPP;
-		
-		pp_uint32 yChr = cchrDim;
-		for (pp_uint32 i = 0; i < (unsigned)charHeight; i++)
-		{
-			pp_uint32 xChr = yChr;
-			for (pp_uint32 j = 0; j < (unsigned)charWidth; j++)
-			{
-				if ((fontbuffer[xChr>>3]>>(xChr&7)&1))
-				{
-					*reinterpret_cast<pp_uint32*>(buff) = rgb1;
-				}
-				buff+=BPP;
-				xChr++;
-			}
-			buff+=pitch-(charWidth*BPP);
-			yChr+=charWidth;
-		}
-	}
-	else
-	{
-		pp_uint32 yChr = cchrDim;
-		for (pp_int32 i = 0; i < charHeight; i++)
-		{
-			pp_uint32 xChr = yChr;
-			for (pp_int32 j = 0; j < charWidth; j++)
-			{
-				
-				if (y+(signed)i >= currentClipRect.y1 && y+(signed)i < currentClipRect.y2 &&
-					x+(signed)j >= currentClipRect.x1 && x+(signed)j < currentClipRect.x2 &&
-					(fontbuffer[xChr>>3]>>(xChr&7)&1))
-				{
-					
-					pp_uint8* buff = (pp_uint8*)buffer+((y+i)*pitch+(x+j)*BPP);
-					
-					*reinterpret_cast<pp_uint32*>(buff) = rgb1;					
-				}
-				xChr++;
+void PPGraphics_ARGB32::drawChar(pp_uint8 chr, pp_int32 x, pp_int32 y, bool underlined/* = false*/)
+{
+	if (currentFont == NULL)
+		return;
 
-			}
-			yChr+=charWidth;
-		}
+	const SpanFillDword filler(getARGB32(currentColor));
 
-	}
+	drawGlyph(chr, x, y, filler);
 
 	if (underlined)
-		drawHLine(x, x+charWidth, y+charHeight);
+		drawHLine(x, x+currentFont->getCharWidth(), y+currentFont->getCharHeight());
 }
 
 void PPGraphics_ARGB32::drawString(const char* str, pp_int32 x, pp_int32 y, bool underlined/* = false*/)
@@ -356,28 +293,9 @@ void PPGraphics_ARGB32::drawString(const char* str, pp_int32 x, pp_int32 y, bool
 	if (currentFont == NULL)
 		return;
 
-	const pp_int32 charWidth = (signed)currentFont->getCharWidth();
-	const pp_int32 charHeight = (signed)currentFont->getCharHeight();
-
-	pp_int32 sx = x;
+	const SpanFillDword filler(getARGB32(currentColor));
 
-    while (*str) 
-	{
-		switch (*str)
-		{
-			case '\xf4':
-				setPixel(x+(charWidth>>1), y+(charHeight>>1));
-				break;
-			case '\n':
-				y+=charHeight;
-				x=sx-charWidth;
-				break;
-			default:
-				drawChar(*str, x, y, underlined);
-		}
-        x += charWidth;
-        str++;
-    }
+	drawGlyphs(str, x, y, underlined, false, filler);
 }
 
 void PPGraphics_ARGB32::drawStringVertical(const char* str, pp_int32 x, pp_int32 y, bool underlined/* = false*/)
@@ -385,21 +303,7 @@ void PPGraphics_ARGB32::drawStringVertical(const char* str, pp_int32 x, pp_int32
 	if (currentFont == NULL)
 		return;
 
-	const pp_int32 charWidth = (signed)currentFont->getCharWidth();
-	const pp_int32 charHeight = (signed)currentFont->getCharHeight();
+	const SpanFillDword filler(getARGB32(currentColor));
 
-    while (*str) 
-	{
-		switch (*str)
-		{
-			case '\xf4':
-				setPixel(x+(charWidth>>1), y+(charHeight>>1));
-				break;
-			default:
-				drawChar(*str, x, y, underlined);
-		}
-        y += charHeight;
-        str++;
-    }
+	drawGlyphs(str, x, y, underlined, true, filler);
 }
-
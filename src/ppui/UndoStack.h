@@ -205,6 +205,41 @@ public:
 		return m_pUndoStack[m_nCurIndex+1];
 	}
 
+	//---------------------------------------------------------------------------
+	// Pre     : 
+	// Post    : 
+	// Globals : 
+	// I/O     : 
+	// Task    : Remove bottom entry (e.g. to stay within a memory limit),
+	//			 the entry we can undo to last is always kept
+	//---------------------------------------------------------------------------
+	bool RemoveBottom()
+	{
+		if (m_nCurIndex <= 0)
+			return false;
+			
+		delete m_pUndoStack[0];
+		
+		// move references
+		for (pp_int32 i = 0; i < m_nStackSize; i++)
+			m_pUndoStack[i] = m_pUndoStack[i+1];
+		m_pUndoStack[m_nStackSize] = NULL;
+		
+		m_nCurIndex--;
+		m_nTopIndex--;
+		
+		m_bOverflow = true;
+		return true;
+	}
+
+	// number of valid entries, including those which can be redone
+	pp_int32 GetNumEntries() const { return m_pUndoStack[0] ? m_nTopIndex+1 : 0; }
+
+	const type* GetEntry(pp_int32 index) const { return m_pUndoStack[index]; }
+
+	// entry which holds the current state (NULL if there is none)
+	const type* GetCurrent() const { return (m_nCurIndex+1 < GetNumEntries()) ? m_pUndoStack[m_nCurIndex+1] : NULL; }
+
 	bool IsEmpty() const { return (m_nCurIndex == -1); }
 
 	bool IsTop() const { return ((m_nTopIndex-1)==m_nCurIndex); }
@@ -43,3 +43,48 @@ static inline void fill_dword_vertical(pp_uint32* buff, pp_uint32 dw, pp_uint32
 		buff += pitch;
 	} while (--len);
 }
+
+static inline void fill_word(pp_uint16* buff, pp_uint16 w, pp_uint32 len)
+{
+	while (len--)
+		*(buff++) = w;
+}
+
+static inline void fill_bytes3(pp_uint8* buff, pp_uint8 b0, pp_uint8 b1, pp_uint8 b2, pp_uint32 len)
+{
+	while (len--)
+	{
+		buff[0] = b0;
+		buff[1] = b1;
+		buff[2] = b2;
+		buff+=3;
+	}
+}
+
+// span fillers for PPGraphicsFrameBuffer::drawGlyph
+struct SpanFillDword
+{
+	enum { bytesPerPixel = 4 };
+	pp_uint32 dw;
+
+	SpanFillDword(pp_uint32 dw) : dw(dw) {}
+	void fill(pp_uint8* buff, pp_uint32 len) const { fill_dword(reinterpret_cast<pp_uint32*>(buff), dw, len); }
+};
+
+struct SpanFillWord
+{
+	enum { bytesPerPixel = 2 };
+	pp_uint16 w;
+
+	SpanFillWord(pp_uint16 w) : w(w) {}
+	void fill(pp_uint8* buff, pp_uint32 len) const { fill_word(reinterpret_cast<pp_uint16*>(buff), w, len); }
+};
+
+struct SpanFillBytes3
+{
+	enum { bytesPerPixel = 3 };
+	pp_uint8 b0, b1, b2;
+
+	SpanFillBytes3(pp_uint8 b0, pp_uint8 b1, pp_uint8 b2) : b0(b0), b1(b1), b2(b2) {}
+	void fill(pp_uint8* buff, pp_uint32 len) const { fill_bytes3(buff, b0, b1, b2, len); }
+};
@@ -37,6 +37,7 @@
 #include "Seperator.h"
 #include "fx/EQConstants.h"
 #include "FilterParameters.h"
+#include "SampleToolPreview.h"
 
 DialogEQ::DialogEQ(PPScreen* screen, 
 				   DialogResponder* responder,
@@ -48,6 +49,8 @@ DialogEQ::DialogEQ(PPScreen* screen,
   preview      = false;
   needUpdate   = false;
 	sampleEditor = NULL;
+	toolPreview  = NULL;
+	toolPreviewRate = 0.0f;
 	switch (numBands)
 	{
 		case EQ10Bands:
@@ -178,6 +181,8 @@ pp_int32 DialogEQ::handleEvent(PPObject* sender, PPEvent* event)
 			case MESSAGEBOX_LISTBOX_VALUE_ONE:
 			{
 				resetSliders();
+				if (toolPreview)
+					updateToolPreview();
 				update();
 				break;
 			}
@@ -187,9 +192,16 @@ pp_int32 DialogEQ::handleEvent(PPObject* sender, PPEvent* event)
 		}
 	}
 
+	// streamed preview follows the sliders while they're dragged
+	if (toolPreview && event->getID() == eValueChanged &&
+		id >= MESSAGEBOX_CONTROL_USER1 && id < MESSAGEBOX_CONTROL_USER1+numSliders)
+	{
+		updateToolPreview();
+	}
+
   // realtime preview of current settings (when pattern is playing)
 	if( event->getID() == eLMouseUp && needUpdate ){
-		if( sampleEditor != NULL ){
+		if( sampleEditor != NULL && toolPreview == NULL ){
 			pp_uint32 numBands = getNumBandsAsInt();
 			FilterParameters par(numBands);
 			for (pp_uint32 i = 0; i < numBands; i++)
@@ -207,6 +219,24 @@ pp_int32 DialogEQ::handleEvent(PPObject* sender, PPEvent* event)
 	return PPDialogBase::handleEvent(sender, event);
 }
 
+void DialogEQ::updateToolPreview()
+{
+	float bandParams[SampleToolPreview::MaxBands];
+	for (pp_uint32 i = 0; i < numSliders; i++)
+		bandParams[i] = getBandParam(i);
+		
+	toolPreview->setEQ(numSliders, bandParams, toolPreviewRate);
+}
+
+void DialogEQ::setToolPreview(SampleToolPreview* preview, float rate)
+{
+	toolPreview = preview;
+	toolPreviewRate = rate;
+	
+	if (toolPreview)
+		updateToolPreview();
+}
+
 void DialogEQ::setBandParam(pp_uint32 index, float param)
 {
 	if (index >= numSliders)
@@ -49,11 +49,14 @@ private:
 	SampleEditor *sampleEditor;
 	bool needUpdate;
 	bool preview;
+	class SampleToolPreview* toolPreview;
+	float toolPreviewRate;
 
 	virtual pp_int32 handleEvent(PPObject* sender, PPEvent* event);	
 	
 	void resetSliders();
 	void update();
+	void updateToolPreview();
 
 public:
 	DialogEQ(PPScreen* screen, DialogResponder* responder,
@@ -68,6 +71,10 @@ public:
 
 	void setSampleEditor(SampleEditor *s){ this->sampleEditor = s; }
 	SampleEditor * getSampleEditor(){ return this->sampleEditor; }
+
+	// stream the settings through preview instead of applying them to the
+	// sample, rate is passed on to SampleToolPreview::setEQ
+	void setToolPreview(SampleToolPreview* preview, float rate);
 };
 
 
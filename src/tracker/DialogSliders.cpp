@@ -39,8 +39,9 @@
 #include "FilterParameters.h"
 #include "SampleEditor.h"
 #include "ListBox.h"
+#include "SampleToolPreview.h"
 
-DialogSliders::DialogSliders(PPScreen *parentScreen, DialogResponder *toolHandlerResponder, pp_int32 id, const PPString& title, pp_int32 sliders, SampleEditor *sampleEditor, void (SampleEditor::*fn)(const FilterParameters*) ) : sampleEditor_(sampleEditor), func(fn)
+DialogSliders::DialogSliders(PPScreen *parentScreen, DialogResponder *toolHandlerResponder, pp_int32 id, const PPString& title, pp_int32 sliders, SampleEditor *sampleEditor, void (SampleEditor::*fn)(const FilterParameters*) ) : sampleEditor_(sampleEditor), func(fn), toolPreview(NULL)
 {
 	needUpdate    = false;
 	preview       = false;
@@ -124,8 +125,10 @@ pp_int32 DialogSliders::handleEvent(PPObject* sender, PPEvent* event)
     needUpdate = true;
   }
   if( eID == eCommand && id == PP_MESSAGEBOX_BUTTON_CANCEL ){
-    sampleEditor->undo();
+    if( preview ) sampleEditor->undo();
     update();
+  }else if( toolPreview != NULL ){
+    if( eID == eValueChanged ) process();
   }else{
     if( clicked && valueChanged ){
       process();
@@ -138,6 +141,10 @@ pp_int32 DialogSliders::handleEvent(PPObject* sender, PPEvent* event)
 }
 
 void DialogSliders::process(){
+  if( toolPreview != NULL ){
+    toolPreview->setGain( getSlider(0) / 100.0f );
+    return;
+  }
   if( sampleEditor != NULL ){
     FilterParameters par(numSliders);
     pp_int32 i;
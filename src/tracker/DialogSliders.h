@@ -51,6 +51,7 @@ private:
 	SampleEditor *sampleEditor;
   SampleEditor *sampleEditor_;
   void (SampleEditor::*func)(const FilterParameters*);
+  class SampleToolPreview* toolPreview;
 	class PPListBox* listBoxes[MAX_SLIDERS];
   
 	bool needUpdate;
@@ -77,6 +78,12 @@ public:
 	SampleEditor * getSampleEditor(){ return this->sampleEditor; }
 
   void process();
+  // true when the tool has been run on the sample already
+  bool isPreviewApplied() const { return preview; }
+
+  // stream the first slider as gain in percent through preview instead of
+  // running the tool on the sample, has to be set before initSlider()
+  void setToolPreview(SampleToolPreview* preview) { toolPreview = preview; }
 
 };
 
@@ -224,6 +224,12 @@ void ModuleEditor::reloadEnvelope(mp_sint32 insIndex, mp_sint32 smpIndex, mp_sin
 	envelopeEditor->attachEnvelope(getEnvelope(insIndex, smpIndex, type), module);
 }
 
+void ModuleEditor::attachPlayerCriticalSection(PlayerCriticalSection* playerCriticalSection) 
+{ 
+	this->playerCriticalSection = playerCriticalSection; 
+	sampleEditor->attachPlayerCriticalSection(playerCriticalSection);
+}
+
 void ModuleEditor::enterCriticalSection()
 {
 	if (playerCriticalSection)
@@ -680,7 +686,16 @@ bool ModuleEditor::openSong(const SYSCHAR* fileName, const SYSCHAR* preferredFil
 	if (!XMFile::exists(fileName))
 		return false;
 
-	mp_sint32 nRes = module->loadModule(fileName);
+	XMFileMapped f(fileName);
+	if (!f.isOpen())
+		return false;
+
+	return openSong(f, preferredFileName ? preferredFileName : fileName);
+}
+
+bool ModuleEditor::openSong(XMFileBase& f, const SYSCHAR* fileName)
+{
+	mp_sint32 nRes = module->loadModule(f);
 	
 	// unknown format
 	if (nRes == MP_UNKNOWN_FORMAT)
@@ -712,15 +727,17 @@ bool ModuleEditor::openSong(const SYSCHAR* fileName, const SYSCHAR* preferredFil
 			}
 		} 
 	
-		PPSystemString tempFile(getTempFilename());
-	
+		// convert through an XM in memory
 		try
 		{
-			res = module->saveExtendedModule(tempFile) == MP_OK;
+			XMFileBuffer buffer;
+			
+			res = module->saveExtendedModule(buffer) == MP_OK;
 			if(!res)
 				return res;
 
-			res = module->loadModule(tempFile) == MP_OK;
+			buffer.seek(0);
+			res = module->loadModule(buffer) == MP_OK;
 		} catch (const std::bad_alloc &) {
 			return false;
 		}
@@ -738,8 +755,6 @@ bool ModuleEditor::openSong(const SYSCHAR* fileName, const SYSCHAR* preferredFil
 				}
 			}
 		} 
-	
-		XMFile::remove(tempFile);
 	}
 
 	if (module->header.channum > TrackerConfig::numPlayerChannels)
@@ -757,7 +772,7 @@ bool ModuleEditor::openSong(const SYSCHAR* fileName, const SYSCHAR* preferredFil
 		for (mp_sint32 i = 0; i < module->header.patnum; i++)
 			getPattern(i);
 		
-		PPSystemString strFileName = preferredFileName ? preferredFileName : fileName;
+		PPSystemString strFileName = fileName;
 
 		moduleFileName = strFileName.stripExtension();
 		
@@ -149,7 +149,7 @@ public:
 	EnvelopeEditor* getEnvelopeEditor() { return envelopeEditor; }
 	ModuleServices* getModuleServices() { return moduleServices; }
 	
-	void attachPlayerCriticalSection(PlayerCriticalSection* playerCriticalSection) { this->playerCriticalSection = playerCriticalSection; }
+	void attachPlayerCriticalSection(PlayerCriticalSection* playerCriticalSection);
 
 	PPSystemString getModuleFileNameFull(ModSaveTypes extension = ModSaveTypeDefault);
 	PPSystemString getModuleFileName(ModSaveTypes extension = ModSaveTypeDefault);
@@ -241,6 +241,8 @@ public:
 	bool isEmpty() const;
 						 
 	bool openSong(const SYSCHAR* fileName, const SYSCHAR* preferredFileName = NULL);	
+	// fileName is only used for naming the song
+	bool openSong(XMFileBase& f, const SYSCHAR* fileName);
 	bool saveSong(const SYSCHAR* fileName, ModSaveTypes saveType = ModSaveTypeXM);
 	mp_sint32 saveBackup(const SYSCHAR* fileName);
 	
@@ -29,9 +29,12 @@
  */
 
 #include "ModuleServices.h"
+#include "PPSystem.h"
 #include "SongLengthEstimator.h"
 #include "PlayerGeneric.h"
 #include "AudioDriver_NULL.h"
+#include "ResamplerFactory.h"
+#include "ThreadPool.h"
 #include "XModule.h"
 
 void ModuleServices::estimateSongLength()
@@ -101,25 +104,90 @@ pp_int32 ModuleServices::estimateWaveLengthInSamples(WAVWriterParameters& parame
 	return res;
 }
 
-pp_int32 ModuleServices::exportToWAV(const PPSystemString& fileName, WAVWriterParameters& parameters)
+// Renders one track (all other channels muted) of a multi track export,
+// every job has its own player so the tracks can be rendered in parallel
+class StemExportJob : public ThreadPool::Job
 {
-	PlayerGeneric* player = new PlayerGeneric(parameters.sampleRate);
+private:
+	XModule& module;
+	const ModuleServices::WAVWriterParameters& parameters;
+	PPSystemString fileName;
+	mp_ubyte* muting;
+	
+public:
+	pp_int32 res;
 
-	player->setBufferSize(1024);
-	player->setPlayMode((PlayerGeneric::PlayModes)parameters.playMode);
-	player->setResamplerType((ChannelMixer::ResamplerTypes)parameters.resamplerType);
-	player->setSampleShift(parameters.mixerShift);
-	player->setMasterVolume(parameters.mixerVolume);
+	StemExportJob(XModule& module, 
+				  const ModuleServices::WAVWriterParameters& parameters, 
+				  const PPSystemString& fileName,
+				  pp_uint32 channel) :
+		module(module),
+		parameters(parameters),
+		fileName(fileName),
+		res(0)
+	{
+		muting = new mp_ubyte[module.header.channum];
+		memset(muting, 1, module.header.channum);
+		muting[channel] = 0;
+	}
+	
+	virtual ~StemExportJob()
+	{
+		delete[] muting;
+	}
 	
+	virtual void run()
+	{
+		PlayerGeneric* player = new PlayerGeneric(parameters.sampleRate);
+
+		player->setBufferSize(1024);
+		player->setPlayMode((PlayerGeneric::PlayModes)parameters.playMode);
+		player->setResamplerType((ChannelMixer::ResamplerTypes)parameters.resamplerType);
+		player->setSampleShift(parameters.mixerShift);
+		player->setMasterVolume(parameters.mixerVolume);
+		player->setExportWAVFormat((WAVWriter::WAVFormats)parameters.sampleFormat);
+
+		res = player->exportToWAV(fileName, &module, 
+								  parameters.fromOrder, parameters.toOrder, 
+								  muting, 
+								  module.header.channum, 
+								  parameters.panning,
+								  NULL,NULL,
+								  parameters.limiterDrive);
+		
+		delete player;
+	}
+};
+
+pp_int32 ModuleServices::exportToWAV(const PPSystemString& fileName, WAVWriterParameters& parameters, 
+									 WAVWriterStatistics* statistics/* = NULL*/)
+{
 	pp_int32 res = 0;
 	
 	if (parameters.multiTrack)
 	{
-		mp_ubyte* muting = new mp_ubyte[module.header.channum];
+		// the tracks have to share the same gain, so we can't normalize 
+		// them while rendering, the peak of the full mix is estimated first
+		if (parameters.normalize)
+		{
+			pp_uint32 mixerVolume = estimateMixerVolume(parameters);
+			if (mixerVolume < parameters.mixerVolume)
+				parameters.mixerVolume = mixerVolume;
+			
+			if (statistics)
+				statistics->mixerVolume = parameters.mixerVolume;
+		}
 		
+		// some resamplers build their shared lookup tables on first use,
+		// make sure this happens before the workers start
+		delete ResamplerFactory::createResampler((ChannelMixer::ResamplerTypes)parameters.resamplerType);
+
 		PPSystemString baseName = fileName.stripExtension();
 		PPSystemString extension = fileName.getExtension();
 		
+		StemExportJob** jobs = new StemExportJob*[module.header.channum];
+		pp_uint32 numJobs = 0;
+		
 		for (pp_uint32 i = 0; i < module.header.channum; i++)
 		{
 			PPSystemString fileName = baseName;
@@ -131,33 +199,73 @@ pp_int32 ModuleServices::exportToWAV(const PPSystemString& fileName, WAVWriterPa
 			fileName.append(extension);
 		
 			if (!parameters.muting[i])
-			{
-				memset(muting, 1, module.header.channum);				
-				muting[i] = 0;				
-				res = player->exportToWAV(fileName, &module, 
-										  parameters.fromOrder, parameters.toOrder, 
-										  muting, 
-										  module.header.channum, 
-										  parameters.panning,
-										  NULL,NULL,
-										  parameters.limiterDrive);
-			}
+				jobs[numJobs++] = new StemExportJob(module, parameters, fileName, i);
 		}
 		
-		delete[] muting;
+		if (numJobs)
+		{
+			ThreadPool pool(numJobs < (pp_uint32)ThreadPool::getNumProcessors() ? numJobs : 0);
+			
+			for (pp_uint32 i = 0; i < numJobs; i++)
+				pool.addJob(jobs[i]);
+			
+			pool.waitForAll();
+		}
+		
+		// report the first failure, otherwise the length of the last track
+		for (pp_uint32 i = 0; i < numJobs; i++)
+		{
+			if (res >= 0)
+				res = jobs[i]->res;
+			delete jobs[i];
+		}
+		
+		delete[] jobs;
 	}
 	else
 	{
-		res = player->exportToWAV(fileName, &module, 
-								  parameters.fromOrder, parameters.toOrder, 
-								  parameters.muting, 
-								  module.header.channum, 
-								  parameters.panning,
-								  NULL,NULL,
-								  parameters.limiterDrive);
+		PlayerGeneric* player = new PlayerGeneric(parameters.sampleRate);
+
+		player->setBufferSize(1024);
+		player->setPlayMode((PlayerGeneric::PlayModes)parameters.playMode);
+		player->setResamplerType((ChannelMixer::ResamplerTypes)parameters.resamplerType);
+		player->setSampleShift(parameters.mixerShift);
+		player->setMasterVolume(parameters.mixerVolume);
+		player->setExportWAVFormat((WAVWriter::WAVFormats)parameters.sampleFormat);
+
+		if (parameters.normalize)
+		{
+			PlayerGeneric::TExportStatistics exportStatistics;
+			
+			res = player->exportToWAVNormalized(fileName, System::getTempFileName(), &module,
+												parameters.fromOrder, parameters.toOrder, 
+												parameters.muting, 
+												module.header.channum, 
+												parameters.panning,
+												parameters.limiterDrive,
+												&exportStatistics);
+			
+			if (statistics && res >= 0)
+			{
+				statistics->mixerVolume = exportStatistics.masterVolume;
+				statistics->peakDB = exportStatistics.peakDB;
+				statistics->rmsDB = exportStatistics.rmsDB;
+			}
+		}
+		else
+		{
+			res = player->exportToWAV(fileName, &module, 
+									  parameters.fromOrder, parameters.toOrder, 
+									  parameters.muting, 
+									  module.header.channum, 
+									  parameters.panning,
+									  NULL,NULL,
+									  parameters.limiterDrive);
+		}
+
+		delete player;	
 	}
 		
-	delete player;	
 	return res;
 }
 
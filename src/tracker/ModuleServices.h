@@ -68,20 +68,41 @@ public:
 		pp_uint32 limiterDrive;
 		
 		bool multiTrack;
+		// scale the mix to full scale (mixerVolume is the upper limit)
+		bool normalize;
+		// 16 bit, 24 bit or float (see WAVWriter::WAVFormats)
+		pp_uint32 sampleFormat;
 		
 		WAVWriterParameters() :
 			sampleRate(0),
 			resamplerType(0),
+			rampin(false),
 			playMode(0),
 			mixerShift(0),	
 			mixerVolume(0),	
 			fromOrder(0),
 			toOrder(0),
-			rampin(false),
 			muting(NULL),
 			panning(NULL),
+			limiterDrive(0),
 			multiTrack(false),
-			limiterDrive(0)
+			normalize(false),
+			sampleFormat(0)
+		{
+		}
+	};
+	
+	// results of a normalized export
+	struct WAVWriterStatistics
+	{
+		pp_int32 mixerVolume;
+		float peakDB;
+		float rmsDB;
+		
+		WAVWriterStatistics() :
+			mixerVolume(0),
+			peakDB(0.0f),
+			rmsDB(0.0f)
 		{
 		}
 	};
@@ -91,7 +112,8 @@ public:
 								 
 	pp_int32 estimateWaveLengthInSamples(WAVWriterParameters& parameters);
 
-	pp_int32 exportToWAV(const PPSystemString& fileName, WAVWriterParameters& parameters);
+	pp_int32 exportToWAV(const PPSystemString& fileName, WAVWriterParameters& parameters, 
+						 WAVWriterStatistics* statistics = NULL);
 	
 	pp_int32 exportToBuffer16Bit(WAVWriterParameters& parameters, pp_int16* buffer, 
 								 pp_uint32 bufferSize, bool mono = true);
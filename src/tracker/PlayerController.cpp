@@ -35,6 +35,7 @@
 #include "PPSystem.h"
 #include "PlayerCriticalSection.h"
 #include "ModuleEditor.h"
+#include "LockFreeRingBuffer.h"
 
 class PlayerStatusTracker : public PlayerSTD::StatusEventListener
 {
@@ -42,51 +43,21 @@ public:
 	PlayerStatusTracker(PlayerController& playerController) :
 		playerController(playerController)
 	{
-		clearUpdateCommandBuff();
 	}
 	
+	// this is being called from the player callback in a serialized fashion
+	// at every beat packet, i.e. several times per tick
+	virtual void timerTickStarted(PlayerSTD& player, XModule& module)
+	{
+		flushCommands(player);
+	}
+
 	// this is being called from the player callback in a serialized fashion
 	virtual void playerTickStarted(PlayerSTD& player, XModule& module) 
 	{ 
-		while (rbReadIndex < rbWriteIndex)
-		{			
-			mp_sint32 idx = rbReadIndex & (UPDATEBUFFSIZE-1);			
-			
-			// handle notes that are played from external source
-			// i.e. keyboard playback
-			switch (updateCommandBuff[idx].code)
-			{
-				case UpdateCommandCodeNote:
-				{
-					UpdateCommandNote* command = reinterpret_cast<UpdateCommandNote*>(&updateCommandBuff[idx]);
-					mp_sint32 note = command->note;
-					if (note)
-					{
-						player.playNote(command->channel, note, 
-										command->ins, 
-										command->volume);
-						command->note = 0;
-					}
-					break;
-				}
-
-				case UpdateCommandCodeSample:
-				{
-					UpdateCommandSample* command = reinterpret_cast<UpdateCommandSample*>(&updateCommandBuff[idx]);
-					const TXMSample* smp = command->smp;
-					if (smp)
-					{
-						playSampleInternal(player, command->channel, smp, command->currentSamplePlayNote,
-										   command->rangeStart,  command->rangeEnd);
-						command->smp = NULL;
-					}
-					
-					break;
-				}
-				
-			}
-			rbReadIndex++;
-		}
+		// handle notes that are played from external source
+		// i.e. keyboard playback
+		flushTickCommands(player);
 	}	
 	
 	virtual void patternEndReached(PlayerSTD& player, XModule& module, mp_sint32& newOrderIndex) 
@@ -94,33 +65,80 @@ public:
 		handleQueuedPositions(player, newOrderIndex);
 	}
 
-	void playNote(mp_ubyte chn, mp_sint32 note, mp_sint32 ins, mp_sint32 vol/* = -1*/)
+	// these are applied at the start of the next tick, they return false
+	// when the queue is full
+	bool playNote(mp_ubyte chn, mp_sint32 note, mp_sint32 ins, mp_sint32 vol/* = -1*/)
 	{	
-		// fill ring buffer with note entries
 		// the callback will query these notes and play them 
-		mp_sint32 idx = rbWriteIndex & (UPDATEBUFFSIZE-1);
-		UpdateCommandNote* command = reinterpret_cast<UpdateCommandNote*>(&updateCommandBuff[idx]);
-		command->channel = chn;
-		command->ins = ins;
-		command->volume = vol;
-		command->note = note;
-		// code needs to be filled in last
-		command->code = UpdateCommandCodeNote;
-		rbWriteIndex++;
+		UpdateCommand command(UpdateCommandCodeNote);
+		command.channel = chn;
+		command.ins = ins;
+		command.volume = vol;
+		command.note = note;
+		return tickCommandQueue.push(command);
+	}
+
+	bool playSample(mp_ubyte chn, const TXMSample& smp, mp_sint32 currentSamplePlayNote, mp_sint32 rangeStart, mp_sint32 rangeEnd)
+	{
+		UpdateCommand command(UpdateCommandCodeSample);
+		command.channel = chn;
+		command.currentSamplePlayNote = currentSamplePlayNote;
+		command.rangeStart = rangeStart;
+		command.rangeEnd = rangeEnd;
+		command.smp = &smp;
+		return tickCommandQueue.push(command);
+	}
+	
+	// the following commands are applied at the next beat packet, they
+	// return false when the queue is full
+	bool muteChannel(mp_sint32 chn, bool mute)
+	{
+		UpdateCommand command(UpdateCommandCodeMute);
+		command.channel = chn;
+		command.mute = mute;
+		return commandQueue.push(command);
+	}
+	
+	bool stopInstrument(mp_sint32 ins)
+	{
+		UpdateCommand command(UpdateCommandCodeStopInstrument);
+		command.ins = ins;
+		return commandQueue.push(command);
+	}
+	
+	// newSmp must stay valid until the command has been handled
+	bool swapSample(TXMSample& smp, const TXMSample& newSmp)
+	{
+		UpdateCommand command(UpdateCommandCodeSwapSample);
+		command.dstSmp = &smp;
+		command.smp = &newSmp;
+		return commandQueue.push(command);
+	}
+	
+	bool hasPendingCommands() const { return !commandQueue.isEmpty(); }
+	
+	// mixer thread, or any other thread while the player isn't being mixed.
+	// A command is only taken off the queue once it has been applied, so 
+	// hasPendingCommands() stays true until then
+	void flushCommands(PlayerSTD& player)
+	{
+		UpdateCommand command;
+		while (commandQueue.peek(command))
+		{
+			handleCommand(player, command);
+			commandQueue.consume();
+		}
 	}
 
-	void playSample(mp_ubyte chn, const TXMSample& smp, mp_sint32 currentSamplePlayNote, mp_sint32 rangeStart, mp_sint32 rangeEnd)
+	// same for the notes
+	void flushTickCommands(PlayerSTD& player)
 	{
-		// fill ring buffer with sample playback entries
-		mp_sint32 idx = rbWriteIndex & (UPDATEBUFFSIZE-1);
-		UpdateCommandSample* command = reinterpret_cast<UpdateCommandSample*>(&updateCommandBuff[idx]);
-		command->channel = chn;
-		command->currentSamplePlayNote = currentSamplePlayNote;
-		command->rangeStart = rangeStart;
-		command->rangeEnd = rangeEnd;
-		command->smp = &smp;
-		command->code = UpdateCommandCodeSample;
-		rbWriteIndex++;
+		UpdateCommand command;
+		while (tickCommandQueue.peek(command))
+		{
+			handleCommand(player, command);
+			tickCommandQueue.consume();
+		}
 	}
 				  
 private:
@@ -189,11 +207,20 @@ private:
 			player.playSample(chn, smp->sample, smp->samplen, rangeStart, 0, false, 0, rangeEnd, flags);
 		}
 	}
-
-	void clearUpdateCommandBuff()
+	
+	void swapSampleInternal(PlayerSTD& player, TXMSample* dst, const TXMSample* src)
 	{
-		memset(updateCommandBuff, 0, sizeof(updateCommandBuff));
-		rbReadIndex = rbWriteIndex = 0;
+		// nothing must play the old memory once the caller frees it
+		if (dst->sample != src->sample)
+			player.detachSampleData(dst->sample);
+		
+		dst->sample = src->sample;
+		dst->samplen = src->samplen;
+		dst->loopstart = src->loopstart;
+		dst->looplen = src->looplen;
+		dst->relnote = src->relnote;
+		dst->finetune = src->finetune;
+		dst->type = src->type;
 	}
 	
 	enum
@@ -207,44 +234,91 @@ private:
 		UpdateCommandCodeInvalid = 0,
 		UpdateCommandCodeNote,
 		UpdateCommandCodeSample,
+		UpdateCommandCodeMute,
+		UpdateCommandCodeStopInstrument,
+		UpdateCommandCodeSwapSample
 	};
 	
 	struct UpdateCommand
 	{
-		mp_ubyte code;			
-		mp_uint32 data[8];
-		void* pdata[8];
-	};
-
-	struct UpdateCommandNote
-	{
-		mp_ubyte code;			
-		mp_sint32 note;
+		UpdateCommandCodes code;
 		mp_sint32 channel;
+		// note
+		mp_sint32 note;
 		mp_sint32 ins;
 		mp_sint32 volume;
-		mp_uint32 data[4];
-		void* pdata[8];
-	};
-	
-	struct UpdateCommandSample
-	{
-		mp_ubyte code;
-		mp_uint32 currentSamplePlayNote;
-		mp_uint32 rangeStart;
-		mp_uint32 rangeEnd;
-		mp_sint32 channel;
-		mp_uint32 data[4];
+		// sample
+		mp_sint32 currentSamplePlayNote;
+		mp_sint32 rangeStart;
+		mp_sint32 rangeEnd;
 		const TXMSample* smp;
-		void* pdata[7];
+		// swap
+		TXMSample* dstSmp;
+		// mute
+		bool mute;
+		
+		UpdateCommand(UpdateCommandCodes code = UpdateCommandCodeInvalid) :
+			code(code),
+			channel(0),
+			note(0), ins(0), volume(-1),
+			currentSamplePlayNote(0), rangeStart(-1), rangeEnd(-1),
+			smp(NULL),
+			dstSmp(NULL),
+			mute(false)
+		{
+		}
 	};
 	
-	UpdateCommand updateCommandBuff[UPDATEBUFFSIZE];
-	
-	mp_sint32 rbReadIndex;
-	mp_sint32 rbWriteIndex;	
+	// notes are played at the start of a tick
+	LockFreeRingBuffer<UpdateCommand, UPDATEBUFFSIZE> tickCommandQueue;
+	// everything else at the next beat packet
+	LockFreeRingBuffer<UpdateCommand, UPDATEBUFFSIZE> commandQueue;
+
+	void handleCommand(PlayerSTD& player, const UpdateCommand& command);
 };
 
+void PlayerStatusTracker::handleCommand(PlayerSTD& player, const UpdateCommand& command)
+{
+	switch (command.code)
+	{
+		case UpdateCommandCodeNote:
+			if (command.note)
+				player.playNote(command.channel, command.note, command.ins, command.volume);
+			break;
+
+		case UpdateCommandCodeSample:
+			if (command.smp)
+				playSampleInternal(player, command.channel, command.smp, command.currentSamplePlayNote,
+								   command.rangeStart, command.rangeEnd);
+			break;
+			
+		case UpdateCommandCodeMute:
+			player.muteChannel(command.channel, command.mute);
+			break;
+			
+		case UpdateCommandCodeStopInstrument:
+			if (player.isPlaying())
+			{
+				for (pp_int32 i = 0; i < playerController.numPlayerChannels + playerController.numVirtualChannels; i++)
+				{
+					if (player.chninfo[i].ins == command.ins)
+					{
+						player.stopSample(i);
+						player.chninfo[i].flags &= ~0x100; // CHANNEL_FLAGS_UPDATE_IGNORE
+					}
+				}
+			}
+			break;
+			
+		case UpdateCommandCodeSwapSample:
+			swapSampleInternal(player, command.dstSmp, command.smp);
+			break;
+			
+		default:
+			break;
+	}
+}
+
 void PlayerController::assureNotSuspended()
 {
 	if (mixer->isDevicePaused(player))
@@ -735,7 +809,11 @@ void PlayerController::playSample(const TXMSample& smp, mp_sint32 currentSampleP
 	{
 		pp_int32 i = numPlayerChannels + numVirtualChannels + 1;
 
-		playerStatusTracker->playSample(i, smp, currentSamplePlayNote, rangeStart, rangeEnd);		
+		if (!playerStatusTracker->playSample(i, smp, currentSamplePlayNote, rangeStart, rangeEnd))
+		{
+			flushTickCommandsSuspended();
+			playerStatusTracker->playSample(i, smp, currentSamplePlayNote, rangeStart, rangeEnd);
+		}
 	}	
 
 }
@@ -764,7 +842,10 @@ void PlayerController::stopInstrument(mp_sint32 insIndex)
 
 	if (player->isPlaying())
 	{
-		// doesn't seem to be a critical race condition
+		// channel flags are modified by the mixer as well, let it do the job
+		if (isMixing() && playerStatusTracker->stopInstrument(insIndex))
+			return;
+	
 		for (pp_int32 i = 0; i < numPlayerChannels + numVirtualChannels; i++)
 		{
 			if (player->chninfo[i].ins == insIndex)
@@ -784,7 +865,22 @@ void PlayerController::playNote(mp_ubyte chn, mp_sint32 note, mp_sint32 i, mp_si
 	assureNotSuspended();
 
 	// note playing goes synchronized in the playback callback
-	playerStatusTracker->playNote(chn, note, i, vol);
+	if (!playerStatusTracker->playNote(chn, note, i, vol))
+	{
+		flushTickCommandsSuspended();
+		playerStatusTracker->playNote(chn, note, i, vol);
+	}
+}
+
+void PlayerController::flushTickCommandsSuspended()
+{
+	// queue is full, we need to stop the player to make room
+	const bool wasSuspended = suspended;
+	if (!wasSuspended)
+		suspendPlayer(false, false);
+	playerStatusTracker->flushTickCommands(*player);
+	if (!wasSuspended)
+		resumePlayer(false);
 }
 
 void PlayerController::suspendPlayer(bool bResetMainVolume/* = true*/, bool stopPlaying/* = true*/)
@@ -822,7 +918,103 @@ void PlayerController::muteChannel(mp_sint32 c, bool m)
 	muteChannels[c] = m;
 	
 	if (player)
+	{
+		if (isMixing() && playerStatusTracker->muteChannel(c, m))
+			return;
 		player->muteChannel(c, m);
+	}
+}
+
+bool PlayerController::isMixing() const
+{
+	return mixer->isActive() && !mixer->isDeviceRemoved(player) && 
+		   !mixer->isDevicePaused(player) && !player->isPaused();
+}
+
+void PlayerController::swapSample(TXMSample& smp, const TXMSample& newSmp)
+{
+	if (player && playerStatusTracker->swapSample(smp, newSmp))
+	{
+		waitForCommands();
+		return;
+	}
+	
+	// queue is full, we need to stop the player
+	const bool wasSuspended = suspended;
+	if (!wasSuspended)
+		suspendPlayer(false, false);
+	if (player)
+		player->detachSampleData(smp.sample);
+	smp.sample = newSmp.sample;
+	smp.samplen = newSmp.samplen;
+	smp.loopstart = newSmp.loopstart;
+	smp.looplen = newSmp.looplen;
+	smp.relnote = newSmp.relnote;
+	smp.finetune = newSmp.finetune;
+	smp.type = newSmp.type;
+	if (!wasSuspended)
+		resumePlayer(false);
+}
+
+void PlayerController::setScopeTaps(bool b)
+{
+	// fake scopes don't read anything the mixer recorded
+	if (!player || !mixerDataCache)
+		return;
+
+	const bool wasSuspended = suspended;
+	if (!wasSuspended)
+		suspendPlayer(false, false);
+	player->setScopeTaps(b);
+	if (!wasSuspended)
+		resumePlayer(false);
+}
+
+void PlayerController::setSampleInsert(const TXMSample& smp, Mixable* insert)
+{
+	if (!player)
+		return;
+
+	const bool wasSuspended = suspended;
+	if (!wasSuspended)
+		suspendPlayer(false, false);
+	player->setInsertHook(insert, insert ? smp.sample : NULL);
+	if (!wasSuspended)
+		resumePlayer(false);
+}
+
+void PlayerController::waitForCommands()
+{
+	if (!player || !playerStatusTracker->hasPendingCommands())
+		return;
+
+	if (isMixing())
+	{
+		// commands are handled at every beat packet, i.e. the mixer
+		// should get to them within a buffer
+		mp_uint32 waitMillis = (mp_uint32)(((double)mixer->getBufferSize() / (double)mixer->getSampleRate()) * 1000.0 * 4.0);
+		if (waitMillis < 50)
+			waitMillis = 50;
+		
+		mp_uint32 time = 0;
+		while (playerStatusTracker->hasPendingCommands() && time < waitMillis)
+		{
+			System::msleep(1);
+			time++;
+		}
+	}
+	
+	// nobody picks them up (or the mixer got stuck), apply them here
+	// while the player is suspended
+	if (playerStatusTracker->hasPendingCommands())
+	{
+		const bool wasSuspended = suspended;
+		if (!wasSuspended)
+			suspendPlayer(false, false);
+		playerStatusTracker->flushCommands(*player);
+		if (!wasSuspended)
+			resumePlayer(false);
+	}
 }
 
 bool PlayerController::isChannelMuted(mp_sint32 c)
@@ -1145,6 +1337,11 @@ mp_sint32 PlayerController::getPlayerNumPlayingChannels()
 	return player->initialNumChannels;
 }
 
+mp_uint32 PlayerController::getSampleRate() const
+{
+	return mixer->getSampleRate();
+}
+
 mp_sint32 PlayerController::getCurrentSamplePosition()
 {
 	if (mixer && mixer->getAudioDriver())
@@ -1172,14 +1369,15 @@ bool PlayerController::isSamplePlaying(const TXMSample& smp, mp_sint32 channel,
 	// maybe someday this entire decision should go into the
 	// player or mixer class itself, so I don't need to access it here
 	pp_int32 j = getCurrentBeatIndex();
-	pos = mixer->channel[channel].timeRecord[j].smppos;
+	const ChannelMixer::TTimeRecord* timeRecord = mixer->getTimeRecord(channel) + j;
+	pos = timeRecord->smppos;
 	
 	// compare sample from sample editor against sample from current mixer channel
 	if (pos >= 0 && 
-		(void*)mixer->channel[channel].timeRecord[j].sample == (void*)smp.sample)
+		(void*)timeRecord->sample == (void*)smp.sample)
 	{
-		vol = (mixer->channel[channel].timeRecord[j].volPan & 0xFFFF) >> 1;
-		pan = (mixer->channel[channel].timeRecord[j].volPan) >> 16;
+		vol = (timeRecord->volPan & 0xFFFF) >> 1;
+		pan = (timeRecord->volPan) >> 16;
 		return true;
 	}
 	
@@ -1214,7 +1412,7 @@ bool PlayerController::isEnvelopePlaying(const TEnvelope& envelope, mp_sint32 en
 		if ((env->timeRecord[j].envstruc->num && 
 			 !(env->timeRecord[j].envstruc->type & 4) &&
 			 pos >= env->timeRecord[j].envstruc->env[env->timeRecord[j].envstruc->num-1][0]) ||
-			!(mixer->channel[channel].timeRecord[j].volPan & 0xFFFF))
+			!(mixer->getTimeRecord(channel)[j].volPan & 0xFFFF))
 		{
 			pos = -1;
 		}
@@ -1283,9 +1481,20 @@ void PlayerController::grabSampleData(mp_uint32 chnIndex, mp_sint32 count, mp_si
 	
 	ChannelMixer* mixer = player;
 
+	// cheaper than resampling the channel again below and that's how 
+	// it actually sounds, filters and volume ramps included
+	if (mixerDataCache && count > 0 && 
+		mixer->readScopeTap(chnIndex, getCurrentBeatIndex(), fMul, mixerDataCache, count))
+	{
+		for (mp_sint32 i = 0; i < count; i++)
+			fetcher.fetchSampleData(mixerDataCache[i]);
+		return;
+	}
+
 	ChannelMixer::TMixerChannel* chn = &mixer->channel[chnIndex];
 	
 	pp_int32 j = getCurrentBeatIndex();
+	const ChannelMixer::TTimeRecord* timeRecord = mixer->getTimeRecord(chnIndex) + j;
 
 	if (chn->flags & ChannelMixer::MP_SAMPLE_PLAY)
 	{
@@ -1297,23 +1506,23 @@ void PlayerController::grabSampleData(mp_uint32 chnIndex, mp_sint32 count, mp_si
 		// BUT it's important that we only access sample data
 		// within the range of the current sample we have
 		ChannelMixer::TMixerChannel channel;	
-		channel.sample = chn->timeRecord[j].sample;
+		channel.sample = timeRecord->sample;
 		
 		if (channel.sample == NULL)
 			goto resort;
 		
 		channel.smplen = TXMSample::getSampleSizeInSamples((mp_ubyte*)channel.sample);
-		channel.flags = chn->timeRecord[j].flags;
-		channel.smppos = chn->timeRecord[j].smppos % channel.smplen;
-		channel.smpposfrac = chn->timeRecord[j].smpposfrac;
-		channel.smpadd = chn->timeRecord[j].smpadd;
-		channel.loopend = channel.loopendcopy = chn->timeRecord[j].loopend % (channel.smplen+1);
-		channel.loopstart = chn->timeRecord[j].loopstart % (channel.smplen+1);
+		channel.flags = timeRecord->flags;
+		channel.smppos = timeRecord->smppos % channel.smplen;
+		channel.smpposfrac = timeRecord->smpposfrac;
+		channel.smpadd = timeRecord->smpadd;
+		channel.loopend = channel.loopendcopy = timeRecord->loopend % (channel.smplen+1);
+		channel.loopstart = timeRecord->loopstart % (channel.smplen+1);
 		if (channel.loopstart >= channel.loopend)
 			channel.flags &= ~3;
-		channel.vol = chn->timeRecord[j].volPan & 0xFFFF;
-		channel.pan = chn->timeRecord[j].volPan >> 16;
-		channel.fixedtimefrac = chn->timeRecord[j].fixedtimefrac;
+		channel.vol = timeRecord->volPan & 0xFFFF;
+		channel.pan = timeRecord->volPan >> 16;
+		channel.fixedtimefrac = timeRecord->fixedtimefrac;
 		channel.cutoff = ChannelMixer::MP_INVALID_VALUE;
 		channel.resonance = ChannelMixer::MP_INVALID_VALUE;
 //		channel.index = chnIndex; Uncomment this if you like crackly audio
@@ -1361,9 +1570,7 @@ bool PlayerController::hasSampleData(mp_uint32 chnIndex)
 
 	ChannelMixer* mixer = player;
 
-	ChannelMixer::TMixerChannel* chn = &mixer->channel[chnIndex];
-
-	pp_int32 j = getCurrentBeatIndex();
+	const ChannelMixer::TTimeRecord* timeRecord = mixer->getTimeRecord(chnIndex) + getCurrentBeatIndex();
 
-	return ((chn->timeRecord[j].flags & ChannelMixer::MP_SAMPLE_PLAY) && (chn->timeRecord[j].volPan & 0xFFFF));
+	return ((timeRecord->flags & ChannelMixer::MP_SAMPLE_PLAY) && (timeRecord->volPan & 0xFFFF));
 }
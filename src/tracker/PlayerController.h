@@ -98,6 +98,9 @@ private:
 	void assureNotSuspended();
 	void continuePlaying(bool assureNotSuspended);
 	
+	// true when the mixer thread is currently processing our player
+	bool isMixing() const;
+	
 	// no construction outside
 	PlayerController(class MasterMixer* mixer, bool fakeScopes);
 
@@ -159,16 +162,34 @@ public:
 	void muteChannel(mp_sint32 c, bool m);
 	bool isChannelMuted(mp_sint32 c);
 
+	// exchange sample data and properties of smp with the ones from newSmp
+	// at the next beat packet without interrupting playback, channels playing
+	// the old data are stopped and it may be freed as soon as this returns
+	void swapSample(TXMSample& smp, const TXMSample& newSmp);
+	
+	// run everything playing the data of smp through insert before it's
+	// mixed, NULL removes the insert again
+	void setSampleInsert(const TXMSample& smp, struct Mixable* insert);
+	
+	// block until the mixer has applied every command posted so far
+	void waitForCommands();
+
 	void recordChannel(mp_sint32 c, bool m);
 	bool isChannelRecording(mp_sint32 c);
 
 private:
 	void reallocateChannels(mp_sint32 moduleChannels = 32, mp_sint32 virtualChannels = 0);
 	void setUseVirtualChannels(bool bUseVirtualChannels);
+	
+	// apply the queued notes right away when there's no room for more
+	void flushTickCommandsSuspended();
 
 	void setMultiChannelKeyJazz(bool b) { multiChannelKeyJazz = b; }
 	void setMultiChannelRecord(bool b) { multiChannelRecord = b; }
 
+	// let the mixer record what each channel sounds like for the scopes
+	void setScopeTaps(bool b);
+
 public:
 	void resetFirstPlayingChannel();
 	mp_sint32 getNextPlayingChannel(mp_sint32 currentChannel);
@@ -202,6 +223,7 @@ public:
 	// queries on the mixer
 	mp_sint32 getAllNumPlayingChannels();
 	mp_sint32 getPlayerNumPlayingChannels();
+	mp_uint32 getSampleRate() const;
 
 private:
 	mp_sint32 getCurrentSamplePosition();
@@ -61,6 +61,13 @@ public:
 		playerController.resumePlayer(continuePlaying);
 		enabled = false;
 	}
+	
+	// no need to enter the critical section for this one,
+	// playback goes on while the data is exchanged
+	void swapSample(TXMSample& smp, const TXMSample& newSmp)
+	{
+		playerController.swapSample(smp, newSmp);
+	}
 };
 
 #endif
@@ -166,7 +166,8 @@ PlayerMaster::PlayerMaster(pp_uint32 numDevices/* = DefaultMaxDevices*/) :
 	oldBufferSize(getPreferredBufferSize()),
 	forcePowerOfTwoBufferSize(false),
 	multiChannelKeyJazz(true),
-	multiChannelRecord(true)	
+	multiChannelRecord(true),
+	scopeTaps(false)
 {
 	listener = new MasterMixerNotificationListener(*this);
 
@@ -214,6 +215,7 @@ PlayerController* PlayerMaster::createPlayerController(bool fakeScopes)
 
 	playerController->setMultiChannelKeyJazz(this->multiChannelKeyJazz);
 	playerController->setMultiChannelRecord(this->multiChannelRecord);
+	playerController->setScopeTaps(this->scopeTaps);
 
 	if (currentSettings.numVirtualChannels >= 0)
 	{
@@ -321,6 +323,12 @@ bool PlayerMaster::applyNewMixerSettings(const TMixerSettings& settings, bool al
 	if (settings.limiterDrive >= 0)
 		currentSettings.limiterDrive = settings.limiterDrive;
 
+	if (settings.parallelMixing >= 0)
+	{
+		currentSettings.parallelMixing = settings.parallelMixing;
+		mixer->setParallelMixing(settings.parallelMixing != 0);
+	}
+
 	if (settings.ramping >= 0)
 		currentSettings.ramping = settings.ramping;
 	
@@ -426,6 +434,15 @@ void PlayerMaster::setMultiChannelRecord(bool b)
 	}
 }
 
+void PlayerMaster::setScopeTaps(bool b)
+{
+	scopeTaps = b;
+	for (pp_int32 i = 0; i < playerControllers->size(); i++)
+	{		
+		playerControllers->get(i)->setScopeTaps(b);
+	}
+}
+
 
 bool PlayerMaster::start()
 {
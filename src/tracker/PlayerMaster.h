@@ -60,6 +60,8 @@ struct TMixerSettings
 	pp_int32 numVirtualChannels;
 	// limiterDrive (negative value means ignore)
 	pp_int32 limiterDrive;
+	// 0 = mix the players serially, 1 = on all processors, negative values means ignore
+	pp_int32 parallelMixing;
 
 	TMixerSettings() :
 		mixFreq(-1),
@@ -73,7 +75,8 @@ struct TMixerSettings
 		audioDriverName(NULL),
         numPlayerChannels(TrackerConfig::numPlayerChannels),
 		limiterDrive(-1),
-		numVirtualChannels(-1)
+		numVirtualChannels(-1),
+		parallelMixing(-1)
 	{
 	}
 
@@ -127,6 +130,9 @@ struct TMixerSettings
 		if (numVirtualChannels != source.numVirtualChannels)
 			return false;
 
+		if (parallelMixing != source.parallelMixing)
+			return false;
+
 		return strcmp(audioDriverName, source.audioDriverName) == 0;
 	}
 	
@@ -162,6 +168,7 @@ private:
 
 	bool multiChannelKeyJazz;
 	bool multiChannelRecord;
+	bool scopeTaps;
 	
 	void adjustSettings();
 	void applySettingsToPlayerController(PlayerController& playerController, const TMixerSettings& settings);
@@ -200,6 +207,7 @@ public:
 	// see above
 	void setMultiChannelKeyJazz(bool b);
 	void setMultiChannelRecord(bool b);
+	void setScopeTaps(bool b);
 	
 	bool start();
 	bool stop(bool detachPlayers);
@@ -0,0 +1,542 @@
+/*
+ *  tracker/SampleBlockProcessor.cpp
+ *
+ *  Copyright 2009 Peter Barth
+ *
+ *  This file is part of Milkytracker.
+ *
+ *  Milkytracker is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Milkytracker is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Milkytracker.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ *  SampleBlockProcessor.cpp
+ *  milkytracker
+ *
+ */
+
+#include "SampleBlockProcessor.h"
+#include "XModule.h"
+#include "ThreadPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define __SAMPLEBLOCKPROCESSOR_SSE2__
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define __SAMPLEBLOCKPROCESSOR_NEON__
+#include <arm_neon.h>
+#endif
+
+// TXMSample keeps the first few samples behind the loop end in a backup
+// buffer while the loop is prepared for the mixer, and has to update the
+// loop state when the samples at the loop start are changed
+#define LOOPAREAMARGIN 8
+
+//////////////////////////////////////////////////////////////////////////
+// Conversion between sample data and float, the vector loops compute	//
+// the exact same values as the scalar ones								//
+//////////////////////////////////////////////////////////////////////////
+static inline float toFloat16(mp_sint32 s)
+{
+	return s > 0 ? (float)s*(1.0f/32767.0f) : (float)s*(1.0f/32768.0f);
+}
+
+static inline float toFloat8(mp_sint32 s)
+{
+	return s > 0 ? (float)s*(1.0f/127.0f) : (float)s*(1.0f/128.0f);
+}
+
+static inline float clip(float f)
+{
+	if (f > 1.0f)
+		f = 1.0f;
+	if (f < -1.0f)
+		f = -1.0f;
+	return f;
+}
+
+static inline mp_sword fromFloat16(float f)
+{
+	f = clip(f);
+	return f > 0 ? (mp_sword)(f*32767.0f+0.5f) : (mp_sword)(f*32768.0f-0.5f);
+}
+
+static inline mp_sbyte fromFloat8(float f)
+{
+	f = clip(f);
+	return f > 0 ? (mp_sbyte)(f*127.0f+0.5f) : (mp_sbyte)(f*128.0f-0.5f);
+}
+
+#if defined(__SAMPLEBLOCKPROCESSOR_SSE2__)
+static inline __m128 toFloatSSE2(__m128i x, __m128 posScale, __m128 negScale)
+{
+	const __m128 f = _mm_cvtepi32_ps(x);
+	const __m128 positive = _mm_cmpgt_ps(f, _mm_setzero_ps());
+	return _mm_mul_ps(f, _mm_or_ps(_mm_and_ps(positive, posScale), _mm_andnot_ps(positive, negScale)));
+}
+
+static inline __m128i fromFloatSSE2(__m128 f, __m128 posScale, __m128 negScale)
+{
+	const __m128 half = _mm_set1_ps(0.5f);
+	f = _mm_max_ps(_mm_min_ps(f, _mm_set1_ps(1.0f)), _mm_set1_ps(-1.0f));
+	const __m128 positive = _mm_cmpgt_ps(f, _mm_setzero_ps());
+	const __m128 p = _mm_add_ps(_mm_mul_ps(f, posScale), half);
+	const __m128 n = _mm_sub_ps(_mm_mul_ps(f, negScale), half);
+	return _mm_cvttps_epi32(_mm_or_ps(_mm_and_ps(positive, p), _mm_andnot_ps(positive, n)));
+}
+#elif defined(__SAMPLEBLOCKPROCESSOR_NEON__)
+static inline float32x4_t toFloatNEON(int32x4_t x, float32x4_t posScale, float32x4_t negScale)
+{
+	const float32x4_t f = vcvtq_f32_s32(x);
+	return vmulq_f32(f, vbslq_f32(vcgtq_f32(f, vdupq_n_f32(0.0f)), posScale, negScale));
+}
+
+static inline int32x4_t fromFloatNEON(float32x4_t f, float32x4_t posScale, float32x4_t negScale)
+{
+	const float32x4_t half = vdupq_n_f32(0.5f);
+	f = vmaxq_f32(vminq_f32(f, vdupq_n_f32(1.0f)), vdupq_n_f32(-1.0f));
+	const float32x4_t p = vaddq_f32(vmulq_f32(f, posScale), half);
+	const float32x4_t n = vsubq_f32(vmulq_f32(f, negScale), half);
+	return vcvtq_s32_f32(vbslq_f32(vcgtq_f32(f, vdupq_n_f32(0.0f)), p, n));
+}
+#endif
+
+static void convert16ToFloat(const mp_sword* src, float* dst, pp_int32 count)
+{
+	pp_int32 i = 0;
+#if defined(__SAMPLEBLOCKPROCESSOR_SSE2__)
+	const __m128 posScale = _mm_set1_ps(1.0f/32767.0f);
+	const __m128 negScale = _mm_set1_ps(1.0f/32768.0f);
+	for (; i + 8 <= count; i+=8)
+	{
+		const __m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+		_mm_storeu_ps(dst + i, toFloatSSE2(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16), posScale, negScale));
+		_mm_storeu_ps(dst + i + 4, toFloatSSE2(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16), posScale, negScale));
+	}
+#elif defined(__SAMPLEBLOCKPROCESSOR_NEON__)
+	const float32x4_t posScale = vdupq_n_f32(1.0f/32767.0f);
+	const float32x4_t negScale = vdupq_n_f32(1.0f/32768.0f);
+	for (; i + 8 <= count; i+=8)
+	{
+		const int16x8_t x = vld1q_s16(src + i);
+		vst1q_f32(dst + i, toFloatNEON(vmovl_s16(vget_low_s16(x)), posScale, negScale));
+		vst1q_f32(dst + i + 4, toFloatNEON(vmovl_s16(vget_high_s16(x)), posScale, negScale));
+	}
+#endif
+	for (; i < count; i++)
+		dst[i] = toFloat16(src[i]);
+}
+
+static void convert8ToFloat(const mp_sbyte* src, float* dst, pp_int32 count)
+{
+	pp_int32 i = 0;
+#if defined(__SAMPLEBLOCKPROCESSOR_SSE2__)
+	const __m128 posScale = _mm_set1_ps(1.0f/127.0f);
+	const __m128 negScale = _mm_set1_ps(1.0f/128.0f);
+	for (; i + 16 <= count; i+=16)
+	{
+		const __m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+		const __m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(x, x), 8);
+		const __m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(x, x), 8);
+		_mm_storeu_ps(dst + i, toFloatSSE2(_mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16), posScale, negScale));
+		_mm_storeu_ps(dst + i + 4, toFloatSSE2(_mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16), posScale, negScale));
+		_mm_storeu_ps(dst + i + 8, toFloatSSE2(_mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16), posScale, negScale));
+		_mm_storeu_ps(dst + i + 12, toFloatSSE2(_mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16), posScale, negScale));
+	}
+#elif defined(__SAMPLEBLOCKPROCESSOR_NEON__)
+	const float32x4_t posScale = vdupq_n_f32(1.0f/127.0f);
+	const float32x4_t negScale = vdupq_n_f32(1.0f/128.0f);
+	for (; i + 16 <= count; i+=16)
+	{
+		const int8x16_t x = vld1q_s8(src + i);
+		const int16x8_t lo = vmovl_s8(vget_low_s8(x));
+		const int16x8_t hi = vmovl_s8(vget_high_s8(x));
+		vst1q_f32(dst + i, toFloatNEON(vmovl_s16(vget_low_s16(lo)), posScale, negScale));
+		vst1q_f32(dst + i + 4, toFloatNEON(vmovl_s16(vget_high_s16(lo)), posScale, negScale));
+		vst1q_f32(dst + i + 8, toFloatNEON(vmovl_s16(vget_low_s16(hi)), posScale, negScale));
+		vst1q_f32(dst + i + 12, toFloatNEON(vmovl_s16(vget_high_s16(hi)), posScale, negScale));
+	}
+#endif
+	for (; i < count; i++)
+		dst[i] = toFloat8(src[i]);
+}
+
+static void convertFloatTo16(const float* src, mp_sword* dst, pp_int32 count)
+{
+	pp_int32 i = 0;
+#if defined(__SAMPLEBLOCKPROCESSOR_SSE2__)
+	const __m128 posScale = _mm_set1_ps(32767.0f);
+	const __m128 negScale = _mm_set1_ps(32768.0f);
+	for (; i + 8 <= count; i+=8)
+	{
+		const __m128i a = fromFloatSSE2(_mm_loadu_ps(src + i), posScale, negScale);
+		const __m128i b = fromFloatSSE2(_mm_loadu_ps(src + i + 4), posScale, negScale);
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(a, b));
+	}
+#elif defined(__SAMPLEBLOCKPROCESSOR_NEON__)
+	const float32x4_t posScale = vdupq_n_f32(32767.0f);
+	const float32x4_t negScale = vdupq_n_f32(32768.0f);
+	for (; i + 8 <= count; i+=8)
+	{
+		const int32x4_t a = fromFloatNEON(vld1q_f32(src + i), posScale, negScale);
+		const int32x4_t b = fromFloatNEON(vld1q_f32(src + i + 4), posScale, negScale);
+		vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+	}
+#endif
+	for (; i < count; i++)
+		dst[i] = fromFloat16(src[i]);
+}
+
+static void convertFloatTo8(const float* src, mp_sbyte* dst, pp_int32 count)
+{
+	pp_int32 i = 0;
+#if defined(__SAMPLEBLOCKPROCESSOR_SSE2__)
+	const __m128 posScale = _mm_set1_ps(127.0f);
+	const __m128 negScale = _mm_set1_ps(128.0f);
+	for (; i + 16 <= count; i+=16)
+	{
+		const __m128i a = fromFloatSSE2(_mm_loadu_ps(src + i), posScale, negScale);
+		const __m128i b = fromFloatSSE2(_mm_loadu_ps(src + i + 4), posScale, negScale);
+		const __m128i c = fromFloatSSE2(_mm_loadu_ps(src + i + 8), posScale, negScale);
+		const __m128i d = fromFloatSSE2(_mm_loadu_ps(src + i + 12), posScale, negScale);
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+	}
+#elif defined(__SAMPLEBLOCKPROCESSOR_NEON__)
+	const float32x4_t posScale = vdupq_n_f32(127.0f);
+	const float32x4_t negScale = vdupq_n_f32(128.0f);
+	for (; i + 16 <= count; i+=16)
+	{
+		const int16x8_t lo = vcombine_s16(vqmovn_s32(fromFloatNEON(vld1q_f32(src + i), posScale, negScale)),
+										  vqmovn_s32(fromFloatNEON(vld1q_f32(src + i + 4), posScale, negScale)));
+		const int16x8_t hi = vcombine_s16(vqmovn_s32(fromFloatNEON(vld1q_f32(src + i + 8), posScale, negScale)),
+										  vqmovn_s32(fromFloatNEON(vld1q_f32(src + i + 12), posScale, negScale)));
+		vst1q_s8(dst + i, vcombine_s8(vqmovn_s16(lo), vqmovn_s16(hi)));
+	}
+#endif
+	for (; i < count; i++)
+		dst[i] = fromFloat8(src[i]);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Filters used for the measurements, one per slice						//
+//////////////////////////////////////////////////////////////////////////
+class PeakMeter : public SampleBlockProcessor::Filter
+{
+public:
+	float peak;
+
+	PeakMeter() : peak(0.0f) {}
+
+	virtual void process(float* block, pp_int32, pp_int32 count)
+	{
+		for (pp_int32 i = 0; i < count; i++)
+		{
+			float f = block[i] < 0 ? -block[i] : block[i];
+			if (f > peak)
+				peak = f;
+		}
+	}
+};
+
+class SumMeter : public SampleBlockProcessor::Filter
+{
+public:
+	double sum;
+
+	SumMeter() : sum(0.0) {}
+
+	virtual void process(float* block, pp_int32, pp_int32 count)
+	{
+		// sum up every block on its own first, so the rounding error
+		// doesn't grow with the length of the sample
+		float blockSum = 0.0f;
+		for (pp_int32 i = 0; i < count; i++)
+			blockSum += block[i];
+		sum += blockSum;
+	}
+};
+
+// Processes one slice of the range on a thread of the pool
+class SampleBlockProcessorJob : public ThreadPool::Job
+{
+private:
+	SampleBlockProcessor& processor;
+	SampleBlockProcessor::Filter& filter;
+	pp_int32 start;
+	pp_int32 end;
+	bool writeBack;
+
+public:
+	SampleBlockProcessorJob(SampleBlockProcessor& processor,
+							SampleBlockProcessor::Filter& filter,
+							pp_int32 start, pp_int32 end,
+							bool writeBack) :
+		processor(processor),
+		filter(filter),
+		start(start),
+		end(end),
+		writeBack(writeBack)
+	{
+	}
+
+	virtual void run()
+	{
+		processor.processRange(filter, start, end, writeBack, true);
+	}
+};
+
+SampleBlockProcessor::SampleBlockProcessor(TXMSample* sample) :
+	sample(sample),
+	numLoopAreas(0)
+{
+	if (sample->type & 3)
+	{
+		pp_int32 loopStart = sample->loopstart;
+		pp_int32 loopEnd = sample->loopstart + sample->looplen;
+
+		loopAreaStart[0] = loopStart;
+		loopAreaEnd[0] = loopStart + LOOPAREAMARGIN;
+		numLoopAreas = 1;
+
+		// short loops have both areas overlap
+		if (loopEnd < loopAreaEnd[0])
+			loopAreaEnd[0] = loopEnd + LOOPAREAMARGIN;
+		else
+		{
+			loopAreaStart[1] = loopEnd;
+			loopAreaEnd[1] = loopEnd + LOOPAREAMARGIN;
+			numLoopAreas = 2;
+		}
+	}
+}
+
+bool SampleBlockProcessor::isLoopArea(pp_int32 index) const
+{
+	for (pp_int32 i = 0; i < numLoopAreas; i++)
+		if (index >= loopAreaStart[i] && index < loopAreaEnd[i])
+			return true;
+
+	return false;
+}
+
+pp_int32 SampleBlockProcessor::getDirectEnd(pp_int32 index, pp_int32 end) const
+{
+	for (pp_int32 i = 0; i < numLoopAreas; i++)
+	{
+		if (index >= loopAreaStart[i] && index < loopAreaEnd[i])
+			return index;
+		if (loopAreaStart[i] > index && loopAreaStart[i] < end)
+			end = loopAreaStart[i];
+	}
+
+	return end;
+}
+
+void SampleBlockProcessor::read(float* dst, pp_int32 index, pp_int32 count) const
+{
+	const pp_int32 end = index + count;
+	const bool is16Bit = (sample->type & 16) != 0;
+
+	while (index < end)
+	{
+		pp_int32 directEnd = getDirectEnd(index, end);
+		if (directEnd > index)
+		{
+			if (is16Bit)
+				convert16ToFloat((const mp_sword*)sample->sample + index, dst, directEnd - index);
+			else
+				convert8ToFloat(sample->sample + index, dst, directEnd - index);
+
+			dst+=directEnd - index;
+			index = directEnd;
+		}
+
+		for (; index < end && isLoopArea(index); index++)
+		{
+			mp_sint32 s = sample->getSampleValue(index);
+			*dst++ = is16Bit ? toFloat16(s) : toFloat8(s);
+		}
+	}
+}
+
+void SampleBlockProcessor::write(const float* src, pp_int32 index, pp_int32 count, bool skipLoopAreas)
+{
+	const pp_int32 end = index + count;
+	const bool is16Bit = (sample->type & 16) != 0;
+
+	while (index < end)
+	{
+		pp_int32 directEnd = getDirectEnd(index, end);
+		if (directEnd > index)
+		{
+			if (is16Bit)
+				convertFloatTo16(src, (mp_sword*)sample->sample + index, directEnd - index);
+			else
+				convertFloatTo8(src, sample->sample + index, directEnd - index);
+
+			src+=directEnd - index;
+			index = directEnd;
+		}
+
+		for (; index < end && isLoopArea(index); index++, src++)
+		{
+			if (!skipLoopAreas)
+				sample->setSampleValue(index, is16Bit ? fromFloat16(*src) : fromFloat8(*src));
+		}
+	}
+}
+
+void SampleBlockProcessor::processRange(Filter& filter, pp_int32 start, pp_int32 end, bool writeBack, bool skipLoopAreas)
+{
+	float* block = new float[BlockSize];
+
+	for (pp_int32 i = start; i < end; i+=BlockSize)
+	{
+		pp_int32 count = end - i < BlockSize ? end - i : BlockSize;
+
+		read(block, i, count);
+		filter.process(block, i, count);
+		if (writeBack)
+			write(block, i, count, skipLoopAreas);
+	}
+
+	delete[] block;
+}
+
+pp_int32 SampleBlockProcessor::getNumSlices(pp_int32 start, pp_int32 end) const
+{
+	pp_int32 numSlices = (end - start) / MinSliceSize;
+	pp_int32 numProcessors = ThreadPool::getNumProcessors();
+
+	if (numSlices > numProcessors)
+		numSlices = numProcessors;
+
+	return numSlices < 1 ? 1 : numSlices;
+}
+
+void SampleBlockProcessor::processSlices(Filter** filters, pp_int32 numSlices, pp_int32 start, pp_int32 end, bool writeBack)
+{
+	if (numSlices <= 1)
+	{
+		processRange(*filters[0], start, end, writeBack, false);
+		return;
+	}
+
+	// slices start on block boundaries
+	pp_int32 sliceSize = ((end - start) / numSlices + BlockSize - 1) / BlockSize * BlockSize;
+
+	SampleBlockProcessorJob** jobs = new SampleBlockProcessorJob*[numSlices];
+
+	pp_int32 i;
+	ThreadPool pool(numSlices);
+	for (i = 0; i < numSlices; i++)
+	{
+		pp_int32 sliceStart = start + i*sliceSize;
+		pp_int32 sliceEnd = i == numSlices-1 ? end : sliceStart + sliceSize;
+		if (sliceStart > end)
+			sliceStart = end;
+		if (sliceEnd > end)
+			sliceEnd = end;
+
+		jobs[i] = new SampleBlockProcessorJob(*this, *filters[i], sliceStart, sliceEnd, writeBack);
+		pool.addJob(jobs[i]);
+	}
+
+	pool.waitForAll();
+
+	for (i = 0; i < numSlices; i++)
+		delete jobs[i];
+	delete[] jobs;
+
+	// writing the loop areas changes the loop state of the sample,
+	// that's left to this thread
+	if (writeBack)
+	{
+		for (i = 0; i < numLoopAreas; i++)
+		{
+			pp_int32 areaStart = loopAreaStart[i] > start ? loopAreaStart[i] : start;
+			pp_int32 areaEnd = loopAreaEnd[i] < end ? loopAreaEnd[i] : end;
+			if (areaStart < areaEnd)
+				processRange(*filters[0], areaStart, areaEnd, true, false);
+		}
+	}
+}
+
+void SampleBlockProcessor::process(Filter& filter, pp_int32 start, pp_int32 end)
+{
+	processRange(filter, start, end, true, false);
+}
+
+void SampleBlockProcessor::analyse(Filter& filter, pp_int32 start, pp_int32 end)
+{
+	processRange(filter, start, end, false, false);
+}
+
+void SampleBlockProcessor::processParallel(Filter& filter, pp_int32 start, pp_int32 end)
+{
+	pp_int32 numSlices = getNumSlices(start, end);
+
+	Filter** filters = new Filter*[numSlices];
+	for (pp_int32 i = 0; i < numSlices; i++)
+		filters[i] = &filter;
+
+	processSlices(filters, numSlices, start, end, true);
+
+	delete[] filters;
+}
+
+float SampleBlockProcessor::getPeak(pp_int32 start, pp_int32 end)
+{
+	pp_int32 numSlices = getNumSlices(start, end);
+
+	PeakMeter* meters = new PeakMeter[numSlices];
+	Filter** filters = new Filter*[numSlices];
+	pp_int32 i;
+	for (i = 0; i < numSlices; i++)
+		filters[i] = &meters[i];
+
+	processSlices(filters, numSlices, start, end, false);
+
+	float peak = 0.0f;
+	for (i = 0; i < numSlices; i++)
+		if (meters[i].peak > peak)
+			peak = meters[i].peak;
+
+	delete[] filters;
+	delete[] meters;
+
+	return peak;
+}
+
+double SampleBlockProcessor::getSum(pp_int32 start, pp_int32 end)
+{
+	pp_int32 numSlices = getNumSlices(start, end);
+
+	SumMeter* meters = new SumMeter[numSlices];
+	Filter** filters = new Filter*[numSlices];
+	pp_int32 i;
+	for (i = 0; i < numSlices; i++)
+		filters[i] = &meters[i];
+
+	processSlices(filters, numSlices, start, end, false);
+
+	double sum = 0.0;
+	for (i = 0; i < numSlices; i++)
+		sum += meters[i].sum;
+
+	delete[] filters;
+	delete[] meters;
+
+	return sum;
+}
@@ -0,0 +1,106 @@
+/*
+ *  tracker/SampleBlockProcessor.h
+ *
+ *  Copyright 2009 Peter Barth
+ *
+ *  This file is part of Milkytracker.
+ *
+ *  Milkytracker is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Milkytracker is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Milkytracker.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ *  SampleBlockProcessor.h
+ *  milkytracker
+ *
+ *  Runs sample editor filters on blocks of float samples instead of
+ *  converting every single sample from and into the 8/16 bit storage.
+ *  The conversion uses the same scaling and rounding as
+ *  SampleEditor::getFloatSampleFromWaveform/setFloatSampleInWaveform.
+ *  Filters which don't carry any state from one sample to the next can be
+ *  run on several threads, the range is split into one slice per thread then.
+ *
+ */
+
+#ifndef __SAMPLEBLOCKPROCESSOR_H__
+#define __SAMPLEBLOCKPROCESSOR_H__
+
+#include "BasicTypes.h"
+
+struct TXMSample;
+
+class SampleBlockProcessor
+{
+public:
+	enum
+	{
+		BlockSize = 4096,
+		// don't bother starting threads for less than this
+		MinSliceSize = 65536
+	};
+
+	class Filter
+	{
+	public:
+		virtual ~Filter() {}
+
+		// block holds count samples starting at sample index "index",
+		// changes are written back to the sample unless the range is only
+		// being analysed
+		virtual void process(float* block, pp_int32 index, pp_int32 count) = 0;
+	};
+
+private:
+	TXMSample* sample;
+
+	// samples around the loop start and end which have to be accessed
+	// through TXMSample::getSampleValue/setSampleValue: [start, end)
+	pp_int32 loopAreaStart[2];
+	pp_int32 loopAreaEnd[2];
+	pp_int32 numLoopAreas;
+
+	bool isLoopArea(pp_int32 index) const;
+	// end of the samples starting at index which can be accessed directly
+	pp_int32 getDirectEnd(pp_int32 index, pp_int32 end) const;
+
+	void write(const float* src, pp_int32 index, pp_int32 count, bool skipLoopAreas);
+
+	void processRange(Filter& filter, pp_int32 start, pp_int32 end, bool writeBack, bool skipLoopAreas);
+	pp_int32 getNumSlices(pp_int32 start, pp_int32 end) const;
+	void processSlices(Filter** filters, pp_int32 numSlices, pp_int32 start, pp_int32 end, bool writeBack);
+
+	friend class SampleBlockProcessorJob;
+
+public:
+	SampleBlockProcessor(TXMSample* sample);
+
+	void read(float* dst, pp_int32 index, pp_int32 count) const;
+	// values are clipped to [-1.0, 1.0]
+	void write(const float* src, pp_int32 index, pp_int32 count) { write(src, index, count, false); }
+
+	// filter [start, end) block by block in ascending order
+	void process(Filter& filter, pp_int32 start, pp_int32 end);
+	// same without writing anything back
+	void analyse(Filter& filter, pp_int32 start, pp_int32 end);
+	// the filter's process() is called from several threads at once and must
+	// not depend on the blocks it has seen before
+	void processParallel(Filter& filter, pp_int32 start, pp_int32 end);
+
+	// largest absolute sample value in [start, end)
+	float getPeak(pp_int32 start, pp_int32 end);
+	// sum of the sample values in [start, end)
+	double getSum(pp_int32 start, pp_int32 end);
+};
+
+#endif
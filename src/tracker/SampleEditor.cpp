@@ -32,11 +32,13 @@
  */
 
 #include "SampleEditor.h"
+#include "PlayerCriticalSection.h"
 #include "SimpleVector.h"
 #include "XModule.h"
 #include "VRand.h"
 #include "FilterParameters.h"
 #include "SampleEditorResampler.h"
+#include "SampleBlockProcessor.h"
 #include "PlayerMaster.h"
 
 #define ZEROCROSS(a,b) (a > 0.0 && b <= 0.0 || a < 0.0 && b >= 0.0)
@@ -185,10 +187,12 @@ void SampleEditor::prepareUndo()
 		undoUserData.clear();
 		notifyListener(NotificationFeedUndoData);
 
+		// the current state is usually on the stack already, share its chunks
 		before = new SampleUndoStackEntry(*sample, 
 										  getSelectionStart(), 
 										  getSelectionEnd(), 
-										  &undoUserData);
+										  &undoUserData,
+										  undoStack->GetCurrent());
 	}
 }
 
@@ -206,10 +210,12 @@ void SampleEditor::finishUndo()
 		// we want some user data now
 		notifyListener(NotificationFeedUndoData);
 
-		SampleUndoStackEntry after(SampleUndoStackEntry(*sample, 
-										 getSelectionStart(), 
-										 getSelectionEnd(), 
-										 &undoUserData)); 
+		// only the chunks the operation touched are stored again
+		SampleUndoStackEntry after(*sample, 
+								   getSelectionStart(), 
+								   getSelectionEnd(), 
+								   &undoUserData,
+								   before); 
 		if (*before != after) 
 		{ 
 			if (undoStack) 
@@ -217,6 +223,8 @@ void SampleEditor::finishUndo()
 				undoStack->Push(*before); 
 				undoStack->Push(after); 
 				undoStack->Pop(); 
+				
+				trimUndoStack();
 			} 
 		} 
 	} 
@@ -225,47 +233,87 @@ void SampleEditor::finishUndo()
 	notifyListener(NotificationChanges);			
 }
 	
+void SampleEditor::trimUndoStack()
+{
+	// entries only own the chunks they don't share with their predecessor
+	pp_uint32 memSize = 0;
+	const SampleUndoStackEntry* prev = NULL;
+	for (pp_int32 i = 0; i < undoStack->GetNumEntries(); i++)
+	{
+		const SampleUndoStackEntry* entry = undoStack->GetEntry(i);
+		memSize+=entry->getMemSize(prev);
+		prev = entry;
+	}
+	
+	while (memSize > undoMemoryLimit && undoStack->GetNumEntries() > 1)
+	{
+		const SampleUndoStackEntry* bottom = undoStack->GetEntry(0);
+		const SampleUndoStackEntry* next = undoStack->GetEntry(1);
+		pp_uint32 newMemSize = memSize - bottom->getMemSize() - next->getMemSize(bottom) + next->getMemSize();
+		
+		if (!undoStack->RemoveBottom())
+			break;
+		
+		memSize = newMemSize;
+	}
+}
+
 bool SampleEditor::revoke(const SampleUndoStackEntry* stackEntry)
 {
 	if (sample == NULL)
 		return false;
 	 if (undoStack == NULL || !undoStackEnabled)
 		return false;
-		
-	sample->samplen = stackEntry->getSampLen();
-	sample->loopstart = stackEntry->getLoopStart(); 
-	sample->looplen = stackEntry->getLoopLen(); 
-	sample->relnote = stackEntry->getRelNote(); 
-	sample->finetune = stackEntry->getFineTune(); 
-	sample->type = (mp_ubyte)stackEntry->getFlags();
+	
+	TXMSample newSample = *sample;
+	newSample.samplen = stackEntry->getSampLen();
+	newSample.loopstart = stackEntry->getLoopStart(); 
+	newSample.looplen = stackEntry->getLoopLen(); 
+	newSample.relnote = stackEntry->getRelNote(); 
+	newSample.finetune = stackEntry->getFineTune(); 
+	newSample.type = (mp_ubyte)stackEntry->getFlags();
+	newSample.sample = NULL;
+	
+	if (stackEntry->hasBuffer())
+	{			
+		if (newSample.type & 16)
+			newSample.sample = (mp_sbyte*)module->allocSampleMem(newSample.samplen*2);
+		else
+			newSample.sample = (mp_sbyte*)module->allocSampleMem(newSample.samplen);
+		stackEntry->copyBuffer(newSample.sample);
+	}
 	
 	setSelectionStart(stackEntry->getSelectionStart());
 	setSelectionEnd(stackEntry->getSelectionEnd());
 	
-	enterCriticalSection();
+	mp_sbyte* oldSample = sample->sample;
 	
-	// free old sample memory
-	if (sample->sample)
+	// the player picks up the new data at the next beat packet,
+	// so there's no need to stop playback
+	if (playerCriticalSection)
 	{
-		module->freeSampleMem((mp_ubyte*)sample->sample);
-		sample->sample = NULL;
+		playerCriticalSection->swapSample(*sample, newSample);
 	}
-	
-	if (stackEntry->getBuffer())
-	{			
-		if (sample->type & 16)
-		{
-			sample->sample = (mp_sbyte*)module->allocSampleMem(sample->samplen*2);
-			TXMSample::copyPaddedMem(sample->sample, stackEntry->getBuffer(), sample->samplen*2);
-		}
-		else
-		{
-			sample->sample = (mp_sbyte*)module->allocSampleMem(sample->samplen);
-			TXMSample::copyPaddedMem(sample->sample, stackEntry->getBuffer(), sample->samplen);
-		}
+	else
+	{
+		enterCriticalSection();
+		
+		sample->samplen = newSample.samplen;
+		sample->loopstart = newSample.loopstart; 
+		sample->looplen = newSample.looplen; 
+		sample->relnote = newSample.relnote; 
+		sample->finetune = newSample.finetune; 
+		sample->type = newSample.type;
+		sample->sample = newSample.sample;
+		
+		leaveCriticalSection();
 	}
 	
-	leaveCriticalSection();
+	// free old sample memory
+	if (oldSample)
+		module->freeSampleMem((mp_ubyte*)oldSample);
+	
+	peakCache.invalidateAll();
 	undoUserData = stackEntry->getUserData();
 	notifyListener(NotificationFetchUndoData);
 	notifyListener(NotificationChanges);
@@ -297,6 +345,8 @@ SampleEditor::SampleEditor() :
 	undoStackActivated(true),	
 	before(NULL),
 	undoStack(NULL),
+	undoMemoryLimit(UNDOMEMORY_SAMPLEEDITOR*1024*1024),
+	playerCriticalSection(NULL),
 	lastOperationDidChangeSize(false),
 	lastOperation(OperationRegular),
 	drawing(false),
@@ -362,6 +412,8 @@ void SampleEditor::attachSample(TXMSample* sample, XModule* module)
 	this->sample = sample;
 	attachModule(module);
 
+	peakCache.invalidateAll();
+
 	resetSelection();
 	
 	notifyListener(NotificationReload);
@@ -429,6 +481,13 @@ void SampleEditor::enableUndoStack(bool enable)
 	reset();
 }
 
+void SampleEditor::setUndoMemoryLimit(pp_uint32 limit)
+{
+	undoMemoryLimit = limit;
+	if (undoStackEnabled && undoStack)
+		trimUndoStack();
+}
+
 bool SampleEditor::undo()
 {
 	if (!undoStackEnabled || undoStack == NULL) return false;
@@ -1163,7 +1222,10 @@ void SampleEditor::setFloatSampleInWaveform(pp_int32 index, float singleSample,
 		if (src)
 			*(((mp_sword*)src)+index) = s;
 		else
+		{
 			sample->setSampleValue(index, s);
+			peakCache.invalidate(index, index+1);
+		}
 	}
 	else
 	{
@@ -1171,7 +1233,10 @@ void SampleEditor::setFloatSampleInWaveform(pp_int32 index, float singleSample,
 		if (src)
 			*(((mp_sbyte*)src)+index) = s;
 		else
+		{
 			sample->setSampleValue(index, s);
+			peakCache.invalidate(index, index+1);
+		}
 	}
 }
 
@@ -1210,6 +1275,10 @@ void SampleEditor::preFilter(TFilterFunc filterFuncPtr, const FilterParameters*
 
 void SampleEditor::postFilter()
 {
+	// these replace the sample memory, which might end up at the same address
+	if (lastOperation != OperationRegular)
+		peakCache.invalidateAll();
+
 	notifyListener(NotificationUnprepareLengthy);
 
 	leaveCriticalSection();
@@ -1801,6 +1870,7 @@ void SampleEditor::tool_foldSample(const FilterParameters* par)
 		                        : sample->getSampleValue(i)*0.5 + sample->getSampleValue(i+sEnd)*0.5;
 		sample->setSampleValue( i, mix);
 	}
+	peakCache.invalidate(0, sEnd);
 
 	finishUndo();	
 	
@@ -1814,6 +1884,41 @@ void SampleEditor::tool_foldSample(const FilterParameters* par)
 	setLoopType(1);
 }
 
+// Volume ramp from startScale on, the scale is accumulated sample by 
+// sample like it always was, so a ramp needs the blocks in order
+class ScaleFilter : public SampleBlockProcessor::Filter
+{
+private:
+	float scale;
+	float step;
+	
+public:
+	ScaleFilter(float startScale, float step) :
+		scale(startScale),
+		step(step)
+	{
+	}
+	
+	virtual void process(float* block, pp_int32, pp_int32 count)
+	{
+		pp_int32 i;
+		
+		// constant scale, nothing changes here and it can be run in parallel
+		if (step == 0.0f)
+		{
+			for (i = 0; i < count; i++)
+				block[i] *= scale;
+			return;
+		}
+		
+		for (i = 0; i < count; i++)
+		{
+			block[i] *= scale;
+			scale+=step;
+		}
+	}
+};
+
 void SampleEditor::tool_scaleSample(const FilterParameters* par)
 {
 	if (isEmptySample())
@@ -1847,12 +1952,13 @@ void SampleEditor::tool_scaleSample(const FilterParameters* par)
 	
 	float step = (endScale - startScale) / (float)(sEnd - sStart);
 	
-	for (pp_int32 i = sStart; i < sEnd; i++)
-	{
-		float f = getFloatSampleFromWaveform(i);
-		setFloatSampleInWaveform(i, f*startScale);
-		startScale+=step;
-	}
+	SampleBlockProcessor processor(sample);
+	ScaleFilter filter(startScale, step);
+	if (step == 0.0f)
+		processor.processParallel(filter, sStart, sEnd);
+	else
+		processor.process(filter, sStart, sEnd);
+	peakCache.invalidate(sStart, sEnd);
 				
 	finishUndo();	
 	
@@ -1888,23 +1994,16 @@ void SampleEditor::tool_normalizeSample(const FilterParameters* par)
 	prepareUndo();
 	
 	float maxLevel = ((par == NULL)? 1.0f : par->getParameter(0).floatPart);
-	float peak = 0.0f;
 
-	pp_int32 i;
-
-	// find peak value
-	for (i = sStart; i < sEnd; i++)
-	{
-		float f = getFloatSampleFromWaveform(i);
-		if (ppfabs(f) > peak) peak = ppfabs(f);
-	}
-	
-	float scale = maxLevel / peak;
+	SampleBlockProcessor processor(sample);
+	float peak = processor.getPeak(sStart, sEnd);
 	
-	for (i = sStart; i < sEnd; i++)
+	// nothing to scale in silence
+	if (peak > 0.0f)
 	{
-		float f = getFloatSampleFromWaveform(i);
-		setFloatSampleInWaveform(i, f*scale);
+		ScaleFilter filter(maxLevel / peak, 0.0f);
+		processor.processParallel(filter, sStart, sEnd);
+		peakCache.invalidate(sStart, sEnd);
 	}
 				
 	finishUndo();	
@@ -1912,6 +2011,132 @@ void SampleEditor::tool_normalizeSample(const FilterParameters* par)
 	postFilter();
 }
 
+// Scaling limiter inspired by awesome 'TAP scaling limiter':
+// every waveset (the samples between two zero crossings) peaking above
+// the treshold is scaled down to the treshold.
+// The detector collects the wavesets in a first pass, so the scaler 
+// applying the gains has no state and can process the sample in parallel.
+class WavesetDetector : public SampleBlockProcessor::Filter
+{
+public:
+	struct TWaveset
+	{
+		pp_int32 start;
+		pp_int32 end;
+		float scale;
+	};
+
+private:
+	float peakTreshold;
+	
+	TWaveset* wavesets;
+	pp_int32 numWavesets;
+	pp_int32 numWavesetsAllocated;
+
+	float last;
+	pp_int32 zerocross;
+	float wpeak;
+
+	void addWaveset(pp_int32 start, pp_int32 end, float scale)
+	{
+		if (numWavesets == numWavesetsAllocated)
+		{
+			numWavesetsAllocated = numWavesetsAllocated ? numWavesetsAllocated*2 : 256;
+			TWaveset* newWavesets = new TWaveset[numWavesetsAllocated];
+			for (pp_int32 i = 0; i < numWavesets; i++)
+				newWavesets[i] = wavesets[i];
+			delete[] wavesets;
+			wavesets = newWavesets;
+		}
+		
+		wavesets[numWavesets].start = start;
+		wavesets[numWavesets].end = end;
+		wavesets[numWavesets].scale = scale;
+		numWavesets++;
+	}
+
+public:
+	WavesetDetector(float peakTreshold) :
+		peakTreshold(peakTreshold),
+		wavesets(NULL),
+		numWavesets(0),
+		numWavesetsAllocated(0),
+		last(0.0f),
+		zerocross(-1),
+		wpeak(0.0f)
+	{
+	}
+	
+	virtual ~WavesetDetector()
+	{
+		delete[] wavesets;
+	}
+	
+	virtual void process(float* block, pp_int32 index, pp_int32 count)
+	{
+		for (pp_int32 i = 0; i < count; i++)
+		{
+			float f = block[i];
+			if (ZEROCROSS(f, last))
+			{
+				// detected waveset, scale it down if it exceeds the treshold
+				if (zerocross >= 0 && wpeak > peakTreshold)
+					addWaveset(zerocross, index + i, peakTreshold / wpeak);
+				
+				zerocross = index + i;
+				wpeak = 0.0f;
+			}
+			if (ppfabs(f) > wpeak) wpeak = ppfabs(f);
+			last = f;
+		}
+	}
+	
+	const TWaveset* getWavesets() const { return wavesets; }
+	pp_int32 getNumWavesets() const { return numWavesets; }
+};
+
+class WavesetScaler : public SampleBlockProcessor::Filter
+{
+private:
+	const WavesetDetector::TWaveset* wavesets;
+	pp_int32 numWavesets;
+	float postScale;
+	
+public:
+	WavesetScaler(const WavesetDetector& detector, float postScale) :
+		wavesets(detector.getWavesets()),
+		numWavesets(detector.getNumWavesets()),
+		postScale(postScale)
+	{
+	}
+
+	virtual void process(float* block, pp_int32 index, pp_int32 count)
+	{
+		// first waveset ending behind the start of the block
+		pp_int32 l = 0, r = numWavesets;
+		while (l < r)
+		{
+			pp_int32 m = (l + r) >> 1;
+			if (wavesets[m].end <= index)
+				l = m + 1;
+			else
+				r = m;
+		}
+		
+		for (pp_int32 i = 0; i < count; i++)
+		{
+			pp_int32 pos = index + i;
+			while (l < numWavesets && wavesets[l].end <= pos)
+				l++;
+			
+			if (l < numWavesets && wavesets[l].start <= pos)
+				block[i] *= wavesets[l].scale * postScale;
+			else
+				block[i] *= postScale;
+		}
+	}
+};
+
 void SampleEditor::tool_compressSample(const FilterParameters* par)
 {
 	if (isEmptySample())
@@ -1940,55 +2165,23 @@ void SampleEditor::tool_compressSample(const FilterParameters* par)
 
 	prepareUndo();
 
-	pp_int32 i;
-	float peak = 0.0f;
+	SampleBlockProcessor processor(sample);
 
 	// find peak value (pre)
-	for (i = sStart; i < sEnd; i++)
-	{
-		float f = getFloatSampleFromWaveform(i);
-		if (ppfabs(f) > peak) peak = ppfabs(f);
-	}
+	float peak = processor.getPeak(sStart, sEnd);
 
-	float max = 0.0f;
-	float compress = peak * 0.66;
-	float last  = 0.0;
-	float wpeak = 0.0;
-	int zerocross[2];
-	zerocross[0] = -1;
-	zerocross[1] = -1;
-	float treshold = 0.8;
-	float peakTreshold = peak * treshold;
+	if (peak > 0.0f)
+	{
+		float treshold = 0.8;
+		float peakTreshold = peak * treshold;
 
-	// scaling limiter inspired by awesome 'TAP scaling limiter'
-	for (i = sStart; i < sEnd; i++) {
-		float f = getFloatSampleFromWaveform(i);
-		if (ZEROCROSS(f, last)) {
-			zerocross[0] = zerocross[1];
-			zerocross[1] = i;
-			if (zerocross[0] >= 0 && zerocross[1] > 0) {                   // detected waveset 
-				wpeak = 0;
-				for (int j = zerocross[0]; j < zerocross[1]; j++) {        // get peak from waveset
-					float w = getFloatSampleFromWaveform(j);
-					if (ppfabs(w) > wpeak) wpeak = ppfabs(w);
-				}
-				if (wpeak > peakTreshold) {                                    // scale down waveset if wpeak exceeds treshold
-					for (int j = zerocross[0]; j < zerocross[1]; j++) {
-						float b = getFloatSampleFromWaveform(j) * (peakTreshold / wpeak);
-						this->setFloatSampleInWaveform(j,b );
-					}
-				}
-			}
-		}
-		last = f;
-	}
+		WavesetDetector detector(peakTreshold);
+		processor.analyse(detector, sStart, sEnd);
 
-	// post-compensate amplitudes 
-	float scale = (peak/peakTreshold);
-	for (i = sStart; i < sEnd; i++)
-	{
-		float f = getFloatSampleFromWaveform(i);
-		setFloatSampleInWaveform(i, f * scale);
+		// post-compensate amplitudes 
+		WavesetScaler scaler(detector, peak/peakTreshold);
+		processor.processParallel(scaler, sStart, sEnd);
+		peakCache.invalidate(sStart, sEnd);
 	}
 
 	finishUndo();
@@ -2315,6 +2508,7 @@ void SampleEditor::tool_changeSignSample(const FilterParameters* par)
 			smp[i] ^= mask;
 		}
 	}
+	peakCache.invalidate(sStart, sEnd);
 	
 	finishUndo();	
 	
@@ -2360,6 +2554,7 @@ void SampleEditor::tool_swapByteOrderSample(const FilterParameters* par)
 		mp_uword s = (smp[i] >> 8) | ((smp[i] & 0xFF) << 8);
 		smp[i] = s;
 	}
+	peakCache.invalidate(sStart, sEnd);
 	
 	finishUndo();	
 	
@@ -2408,6 +2603,24 @@ void SampleEditor::tool_resampleSample(const FilterParameters* par)
 	postFilter();
 }
 
+class OffsetFilter : public SampleBlockProcessor::Filter
+{
+private:
+	float offset;
+	
+public:
+	OffsetFilter(float offset) :
+		offset(offset)
+	{
+	}
+	
+	virtual void process(float* block, pp_int32, pp_int32 count)
+	{
+		for (pp_int32 i = 0; i < count; i++)
+			block[i] += offset;
+	}
+};
+
 void SampleEditor::tool_DCNormalizeSample(const FilterParameters* par)
 {
 	if (isEmptySample())
@@ -2436,18 +2649,13 @@ void SampleEditor::tool_DCNormalizeSample(const FilterParameters* par)
 	
 	prepareUndo();
 	
-	pp_int32 i;
+	SampleBlockProcessor processor(sample);
 
-	float DC = 0.0f;
-	for (i = sStart; i < sEnd; i++)
-	{
-		DC += getFloatSampleFromWaveform(i);		
-	}
-	DC = DC / (float)(sEnd-sStart);
-	for (i = sStart; i < sEnd; i++)
-	{
-		setFloatSampleInWaveform(i, getFloatSampleFromWaveform(i) - DC);
-	}
+	float DC = (float)(processor.getSum(sStart, sEnd) / (double)(sEnd-sStart));
+	
+	OffsetFilter filter(-DC);
+	processor.processParallel(filter, sStart, sEnd);
+	peakCache.invalidate(sStart, sEnd);
 	
 	finishUndo();	
 	
@@ -2482,19 +2690,99 @@ void SampleEditor::tool_DCOffsetSample(const FilterParameters* par)
 	
 	prepareUndo();
 	
-	pp_int32 i;
+	SampleBlockProcessor processor(sample);
 
-	float DC = par->getParameter(0).floatPart;
-	for (i = sStart; i < sEnd; i++)
-	{
-		setFloatSampleInWaveform(i, getFloatSampleFromWaveform(i) + DC);
-	}
+	OffsetFilter filter(par->getParameter(0).floatPart);
+	processor.processParallel(filter, sStart, sEnd);
+	peakCache.invalidate(sStart, sEnd);
 	
 	finishUndo();	
 	
 	postFilter();
 }
 
+// 3 tap rectangular or 5 tap triangular smoothing, samples outside the 
+// selection are replaced by the first/last sample of the selection.
+// The neighbours on the left have already been overwritten when a block
+// is processed, so they're kept from the previous block, the ones on the 
+// right are read ahead.
+class SmoothFilter : public SampleBlockProcessor::Filter
+{
+public:
+	enum Kernels
+	{
+		Rectangular = 1,
+		Triangular = 2
+	};
+	
+private:
+	const SampleBlockProcessor& processor;
+	pp_int32 start;
+	pp_int32 end;
+	pp_int32 radius;
+	
+	// the block surrounded by radius samples on either side
+	float* buffer;
+	float history[Triangular];
+	
+public:
+	SmoothFilter(const SampleBlockProcessor& processor, pp_int32 start, pp_int32 end, Kernels kernel) :
+		processor(processor),
+		start(start),
+		end(end),
+		radius(kernel)
+	{
+		buffer = new float[SampleBlockProcessor::BlockSize + 2*Triangular];
+	}
+	
+	virtual ~SmoothFilter()
+	{
+		delete[] buffer;
+	}
+	
+	virtual void process(float* block, pp_int32 index, pp_int32 count)
+	{
+		pp_int32 i;
+		
+		if (index == start)
+		{
+			for (i = 0; i < radius; i++)
+				history[i] = block[0];
+		}
+		
+		for (i = 0; i < radius; i++)
+			buffer[i] = history[i];
+		
+		memcpy(buffer + radius, block, count*sizeof(float));
+		
+		pp_int32 ahead = end - (index + count);
+		if (ahead > radius)
+			ahead = radius;
+		processor.read(buffer + radius + count, index + count, ahead);
+		for (i = radius + count + ahead; i < count + 2*radius; i++)
+			buffer[i] = buffer[i-1];
+
+		// the last samples of this block before they're overwritten
+		for (i = 0; i < radius; i++)
+			history[i] = buffer[count + i];
+
+		if (radius == Rectangular)
+		{
+			for (i = 0; i < count; i++)
+				block[i] = (buffer[i] + buffer[i+1] + buffer[i+2]) * (1.0f/3.0f);
+		}
+		else
+		{
+			for (i = 0; i < count; i++)
+				block[i] = (buffer[i] + 
+							buffer[i+1]*2.0f + 
+							buffer[i+2]*3.0f + 
+							buffer[i+3]*2.0f + 
+							buffer[i+4]) * (1.0f/9.0f);
+		}
+	}
+};
+
 void SampleEditor::tool_rectangularSmoothSample(const FilterParameters* par)
 {
 	if (isEmptySample())
@@ -2521,28 +2809,12 @@ void SampleEditor::tool_rectangularSmoothSample(const FilterParameters* par)
 	
 	preFilter(&SampleEditor::tool_rectangularSmoothSample, par);
 	
-	mp_sint32 sLen = sEnd - sStart;
-	
-	mp_ubyte* buffer = new mp_ubyte[(sample->type & 16) ? sLen*2 : sLen];
-	if (!buffer)
-		return;
-
-	memcpy(buffer, sample->sample + sStart, (sample->type & 16) ? sLen*2 : sLen);
-
 	prepareUndo();	
 	
-	pp_int32 i;
-
-	for (i = sStart; i < sEnd; i++)
-	{
-		float f = (getFloatSampleFromWaveform(i - sStart - 1, buffer, sLen) +
-				  getFloatSampleFromWaveform(i - sStart, buffer, sLen) +
-				  getFloatSampleFromWaveform(i - sStart + 1, buffer, sLen)) * (1.0f/3.0f);
-				  
-		setFloatSampleInWaveform(i, f);		
-	}
-	
-	delete[] buffer;
+	SampleBlockProcessor processor(sample);
+	SmoothFilter filter(processor, sStart, sEnd, SmoothFilter::Rectangular);
+	processor.process(filter, sStart, sEnd);
+	peakCache.invalidate(sStart, sEnd);
 	
 	finishUndo();	
 	
@@ -2575,35 +2847,81 @@ void SampleEditor::tool_triangularSmoothSample(const FilterParameters* par)
 	
 	preFilter(&SampleEditor::tool_triangularSmoothSample, par);
 	
-	mp_sint32 sLen = sEnd - sStart;
+	prepareUndo();	
 	
-	mp_ubyte* buffer = new mp_ubyte[(sample->type & 16) ? sLen*2 : sLen];
-	if (!buffer)
-		return;
+	SampleBlockProcessor processor(sample);
+	SmoothFilter filter(processor, sStart, sEnd, SmoothFilter::Triangular);
+	processor.process(filter, sStart, sEnd);
+	peakCache.invalidate(sStart, sEnd);
+	
+	finishUndo();	
 
-	memcpy(buffer, sample->sample + sStart, (sample->type & 16) ? sLen*2 : sLen);
+	postFilter();
+}
 
-	prepareUndo();	
+// Cascaded equalizer bands, the selective version blends between the 
+// filtered and the original signal by the (stretched) clipboard contents
+class EQFilter : public SampleBlockProcessor::Filter
+{
+private:
+	Equalizer** eqs;
+	pp_int32 numEqs;
+	SampleEditor::ClipBoard* clipBoard;
+	float step;
+	float j2;
 	
-	pp_int32 i;
-
-	for (i = sStart; i < sEnd; i++)
+public:
+	EQFilter(Equalizer** eqs, pp_int32 numEqs, SampleEditor::ClipBoard* clipBoard, float step) :
+		eqs(eqs),
+		numEqs(numEqs),
+		clipBoard(clipBoard),
+		step(step),
+		j2(0.0f)
 	{
-		float f = (getFloatSampleFromWaveform(i - sStart - 2, buffer, sLen) +
-				   getFloatSampleFromWaveform(i - sStart - 1, buffer, sLen)*2.0f +
-				   getFloatSampleFromWaveform(i - sStart, buffer, sLen)*3.0f +
-				   getFloatSampleFromWaveform(i - sStart + 1, buffer, sLen)*2.0f +
-				   getFloatSampleFromWaveform(i - sStart + 2, buffer, sLen)) * (1.0f/9.0f);
-				  
-		setFloatSampleInWaveform(i, f);		
 	}
 	
-	delete[] buffer;
-	
-	finishUndo();	
+	virtual void process(float* block, pp_int32, pp_int32 count)
+	{
+		for (pp_int32 i = 0; i < count; i++)
+		{
+			// Fetch a stereo signal
+			double xL = block[i];
+			double xR = xL;
+			float x = (float)xL;
+				
+			for (pp_int32 j = 0; j < numEqs; j++)
+			{
+				double yL, yR;
+				// Pass the stereo input
+				eqs[j]->Filter(xL, xR, yL, yR);
+				
+				xL = yL;
+				xR = yR;
+			}
+			if (clipBoard)
+			{
+				float frac = j2 - (float)floor(j2);
+			
+				pp_int16 s = clipBoard->getSampleWord((pp_int32)j2);
+				float f1 = s < 0 ? (s/32768.0f) : (s/32767.0f);
+				s = clipBoard->getSampleWord((pp_int32)j2+1);
+				float f2 = s < 0 ? (s/32768.0f) : (s/32767.0f);
 
-	postFilter();
-}
+				float f = (1.0f-frac)*f1 + frac*f2;
+
+				if (f>=0) {
+					x = f * ((float)xL) + (1.0f-f) * x;
+				} else {
+					x = -f * (x-(float)xL) + (1.0+f) * x; 
+				}
+				j2+=step;
+			} else {
+				x = (float)xL;
+			}
+			block[i] = x;
+		}
+	}
+};
 
 void SampleEditor::tool_eqSample(const FilterParameters* par)
 {
@@ -2646,9 +2964,8 @@ void SampleEditor::tool_eqSample(const FilterParameters* par, bool selective)
 	
 	prepareUndo();	
 	
-	ClipBoard* clipBoard;
-	float step;
-	float j2 = 0.0f;
+	ClipBoard* clipBoard = NULL;
+	float step = 0.0f;
 	if (selective) {
 		clipBoard = ClipBoard::getInstance();
 		step = (float)clipBoard->getWidth() / (float)(sEnd-sStart);
@@ -2684,48 +3001,12 @@ void SampleEditor::tool_eqSample(const FilterParameters* par, bool selective)
 	}
 	
 	// apply EQ here
-	pp_int32 i;
-
-	for (i = sStart; i < sEnd; i++)
-	{
-		// Fetch a stereo signal
-		double xL = getFloatSampleFromWaveform(i);
-		double xR = xL;
-		float x = (float)xL;
-			
-		for (pp_int32 j = 0; j < par->getNumParameters(); j++)
-		{
-			double yL, yR;
-			// Pass the stereo input
-			eqs[j]->Filter(xL, xR, yL, yR);
-			
-			xL = yL;
-			xR = yR;
-		}
-		if (selective)
-		{
-			float frac = j2 - (float)floor(j2);
-		
-			pp_int16 s = clipBoard->getSampleWord((pp_int32)j2);
-			float f1 = s < 0 ? (s/32768.0f) : (s/32767.0f);
-			s = clipBoard->getSampleWord((pp_int32)j2+1);
-			float f2 = s < 0 ? (s/32768.0f) : (s/32767.0f);
-
-			float f = (1.0f-frac)*f1 + frac*f2;
-
-			if (f>=0) {
-				x = f * ((float)xL) + (1.0f-f) * x;
-			} else {
-				x = -f * (x-(float)xL) + (1.0+f) * x; 
-			}
-			j2+=step;
-		} else {
-			x = (float)xL;
-		}
-		setFloatSampleInWaveform(i, x);
-	}
+	SampleBlockProcessor processor(sample);
+	EQFilter filter(eqs, par->getNumParameters(), selective ? clipBoard : NULL, step);
+	processor.process(filter, sStart, sEnd);
+	peakCache.invalidate(sStart, sEnd);
 	
-	for (i = 0; i < par->getNumParameters(); i++)
+	for (pp_int32 i = 0; i < par->getNumParameters(); i++)
 		delete eqs[i];
 	
 	delete[] eqs;
@@ -3733,6 +4014,7 @@ void SampleEditor::tool_synth(const FilterParameters* par)
   
   //enableUndoStack(false);
   synth->process( NULL,NULL);
+  peakCache.invalidateAll();
   //enableUndoStack(true);
 
   // serialize synth to samplename 
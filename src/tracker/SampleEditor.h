@@ -35,6 +35,7 @@
 #include "Undo.h"
 #include "Singleton.h"
 #include "Synth.h"
+#include "SamplePeakCache.h"
 #include "fx/Filter.h"
 #include "fx/Equalizer.h"
 #include "fx/EQConstants.h"
@@ -44,6 +45,7 @@
 struct TXMSample;
 
 class FilterParameters;
+class PlayerCriticalSection;
 
 class SampleEditor : public EditorBase
 {
@@ -122,18 +124,26 @@ private:
 	SampleUndoStackEntry* before;
 	PPUndoStack<SampleUndoStackEntry>* undoStack;	
 	UndoHistory<TXMSample, SampleUndoStackEntry>* undoHistory;
+	pp_uint32 undoMemoryLimit;
+	PlayerCriticalSection* playerCriticalSection;
 	bool lastOperationDidChangeSize;
 	Operations lastOperation;
 
 	bool drawing;
 	pp_int32 lastSamplePos;
 
+	// min/max pyramid for drawing the waveform, every operation which
+	// modifies the sample data in place has to invalidate the range it touches
+	SamplePeakCache peakCache;
+
   Synth *synth;
 
 	void prepareUndo();
 	void finishUndo();
 	
 	bool revoke(const SampleUndoStackEntry* stackEntry);
+	// drop the oldest undo steps until we're within the memory limit
+	void trimUndoStack();
 	
 	void notifyChanges(bool condition, bool lazy = true);
  
@@ -148,9 +158,12 @@ public:
 	Operations getLastOperation() const { return lastOperation; }
 
 	void attachSample(TXMSample* sample, XModule* module);
+	// allows exchanging sample data without stopping the player
+	void attachPlayerCriticalSection(PlayerCriticalSection* playerCriticalSection) { this->playerCriticalSection = playerCriticalSection; }
 	void reset();
 
 	TXMSample* getSample() { return sample; }
+	SamplePeakCache& getPeakCache() { return peakCache; }
 	pp_int32 getSampleLen() const { return sample ? sample->samplen : 0; }
 	bool isValidSample() const { return sample != NULL; }
 	bool isEmptySample() const;	
@@ -207,6 +220,8 @@ public:
 
 	// --- Multilevel UNDO / REDO --------------------------------------------
 	void enableUndoStack(bool enable);
+	// in bytes
+	void setUndoMemoryLimit(pp_uint32 limit);
 	bool isUndoStackEnabled() const { return undoStackEnabled; }
 
 	void activateUndoStack(bool activate) { undoStackActivated = activate; }
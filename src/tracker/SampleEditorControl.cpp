@@ -206,7 +206,8 @@ SampleEditorControl::SampleEditorControl(pp_int32 id,
 
 	// Create tool handler responder
 	toolHandlerResponder = new ToolHandlerResponder(*this);
-	dialog = NULL;	
+	dialog = NULL;
+	toolPreview = NULL;	
 	this->tracker = (Tracker *)&tracker;
 	
 	resetLastValues();
@@ -217,6 +218,7 @@ SampleEditorControl::~SampleEditorControl()
 	if (sampleEditor)
 		sampleEditor->removeNotificationListener(this);
 
+	stopToolPreview();
 	delete dialog;
 		
 	delete toolHandlerResponder;
@@ -452,6 +454,11 @@ void SampleEditorControl::paint(PPGraphicsAbstract* g)
 	
 	mp_sint32 lasty = -(pp_int32)(sample->getSampleValue((pp_int32)(startPos*xScale))*scale);
 	
+	// when zoomed out, every pixel column shows the peaks of all samples it covers
+	SamplePeakCache& peakCache = sampleEditor->getPeakCache();
+	const bool drawPeaks = xScale > 1.0f;
+	mp_sint32 lastTop = lasty, lastBottom = lasty;
+	
 	g->setColor(*borderColor);
 	g->setPixel(xOffset, yOffset);
 	
@@ -472,6 +479,30 @@ void SampleEditorControl::paint(PPGraphicsAbstract* g)
 				g->setColor(TrackerConfig::colorSampleEditorWaveform);
 			}
 			
+			if (drawPeaks)
+			{
+				pp_int32 start = (pp_int32)((startPos+x)*xScale);
+				pp_int32 end = (pp_int32)((startPos+x+1)*xScale);
+				if (end <= start)
+					end = start+1;
+				
+				pp_int32 min, max;
+				peakCache.getPeak(sample, start, end, min, max);
+				
+				mp_sint32 top = -(mp_sint32)(max*scale);
+				mp_sint32 bottom = -(mp_sint32)(min*scale);
+				
+				// connect to the previous column
+				mp_sint32 y1 = top > lastBottom ? lastBottom : top;
+				mp_sint32 y2 = bottom < lastTop ? lastTop : bottom;
+				
+				g->drawVLine(yOffset + y1, yOffset + y2 + 1, xOffset + x);
+				
+				lastTop = top;
+				lastBottom = bottom;
+				continue;
+			}
+			
 			float findex = ((startPos+x)*xScale);
 			pp_int32 index = (pp_int32)(floor(findex));
 			pp_int32 index2 = index+1;
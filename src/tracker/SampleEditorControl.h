@@ -39,6 +39,7 @@ class PPControl;
 class PPContextMenu;
 class FilterParameters;
 class PPDialogBase;
+class SampleToolPreview;
 
 class SampleEditorControl : public PPControl, public EventListenerInterface, public EditorBase::EditorNotificationListener
 {
@@ -404,10 +405,17 @@ private:
 	
 	PPDialogBase* dialog;
 	ToolHandlerResponder* toolHandlerResponder;
+	// streams the settings of the open dialog while the sample plays
+	SampleToolPreview* toolPreview;
 	
 	bool invokeToolParameterDialog(ToolHandlerResponder::SampleToolTypes type);
 	bool invokeTool(ToolHandlerResponder::SampleToolTypes type);
 	
+	bool startToolPreview();
+	void stopToolPreview();
+	// rate for SampleToolPreview::setEQ at the sample editor's play note
+	float getToolPreviewEQRate() const;
+	
 	SampleEditorControlLastValues lastValues;
 	
 	void resetLastValues()
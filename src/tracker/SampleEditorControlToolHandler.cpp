@@ -39,6 +39,46 @@
 #include "FilterParameters.h"
 #include "SectionSamples.h"
 #include "PatternEditor.h"
+#include "ModuleEditor.h"
+#include "PlayerController.h"
+#include "SampleToolPreview.h"
+#include "XModule.h"
+
+bool SampleEditorControl::startToolPreview()
+{
+  stopToolPreview();
+
+  if (!sampleEditor->isValidSample())
+    return false;
+
+  toolPreview = new SampleToolPreview();
+  tracker->playerController->setSampleInsert(*sampleEditor->getSample(), toolPreview);
+  return true;
+}
+
+void SampleEditorControl::stopToolPreview()
+{
+  if (!toolPreview)
+    return;
+
+  tracker->playerController->setSampleInsert(*sampleEditor->getSample(), NULL);
+  delete toolPreview;
+  toolPreview = NULL;
+}
+
+float SampleEditorControl::getToolPreviewEQRate() const
+{
+  // the sample editor designs the bands for 8363Hz sample data, the preview
+  // sees the sample resampled from its play rate to the mixer frequency
+  mp_sint32 relnote = tracker->sectionSamples->getCurrentSamplePlayNote() - ModuleEditor::MAX_NOTE/2 + sampleEditor->getRelNoteNum();
+  if (relnote < -96)
+    relnote = -96;
+  else if (relnote > 95)
+    relnote = 95;
+
+  const float playRate = (float)XModule::getc4spd(relnote, sampleEditor->getFinetune());
+  return (float)tracker->playerController->getSampleRate() * 8363.0f / playRate;
+}
 
 bool SampleEditorControl::invokeToolParameterDialog(SampleEditorControl::ToolHandlerResponder::SampleToolTypes type)
 {
@@ -48,6 +88,8 @@ bool SampleEditorControl::invokeToolParameterDialog(SampleEditorControl::ToolHan
     dialog = NULL;
   }
 
+  stopToolPreview();
+
   toolHandlerResponder->setSampleToolType(type);
 
   switch (type)
@@ -65,6 +107,8 @@ bool SampleEditorControl::invokeToolParameterDialog(SampleEditorControl::ToolHan
     case ToolHandlerResponder::SampleToolTypeVolume:{
       dialog = new DialogSliders(parentScreen, toolHandlerResponder, PP_DEFAULT_ID, "Sample Volume", 1, sampleEditor, &SampleEditor::tool_scaleSample );
       DialogSliders *sliders = static_cast<DialogSliders*>(dialog);
+      if (startToolPreview())
+        sliders->setToolPreview(toolPreview);
       float value = lastValues.boostSampleVolume != SampleEditorControlLastValues::invalidFloatValue() ? lastValues.boostSampleVolume : 100.0f;
       sliders->initSlider(0,0.0f, 300.0f, value,"Volume");
       break;
@@ -118,6 +162,8 @@ bool SampleEditorControl::invokeToolParameterDialog(SampleEditorControl::ToolHan
           eq->setBandParam(i, lastValues.EQ3BandValues[i]);
       }
       eq->setSampleEditor(sampleEditor);
+      if (startToolPreview())
+        eq->setToolPreview(toolPreview, getToolPreviewEQRate());
       break;
     }
 
@@ -131,6 +177,9 @@ bool SampleEditorControl::invokeToolParameterDialog(SampleEditorControl::ToolHan
           eq->setBandParam(i, lastValues.EQ10BandValues[i]);
       }
       eq->setSampleEditor(sampleEditor);
+      // the selective EQ is previewed without the clipboard blend
+      if (startToolPreview())
+        eq->setToolPreview(toolPreview, getToolPreviewEQRate());
       break;
     }
 
@@ -328,8 +377,15 @@ bool SampleEditorControl::invokeTool(ToolHandlerResponder::SampleToolTypes type)
 
     case ToolHandlerResponder::SampleToolTypeVolume:
     {
-      lastValues.boostSampleVolume = static_cast<DialogSliders*>(dialog)->getSlider(0);
-      // we don't do anything here since dialogsliders processes inplace already
+      DialogSliders *sliders = static_cast<DialogSliders*>(dialog);
+      lastValues.boostSampleVolume = sliders->getSlider(0);
+      // only streamed so far, dialogsliders processes inplace otherwise
+      if (!sliders->isPreviewApplied())
+      {
+        FilterParameters par(1);
+        par.setParameter(0, FilterParameters::Parameter(lastValues.boostSampleVolume));
+        sampleEditor->tool_scaleSample(&par);
+      }
       break;
     }
 
@@ -578,11 +634,13 @@ SampleEditorControl::ToolHandlerResponder::ToolHandlerResponder(SampleEditorCont
 
 pp_int32 SampleEditorControl::ToolHandlerResponder::ActionOkay(PPObject* sender)
 {
+  sampleEditorControl.stopToolPreview();
   sampleEditorControl.invokeTool(sampleToolType);
   return 0;
 }
 
 pp_int32 SampleEditorControl::ToolHandlerResponder::ActionCancel(PPObject* sender)
 {
+  sampleEditorControl.stopToolPreview();
   return 0;
 }
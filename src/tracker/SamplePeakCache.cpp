@@ -0,0 +1,286 @@
+/*
+ *  tracker/SamplePeakCache.cpp
+ *
+ *  Copyright 2009 Peter Barth
+ *
+ *  This file is part of Milkytracker.
+ *
+ *  Milkytracker is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Milkytracker is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Milkytracker.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ *  SamplePeakCache.cpp
+ *  milkytracker
+ *
+ */
+
+#include "SamplePeakCache.h"
+#include "XModule.h"
+
+// TXMSample keeps the first few samples behind the loop end in a backup
+// buffer while the loop is prepared for the mixer, the real values
+// have to be read through TXMSample::getSampleValue there
+#define LOOPAREAMARGIN 8
+
+#define DIRTY_NONE_START 0x7FFFFFFF
+#define DIRTY_NONE_END 0
+
+static inline pp_int32 getLoopEnd(const TXMSample* sample)
+{
+	return (sample->type & 3) ? (pp_int32)(sample->loopstart + sample->looplen) : -1;
+}
+
+SamplePeakCache::SamplePeakCache() :
+	sampleData(NULL),
+	sampleLen(0),
+	sample16Bit(false),
+	loopEnd(-1),
+	numLevels(0),
+	dirtyStart(DIRTY_NONE_START),
+	dirtyEnd(DIRTY_NONE_END)
+{
+	for (pp_uint32 i = 0; i < MaxLevels; i++)
+	{
+		levels[i] = NULL;
+		levelSizes[i] = 0;
+	}
+}
+
+SamplePeakCache::~SamplePeakCache()
+{
+	clear();
+}
+
+void SamplePeakCache::clear()
+{
+	for (pp_uint32 i = 0; i < numLevels; i++)
+	{
+		delete[] levels[i];
+		levels[i] = NULL;
+		levelSizes[i] = 0;
+	}
+	
+	numLevels = 0;
+	sampleData = NULL;
+	sampleLen = 0;
+}
+
+void SamplePeakCache::invalidateAll()
+{
+	// forces a rebuild on the next query
+	clear();
+	dirtyStart = DIRTY_NONE_START;
+	dirtyEnd = DIRTY_NONE_END;
+}
+
+void SamplePeakCache::scan(TXMSample* sample, pp_int32 start, pp_int32 end, pp_int32& min, pp_int32& max)
+{
+	const pp_int32 loopEnd = getLoopEnd(sample);
+	
+	if (loopEnd >= 0 && start < loopEnd + LOOPAREAMARGIN && end > loopEnd)
+	{
+		for (pp_int32 i = start; i < end; i++)
+		{
+			const pp_int32 s = sample->getSampleValue(i);
+			if (s < min) min = s;
+			if (s > max) max = s;
+		}
+	}
+	else if (sample->type & 16)
+	{
+		const mp_sword* smp = (const mp_sword*)sample->sample;
+		for (pp_int32 i = start; i < end; i++)
+		{
+			const pp_int32 s = smp[i];
+			if (s < min) min = s;
+			if (s > max) max = s;
+		}
+	}
+	else
+	{
+		const mp_sbyte* smp = sample->sample;
+		for (pp_int32 i = start; i < end; i++)
+		{
+			const pp_int32 s = smp[i];
+			if (s < min) min = s;
+			if (s > max) max = s;
+		}
+	}
+}
+
+void SamplePeakCache::rebuild(TXMSample* sample)
+{
+	clear();
+	
+	sampleData = sample->sample;
+	sampleLen = sample->samplen;
+	sample16Bit = (sample->type & 16) != 0;
+	loopEnd = getLoopEnd(sample);
+	
+	pp_uint32 size = (sampleLen + BlockSize - 1) >> BlockShift;
+	while (size && numLevels < MaxLevels)
+	{
+		levels[numLevels] = new TPeak[size];
+		levelSizes[numLevels] = size;
+		numLevels++;
+		
+		if (size == 1)
+			break;
+		size = (size + 1) >> 1;
+	}
+	
+	dirtyStart = 0;
+	dirtyEnd = sampleLen;
+}
+
+void SamplePeakCache::validate(TXMSample* sample)
+{
+	if (sample->sample != sampleData || 
+		sample->samplen != sampleLen || 
+		((sample->type & 16) != 0) != sample16Bit)
+	{
+		rebuild(sample);
+		return;
+	}
+	
+	// moving the loop moves the backup area
+	const pp_int32 newLoopEnd = getLoopEnd(sample);
+	if (newLoopEnd != loopEnd)
+	{
+		if (loopEnd >= 0)
+			invalidate(loopEnd, loopEnd + LOOPAREAMARGIN);
+		if (newLoopEnd >= 0)
+			invalidate(newLoopEnd, newLoopEnd + LOOPAREAMARGIN);
+		loopEnd = newLoopEnd;
+	}
+}
+
+void SamplePeakCache::update(TXMSample* sample)
+{
+	if (dirtyStart < 0)
+		dirtyStart = 0;
+	if (dirtyEnd > (pp_int32)sampleLen)
+		dirtyEnd = sampleLen;
+	
+	if (dirtyStart >= dirtyEnd || !numLevels)
+	{
+		dirtyStart = DIRTY_NONE_START;
+		dirtyEnd = DIRTY_NONE_END;
+		return;
+	}
+	
+	pp_uint32 first = dirtyStart >> BlockShift;
+	pp_uint32 last = (dirtyEnd - 1) >> BlockShift;
+	
+	TPeak* peaks = levels[0];
+	for (pp_uint32 i = first; i <= last; i++)
+	{
+		const pp_int32 start = i << BlockShift;
+		pp_int32 end = start + BlockSize;
+		if (end > (pp_int32)sampleLen)
+			end = sampleLen;
+		
+		pp_int32 min = 32767, max = -32768;
+		scan(sample, start, end, min, max);
+		peaks[i].min = (pp_int16)min;
+		peaks[i].max = (pp_int16)max;
+	}
+	
+	for (pp_uint32 l = 1; l < numLevels; l++)
+	{
+		first >>= 1;
+		last >>= 1;
+		
+		const TPeak* src = levels[l-1];
+		const pp_uint32 srcSize = levelSizes[l-1];
+		TPeak* dst = levels[l];
+		
+		for (pp_uint32 i = first; i <= last; i++)
+		{
+			TPeak peak = src[i*2];
+			if (i*2+1 < srcSize)
+			{
+				if (src[i*2+1].min < peak.min) peak.min = src[i*2+1].min;
+				if (src[i*2+1].max > peak.max) peak.max = src[i*2+1].max;
+			}
+			dst[i] = peak;
+		}
+	}
+	
+	dirtyStart = DIRTY_NONE_START;
+	dirtyEnd = DIRTY_NONE_END;
+}
+
+void SamplePeakCache::getPeak(TXMSample* sample, pp_int32 start, pp_int32 end, pp_int32& min, pp_int32& max)
+{
+	min = 0;
+	max = 0;
+	
+	if (sample == NULL || sample->sample == NULL)
+		return;
+	
+	if (start < 0)
+		start = 0;
+	if (end > (pp_int32)sample->samplen)
+		end = sample->samplen;
+	if (start >= end)
+		return;
+	
+	validate(sample);
+	update(sample);
+	
+	min = 32767;
+	max = -32768;
+
+	// unaligned head and tail
+	pp_int32 alignedStart = (start + BlockSize - 1) & ~(BlockSize - 1);
+	pp_int32 alignedEnd = end & ~(BlockSize - 1);
+	
+	if (alignedStart >= alignedEnd)
+	{
+		scan(sample, start, end, min, max);
+		return;
+	}
+
+	scan(sample, start, alignedStart, min, max);
+	scan(sample, alignedEnd, end, min, max);
+
+	// whole blocks, climb up the pyramid as long as the range covers
+	// complete entries of the next level
+	pp_uint32 b0 = alignedStart >> BlockShift;
+	pp_uint32 b1 = alignedEnd >> BlockShift;
+	
+	for (pp_uint32 l = 0; b0 < b1 && l < numLevels; l++)
+	{
+		const TPeak* peaks = levels[l];
+		
+		if (b0 & 1)
+		{
+			if (peaks[b0].min < min) min = peaks[b0].min;
+			if (peaks[b0].max > max) max = peaks[b0].max;
+			b0++;
+		}
+		
+		if (b1 & 1)
+		{
+			b1--;
+			if (peaks[b1].min < min) min = peaks[b1].min;
+			if (peaks[b1].max > max) max = peaks[b1].max;
+		}
+		
+		b0 >>= 1;
+		b1 >>= 1;
+	}
+}
@@ -0,0 +1,103 @@
+/*
+ *  tracker/SamplePeakCache.h
+ *
+ *  Copyright 2009 Peter Barth
+ *
+ *  This file is part of Milkytracker.
+ *
+ *  Milkytracker is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Milkytracker is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Milkytracker.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ *  SamplePeakCache.h
+ *  milkytracker
+ *
+ *  Min/max pyramid of a sample for drawing zoomed out waveforms.
+ *  Level 0 holds the peaks of blocks of BlockSize samples, every further 
+ *  level combines two entries of the level below, so the peak of any range 
+ *  is found by looking at O(log n) entries plus the unaligned samples at 
+ *  both ends.
+ *  The cache rebuilds itself when the sample memory, length or resolution 
+ *  changes, changes to the sample data itself have to be reported with 
+ *  invalidate(), the affected blocks are recalculated on the next query.
+ *
+ */
+
+#ifndef __SAMPLEPEAKCACHE_H__
+#define __SAMPLEPEAKCACHE_H__
+
+#include "BasicTypes.h"
+
+struct TXMSample;
+
+class SamplePeakCache
+{
+public:
+	enum
+	{
+		BlockShift = 5,
+		BlockSize = 1 << BlockShift,
+		MaxLevels = 32
+	};
+
+private:
+	struct TPeak
+	{
+		pp_int16 min;
+		pp_int16 max;
+	};
+
+	// sample state the cache has been built from
+	const void* sampleData;
+	pp_uint32 sampleLen;
+	bool sample16Bit;
+	pp_int32 loopEnd;
+	
+	TPeak* levels[MaxLevels];
+	pp_uint32 levelSizes[MaxLevels];
+	pp_uint32 numLevels;
+
+	// samples which have changed since the last query: [dirtyStart, dirtyEnd)
+	pp_int32 dirtyStart;
+	pp_int32 dirtyEnd;
+	
+	void clear();
+	void rebuild(TXMSample* sample);
+	void validate(TXMSample* sample);
+	void update(TXMSample* sample);
+	
+	static void scan(TXMSample* sample, pp_int32 start, pp_int32 end, pp_int32& min, pp_int32& max);
+
+public:
+	SamplePeakCache();
+	~SamplePeakCache();
+
+	// sample data in [start, end) has been modified
+	void invalidate(pp_int32 start, pp_int32 end)
+	{
+		if (start < dirtyStart)
+			dirtyStart = start;
+		if (end > dirtyEnd)
+			dirtyEnd = end;
+	}
+
+	// anything might have changed
+	void invalidateAll();
+	
+	// smallest and largest value (in the sample's resolution) within [start, end)
+	void getPeak(TXMSample* sample, pp_int32 start, pp_int32 end, pp_int32& min, pp_int32& max);
+};
+
+#endif
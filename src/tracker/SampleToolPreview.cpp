@@ -0,0 +1,165 @@
+/*
+ *  tracker/SampleToolPreview.cpp
+ *
+ *  Copyright 2009 Peter Barth
+ *
+ *  This file is part of Milkytracker.
+ *
+ *  Milkytracker is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Milkytracker is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Milkytracker.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ *  SampleToolPreview.cpp
+ *  milkytracker
+ *
+ */
+
+#include "SampleToolPreview.h"
+#include "LockFreeRingBuffer.h"
+#include "fx/EQConstants.h"
+
+SampleToolPreview::SampleToolPreview() :
+	back(0),
+	front(1),
+	middle(2),
+	gain(1.0f)
+{
+	pending.gain = 1.0f;
+	pending.numBands = 0;
+	pending.rate = 0.0f;
+	for (pp_int32 i = 0; i < MaxBands; i++)
+		pending.bandParams[i] = 0.5f;
+		
+	for (pp_int32 i = 0; i < 3; i++)
+		parameters[i] = pending;
+	current = pending;
+}
+
+void SampleToolPreview::publish()
+{
+	parameters[back] = pending;
+
+	for (;;)
+	{
+		mp_uint32 old = LockFreeAtomic::loadAcquire(&middle);
+		if (LockFreeAtomic::compareAndSwap(&middle, old, back | MiddleFresh))
+		{
+			back = old & 3;
+			break;
+		}
+	}
+}
+
+void SampleToolPreview::setGain(float gain)
+{
+	pending.gain = gain;
+	publish();
+}
+
+void SampleToolPreview::setEQ(pp_int32 numBands, const float* bandParams, float rate)
+{
+	if (numBands > MaxBands)
+		numBands = MaxBands;
+		
+	pending.numBands = numBands;
+	for (pp_int32 i = 0; i < numBands; i++)
+		pending.bandParams[i] = bandParams[i];
+	pending.rate = rate;
+	publish();
+}
+
+void SampleToolPreview::updateFilters(const Parameters& p)
+{
+	bool changed = p.numBands != current.numBands || p.rate != current.rate;
+	for (pp_int32 i = 0; i < p.numBands && !changed; i++)
+		changed = p.bandParams[i] != current.bandParams[i];
+
+	if (!changed)
+		return;
+	
+	// a different set of bands starts from silence, otherwise the filter
+	// state is kept so moving a slider doesn't click
+	if (p.numBands != current.numBands)
+	{
+		for (pp_int32 i = 0; i < MaxBands; i++)
+			eqs[i] = Equalizer();
+	}
+
+	const float* bands = p.numBands == 3 ? EQConstants::EQ3bands : EQConstants::EQ10bands;
+	const float* bandwidths = p.numBands == 3 ? EQConstants::EQ3bandwidths : EQConstants::EQ10bandwidths;
+	
+	for (pp_int32 i = 0; i < p.numBands; i++)
+		eqs[i].CalcCoeffs(bands[i], bandwidths[i], p.rate, Equalizer::CalcGain(p.bandParams[i]));
+	
+	current = p;
+}
+
+void SampleToolPreview::mix(mp_sint32* buffer, mp_uint32 numSamples)
+{
+	if (LockFreeAtomic::loadAcquire(&middle) & MiddleFresh)
+	{
+		for (;;)
+		{
+			mp_uint32 old = LockFreeAtomic::loadAcquire(&middle);
+			if (LockFreeAtomic::compareAndSwap(&middle, old, front))
+			{
+				front = old & 3;
+				break;
+			}
+		}
+	}
+	
+	const Parameters& p = parameters[front];
+	
+	updateFilters(p);
+
+	if (!numSamples)
+		return;
+
+	const pp_int32 numBands = current.numBands;
+
+	// ramp to the new gain within this beat packet or tick span
+	double g = gain;
+	const double step = ((double)p.gain - g) / (double)numSamples;
+	
+	for (mp_uint32 i = 0; i < numSamples; i++)
+	{
+		double xL = buffer[0];
+		double xR = buffer[1];
+
+		for (pp_int32 j = 0; j < numBands; j++)
+		{
+			double yL, yR;
+			eqs[j].Filter(xL, xR, yL, yR);
+			xL = yL;
+			xR = yR;
+		}
+		
+		g+=step;
+		xL*=g;
+		xR*=g;
+		
+		if (xL > 2147483647.0) xL = 2147483647.0;
+		else if (xL < -2147483648.0) xL = -2147483648.0;
+		if (xR > 2147483647.0) xR = 2147483647.0;
+		else if (xR < -2147483648.0) xR = -2147483648.0;
+		
+		buffer[0] = (mp_sint32)xL;
+		buffer[1] = (mp_sint32)xR;
+		buffer+=2;
+	}
+	
+	gain = p.gain;
+}
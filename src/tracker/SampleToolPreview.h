@@ -0,0 +1,98 @@
+/*
+ *  tracker/SampleToolPreview.h
+ *
+ *  Copyright 2009 Peter Barth
+ *
+ *  This file is part of Milkytracker.
+ *
+ *  Milkytracker is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  Milkytracker is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with Milkytracker.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ *  SampleToolPreview.h
+ *  milkytracker
+ *
+ *  Streams the gain and equalizer tools as an insert on the channels
+ *  playing the edited sample, so the dialogs can be previewed without
+ *  touching the sample data. The dialog publishes new settings through a
+ *  lock free triple buffer, the mixer picks up the latest ones at the next
+ *  call to mix() and ramps the gain over the samples of that call. mix() is
+ *  called once per beat packet or tick span, not once per audio buffer.
+ *
+ */
+
+#ifndef __SAMPLETOOLPREVIEW_H__
+#define __SAMPLETOOLPREVIEW_H__
+
+#include "BasicTypes.h"
+#include "Mixable.h"
+#include "fx/Equalizer.h"
+
+class SampleToolPreview : public Mixable
+{
+public:
+	enum
+	{
+		MaxBands = 10
+	};
+
+	struct Parameters
+	{
+		float gain;
+		// 0, 3 or 10 bands
+		pp_int32 numBands;
+		// band gains as returned by DialogEQ::getBandParam
+		float bandParams[MaxBands];
+		// rate the bands are designed for
+		float rate;
+	};
+
+private:
+	enum
+	{
+		// set in middle when it holds settings the mixer hasn't seen yet
+		MiddleFresh = 4
+	};
+
+	// the dialog writes to parameters[back], the mixer reads parameters[front],
+	// middle is swapped with either of them
+	Parameters parameters[3];
+	pp_uint32 back;
+	pp_uint32 front;
+	volatile mp_uint32 middle;
+	
+	// settings the dialog is editing
+	Parameters pending;
+
+	// mixer side
+	Parameters current;
+	Equalizer eqs[MaxBands];
+	float gain;
+	
+	void publish();
+	void updateFilters(const Parameters& p);
+
+public:
+	SampleToolPreview();
+
+	void setGain(float gain);
+	// bandParams holds numBands slider values, rate is the one the sample
+	// editor would use for the bands, scaled to the mixer frequency
+	void setEQ(pp_int32 numBands, const float* bandParams, float rate);
+
+	virtual void mix(mp_sint32* buffer, mp_uint32 numSamples);
+};
+
+#endif
@@ -82,6 +82,7 @@ enum ControlIDs
 	HDRECORD_BUTTON_SMP_PLUS,
 	HDRECORD_BUTTON_SMP_MINUS,
 	HDRECORD_BUTTON_MIXER_AUTO,
+	HDRECORD_BUTTON_SAMPLEFORMAT,
 	
 	RESPONDMESSAGEBOX_SELECTRESAMPLER
 };
@@ -135,8 +136,9 @@ void SectionHDRecorder::validate()
 SectionHDRecorder::SectionHDRecorder(Tracker& tracker) :
 	SectionUpperLeft(tracker, NULL, new DialogResponderHDRec(*this)),
 	recorderMode(RecorderModeToFile),
-	fromOrder(0), toOrder(0), mixerVolume(256), 
+	fromOrder(0), toOrder(0), mixerVolume(256), autoMixerVolume(false),
 	resampler(1),
+	sampleFormat(WAVWriter::WAVFormat16Bit),
 	insIndex(0), smpIndex(0),
 	currentFileName(TrackerConfig::untitledSong)
 {
@@ -266,6 +268,14 @@ pp_int32 SectionHDRecorder::handleEvent(PPObject* sender, PPEvent* event)
 				update();
 				break;
 				
+			case HDRECORD_BUTTON_SAMPLEFORMAT:
+				if (event->getID() != eCommand)
+					break;
+				
+				sampleFormat = (sampleFormat + 1) % 3;
+				update();
+				break;
+
 			case HDRECORD_BUTTON_EXIT:	
 				if (event->getID() != eCommand)
 					break;
@@ -323,7 +333,7 @@ pp_int32 SectionHDRecorder::handleEvent(PPObject* sender, PPEvent* event)
 				if (event->getID() != eCommand)
 					break;
 
-				getPeakLevel();
+				autoMixerVolume = !autoMixerVolume;
 
 				update();
 				break;
@@ -364,6 +374,7 @@ pp_int32 SectionHDRecorder::handleEvent(PPObject* sender, PPEvent* event)
 			case HDRECORD_SLIDER_MIXERVOLUME:
 			{
 				mixerVolume = reinterpret_cast<PPSlider*>(sender)->getCurrentValue();
+				autoMixerVolume = false;
 				update();
 				break;
 			}
@@ -489,6 +500,10 @@ void SectionHDRecorder::init(pp_int32 px, pp_int32 py)
 	container->addControl(new PPSeperator(0, screen, PPPoint(x2 - 6, py+16 - 2), container->getSize().height - (dy+14), TrackerConfig::colorThemeMain, false));
 	
 	container->addControl(new PPStaticText(0, NULL, NULL, PPPoint(x2, y2), "Quality:", true));
+	button = new PPButton(HDRECORD_BUTTON_SAMPLEFORMAT, screen, this, PPPoint(x2 + 8*10 + 4, y2-2), PPSize(6*7 + 4, 11));
+	button->setFont(PPFont::getFont(PPFont::FONT_TINY));
+	button->setText("16 Bit");
+	container->addControl(button);
 	
 	y2+=13;
 
@@ -649,7 +664,10 @@ void SectionHDRecorder::update(bool repaint/* = true*/)
 	PPSlider* slider = static_cast<PPSlider*>(container->getControlByID(HDRECORD_SLIDER_MIXERVOLUME));
 	ASSERT(slider);
 
-	sprintf(buffer, "%i%%", (mixerVolume*100)/256);
+	if (autoMixerVolume)
+		strcpy(buffer, "Auto");
+	else
+		sprintf(buffer, "%i%%", (mixerVolume*100)/256);
 
 	if (strlen(buffer) < 4)
 	{
@@ -662,6 +680,26 @@ void SectionHDRecorder::update(bool repaint/* = true*/)
 
 	slider->setCurrentValue(mixerVolume);
 
+	PPButton* autoButton = static_cast<PPButton*>(container->getControlByID(HDRECORD_BUTTON_MIXER_AUTO));
+	ASSERT(autoButton);
+	autoButton->setPressed(autoMixerVolume);
+
+	PPButton* formatButton = static_cast<PPButton*>(container->getControlByID(HDRECORD_BUTTON_SAMPLEFORMAT));
+	ASSERT(formatButton);
+	switch (sampleFormat)
+	{
+		case WAVWriter::WAVFormat24Bit:
+			formatButton->setText("24 Bit");
+			break;
+		case WAVWriter::WAVFormatFloat:
+			formatButton->setText("Float");
+			break;
+		default:
+			formatButton->setText("16 Bit");
+	}
+	// samples are always recorded in 16 bit
+	formatButton->enable(recorderMode != RecorderModeToSample);
+
 	if (recorderMode == RecorderModeToFile || recorderMode == RecorderModeToFileMulti)
 	{
 		PPButton* button = static_cast<PPButton*>(container->getControlByID(HDRECORD_BUTTON_RECORDINGMODE));
@@ -777,7 +815,9 @@ void SectionHDRecorder::exportWAVAsFileName(const PPSystemString& fileName)
 	parameters.rampin        = getSettingsRamping() == 2; // FT2
 	parameters.playMode = tracker.playerController->getPlayMode();
 	parameters.mixerShift = getSettingsMixerShift(); 
-	parameters.mixerVolume = mixerVolume;
+	parameters.mixerVolume = autoMixerVolume ? 256 : mixerVolume;
+	parameters.normalize = autoMixerVolume;
+	parameters.sampleFormat = sampleFormat;
 	parameters.limiterDrive = tracker.settingsDatabase->restore("LIMITDRIVE")->getIntValue();
 
 	mp_ubyte* muting = new mp_ubyte[moduleEditor->getNumChannels()];
@@ -797,7 +837,9 @@ void SectionHDRecorder::exportWAVAsFileName(const PPSystemString& fileName)
 
 	tracker.signalWaitState(true);
 
-	pp_int32 res = moduleEditor->getModuleServices()->exportToWAV(fileName, parameters);;
+	ModuleServices::WAVWriterStatistics statistics;
+
+	pp_int32 res = moduleEditor->getModuleServices()->exportToWAV(fileName, parameters, &statistics);
 
 	tracker.signalWaitState(false);
 
@@ -808,6 +850,21 @@ void SectionHDRecorder::exportWAVAsFileName(const PPSystemString& fileName)
 		pp_int32 seconds = (pp_int32)((float)res / (float)getSettingsFrequency());
 		char buffer[200];
 		sprintf(buffer, "%i:%02i successfully recorded", seconds/60, seconds%60);
+
+		if (parameters.normalize)
+		{
+			// show the resulting volume on the slider
+			mixerVolume = statistics.mixerVolume;
+			
+			if (!parameters.multiTrack)
+			{
+				sprintf(buffer + strlen(buffer), "\nPeak %.1fdB, RMS %.1fdB, vol. %i%%", 
+						statistics.peakDB, statistics.rmsDB, (mixerVolume*100)/256);
+				tracker.showMessageBoxSized(MESSAGEBOX_UNIVERSAL, buffer, Tracker::MessageBox_OK);
+				return;
+			}
+		}
+
 		tracker.showMessageBox(MESSAGEBOX_UNIVERSAL, buffer, Tracker::MessageBox_OK);
 	}
 	else
@@ -886,6 +943,12 @@ void SectionHDRecorder::exportWAVAsSample()
 	parameters.resamplerType = (getSettingsRamping() ? 1 : 0) | (getSettingsResampler() << 1);
 	parameters.playMode = tracker.playerController->getPlayMode();
 	parameters.mixerShift = getSettingsMixerShift(); 
+
+	// rendering into a sample isn't normalized on the fly,
+	// estimate the mixer volume up front instead
+	if (autoMixerVolume)
+		getPeakLevel();
+
 	parameters.mixerVolume = mixerVolume;
 
 	mp_ubyte* muting = new mp_ubyte[moduleEditor->getNumChannels()];
@@ -53,7 +53,11 @@ private:
 	pp_int32 fromOrder;
 	pp_int32 toOrder;
 	pp_int32 mixerVolume;
+	// normalize while recording instead of using the mixer volume
+	bool autoMixerVolume;
 	pp_uint32 resampler;
+	// 16 bit, 24 bit or float WAV files
+	pp_uint32 sampleFormat;
 
 	pp_int32 insIndex;
 	pp_int32 smpIndex;
@@ -30,7 +30,6 @@
 
 #include "SongLengthEstimator.h"
 #include "MilkyPlay.h"
-#include "AudioDriver_NULL.h"
 
 SongLengthEstimator::SongLengthEstimator(XModule* theModule) :
 	player(NULL),
@@ -68,15 +67,16 @@ mp_sint32 SongLengthEstimator::estimateSongLengthInSeconds()
 			return -1;
 		
 		player->setBufferSize(1024);
-		player->setResamplerType((ChannelMixer::ResamplerTypes)0);
-		player->setMasterVolume(256);
-		player->setDisableMixing(true);
 	}
 	
-	AudioDriver_NULL* audioDriver = new AudioDriver_NULL;
-	mp_sint32 res = player->exportToWAV(NULL, module, 0, -1, NULL, module->header.channum, NULL, audioDriver) / player->getMixFrequency();
-	delete audioDriver;
+	// the song is only processed, nothing is mixed
+	PlayerGeneric::TSongAnalysis* analysis = new PlayerGeneric::TSongAnalysis;
+	
+	mp_sint32 res = -1;
+	if (player->analyzeSong(module, *analysis) == MP_OK && analysis->numSubSongs)
+		res = (mp_sint32)(analysis->subSongs[0].numSamples / player->getMixFrequency());
+	
+	delete analysis;
 
 	return res;
 }
-
@@ -2662,7 +2662,26 @@ bool Tracker::prepareLoading(FileTypes eType, const PPSystemString& fileName, bo
 	FileIdentificator::FileTypes type = fileIdentificator->getFileType();
 	delete fileIdentificator;
 	
-	if (type == FileIdentificator::FileTypeCompressed)
+	if (type == FileIdentificator::FileTypeCompressed &&
+		eType == FileTypes::FileTypeSongAllModules)
+	{
+		// modules can be loaded right from memory, no need for a temporary file
+		XMFileBuffer* memoryFile = new XMFileBuffer();
+		Decompressor decompressor(fileName);
+		if (decompressor.decompressTo(*memoryFile, (DecompressorBase::Hints)fileTypeToHint(eType)))
+		{
+			loadingParameters.memoryFile = memoryFile;
+		}
+		else
+		{
+			delete memoryFile;
+			loadingParameters.lastError = "Unrecognized type/corrupt file";
+			loadingParameters.res = false;
+			finishLoading();
+			return false;
+		}
+	}
+	else if (type == FileIdentificator::FileTypeCompressed)
 	{
 		// if this is compressed, try to decompress
 		PPSystemString tempFile(ModuleEditor::getTempFilename());
@@ -2710,6 +2729,9 @@ bool Tracker::finishLoading()
 	
 	if (loadingParameters.deleteFile)
 		Decompressor::removeFile(loadingParameters.filename);
+	
+	delete loadingParameters.memoryFile;
+	loadingParameters.memoryFile = NULL;
 		
 	if (!loadingParameters.res && loadingParameters.didOpenTab)
 		tabManager->closeTab();
@@ -2727,7 +2749,13 @@ bool Tracker::loadTypeFromFile(FileTypes eType, const PPSystemString& fileName,
 	{
 		case FileTypes::FileTypeSongAllModules:
 		{
-			if (loadingParameters.preferredFilename.length())
+			if (loadingParameters.memoryFile)
+			{
+				loadingParameters.memoryFile->seek(0);
+				loadingParameters.res = moduleEditor->openSong(*loadingParameters.memoryFile,
+				loadingParameters.preferredFilename);
+			}
+			else if (loadingParameters.preferredFilename.length())
 				loadingParameters.res = moduleEditor->openSong(loadingParameters.filename,
 				loadingParameters.preferredFilename);
 			else
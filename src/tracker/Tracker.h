@@ -397,11 +397,14 @@ private:
 		bool abortLoading;
 		bool deleteFile;
 		bool didOpenTab;
+		// decompressed module, loaded from memory instead of filename
+		XMFileBuffer* memoryFile;
 		
 		TPrepareLoadingParameters() :
 			abortLoading(false),
 			deleteFile(false),
-			didOpenTab(false)
+			didOpenTab(false),
+			memoryFile(NULL)
 		{
 		}
 	} loadingParameters;
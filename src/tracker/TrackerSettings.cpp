@@ -77,6 +77,7 @@ void Tracker::buildDefaultSettings()
 	settingsDatabase->store("MIXERSHIFT", 1);
 	settingsDatabase->store("LIMITDRIVE",0);
 	settingsDatabase->store("LIMITRESET",1);
+	settingsDatabase->store("PARALLELMIXING", 0);
 	settingsDatabase->store("RAMPING", 1);
 	settingsDatabase->store("INTERPOLATION", 4); // rpi zero can handle this already
 	settingsDatabase->store("MIXERFREQ", PlayerMaster::getPreferredSampleRate());
@@ -135,6 +136,8 @@ void Tracker::buildDefaultSettings()
 
 	// Scopes?
 	settingsDatabase->store("SCOPES", 1);
+	// recording the scopes while mixing costs the audio thread extra time
+	settingsDatabase->store("SCOPETAPS", 0);
 
 	// Pattern spacing
 	settingsDatabase->store("SPACING", 0);
@@ -179,6 +182,8 @@ void Tracker::buildDefaultSettings()
 
 	// Enable sample undobuffer by default
 	settingsDatabase->store("SAMPLEEDITORUNDOBUFFER", 1);
+	// Sample undo buffer memory limit in MB
+	settingsDatabase->store("SAMPLEEDITORUNDOMEMORY", UNDOMEMORY_SAMPLEEDITOR);
 	// Auto-mixdown to mono when loading samples
 	settingsDatabase->store("AUTOMIXDOWNSAMPLES", 0);
 	// Hexadecimal offsets in the sample editor by default
@@ -302,6 +307,10 @@ void Tracker::applySettingByKey(PPDictionaryKey* theKey, TMixerSettings& setting
 	{
 		settings.limiterDrive = v2;
 	}
+	else if (theKey->getKey().compareTo("PARALLELMIXING") == 0)
+	{
+		settings.parallelMixing = v2;
+	}
 	else if (theKey->getKey().compareTo("MIXERSHIFT") == 0)
 	{
 		settings.mixerShift = 2-v2;
@@ -414,6 +423,10 @@ void Tracker::applySettingByKey(PPDictionaryKey* theKey, TMixerSettings& setting
 	{
 		showScopes(v2 & 1, v2>>1);
 	}
+	else if (theKey->getKey().compareTo("SCOPETAPS") == 0)
+	{
+		playerMaster->setScopeTaps(v2 != 0);
+	}
 	else if (theKey->getKey().compareTo("SPACING") == 0)
 	{
 		if (patternEditorCtrl)
@@ -508,6 +521,17 @@ void Tracker::applySettingByKey(PPDictionaryKey* theKey, TMixerSettings& setting
 		if (sampleEditor)
 			sampleEditor->enableUndoStack(v2 != 0);
 	}
+	else if (theKey->getKey().compareTo("SAMPLEEDITORUNDOMEMORY") == 0)
+	{
+		if (sampleEditor && v2 > 0)
+		{
+			// in megabytes, the limit in bytes has to fit into 32 bits
+			pp_uint32 megs = (pp_uint32)v2;
+			if (megs > 4095)
+				megs = 4095;
+			sampleEditor->setUndoMemoryLimit(megs*1024*1024);
+		}
+	}
 	else if (theKey->getKey().compareTo("SAMPLEEDITORDECIMALOFFSETS") == 0)
 	{
 		if (sectionSamples)
@@ -743,6 +767,7 @@ void Tracker::getMixerSettingsFromDatabase(TMixerSettings& mixerSettings,
     mixerSettings.numPlayerChannels = currentSettings.restore("XMCHANNELLIMIT")->getIntValue();
     mixerSettings.limiterDrive = currentSettings.restore("LIMITDRIVE")->getIntValue();
 	mixerSettings.numVirtualChannels = currentSettings.restore("VIRTUALCHANNELS")->getIntValue();
+	mixerSettings.parallelMixing = currentSettings.restore("PARALLELMIXING")->getIntValue();
 }
 
 void Tracker::applySettings(TrackerSettingsDatabase* newSettings,
@@ -229,24 +229,101 @@ void EnvelopeUndoStackEntry::GetEnvelope(TEnvelope& env) const
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //														samples
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+SampleUndoChunk::SampleUndoChunk(const pp_uint8* src, pp_uint32 size) :
+	size(size),
+	refCount(1)
+{
+	data = new pp_uint8[size];
+	memcpy(data, src, size);
+	hash = calcHash(data, size);
+}
+
+SampleUndoChunk::~SampleUndoChunk()
+{
+	delete[] data;
+}
+
+SampleUndoChunk* SampleUndoChunk::create(const pp_uint8* src, pp_uint32 size)
+{
+	return new SampleUndoChunk(src, size);
+}
+
+bool SampleUndoChunk::equals(const pp_uint8* src, pp_uint32 size) const
+{
+	return this->size == size && memcmp(data, src, size) == 0;
+}
+
+// FNV-1a on 32 bit words, four independent lanes which are combined at the end
+pp_uint32 SampleUndoChunk::calcHash(const pp_uint8* src, pp_uint32 size)
+{
+	const pp_uint32 prime = 16777619U;
+	pp_uint32 h0 = 2166136261U, h1 = h0 ^ 1, h2 = h0 ^ 2, h3 = h0 ^ 3;
+
+	pp_uint32 i = 0;
+	for (; i + 16 <= size; i+=16)
+	{
+		pp_uint32 w[4];
+		memcpy(w, src + i, 16);
+		h0 = (h0 ^ w[0]) * prime;
+		h1 = (h1 ^ w[1]) * prime;
+		h2 = (h2 ^ w[2]) * prime;
+		h3 = (h3 ^ w[3]) * prime;
+	}
+	
+	pp_uint32 hash = (((h0 * prime) ^ h1) * prime ^ h2) * prime ^ h3;
+	for (; i < size; i++)
+		hash = (hash ^ src[i]) * prime;
+
+	return (hash ^ size) * prime;
+}
+
 void SampleUndoStackEntry::calcCheckSum()
 {
-	checkSum = 0;
-	if (!buffer)
-		return;
-	mp_uint32 size = (flags & 16) ? samplen*2 : samplen;
-	if (size)
+	pp_uint32 hash = 0;
+	for (pp_uint32 i = 0; i < numChunks; i++)
+		hash = hash * 31 + chunks[i]->getHash();
+	checkSum = (pp_int32)hash;
+}
+
+void SampleUndoStackEntry::copyFrom(const SampleUndoStackEntry& src)
+{
+	samplen = src.samplen;
+	loopstart = src.loopstart;
+	looplen = src.looplen;	
+	relnote = src.relnote;
+	finetune = src.finetune;
+	flags = src.flags;
+	checkSum = src.checkSum;
+	this->selectionStart = src.selectionStart;
+	this->selectionEnd = src.selectionEnd;
+
+	// chunks are never modified, sharing them is enough
+	numChunks = src.numChunks;
+	chunks = NULL;
+	if (numChunks)
 	{
-		mp_ubyte* mem = TXMSample::getPadStartAddr(buffer);
-		mp_uint32 realSize = TXMSample::getPaddedSize(size);
-		for (pp_uint32 i = 0; i < realSize; i++)
-			checkSum+=(pp_uint32)mem[i];		
+		chunks = new SampleUndoChunk*[numChunks];
+		for (pp_uint32 i = 0; i < numChunks; i++)
+		{
+			chunks[i] = src.chunks[i];
+			chunks[i]->addRef();
+		}
 	}
 }
 
+void SampleUndoStackEntry::releaseChunks()
+{
+	for (pp_uint32 i = 0; i < numChunks; i++)
+		chunks[i]->release();
+	delete[] chunks;
+	chunks = NULL;
+	numChunks = 0;
+}
+
 SampleUndoStackEntry::SampleUndoStackEntry(const TXMSample& sample, 
 										   pp_int32 selectionStart, pp_int32 selectionEnd, 
-										   const UserData* userData/* = NULL*/) :
+										   const UserData* userData/* = NULL*/,
+										   const SampleUndoStackEntry* base/* = NULL*/) :
 	UndoStackEntry(userData)
 {
 	samplen = sample.samplen;
@@ -258,25 +335,37 @@ SampleUndoStackEntry::SampleUndoStackEntry(const TXMSample& sample,
 	this->selectionStart = selectionStart;
 	this->selectionEnd = selectionEnd;
 	
-	buffer = NULL;
+	chunks = NULL;
+	numChunks = 0;
 
 	checkSum = 0;
 	
 	if (sample.samplen && sample.sample)
 	{
-		// 16 bit sample
-		if (flags & 16)
-		{
-			buffer = TXMSample::allocPaddedMem(samplen*2);
-			if (buffer)
-				TXMSample::copyPaddedMem(buffer, sample.sample, samplen*2);				
-		}
-		else
+		mp_uint32 size = (flags & 16) ? samplen*2 : samplen;
+		const pp_uint8* mem = TXMSample::getPadStartAddr((mp_ubyte*)sample.sample);
+		mp_uint32 realSize = TXMSample::getPaddedSize(size);
+		
+		numChunks = (realSize + SampleUndoChunk::ChunkSize - 1) / SampleUndoChunk::ChunkSize;
+		chunks = new SampleUndoChunk*[numChunks];
+		
+		for (pp_uint32 i = 0; i < numChunks; i++)
 		{
-			buffer = TXMSample::allocPaddedMem(samplen);
-			if (buffer)
-				TXMSample::copyPaddedMem(buffer, sample.sample, samplen);
+			const pp_uint32 offset = i * SampleUndoChunk::ChunkSize;
+			const pp_uint32 chunkSize = realSize - offset < (pp_uint32)SampleUndoChunk::ChunkSize ? 
+										realSize - offset : (pp_uint32)SampleUndoChunk::ChunkSize;
+		
+			if (base && i < base->numChunks && base->chunks[i]->equals(mem + offset, chunkSize))
+			{
+				chunks[i] = base->chunks[i];
+				chunks[i]->addRef();
+			}
+			else
+			{
+				chunks[i] = SampleUndoChunk::create(mem + offset, chunkSize);
+			}
 		}
+		
 		calcCheckSum();
 	}
 }
@@ -284,38 +373,12 @@ SampleUndoStackEntry::SampleUndoStackEntry(const TXMSample& sample,
 SampleUndoStackEntry::SampleUndoStackEntry(const SampleUndoStackEntry& src)	:
 	UndoStackEntry(&src.getUserData())
 {
-	samplen = src.samplen;
-	loopstart = src.loopstart;
-	looplen = src.looplen;	
-	relnote = src.relnote;
-	finetune = src.finetune;
-	flags = src.flags;
-	checkSum = src.checkSum;
-	this->selectionStart = src.selectionStart;
-	this->selectionEnd = src.selectionEnd;
-	
-	buffer = NULL;
-	if (src.buffer && samplen)
-	{	
-		// 16 bit sample
-		if (flags & 16)
-		{			
-			buffer = TXMSample::allocPaddedMem(samplen*2);
-			if (buffer)
-				TXMSample::copyPaddedMem(buffer, src.buffer, samplen*2);
-		}
-		else
-		{
-			buffer = TXMSample::allocPaddedMem(samplen);
-			if (buffer)
-				TXMSample::copyPaddedMem(buffer, src.buffer, samplen);
-		}	
-	}
+	copyFrom(src);
 }
 
 SampleUndoStackEntry::~SampleUndoStackEntry()
 {
-	TXMSample::freePaddedMem(buffer);
+	releaseChunks();
 }
 
 // assignment operator
@@ -325,36 +388,8 @@ SampleUndoStackEntry& SampleUndoStackEntry::operator=(const SampleUndoStackEntry
 	{
 		copyBasePart(src);
 	
-		samplen = src.samplen;
-		loopstart = src.loopstart;
-		looplen = src.looplen;	
-		relnote = src.relnote;
-		finetune = src.finetune;
-		flags = src.flags;
-		checkSum = src.checkSum;
-		
-		if (buffer)
-		{
-			TXMSample::freePaddedMem(buffer);
-			buffer = NULL;
-		}
-		
-		if (src.buffer && samplen)
-		{	
-			// 16 bit sample
-			if (flags & 16)
-			{
-				buffer = TXMSample::allocPaddedMem(samplen*2);
-				if (buffer)
-					TXMSample::copyPaddedMem(buffer, src.buffer, samplen*2);
-			}
-			else
-			{
-				buffer = TXMSample::allocPaddedMem(samplen);
-				if (buffer)
-					TXMSample::copyPaddedMem(buffer, src.buffer, samplen);
-			}	
-		}
+		releaseChunks();
+		copyFrom(src);
 	}
 
 	return (*this);
@@ -384,29 +419,45 @@ bool SampleUndoStackEntry::operator==(const SampleUndoStackEntry& src)
 	if (flags != src.flags)
 		return false;
 	
-	if (buffer == NULL && src.buffer != NULL)
-		return false;
-
-	if (buffer != NULL && src.buffer == NULL)
+	if (numChunks != src.numChunks)
 		return false;
 	
-	mp_uint32 size = (flags & 16) ? samplen*2 : samplen;
-	if (size)
+	for (pp_uint32 i = 0; i < numChunks; i++)
 	{
-		mp_ubyte* _src = src.buffer;
-		mp_ubyte* _dst = buffer;
-
-		mp_ubyte* srcmem = TXMSample::getPadStartAddr(_src);
-		mp_ubyte* dstmem = TXMSample::getPadStartAddr(_dst);
-		mp_uint32 realSize = TXMSample::getPaddedSize(size);
-		for (pp_uint32 i = 0; i < realSize; i++)
-			if (srcmem[i] != dstmem[i])
-				return false;
+		// shared chunks are equal anyway
+		if (chunks[i] == src.chunks[i])
+			continue;
+		
+		if (chunks[i]->getHash() != src.chunks[i]->getHash() ||
+			!chunks[i]->equals(src.chunks[i]->getData(), src.chunks[i]->getSize()))
+			return false;
 	}
 
 	return true;
 }
 
+void SampleUndoStackEntry::copyBuffer(void* dst) const
+{
+	pp_uint8* mem = TXMSample::getPadStartAddr((mp_ubyte*)dst);
+	for (pp_uint32 i = 0; i < numChunks; i++)
+	{
+		memcpy(mem, chunks[i]->getData(), chunks[i]->getSize());
+		mem+=chunks[i]->getSize();
+	}
+}
+
+pp_uint32 SampleUndoStackEntry::getMemSize(const SampleUndoStackEntry* base/* = NULL*/) const
+{
+	pp_uint32 size = 0;
+	for (pp_uint32 i = 0; i < numChunks; i++)
+	{
+		if (base && i < base->numChunks && base->chunks[i] == chunks[i])
+			continue;
+		size+=chunks[i]->getSize();
+	}
+	return size;
+}
+
 bool SampleUndoStackEntry::operator!=(const SampleUndoStackEntry& source)
 {
 	return !(*this==source);
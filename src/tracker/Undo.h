@@ -33,8 +33,10 @@
 #define UNDODEPTH_PATTERNEDITOR			32
 #define UNDOHISTORYSIZE_PATTERNEDITOR	8
 
-#define UNDODEPTH_SAMPLEEDITOR			16
+#define UNDODEPTH_SAMPLEEDITOR			64
 #define UNDOHISTORYSIZE_SAMPLEEDITOR	4
+// memory limit of a sample undo stack in MB (the depth above is only an upper bound)
+#define UNDOMEMORY_SAMPLEEDITOR			128
 
 //--- This is what we save --------------------------------------------------
 class UndoStackEntry
@@ -223,19 +225,59 @@ private:
 
 struct TXMSample;
 
+// Sample data in the undo stack is split into fixed size chunks which are
+// never modified once created. They are reference counted, so undo states
+// which follow each other share all chunks an operation didn't touch and
+// an undo step only costs about as much memory as the edit itself.
+class SampleUndoChunk
+{
+public:
+	enum
+	{
+		ChunkSize = 65536
+	};
+
+private:
+	pp_uint8* data;
+	pp_uint32 size;
+	pp_uint32 hash;
+	pp_int32 refCount;
+
+	SampleUndoChunk(const pp_uint8* src, pp_uint32 size);
+	~SampleUndoChunk();
+
+public:
+	static SampleUndoChunk* create(const pp_uint8* src, pp_uint32 size);
+
+	void addRef() { refCount++; }
+	void release() { if (--refCount == 0) delete this; }
+
+	const pp_uint8* getData() const { return data; }
+	pp_uint32 getSize() const { return size; }
+	pp_uint32 getHash() const { return hash; }
+	
+	bool equals(const pp_uint8* src, pp_uint32 size) const;
+
+	static pp_uint32 calcHash(const pp_uint8* src, pp_uint32 size);
+};
+
 // Undo information from Sample Editor
 class SampleUndoStackEntry : public UndoStackEntry
 {
 public:
 	SampleUndoStackEntry() : 
-		UndoStackEntry(NULL)
+		UndoStackEntry(NULL),
+		chunks(NULL),
+		numChunks(0)
 	{
 	}
 
+	// chunks which are unchanged from the base entry are shared with it
 	SampleUndoStackEntry(const TXMSample& sample, 
 						 pp_int32 selectionStart, 
 						 pp_int32 selectionEnd, 
-						 const UserData* userData = NULL);
+						 const UserData* userData = NULL,
+						 const SampleUndoStackEntry* base = NULL);
 						 
 	SampleUndoStackEntry(const SampleUndoStackEntry& src);
 						 
@@ -255,17 +297,25 @@ public:
 	mp_sbyte getRelNote() const { return relnote; }
 	mp_sbyte getFineTune() const { return finetune; }
 	
-	const pp_uint8* getBuffer() const { return buffer; }
+	bool hasBuffer() const { return numChunks != 0; }
+	// copy sample data including padding into memory from TXMSample::allocPaddedMem
+	void copyBuffer(void* dst) const;
 	
 	pp_int32 getSelectionStart() const { return selectionStart; }
 	pp_int32 getSelectionEnd() const { return selectionEnd; }
 	
+	// memory used by the chunks which aren't shared with the given entry
+	pp_uint32 getMemSize(const SampleUndoStackEntry* base = NULL) const;
+	
 private:
 	// from sample
 	pp_uint32 samplen, loopstart, looplen;
 	mp_sbyte relnote, finetune;
-	pp_uint8* buffer;
 	pp_uint8 flags;
+	
+	// padded sample memory
+	SampleUndoChunk** chunks;
+	pp_uint32 numChunks;
 
 	// from sample editor
 	pp_int32 selectionStart;
@@ -273,6 +323,8 @@ private:
 
 	pp_int32 checkSum;
 	
+	void copyFrom(const SampleUndoStackEntry& src);
+	void releaseChunks();
 	void calcCheckSum();
 };
 